@@ -0,0 +1,269 @@
+#pragma once
+// 圧縮した頂点（位置は unorm16、UV は half、法線は八面体写像した snorm16 の 16 バイト）への変換と、戻したときの誤差の計測。
+// Windows のヘッダーに依存しないので、tests/ の Linux 向けのテストからもそのまま使う
+#include "MeshData.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// 圧縮した頂点（16バイト）。位置はメッシュを囲む箱の中での unorm16、UV は half、法線は八面体写像した snorm16
+struct CompactVertexData
+{
+	uint16_t position[4];   // w は使わない（シェーダーで 1 にする）
+	uint16_t texcoord[2];
+	int16_t normal[2];
+};
+static_assert(sizeof(CompactVertexData) == 16, "CompactVertexData must stay 16 bytes");
+
+// 圧縮頂点の位置を元に戻すための、メッシュを囲む箱。ルート定数（b3）としてシェーダーに渡す
+struct VertexQuantization
+{
+	Vector3 positionMin;
+	float padding0;
+	Vector3 positionExtent;
+	float padding1;
+};
+
+// 圧縮頂点の誤差（各要素の最大値）
+struct CompactVertexError
+{
+	float position;   // 位置の軸ごとの誤差を、量子化の1段の幅で割ったもの（丸めなら 0.5 以下）
+	float texcoord;   // UV の誤差を half の精度で割ったもの（丸めなら 0.5 以下）
+	float normal;     // 法線の角度の誤差（ラジアン）
+};
+
+// 八面体写像した snorm16 の法線で許す角度の誤差（ラジアン）
+const float kOctahedralNormalMaxError = 1.0e-4f;
+
+/// <summary>
+/// 頂点を囲む箱を求める
+/// </summary>
+/// <param name="vertices">頂点</param>
+inline VertexQuantization ComputeVertexQuantization(const std::vector<VertexData>& vertices)
+{
+	VertexQuantization quantization{};
+	if (vertices.empty()) {
+		return quantization;
+	}
+
+	Vector3 minimum{ FLT_MAX, FLT_MAX, FLT_MAX };
+	Vector3 maximum{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (const VertexData& vertex : vertices) {
+		minimum = { std::min(minimum.x, vertex.position.x), std::min(minimum.y, vertex.position.y), std::min(minimum.z, vertex.position.z) };
+		maximum = { std::max(maximum.x, vertex.position.x), std::max(maximum.y, vertex.position.y), std::max(maximum.z, vertex.position.z) };
+	}
+	quantization.positionMin = minimum;
+	quantization.positionExtent = { maximum.x - minimum.x, maximum.y - minimum.y, maximum.z - minimum.z };
+	return quantization;
+}
+
+/// <summary>
+/// float を half（IEEE 754 の16ビット浮動小数点数）にする。最も近い値に丸め、ちょうど中間なら偶数の側にする（F16C の vcvtps2ph と同じ）
+/// </summary>
+inline uint16_t ConvertFloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, 4);
+	const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+	const uint32_t absolute = bits & 0x7FFFFFFF;
+
+	auto roundShift = [](uint32_t mantissa, uint32_t shift) {
+		const uint32_t result = mantissa >> shift;
+		const uint32_t remainder = mantissa & ((1u << shift) - 1);
+		const uint32_t halfway = 1u << (shift - 1);
+		return result + ((remainder > halfway || (remainder == halfway && (result & 1))) ? 1u : 0u);
+	};
+
+	if (absolute >= 0x7F800000) {
+		// 無限大と NaN（NaN は静かな NaN にする）
+		return sign | 0x7C00 | (absolute > 0x7F800000 ? 0x0200 : 0);
+	}
+	if (absolute >= 0x477FF000) {
+		// 65520 以上は half の最大値 65504 より無限大に近い
+		return sign | 0x7C00;
+	}
+	if (absolute >= 0x38800000) {
+		// 正規化数。指数を付け替えて仮数の下 13 ビットを丸める（繰り上がりは指数に入る）
+		return sign | static_cast<uint16_t>(roundShift(absolute - (112u << 23), 13));
+	}
+	// 2^-14 より小さいものは非正規化数（2^-24 単位）。2^-25 以下は 0 に丸まる
+	const uint32_t exponent = absolute >> 23;
+	if (exponent < 102) {
+		return sign;
+	}
+	return sign | static_cast<uint16_t>(roundShift((absolute & 0x007FFFFF) | 0x00800000, 126 - exponent));
+}
+
+/// <summary>
+/// half を float に戻す（誤差なく戻る）
+/// </summary>
+inline float ConvertHalfToFloat(uint16_t value)
+{
+	const uint32_t sign = uint32_t(value & 0x8000) << 16;
+	const uint32_t exponent = (value >> 10) & 0x1F;
+	const uint32_t mantissa = value & 0x03FF;
+	uint32_t bits;
+	if (exponent == 0) {
+		// 0 と非正規化数
+		const float magnitude = ldexpf(float(mantissa), -24);
+		memcpy(&bits, &magnitude, 4);
+		bits |= sign;
+	} else if (exponent == 31) {
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	} else {
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+	float result;
+	memcpy(&result, &bits, 4);
+	return result;
+}
+
+inline uint16_t QuantizeUnorm16(float value)
+{
+	return static_cast<uint16_t>(std::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+}
+
+inline int16_t QuantizeSnorm16(float value)
+{
+	return static_cast<int16_t>(lroundf(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+/// <summary>
+/// 単位ベクトルを八面体に写して2つの snorm16 にする
+/// </summary>
+inline void EncodeOctahedralNormal(const Vector3& normal, int16_t encoded[2])
+{
+	const float length = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+	if (length == 0.0f) {
+		encoded[0] = 0;
+		encoded[1] = 0;
+		return;
+	}
+
+	float x = normal.x / length;
+	float y = normal.y / length;
+	if (normal.z < 0.0f) {
+		// 下半分は外側の三角形に折り返す
+		const float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		const float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+	encoded[0] = QuantizeSnorm16(x);
+	encoded[1] = QuantizeSnorm16(y);
+}
+
+/// <summary>
+/// 八面体写像した法線を単位ベクトルに戻す（Object3D.VS.hlsl の DecodeOctahedralNormal と同じ計算）
+/// </summary>
+inline Vector3 DecodeOctahedralNormal(const int16_t encoded[2])
+{
+	Vector3 normal{ std::max(encoded[0] / 32767.0f, -1.0f), std::max(encoded[1] / 32767.0f, -1.0f), 0.0f };
+	normal.z = 1.0f - fabsf(normal.x) - fabsf(normal.y);
+	const float t = std::clamp(-normal.z, 0.0f, 1.0f);
+	normal.x += normal.x >= 0.0f ? -t : t;
+	normal.y += normal.y >= 0.0f ? -t : t;
+	return Normalize(normal);
+}
+
+/// <summary>
+/// 頂点を圧縮頂点にする
+/// </summary>
+/// <param name="vertices">頂点</param>
+/// <param name="quantization">ComputeVertexQuantization で求めた箱</param>
+inline std::vector<CompactVertexData> EncodeCompactVertices(const std::vector<VertexData>& vertices, const VertexQuantization& quantization)
+{
+	// 厚みの無い軸（平面など）は 0 で割らないようにする
+	const Vector3& extent = quantization.positionExtent;
+	const Vector3 scale{ extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f, extent.z > 0.0f ? 1.0f / extent.z : 0.0f };
+
+	std::vector<CompactVertexData> compactVertices(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i) {
+		const VertexData& vertex = vertices[i];
+		CompactVertexData& compact = compactVertices[i];
+		compact.position[0] = QuantizeUnorm16((vertex.position.x - quantization.positionMin.x) * scale.x);
+		compact.position[1] = QuantizeUnorm16((vertex.position.y - quantization.positionMin.y) * scale.y);
+		compact.position[2] = QuantizeUnorm16((vertex.position.z - quantization.positionMin.z) * scale.z);
+		compact.position[3] = 0;
+		compact.texcoord[0] = ConvertFloatToHalf(vertex.texcoord.x);
+		compact.texcoord[1] = ConvertFloatToHalf(vertex.texcoord.y);
+		EncodeOctahedralNormal(vertex.normal, compact.normal);
+	}
+	return compactVertices;
+}
+
+/// <summary>
+/// 圧縮頂点を元の形式に戻す（頂点シェーダーの mainCompact と同じ計算）
+/// </summary>
+inline VertexData DecodeCompactVertex(const CompactVertexData& compact, const VertexQuantization& quantization)
+{
+	VertexData vertex{};
+	vertex.position = {
+		quantization.positionMin.x + compact.position[0] / 65535.0f * quantization.positionExtent.x,
+		quantization.positionMin.y + compact.position[1] / 65535.0f * quantization.positionExtent.y,
+		quantization.positionMin.z + compact.position[2] / 65535.0f * quantization.positionExtent.z,
+		1.0f
+	};
+	vertex.texcoord = {
+		ConvertHalfToFloat(compact.texcoord[0]),
+		ConvertHalfToFloat(compact.texcoord[1])
+	};
+	vertex.normal = DecodeOctahedralNormal(compact.normal);
+	return vertex;
+}
+
+/// <summary>
+/// 圧縮頂点を戻したときの誤差を測る
+/// </summary>
+/// <param name="vertices">元の頂点</param>
+/// <param name="compactVertices">圧縮した頂点</param>
+/// <param name="quantization">圧縮に使った箱</param>
+inline CompactVertexError MeasureCompactVertexError(const std::vector<VertexData>& vertices, const std::vector<CompactVertexData>& compactVertices, const VertexQuantization& quantization)
+{
+	CompactVertexError error{};
+	const float positionSteps[3] = { quantization.positionExtent.x / 65535.0f, quantization.positionExtent.y / 65535.0f, quantization.positionExtent.z / 65535.0f };
+
+	for (size_t i = 0; i < vertices.size(); ++i) {
+		const VertexData& original = vertices[i];
+		const VertexData decoded = DecodeCompactVertex(compactVertices[i], quantization);
+
+		const float positionErrors[3] = {
+			fabsf(decoded.position.x - original.position.x),
+			fabsf(decoded.position.y - original.position.y),
+			fabsf(decoded.position.z - original.position.z)
+		};
+		for (int axis = 0; axis < 3; ++axis) {
+			// 厚みの無い軸は誤差も 0 になるはずなので、そのまま差を見る
+			error.position = std::max(error.position, positionSteps[axis] > 0.0f ? positionErrors[axis] / positionSteps[axis] : positionErrors[axis]);
+		}
+
+		// half の1段の幅は値の大きさの 2^-10 倍（0 付近は非正規化数の 2^-24）
+		const float originalTexcoords[2] = { original.texcoord.x, original.texcoord.y };
+		const float decodedTexcoords[2] = { decoded.texcoord.x, decoded.texcoord.y };
+		for (int k = 0; k < 2; ++k) {
+			int exponent = 0;
+			frexpf(std::max(fabsf(originalTexcoords[k]), 6.103515625e-05f), &exponent);
+			const float halfStep = ldexpf(1.0f, exponent - 11);
+			error.texcoord = std::max(error.texcoord, fabsf(decodedTexcoords[k] - originalTexcoords[k]) / halfStep);
+		}
+
+		// 小さい角度は acos では精度が足りないので、弦の長さから求める
+		const Vector3 originalNormal = Normalize(original.normal);
+		const Vector3 difference{ decoded.normal.x - originalNormal.x, decoded.normal.y - originalNormal.y, decoded.normal.z - originalNormal.z };
+		const float chord = sqrtf(difference.x * difference.x + difference.y * difference.y + difference.z * difference.z);
+		error.normal = std::max(error.normal, 2.0f * asinf(std::min(chord * 0.5f, 1.0f)));
+	}
+	return error;
+}
+
+/// <summary>
+/// 圧縮頂点の誤差が丸めで生じる範囲に収まっているかどうか
+/// </summary>
+inline bool IsCompactVertexErrorWithinBounds(const CompactVertexError& error)
+{
+	// 位置と UV は丸めなので1段の半分まで（float の計算誤差のぶん少し余裕を見る）
+	return error.position <= 0.51f && error.texcoord <= 0.501f && error.normal <= kOctahedralNormalMaxError;
+}
@@ -0,0 +1,133 @@
+#pragma once
+// ディスクリプタの割り当て（世代付きのハンドルで配るずっと使う領域と、フレームごとに使い捨てる領域）。
+// Windows のヘッダーに依存しないので、tests/ の Linux 向けのテストからもそのまま使う
+#include <cstdint>
+#include <cassert>
+#include <vector>
+
+// ----------------------------------------------------------------------------
+// ディスクリプタの割り当て
+// シェーダーから見えるヒープを、ずっと使うディスクリプタ（テクスチャなど）の領域と、フレームごとに使い捨てる領域に分ける。
+// ずっと使う領域は空き番号のスタックから配り、解放するたびに番号の世代を進める。ハンドルは世代を持つので、
+// 解放した後の古いハンドルは IsDescriptorHandleValid で見分けられる。
+// 使い捨ての領域はフレームの組ごとに区切り、先頭から順に配ってフレームの始めに戻す（FrameRing がその組の完了を待った後なので安全）
+// ----------------------------------------------------------------------------
+const uint32_t kInvalidDescriptorIndex = UINT32_MAX;
+
+struct DescriptorHandle
+{
+	// ずっと使う領域の中での番号
+	uint32_t index = kInvalidDescriptorIndex;
+	// 割り当てたときの世代（奇数）
+	uint32_t generation = 0;
+};
+
+struct DescriptorAllocator
+{
+	// ずっと使う領域のヒープの中での先頭と数
+	uint32_t persistentBase = 0;
+	uint32_t persistentCapacity = 0;
+	// 空いている番号（末尾から配る）
+	std::vector<uint32_t> freeSlots;
+	// 番号ごとの世代。割り当てと解放で1つずつ進めるので、奇数なら使用中
+	std::vector<uint32_t> generations;
+	// 使い捨ての領域（ずっと使う領域の後ろに、1フレーム transientCapacity 個ずつ frameCount 組）
+	uint32_t transientBase = 0;
+	uint32_t transientCapacity = 0;
+	uint32_t frameCount = 0;
+	uint32_t transientFrame = 0;
+	uint32_t transientUsed = 0;
+};
+
+/// <summary>
+/// ヒープの persistentBase 番目から、ずっと使う領域を persistentCapacity 個、その後ろに使い捨ての領域をフレームの数だけ取る
+/// </summary>
+inline void InitializeDescriptorAllocator(DescriptorAllocator& allocator, uint32_t persistentBase, uint32_t persistentCapacity, uint32_t transientCapacityPerFrame, uint32_t frameCount)
+{
+	assert(frameCount >= 1);
+	allocator = {};
+	allocator.persistentBase = persistentBase;
+	allocator.persistentCapacity = persistentCapacity;
+	allocator.generations.assign(persistentCapacity, 0);
+	// 小さい番号から配るよう、逆順に積む
+	allocator.freeSlots.resize(persistentCapacity);
+	for (uint32_t i = 0; i < persistentCapacity; ++i) {
+		allocator.freeSlots[i] = persistentCapacity - 1 - i;
+	}
+	allocator.transientBase = persistentBase + persistentCapacity;
+	allocator.transientCapacity = transientCapacityPerFrame;
+	allocator.frameCount = frameCount;
+}
+
+/// <summary>
+/// ヒープに必要なディスクリプタの数
+/// </summary>
+inline uint32_t GetDescriptorHeapSize(const DescriptorAllocator& allocator)
+{
+	return allocator.transientBase + allocator.transientCapacity * allocator.frameCount;
+}
+
+/// <summary>
+/// ずっと使うディスクリプタを1つ割り当てる。空きがなければ index が kInvalidDescriptorIndex のハンドルを返す
+/// </summary>
+inline DescriptorHandle AllocateDescriptor(DescriptorAllocator& allocator)
+{
+	if (allocator.freeSlots.empty()) {
+		return {};
+	}
+	const uint32_t index = allocator.freeSlots.back();
+	allocator.freeSlots.pop_back();
+	const uint32_t generation = ++allocator.generations[index];
+	assert(generation & 1);
+	return { index, generation };
+}
+
+inline bool IsDescriptorHandleValid(const DescriptorAllocator& allocator, const DescriptorHandle& handle)
+{
+	return handle.index < allocator.persistentCapacity && allocator.generations[handle.index] == handle.generation;
+}
+
+inline void FreeDescriptor(DescriptorAllocator& allocator, const DescriptorHandle& handle)
+{
+	// 解放済みのハンドルや、別の世代のハンドルで解放しない
+	assert(IsDescriptorHandleValid(allocator, handle));
+	++allocator.generations[handle.index];
+	allocator.freeSlots.push_back(handle.index);
+}
+
+/// <summary>
+/// ハンドルのディスクリプタが、ヒープの何番目にあるか
+/// </summary>
+inline uint32_t GetDescriptorHeapIndex(const DescriptorAllocator& allocator, const DescriptorHandle& handle)
+{
+	assert(IsDescriptorHandleValid(allocator, handle));
+	return allocator.persistentBase + handle.index;
+}
+
+inline uint32_t GetLiveDescriptorCount(const DescriptorAllocator& allocator)
+{
+	return allocator.persistentCapacity - static_cast<uint32_t>(allocator.freeSlots.size());
+}
+
+/// <summary>
+/// フレームの始めに呼ぶ。この組の使い捨ての領域を空にする（GPU がこの組を読み終えた後に呼ぶこと）
+/// </summary>
+inline void BeginDescriptorFrame(DescriptorAllocator& allocator, uint32_t frameIndex)
+{
+	assert(frameIndex < allocator.frameCount);
+	allocator.transientFrame = frameIndex;
+	allocator.transientUsed = 0;
+}
+
+/// <summary>
+/// このフレームだけ使うディスクリプタを count 個続けて割り当て、先頭のヒープの中での番号を返す。入らなければ kInvalidDescriptorIndex
+/// </summary>
+inline uint32_t AllocateTransientDescriptors(DescriptorAllocator& allocator, uint32_t count)
+{
+	if (allocator.transientUsed + count > allocator.transientCapacity) {
+		return kInvalidDescriptorIndex;
+	}
+	const uint32_t index = allocator.transientBase + allocator.transientCapacity * allocator.transientFrame + allocator.transientUsed;
+	allocator.transientUsed += count;
+	return index;
+}
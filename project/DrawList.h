@@ -0,0 +1,382 @@
+#pragma once
+// インスタンス描画の一覧（行列の詰め込み・64 ビットのキーでの並べ替え・状態の切り替えを減らして出す SubmitInstancedDrawList）。
+// Windows のヘッダーに依存しないので、tests/ の Linux 向けのテストからもそのまま使う
+#include "MathKernels.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <bit>
+#include <vector>
+
+// 描画するインデックスの範囲
+struct IndexRange
+{
+	uint32_t indexOffset;
+	uint32_t indexCount;
+};
+
+// ----------------------------------------------------------------------------
+// インスタンス描画
+// 物体ごとの行列はすべて1本のインスタンスバッファ（StructuredBuffer）に並べ、頂点シェーダーで
+// SV_InstanceID + 先頭の位置（ルート定数）で引く。同じメッシュを何個描いても Draw は1回で済む
+// ----------------------------------------------------------------------------
+
+// 描画に使うPSO・マテリアル・テクスチャの番号（実際のリソースとの対応は backend が持つ）
+struct DrawState
+{
+	uint32_t pipeline;
+	uint32_t material;
+	uint32_t texture;
+};
+
+// 並べ替えのキーの各部分のビット数。上位から、切り替えの重いPSO・マテリアル・テクスチャ・メッシュ・深度の順に並べる
+const uint32_t kDrawKeyPipelineBits = 4;
+const uint32_t kDrawKeyMaterialBits = 8;
+const uint32_t kDrawKeyTextureBits = 8;
+const uint32_t kDrawKeyModelBits = 6;
+const uint32_t kDrawKeyMeshBits = 10;
+const uint32_t kDrawKeyDepthBits = 28;
+static_assert(kDrawKeyPipelineBits + kDrawKeyMaterialBits + kDrawKeyTextureBits + kDrawKeyModelBits + kDrawKeyMeshBits + kDrawKeyDepthBits == 64);
+
+/// <summary>
+/// 描画を並べ替える 64 ビットのキーを作る。状態が同じ描画は隣り合い、同じメッシュの中では手前から順になる
+/// </summary>
+/// <param name="depth">カメラからの距離（ビュー空間の z）。負の値は 0 として扱う</param>
+inline uint64_t MakeDrawSortKey(const DrawState& state, uint32_t modelIndex, uint32_t meshIndex, float depth)
+{
+	assert(state.pipeline < (1u << kDrawKeyPipelineBits));
+	assert(state.material < (1u << kDrawKeyMaterialBits));
+	assert(state.texture < (1u << kDrawKeyTextureBits));
+	assert(modelIndex < (1u << kDrawKeyModelBits));
+	assert(meshIndex < (1u << kDrawKeyMeshBits));
+	// 正の float はビット列を整数として比べても大小が変わらないので、上位のビットをそのまま使う
+	const uint32_t depthBits = std::bit_cast<uint32_t>(std::max(depth, 0.0f)) >> (32 - kDrawKeyDepthBits);
+
+	uint64_t key = state.pipeline;
+	key = (key << kDrawKeyMaterialBits) | state.material;
+	key = (key << kDrawKeyTextureBits) | state.texture;
+	key = (key << kDrawKeyModelBits) | modelIndex;
+	key = (key << kDrawKeyMeshBits) | meshIndex;
+	key = (key << kDrawKeyDepthBits) | depthBits;
+	return key;
+}
+
+/// <summary>
+/// 1つのメッシュのインデックスの範囲を、インスタンスバッファに続けて並べた instanceCount 個の行列で描く
+/// </summary>
+struct InstancedDraw
+{
+	uint64_t sortKey;
+	DrawState state;
+	uint32_t modelIndex;
+	uint32_t meshIndex;
+	IndexRange indexRange;
+	uint32_t firstInstance; // インスタンスバッファの何番目の行列から使うか
+	uint32_t instanceCount;
+};
+
+// 基数ソートで並べ替える、キーと描画の番号の組
+struct DrawSortEntry
+{
+	uint64_t key;
+	uint32_t drawIndex;
+};
+
+/// <summary>
+/// 1フレームぶんの描画の一覧。インスタンスの行列は1本の配列に隙間なく詰める。
+/// BeginInstancedDrawList でマップしたインスタンスバッファを渡すと、行列をそこへ直接詰める（コピーは物体ごとに1回で済む）。
+/// ClearInstancedDrawList で始めたときは instanceStorage に詰め、UploadInstances でまとめて送る
+/// </summary>
+struct InstancedDrawList
+{
+	TransformationMatrix* instances = nullptr;  // 詰めた行列の先頭（instanceStorage か、マップしたインスタンスバッファ）
+	uint32_t instanceCount = 0;
+	uint32_t instanceCapacity = 0;
+	bool writesInPlace = false;                 // instances がマップしたインスタンスバッファを指している
+	std::vector<TransformationMatrix> instanceStorage;
+	std::vector<InstancedDraw> draws;
+	// 並べ替えの作業用（フレームをまたいで使い回す）
+	std::vector<DrawSortEntry> sortEntries;
+	std::vector<DrawSortEntry> sortScratch;
+	std::vector<InstancedDraw> drawScratch;
+};
+
+/// <summary>
+/// 一覧を空にして、行列を instanceStorage に詰めるようにする（確保したメモリは次のフレームでも使い回す）
+/// </summary>
+inline void ClearInstancedDrawList(InstancedDrawList& drawList)
+{
+	drawList.instances = drawList.instanceStorage.data();
+	drawList.instanceCount = 0;
+	drawList.instanceCapacity = static_cast<uint32_t>(drawList.instanceStorage.size());
+	drawList.writesInPlace = false;
+	drawList.draws.clear();
+}
+
+/// <summary>
+/// 一覧を空にして、行列をマップしたインスタンスバッファへ直接詰めるようにする（UploadInstances は要らない）
+/// </summary>
+/// <param name="destination">マップしたインスタンスバッファの先頭（書き込み結合のメモリなので、詰めた行列を読み返さないこと）</param>
+/// <param name="capacity">インスタンスバッファに入る行列の数</param>
+inline void BeginInstancedDrawList(InstancedDrawList& drawList, TransformationMatrix* destination, size_t capacity)
+{
+	drawList.instances = destination;
+	drawList.instanceCount = 0;
+	drawList.instanceCapacity = static_cast<uint32_t>(capacity);
+	drawList.writesInPlace = true;
+	drawList.draws.clear();
+}
+
+/// <summary>
+/// 行列を count 個続けて詰める場所を確保する。instanceStorage に詰めているときは足りなければ広げる
+/// </summary>
+/// <returns>確保した先頭の行列（番号は instanceCount - count）</returns>
+inline TransformationMatrix* ReserveInstances(InstancedDrawList& drawList, size_t count)
+{
+	const size_t required = size_t(drawList.instanceCount) + count;
+	if (required > drawList.instanceCapacity) {
+		// マップしたインスタンスバッファは広げられないので、BeginInstancedDrawList に十分な数を渡しておくこと
+		assert(!drawList.writesInPlace);
+		drawList.instanceStorage.resize(std::max(required, drawList.instanceStorage.size() * 2));
+		drawList.instances = drawList.instanceStorage.data();
+		drawList.instanceCapacity = static_cast<uint32_t>(drawList.instanceStorage.size());
+	}
+	TransformationMatrix* destination = drawList.instances + drawList.instanceCount;
+	drawList.instanceCount = static_cast<uint32_t>(required);
+	return destination;
+}
+
+/// <summary>
+/// 行列を続けてインスタンスバッファに詰める
+/// </summary>
+/// <returns>詰めた先頭のインスタンスの番号</returns>
+inline uint32_t AppendInstances(InstancedDrawList& drawList, const TransformationMatrix* matrices, size_t count)
+{
+	const uint32_t firstInstance = drawList.instanceCount;
+	if (count > 0) {
+		std::memcpy(ReserveInstances(drawList, count), matrices, sizeof(TransformationMatrix) * count);
+	}
+	return firstInstance;
+}
+
+/// <summary>
+/// カリングで残った物体の行列だけを、隙間なく詰める
+/// </summary>
+/// <param name="matrices">すべての物体の行列</param>
+/// <param name="indices">詰める物体の番号（CullBounds などの結果）</param>
+/// <returns>詰めた先頭のインスタンスの番号</returns>
+inline uint32_t PackInstances(InstancedDrawList& drawList, const TransformationMatrix* matrices, const uint32_t* indices, size_t count)
+{
+	const uint32_t firstInstance = drawList.instanceCount;
+	TransformationMatrix* destination = ReserveInstances(drawList, count);
+	for (size_t i = 0; i < count; ++i) {
+		std::memcpy(&destination[i], &matrices[indices[i]], sizeof(TransformationMatrix));
+	}
+	return firstInstance;
+}
+
+/// <summary>
+/// 描画を追加する。インスタンスが1つもなければ何もしない
+/// </summary>
+/// <param name="depth">並べ替えに使うカメラからの距離</param>
+inline void AddInstancedDraw(InstancedDrawList& drawList, const DrawState& state, uint32_t modelIndex, uint32_t meshIndex, const IndexRange& indexRange, uint32_t firstInstance, uint32_t instanceCount, float depth = 0.0f)
+{
+	assert(firstInstance + instanceCount <= drawList.instanceCount);
+	if (instanceCount == 0 || indexRange.indexCount == 0) {
+		return;
+	}
+	drawList.draws.push_back({ MakeDrawSortKey(state, modelIndex, meshIndex, depth), state, modelIndex, meshIndex, indexRange, firstInstance, instanceCount });
+}
+
+// これより少ない描画は、ヒストグラムを作る手間のほうが大きいので比較ソートで並べる
+const size_t kRadixSortMinDrawCount = 1024;
+
+/// <summary>
+/// キーを下の桁から 8 ビットずつ数え上げソートする（LSD 基数ソート）。
+/// 安定なので、同じキーの描画は追加した順のまま残る。全部同じ値の桁は飛ばす
+/// </summary>
+/// <param name="entries">並べ替える組（結果もここに入る）</param>
+/// <param name="scratch">作業用</param>
+inline void RadixSortDrawKeys(std::vector<DrawSortEntry>& entries, std::vector<DrawSortEntry>& scratch)
+{
+	const size_t count = entries.size();
+	if (count < kRadixSortMinDrawCount) {
+		std::stable_sort(entries.begin(), entries.end(), [](const DrawSortEntry& a, const DrawSortEntry& b) { return a.key < b.key; });
+		return;
+	}
+	scratch.resize(count);
+
+	// すべての桁のヒストグラムを、1回たどるだけで数える
+	uint32_t histograms[8][256] = {};
+	for (const DrawSortEntry& entry : entries) {
+		for (int pass = 0; pass < 8; ++pass) {
+			++histograms[pass][(entry.key >> (pass * 8)) & 0xFF];
+		}
+	}
+
+	for (int pass = 0; pass < 8; ++pass) {
+		const int shift = pass * 8;
+		uint32_t* histogram = histograms[pass];
+		if (histogram[(entries[0].key >> shift) & 0xFF] == count) {
+			continue;
+		}
+		// 各値の書き込み先の先頭を求める
+		uint32_t offset = 0;
+		for (int digit = 0; digit < 256; ++digit) {
+			const uint32_t digitCount = histogram[digit];
+			histogram[digit] = offset;
+			offset += digitCount;
+		}
+		for (const DrawSortEntry& entry : entries) {
+			scratch[histogram[(entry.key >> shift) & 0xFF]++] = entry;
+		}
+		entries.swap(scratch);
+	}
+}
+
+/// <summary>
+/// 描画をキーの順に並べ替える（インスタンスの行列は動かさない）
+/// </summary>
+inline void SortInstancedDrawList(InstancedDrawList& drawList)
+{
+	drawList.sortEntries.resize(drawList.draws.size());
+	for (uint32_t i = 0; i < drawList.draws.size(); ++i) {
+		drawList.sortEntries[i] = { drawList.draws[i].sortKey, i };
+	}
+	RadixSortDrawKeys(drawList.sortEntries, drawList.sortScratch);
+
+	drawList.drawScratch.resize(drawList.draws.size());
+	for (size_t i = 0; i < drawList.sortEntries.size(); ++i) {
+		drawList.drawScratch[i] = drawList.draws[drawList.sortEntries[i].drawIndex];
+	}
+	drawList.draws.swap(drawList.drawScratch);
+}
+
+/// <summary>
+/// instanceStorage に詰めたインスタンスの行列を、マップしたインスタンスバッファへまとめて1回でコピーする
+/// （BeginInstancedDrawList で直接詰めたときは要らない）
+/// </summary>
+/// <param name="destination">マップしたインスタンスバッファの先頭</param>
+/// <param name="capacity">インスタンスバッファに入る行列の数</param>
+inline void UploadInstances(const InstancedDrawList& drawList, void* destination, size_t capacity)
+{
+	assert(!drawList.writesInPlace);
+	assert(drawList.instanceCount <= capacity);
+	const size_t count = std::min<size_t>(drawList.instanceCount, capacity);
+	if (count > 0) {
+		std::memcpy(destination, drawList.instances, sizeof(TransformationMatrix) * count);
+	}
+}
+
+// 1回の描画で設定する状態の数（PSO・マテリアル・テクスチャ・トポロジ・メッシュ・インスタンスの先頭の位置）
+const uint32_t kStateCommandsPerDraw = 6;
+
+// 描画の一覧を出した結果
+struct DrawSubmitStatistics
+{
+	uint32_t draws;
+	uint32_t stateCommands;                  // 実際に出した、状態を設定するコマンドの数
+	uint32_t redundantStateCommandsAvoided;  // 描画ごとにすべて設定し直す場合と比べて、省いた数
+};
+
+/// <summary>
+/// 描画の一覧をコマンドに変換して backend に出す。状態は直前と変わったときだけ設定し直す
+/// （先に SortInstancedDrawList で並べ替えておくと、同じ状態の描画が続いて設定が減る）。
+/// backend は SetPipeline(pipeline) / SetMaterial(material) / SetTexture(texture) / SetPrimitiveTopology() /
+/// SetMesh(modelIndex, meshIndex) / SetFirstInstance(firstInstance) /
+/// DrawIndexedInstanced(indexCount, instanceCount, startIndexLocation) を持つ型（D3D12 のコマンドリストに出すものと、記録するだけのもの）
+/// </summary>
+template<typename CommandBackend>
+DrawSubmitStatistics SubmitInstancedDrawList(const InstancedDrawList& drawList, CommandBackend& backend)
+{
+	DrawSubmitStatistics statistics{};
+	uint32_t currentPipeline = UINT32_MAX;
+	uint32_t currentMaterial = UINT32_MAX;
+	uint32_t currentTexture = UINT32_MAX;
+	bool primitiveTopologySet = false;
+	uint32_t currentModel = UINT32_MAX;
+	uint32_t currentMesh = UINT32_MAX;
+	uint32_t currentFirstInstance = UINT32_MAX;
+	for (const InstancedDraw& draw : drawList.draws) {
+		if (draw.state.pipeline != currentPipeline) {
+			currentPipeline = draw.state.pipeline;
+			backend.SetPipeline(draw.state.pipeline);
+			++statistics.stateCommands;
+		}
+		if (draw.state.material != currentMaterial) {
+			currentMaterial = draw.state.material;
+			backend.SetMaterial(draw.state.material);
+			++statistics.stateCommands;
+		}
+		if (draw.state.texture != currentTexture) {
+			currentTexture = draw.state.texture;
+			backend.SetTexture(draw.state.texture);
+			++statistics.stateCommands;
+		}
+		// 描くのは三角形リストだけなので、トポロジは最初に1回設定すればよい
+		if (!primitiveTopologySet) {
+			primitiveTopologySet = true;
+			backend.SetPrimitiveTopology();
+			++statistics.stateCommands;
+		}
+		if (draw.modelIndex != currentModel || draw.meshIndex != currentMesh) {
+			currentModel = draw.modelIndex;
+			currentMesh = draw.meshIndex;
+			backend.SetMesh(draw.modelIndex, draw.meshIndex);
+			++statistics.stateCommands;
+		}
+		if (draw.firstInstance != currentFirstInstance) {
+			currentFirstInstance = draw.firstInstance;
+			backend.SetFirstInstance(draw.firstInstance);
+			++statistics.stateCommands;
+		}
+		backend.DrawIndexedInstanced(draw.indexRange.indexCount, draw.instanceCount, draw.indexRange.indexOffset);
+		++statistics.draws;
+	}
+	statistics.redundantStateCommandsAvoided = statistics.draws * kStateCommandsPerDraw - statistics.stateCommands;
+	return statistics;
+}
+
+// 記録したコマンドの種類
+enum class RecordedCommandType : uint8_t {
+	SetPipeline,
+	SetMaterial,
+	SetTexture,
+	SetPrimitiveTopology,
+	SetMesh,
+	SetFirstInstance,
+	DrawIndexedInstanced,
+	Count
+};
+
+// 記録したコマンド。引数の意味は種類ごとに SubmitInstancedDrawList の backend の関数と同じ並び
+struct RecordedCommand
+{
+	RecordedCommandType type;
+	uint32_t arguments[3];
+};
+
+/// <summary>
+/// GPU を使わずに、出されたコマンドを順に記録し、種類ごとの回数を数えるだけの backend（ベンチマークで検証に使う）
+/// </summary>
+struct RecordingCommandBackend
+{
+	std::vector<RecordedCommand> commands;
+	uint32_t commandCounts[static_cast<size_t>(RecordedCommandType::Count)] = {};
+
+	void Record(RecordedCommandType type, uint32_t argument0 = 0, uint32_t argument1 = 0, uint32_t argument2 = 0)
+	{
+		commands.push_back({ type, { argument0, argument1, argument2 } });
+		++commandCounts[static_cast<size_t>(type)];
+	}
+	void SetPipeline(uint32_t pipeline) { Record(RecordedCommandType::SetPipeline, pipeline); }
+	void SetMaterial(uint32_t material) { Record(RecordedCommandType::SetMaterial, material); }
+	void SetTexture(uint32_t texture) { Record(RecordedCommandType::SetTexture, texture); }
+	void SetPrimitiveTopology() { Record(RecordedCommandType::SetPrimitiveTopology); }
+	void SetMesh(uint32_t modelIndex, uint32_t meshIndex) { Record(RecordedCommandType::SetMesh, modelIndex, meshIndex); }
+	void SetFirstInstance(uint32_t firstInstance) { Record(RecordedCommandType::SetFirstInstance, firstInstance); }
+	void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndexLocation)
+	{
+		Record(RecordedCommandType::DrawIndexedInstanced, indexCount, instanceCount, startIndexLocation);
+	}
+};
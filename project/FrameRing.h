@@ -0,0 +1,129 @@
+#pragma once
+// フレームの多重化（組を順に使い回す FrameRing と、GPU を使わずにフェンスをまねる SimulatedFence）。
+// Windows のヘッダーに依存しないので、tests/ の Linux 向けのテストからもそのまま使う
+#include <cstdint>
+#include <cassert>
+#include <deque>
+#include <utility>
+#include <algorithm>
+
+// ----------------------------------------------------------------------------
+// フレームの多重化
+// CPU が次のフレームを作っている間に GPU が前のフレームを描けるよう、フレームごとに使い回すもの
+// （コマンドアロケーター・毎フレーム書き換える定数・インスタンスバッファ）をフレームの数だけ持ち、順に使う。
+// フェンスを待つのは、これから使う組を GPU がまだ読んでいるかもしれないときだけ。
+// どの組を使うか・いつ待つかはフェンスの型によらないので、D3D12 のフェンスの代わりに SimulatedFence を渡して確かめられる
+// ----------------------------------------------------------------------------
+const uint32_t kMaxFramesInFlight = 3;
+
+struct FrameRing
+{
+	uint32_t frameCount = 1;
+	// CPU がいま書いている組
+	uint32_t frameIndex = 0;
+	// 最後に Signal したフェンスの値
+	uint64_t lastSignaledValue = 0;
+	// 組ごとに、最後にその組を使ったフレームの終わりで Signal した値（0 ならまだ使っていない）
+	uint64_t frameFenceValues[kMaxFramesInFlight] = {};
+	// 実際に待った回数
+	uint64_t waitCount = 0;
+};
+
+inline void InitializeFrameRing(FrameRing& ring, uint32_t frameCount)
+{
+	assert(frameCount >= 1 && frameCount <= kMaxFramesInFlight);
+	ring = {};
+	ring.frameCount = frameCount;
+}
+
+/// <summary>
+/// フレームの始めに呼ぶ。これから使う組を GPU が読み終えていなければ、読み終えるまで待つ。使う組の番号を返す
+/// </summary>
+/// <typeparam name="Fence">GetCompletedValue() / Signal(value) / WaitForValue(value) を持つ型</typeparam>
+template<typename Fence>
+uint32_t BeginFrame(FrameRing& ring, Fence& fence)
+{
+	const uint64_t requiredValue = ring.frameFenceValues[ring.frameIndex];
+	if (fence.GetCompletedValue() < requiredValue) {
+		fence.WaitForValue(requiredValue);
+		++ring.waitCount;
+	}
+	return ring.frameIndex;
+}
+
+/// <summary>
+/// フレームのコマンドを出した後に呼ぶ。この組を使い終えたことをフェンスで知らせて、次の組へ進む（待たない）
+/// </summary>
+template<typename Fence>
+void EndFrame(FrameRing& ring, Fence& fence)
+{
+	fence.Signal(++ring.lastSignaledValue);
+	ring.frameFenceValues[ring.frameIndex] = ring.lastSignaledValue;
+	ring.frameIndex = (ring.frameIndex + 1) % ring.frameCount;
+}
+
+/// <summary>
+/// これまでに出したすべてのフレームを GPU が終えるまで待つ（リソースを解放する前に呼ぶ）
+/// </summary>
+template<typename Fence>
+void WaitForGpuIdle(FrameRing& ring, Fence& fence)
+{
+	if (fence.GetCompletedValue() < ring.lastSignaledValue) {
+		fence.WaitForValue(ring.lastSignaledValue);
+		++ring.waitCount;
+	}
+}
+
+/// <summary>
+/// GPU を使わずにフェンスの動きをまねるもの。Signal した順に、GPU が1フレームに gpuFrameTime かけて処理していくとみなす。
+/// 時刻 now は呼び出し側が CPU の処理の分だけ進め、WaitForValue はその値が完了する時刻まで now を進める
+/// </summary>
+struct SimulatedFence
+{
+	double gpuFrameTime = 0.0;
+	double now = 0.0;
+	// GPU が最後に Signal された処理を終える時刻
+	double gpuBusyUntil = 0.0;
+	// Signal したがまだ完了していない値と、それが完了する時刻
+	std::deque<std::pair<uint64_t, double>> pendingValues;
+	uint64_t completedValue = 0;
+	uint64_t lastSignaledValue = 0;
+	// 待った回数と、そのうち待つ必要のなかった回数、待った時間の合計
+	uint64_t waitCount = 0;
+	uint64_t unnecessaryWaitCount = 0;
+	double waitTime = 0.0;
+
+	uint64_t GetCompletedValue()
+	{
+		while (!pendingValues.empty() && pendingValues.front().second <= now) {
+			completedValue = pendingValues.front().first;
+			pendingValues.pop_front();
+		}
+		return completedValue;
+	}
+	void Signal(uint64_t value)
+	{
+		assert(value > lastSignaledValue);
+		lastSignaledValue = value;
+		gpuBusyUntil = std::max(gpuBusyUntil, now) + gpuFrameTime;
+		pendingValues.push_back({ value, gpuBusyUntil });
+	}
+	void WaitForValue(uint64_t value)
+	{
+		// Signal していない値を待つと、実際の GPU では永久に戻らない
+		assert(value <= lastSignaledValue);
+		++waitCount;
+		if (GetCompletedValue() >= value) {
+			++unnecessaryWaitCount;
+			return;
+		}
+		for (const auto& [pendingValue, completionTime] : pendingValues) {
+			if (pendingValue >= value) {
+				waitTime += completionTime - now;
+				now = completionTime;
+				break;
+			}
+		}
+		GetCompletedValue();
+	}
+};
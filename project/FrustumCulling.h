@@ -0,0 +1,273 @@
+#pragma once
+// 視錐台カリング（視錐台・箱と球・SoA の箱と球を SIMD でまとめて視錐台と比べる CullBounds）。
+// Windows のヘッダーに依存しないので、tests/ の Linux 向けのテストからもそのまま使う
+#include "MathKernels.h"
+#include <cfloat>
+#include <bit>
+
+// メッシュを囲む軸に沿った箱と球（モデル空間）
+struct MeshBounds {
+	Vector3 center;   // 箱と球の中心
+	Vector3 extent;   // 箱の各軸の半分の長さ
+	float radius;     // 球の半径
+};
+
+// 視錐台。各平面は xyz が内向きの単位法線、w が原点からの距離で、dot(xyz, p) + w >= 0 が内側
+struct Frustum
+{
+	Vector4 planes[6];
+};
+
+/// <summary>
+/// 変換行列から視錐台の平面を取り出す。
+/// WVP 行列を渡すとモデル空間、VP 行列を渡すとワールド空間の視錐台になる
+/// </summary>
+/// <param name="m">行ベクトルに右から掛ける変換行列（クリップ空間の z は 0～1）</param>
+inline Frustum MakeFrustumFromMatrix(const Matrix4x4& m)
+{
+	auto column = [&m](int j) { return Vector4{ m.m[0][j], m.m[1][j], m.m[2][j], m.m[3][j] }; };
+	auto add = [](const Vector4& a, const Vector4& b) { return Vector4{ a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w }; };
+	auto subtract = [](const Vector4& a, const Vector4& b) { return Vector4{ a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w }; };
+
+	const Vector4 x = column(0);
+	const Vector4 y = column(1);
+	const Vector4 z = column(2);
+	const Vector4 w = column(3);
+
+	Frustum frustum{};
+	frustum.planes[0] = add(w, x);      // 左
+	frustum.planes[1] = subtract(w, x); // 右
+	frustum.planes[2] = add(w, y);      // 下
+	frustum.planes[3] = subtract(w, y); // 上
+	frustum.planes[4] = z;              // 近
+	frustum.planes[5] = subtract(w, z); // 遠
+	for (Vector4& plane : frustum.planes) {
+		const float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		if (length > 0.0f) {
+			plane = { plane.x / length, plane.y / length, plane.z / length, plane.w / length };
+		}
+	}
+	return frustum;
+}
+
+/// <summary>
+/// 球が視錐台と重なっているかどうか
+/// </summary>
+inline bool IsSphereInFrustum(const Frustum& frustum, const Vector3& center, float radius)
+{
+	for (const Vector4& plane : frustum.planes) {
+		if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/// <summary>
+/// 点を変換行列で変換する（w = 1 として扱い、w での除算はしない）
+/// </summary>
+inline Vector3 TransformPoint(const Vector3& p, const Matrix4x4& m)
+{
+	return {
+		p.x * m.m[0][0] + p.y * m.m[1][0] + p.z * m.m[2][0] + m.m[3][0],
+		p.x * m.m[0][1] + p.y * m.m[1][1] + p.z * m.m[2][1] + m.m[3][1],
+		p.x * m.m[0][2] + p.y * m.m[1][2] + p.z * m.m[2][2] + m.m[3][2]
+	};
+}
+
+/// <summary>
+/// モデル空間の箱と球をワールド行列で変換して、ワールド空間で囲み直す
+/// </summary>
+inline MeshBounds TransformBounds(const MeshBounds& bounds, const Matrix4x4& world)
+{
+	MeshBounds result{};
+	result.center = TransformPoint(bounds.center, world);
+	// 回転した箱を囲む軸に沿った箱の半分の長さは、行列の成分の絶対値で重みをつけた和になる
+	result.extent = {
+		fabsf(world.m[0][0]) * bounds.extent.x + fabsf(world.m[1][0]) * bounds.extent.y + fabsf(world.m[2][0]) * bounds.extent.z,
+		fabsf(world.m[0][1]) * bounds.extent.x + fabsf(world.m[1][1]) * bounds.extent.y + fabsf(world.m[2][1]) * bounds.extent.z,
+		fabsf(world.m[0][2]) * bounds.extent.x + fabsf(world.m[1][2]) * bounds.extent.y + fabsf(world.m[2][2]) * bounds.extent.z };
+	float maxScaleSquared = 0.0f;
+	for (int row = 0; row < 3; ++row) {
+		maxScaleSquared = std::max(maxScaleSquared, world.m[row][0] * world.m[row][0] + world.m[row][1] * world.m[row][1] + world.m[row][2] * world.m[row][2]);
+	}
+	result.radius = bounds.radius * sqrtf(maxScaleSquared);
+	return result;
+}
+
+/// <summary>
+/// たくさんの箱と球を、成分ごとの配列（SoA）で持つ。SIMD で4つ / 8つまとめて視錐台と比べる
+/// </summary>
+struct BoundsSoA {
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	std::vector<float> radius;
+};
+
+/// <summary>
+/// 箱と球の数
+/// </summary>
+inline size_t GetBoundsCount(const BoundsSoA& bounds)
+{
+	return bounds.centerX.size();
+}
+
+/// <summary>
+/// すべての箱と球を取り除く（確保したメモリは残す）
+/// </summary>
+inline void ClearBounds(BoundsSoA& bounds)
+{
+	for (std::vector<float>* component : { &bounds.centerX, &bounds.centerY, &bounds.centerZ,
+		&bounds.extentX, &bounds.extentY, &bounds.extentZ, &bounds.radius }) {
+		component->clear();
+	}
+}
+
+/// <summary>
+/// 箱と球を追加する
+/// </summary>
+inline void AddBounds(BoundsSoA& bounds, const MeshBounds& value)
+{
+	bounds.centerX.push_back(value.center.x);
+	bounds.centerY.push_back(value.center.y);
+	bounds.centerZ.push_back(value.center.z);
+	bounds.extentX.push_back(value.extent.x);
+	bounds.extentY.push_back(value.extent.y);
+	bounds.extentZ.push_back(value.extent.z);
+	bounds.radius.push_back(value.radius);
+}
+
+/// <summary>
+/// i 番目の箱と球が視錐台の内側にどれだけ入っているか。
+/// 平面ごとに、中心までの距離に箱を法線へ投影した半径と球の半径の小さい方を足し、その最小値を返す（負なら外）
+/// </summary>
+inline float GetBoundsFrustumMargin(const BoundsSoA& bounds, size_t i, const Frustum& frustum)
+{
+	float margin = FLT_MAX;
+	for (const Vector4& plane : frustum.planes) {
+		const float distance = plane.x * bounds.centerX[i] + plane.y * bounds.centerY[i] + plane.z * bounds.centerZ[i] + plane.w;
+		const float boxRadius = fabsf(plane.x) * bounds.extentX[i] + fabsf(plane.y) * bounds.extentY[i] + fabsf(plane.z) * bounds.extentZ[i];
+		margin = std::min(margin, distance + std::min(boxRadius, bounds.radius[i]));
+	}
+	return margin;
+}
+
+#if defined(MATH_SIMD_X86)
+
+/// <summary>
+/// [begin, end) の箱と球を4つずつ視錐台と比べ、見えるものの番号を visible に詰めて書く（SSE4.1）
+/// </summary>
+/// <returns>比べ終えた位置（4つに満たない残りは呼び出し側で比べる）</returns>
+MATH_TARGET_SSE41 inline size_t CullBoundsSSE41(const BoundsSoA& bounds, const Frustum& frustum, size_t begin, size_t end, uint32_t* visible, size_t& visibleCount)
+{
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 zero = _mm_setzero_ps();
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4) {
+		const __m128 centerX = _mm_loadu_ps(&bounds.centerX[i]);
+		const __m128 centerY = _mm_loadu_ps(&bounds.centerY[i]);
+		const __m128 centerZ = _mm_loadu_ps(&bounds.centerZ[i]);
+		const __m128 extentX = _mm_loadu_ps(&bounds.extentX[i]);
+		const __m128 extentY = _mm_loadu_ps(&bounds.extentY[i]);
+		const __m128 extentZ = _mm_loadu_ps(&bounds.extentZ[i]);
+		const __m128 radius = _mm_loadu_ps(&bounds.radius[i]);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (const Vector4& plane : frustum.planes) {
+			const __m128 normalX = _mm_set1_ps(plane.x);
+			const __m128 normalY = _mm_set1_ps(plane.y);
+			const __m128 normalZ = _mm_set1_ps(plane.z);
+			const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, centerX), _mm_mul_ps(normalY, centerY)), _mm_mul_ps(normalZ, centerZ)), _mm_set1_ps(plane.w));
+			const __m128 boxRadius = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_and_ps(normalX, absMask), extentX),
+				_mm_mul_ps(_mm_and_ps(normalY, absMask), extentY)),
+				_mm_mul_ps(_mm_and_ps(normalZ, absMask), extentZ));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, _mm_min_ps(boxRadius, radius)), zero));
+		}
+
+		// 見えるものの番号だけを詰めて書く
+		uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+		while (mask != 0) {
+			visible[visibleCount++] = static_cast<uint32_t>(i + std::countr_zero(mask));
+			mask &= mask - 1;
+		}
+	}
+	return i;
+}
+
+/// <summary>
+/// [begin, end) の箱と球を8つずつ視錐台と比べ、見えるものの番号を visible に詰めて書く（AVX2）
+/// </summary>
+/// <returns>比べ終えた位置（8つに満たない残りは呼び出し側で比べる）</returns>
+MATH_TARGET_AVX2 inline size_t CullBoundsAVX2(const BoundsSoA& bounds, const Frustum& frustum, size_t begin, size_t end, uint32_t* visible, size_t& visibleCount)
+{
+	// 平面はループの外で一度だけ並べておく
+	__m256 normalX[6], normalY[6], normalZ[6], planeW[6];
+	__m256 absNormalX[6], absNormalY[6], absNormalZ[6];
+	for (int p = 0; p < 6; ++p) {
+		normalX[p] = _mm256_set1_ps(frustum.planes[p].x);
+		normalY[p] = _mm256_set1_ps(frustum.planes[p].y);
+		normalZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+		absNormalX[p] = _mm256_set1_ps(fabsf(frustum.planes[p].x));
+		absNormalY[p] = _mm256_set1_ps(fabsf(frustum.planes[p].y));
+		absNormalZ[p] = _mm256_set1_ps(fabsf(frustum.planes[p].z));
+	}
+
+	const __m256 zero = _mm256_setzero_ps();
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8) {
+		const __m256 centerX = _mm256_loadu_ps(&bounds.centerX[i]);
+		const __m256 centerY = _mm256_loadu_ps(&bounds.centerY[i]);
+		const __m256 centerZ = _mm256_loadu_ps(&bounds.centerZ[i]);
+		const __m256 extentX = _mm256_loadu_ps(&bounds.extentX[i]);
+		const __m256 extentY = _mm256_loadu_ps(&bounds.extentY[i]);
+		const __m256 extentZ = _mm256_loadu_ps(&bounds.extentZ[i]);
+		const __m256 radius = _mm256_loadu_ps(&bounds.radius[i]);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p) {
+			const __m256 distance = _mm256_fmadd_ps(normalZ[p], centerZ, _mm256_fmadd_ps(normalY[p], centerY, _mm256_fmadd_ps(normalX[p], centerX, planeW[p])));
+			const __m256 boxRadius = _mm256_fmadd_ps(absNormalZ[p], extentZ, _mm256_fmadd_ps(absNormalY[p], extentY, _mm256_mul_ps(absNormalX[p], extentX)));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, _mm256_min_ps(boxRadius, radius)), zero, _CMP_GE_OQ));
+		}
+
+		uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+		while (mask != 0) {
+			visible[visibleCount++] = static_cast<uint32_t>(i + std::countr_zero(mask));
+			mask &= mask - 1;
+		}
+	}
+	return i;
+}
+
+#endif // MATH_SIMD_X86
+
+/// <summary>
+/// すべての箱と球を視錐台と比べ、見えるものの番号を小さい順に詰めて書く
+/// </summary>
+/// <param name="bounds">比べる箱と球（視錐台と同じ空間）</param>
+/// <param name="frustum">視錐台</param>
+/// <param name="visible">見えるものの番号の書き込み先（箱と球の数だけ入ること）</param>
+/// <returns>見えるものの数</returns>
+inline size_t CullBounds(const BoundsSoA& bounds, const Frustum& frustum, uint32_t* visible)
+{
+	const size_t count = GetBoundsCount(bounds);
+	size_t visibleCount = 0;
+	size_t i = 0;
+#if defined(MATH_SIMD_X86)
+	if (gMathKernels.backend == MathBackend::AVX2) {
+		i = CullBoundsAVX2(bounds, frustum, i, count, visible, visibleCount);
+	}
+	if (gMathKernels.backend != MathBackend::Scalar) {
+		i = CullBoundsSSE41(bounds, frustum, i, count, visible, visibleCount);
+	}
+#endif
+	// SIMD の幅に満たない残り（スカラー版ではすべて）
+	for (; i < count; ++i) {
+		if (GetBoundsFrustumMargin(bounds, i, frustum) >= 0.0f) {
+			visible[visibleCount++] = static_cast<uint32_t>(i);
+		}
+	}
+	return visibleCount;
+}
@@ -0,0 +1,554 @@
+#pragma once
+// シーンに置いた物体を囲む箱の階層（BVH）。SAH で作り、動いた物体は refit で追いかけ、視錐台カリングとレイキャストに使う。
+// Windows のヘッダーに依存しないので、tests/ の Linux 向けのテストからもそのまま使う
+#include "FrustumCulling.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// 軸に沿った箱を最小点と最大点で表したもの（BVH の中ではこちらを使う）
+struct Aabb {
+	Vector3 minimum;
+	Vector3 maximum;
+};
+
+/// <summary>
+/// 中心と半分の長さで表した箱を、最小点と最大点の形にする
+/// </summary>
+inline Aabb MakeAabb(const MeshBounds& bounds)
+{
+	return {
+		{ bounds.center.x - bounds.extent.x, bounds.center.y - bounds.extent.y, bounds.center.z - bounds.extent.z },
+		{ bounds.center.x + bounds.extent.x, bounds.center.y + bounds.extent.y, bounds.center.z + bounds.extent.z } };
+}
+
+/// <summary>
+/// 何も含まない箱（どんな箱と合わせてもその箱になる）
+/// </summary>
+inline Aabb MakeEmptyAabb()
+{
+	return { { FLT_MAX, FLT_MAX, FLT_MAX }, { -FLT_MAX, -FLT_MAX, -FLT_MAX } };
+}
+
+/// <summary>
+/// 2つの箱を囲む箱
+/// </summary>
+inline Aabb Union(const Aabb& a, const Aabb& b)
+{
+	return {
+		{ std::min(a.minimum.x, b.minimum.x), std::min(a.minimum.y, b.minimum.y), std::min(a.minimum.z, b.minimum.z) },
+		{ std::max(a.maximum.x, b.maximum.x), std::max(a.maximum.y, b.maximum.y), std::max(a.maximum.z, b.maximum.z) } };
+}
+
+/// <summary>
+/// 箱の表面積（SAH のコストに使う。空の箱は 0）
+/// </summary>
+inline float GetSurfaceArea(const Aabb& box)
+{
+	const float dx = box.maximum.x - box.minimum.x;
+	const float dy = box.maximum.y - box.minimum.y;
+	const float dz = box.maximum.z - box.minimum.z;
+	if (dx < 0.0f || dy < 0.0f || dz < 0.0f) {
+		return 0.0f;
+	}
+	return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+// 半直線（レイ）。direction は正規化していなくてもよく、交差の距離は direction の長さを単位にする
+struct Ray {
+	Vector3 origin;
+	Vector3 direction;
+};
+
+/// <summary>
+/// レイと箱の交差判定（スラブ法）
+/// </summary>
+/// <param name="inverseDirection">レイの向きの各成分の逆数</param>
+/// <param name="maxDistance">これより遠い交差は無視する</param>
+/// <param name="hitDistance">箱に入る距離（レイの始点が箱の中なら 0）</param>
+inline bool IntersectRayAabb(const Ray& ray, const Vector3& inverseDirection, const Aabb& box, float maxDistance, float& hitDistance)
+{
+	const float tx1 = (box.minimum.x - ray.origin.x) * inverseDirection.x;
+	const float tx2 = (box.maximum.x - ray.origin.x) * inverseDirection.x;
+	const float ty1 = (box.minimum.y - ray.origin.y) * inverseDirection.y;
+	const float ty2 = (box.maximum.y - ray.origin.y) * inverseDirection.y;
+	const float tz1 = (box.minimum.z - ray.origin.z) * inverseDirection.z;
+	const float tz2 = (box.maximum.z - ray.origin.z) * inverseDirection.z;
+	const float enter = std::max({ std::min(tx1, tx2), std::min(ty1, ty2), std::min(tz1, tz2), 0.0f });
+	const float exit = std::min({ std::max(tx1, tx2), std::max(ty1, ty2), std::max(tz1, tz2) });
+	hitDistance = enter;
+	return enter <= exit && enter < maxDistance;
+}
+
+/// <summary>
+/// レイの向きの各成分の逆数（0 の成分は十分大きな値にする）
+/// </summary>
+inline Vector3 GetInverseDirection(const Ray& ray)
+{
+	return {
+		(ray.direction.x != 0.0f) ? 1.0f / ray.direction.x : FLT_MAX,
+		(ray.direction.y != 0.0f) ? 1.0f / ray.direction.y : FLT_MAX,
+		(ray.direction.z != 0.0f) ? 1.0f / ray.direction.z : FLT_MAX };
+}
+
+// BVH のノード。count が 0 なら内部ノードで、子は firstOrChild と firstOrChild + 1。
+// count が 1 以上なら葉で、items[firstOrChild] から count 個の物体を持つ
+struct BvhNode {
+	Aabb bounds;
+	uint32_t firstOrChild;
+	uint32_t count;
+};
+
+// 親がないことを表す番号
+const uint32_t kBvhNoParent = UINT32_MAX;
+// 葉に入れる物体の最大数（これ以下なら分けない）
+const uint32_t kBvhMaxLeafItems = 4;
+// SAH で分け方を探すときのビンの数
+const uint32_t kBvhBinCount = 16;
+
+/// <summary>
+/// BVH をたどるときのスタック。ふつうの深さなら関数の中の配列だけで済ませ、
+/// 偏った分け方で木が深くなったときは、あふれた分をヒープに積む
+/// </summary>
+template <typename T>
+struct BvhTraversalStack {
+	static const uint32_t kInlineCapacity = 64;
+	T inlineEntries[kInlineCapacity];
+	std::vector<T> overflowEntries;
+	uint32_t size = 0;
+};
+
+template <typename T>
+inline void PushBvhStack(BvhTraversalStack<T>& stack, const T& entry)
+{
+	if (stack.size < BvhTraversalStack<T>::kInlineCapacity) {
+		stack.inlineEntries[stack.size] = entry;
+	} else {
+		stack.overflowEntries.push_back(entry);
+	}
+	++stack.size;
+}
+
+template <typename T>
+inline T PopBvhStack(BvhTraversalStack<T>& stack)
+{
+	assert(stack.size > 0);
+	--stack.size;
+	if (stack.size < BvhTraversalStack<T>::kInlineCapacity) {
+		return stack.inlineEntries[stack.size];
+	}
+	const T entry = stack.overflowEntries.back();
+	stack.overflowEntries.pop_back();
+	return entry;
+}
+
+/// <summary>
+/// シーンに置いた物体（インスタンス）を囲む箱の階層（BVH）。
+/// 物体が動いたら、その物体の葉から根まで箱を広げ直す（作り直しはしない）
+/// </summary>
+struct InstanceBvh {
+	std::vector<BvhNode> nodes;          // nodes[0] が根。子は親より後ろにある
+	std::vector<uint32_t> parents;       // ノードの親（根は kBvhNoParent）
+	std::vector<uint32_t> items;         // 葉が指す物体の番号を並べたもの
+	std::vector<uint32_t> itemLeaves;    // 物体が入っている葉
+	std::vector<Aabb> itemBounds;        // 物体を囲む箱
+};
+
+/// <summary>
+/// ノードの箱を、子（葉なら物体）の箱から計算し直す
+/// </summary>
+inline Aabb ComputeBvhNodeBounds(const InstanceBvh& bvh, const BvhNode& node)
+{
+	if (node.count == 0) {
+		return Union(bvh.nodes[node.firstOrChild].bounds, bvh.nodes[node.firstOrChild + 1].bounds);
+	}
+	Aabb bounds = MakeEmptyAabb();
+	for (uint32_t i = 0; i < node.count; ++i) {
+		bounds = Union(bounds, bvh.itemBounds[bvh.items[node.firstOrChild + i]]);
+	}
+	return bounds;
+}
+
+/// <summary>
+/// 物体を囲む箱から BVH を作る。分け方はビンを使った SAH（表面積ヒューリスティック）で決める
+/// </summary>
+/// <param name="maxLeafItems">葉に入れる物体の最大数（これ以下なら分けず、超えるなら SAH で得にならなくても分ける）</param>
+inline void BuildInstanceBvh(InstanceBvh& bvh, const std::vector<Aabb>& itemBounds, uint32_t maxLeafItems = kBvhMaxLeafItems)
+{
+	const uint32_t itemCount = static_cast<uint32_t>(itemBounds.size());
+	bvh.itemBounds = itemBounds;
+	bvh.items.resize(itemCount);
+	bvh.itemLeaves.assign(itemCount, 0);
+	for (uint32_t i = 0; i < itemCount; ++i) {
+		bvh.items[i] = i;
+	}
+	bvh.nodes.clear();
+	bvh.parents.clear();
+	bvh.nodes.reserve(size_t(itemCount) * 2);
+	bvh.parents.reserve(size_t(itemCount) * 2);
+	bvh.nodes.push_back({ MakeEmptyAabb(), 0, itemCount });
+	bvh.parents.push_back(kBvhNoParent);
+	if (itemCount == 0) {
+		return;
+	}
+
+	// 物体の箱の中心（軸ごとに並べて、軸の番号で引けるようにする）
+	std::vector<float> centroids(size_t(itemCount) * 3);
+	for (uint32_t i = 0; i < itemCount; ++i) {
+		const Aabb& box = itemBounds[i];
+		centroids[i * 3 + 0] = (box.minimum.x + box.maximum.x) * 0.5f;
+		centroids[i * 3 + 1] = (box.minimum.y + box.maximum.y) * 0.5f;
+		centroids[i * 3 + 2] = (box.minimum.z + box.maximum.z) * 0.5f;
+	}
+	auto centroid = [&centroids](uint32_t item, int axis) {
+		return centroids[size_t(item) * 3 + axis];
+	};
+
+	std::vector<uint32_t> stack = { 0 };
+	while (!stack.empty()) {
+		const uint32_t nodeIndex = stack.back();
+		stack.pop_back();
+		BvhNode& node = bvh.nodes[nodeIndex];
+		node.bounds = ComputeBvhNodeBounds(bvh, node);
+		const uint32_t first = node.firstOrChild;
+		const uint32_t count = node.count;
+		if (count <= maxLeafItems) {
+			continue;
+		}
+
+		// 物体の中心が広がっている範囲
+		float centroidMinimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float centroidMaximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t i = first; i < first + count; ++i) {
+			for (int axis = 0; axis < 3; ++axis) {
+				const float c = centroid(bvh.items[i], axis);
+				centroidMinimum[axis] = std::min(centroidMinimum[axis], c);
+				centroidMaximum[axis] = std::max(centroidMaximum[axis], c);
+			}
+		}
+
+		// 軸ごとにビンへ振り分け、ビンの境目で分けたときのコストが一番小さいものを探す
+		int bestAxis = -1;
+		uint32_t bestSplit = 0;
+		float bestCost = FLT_MAX;
+		for (int axis = 0; axis < 3; ++axis) {
+			const float extent = centroidMaximum[axis] - centroidMinimum[axis];
+			if (extent <= 0.0f) {
+				continue;
+			}
+			const float binScale = float(kBvhBinCount) / extent;
+			Aabb binBounds[kBvhBinCount];
+			uint32_t binCounts[kBvhBinCount] = {};
+			for (Aabb& box : binBounds) {
+				box = MakeEmptyAabb();
+			}
+			for (uint32_t i = first; i < first + count; ++i) {
+				const uint32_t bin = std::min(kBvhBinCount - 1, uint32_t((centroid(bvh.items[i], axis) - centroidMinimum[axis]) * binScale));
+				binBounds[bin] = Union(binBounds[bin], bvh.itemBounds[bvh.items[i]]);
+				++binCounts[bin];
+			}
+
+			// 左から足した面積と数、右から足した面積と数
+			float leftAreas[kBvhBinCount - 1];
+			uint32_t leftCounts[kBvhBinCount - 1];
+			Aabb leftBox = MakeEmptyAabb();
+			uint32_t leftCount = 0;
+			for (uint32_t split = 0; split < kBvhBinCount - 1; ++split) {
+				leftBox = Union(leftBox, binBounds[split]);
+				leftCount += binCounts[split];
+				leftAreas[split] = GetSurfaceArea(leftBox);
+				leftCounts[split] = leftCount;
+			}
+			Aabb rightBox = MakeEmptyAabb();
+			uint32_t rightCount = 0;
+			for (uint32_t split = kBvhBinCount - 1; split > 0; --split) {
+				rightBox = Union(rightBox, binBounds[split]);
+				rightCount += binCounts[split];
+				const float cost = leftAreas[split - 1] * float(leftCounts[split - 1]) + GetSurfaceArea(rightBox) * float(rightCount);
+				if (leftCounts[split - 1] > 0 && rightCount > 0 && cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = split;
+				}
+			}
+		}
+
+		// 葉の最大数を超えているので、SAH で得にならなくても分ける
+		uint32_t leftCount = count / 2;
+		if (bestAxis >= 0) {
+			const float binScale = float(kBvhBinCount) / (centroidMaximum[bestAxis] - centroidMinimum[bestAxis]);
+			uint32_t* middle = std::partition(bvh.items.data() + first, bvh.items.data() + first + count, [&](uint32_t item) {
+				return std::min(kBvhBinCount - 1, uint32_t((centroid(item, bestAxis) - centroidMinimum[bestAxis]) * binScale)) < bestSplit;
+			});
+			leftCount = static_cast<uint32_t>(middle - (bvh.items.data() + first));
+		}
+		// 中心がすべて同じなら、並び順のまま半分に分ける
+
+		// 子は2つ並べて確保する（push_back で node の参照が無効になるので番号で扱う）
+		const uint32_t leftChild = static_cast<uint32_t>(bvh.nodes.size());
+		bvh.nodes[nodeIndex].firstOrChild = leftChild;
+		bvh.nodes[nodeIndex].count = 0;
+		bvh.nodes.push_back({ MakeEmptyAabb(), first, leftCount });
+		bvh.nodes.push_back({ MakeEmptyAabb(), first + leftCount, count - leftCount });
+		bvh.parents.push_back(nodeIndex);
+		bvh.parents.push_back(nodeIndex);
+		stack.push_back(leftChild);
+		stack.push_back(leftChild + 1);
+	}
+
+	// 子の箱がそろったので、後ろから親の箱を計算し直し、物体がどの葉にあるかを覚える
+	for (size_t i = bvh.nodes.size(); i-- > 0;) {
+		BvhNode& node = bvh.nodes[i];
+		node.bounds = ComputeBvhNodeBounds(bvh, node);
+		for (uint32_t j = 0; j < node.count; ++j) {
+			bvh.itemLeaves[bvh.items[node.firstOrChild + j]] = static_cast<uint32_t>(i);
+		}
+	}
+}
+
+/// <summary>
+/// 物体の箱を書き換え、その物体の葉から根へ向かって箱を計算し直す（箱が変わらなくなったところで止める）
+/// </summary>
+inline void UpdateInstanceBvhItem(InstanceBvh& bvh, uint32_t item, const Aabb& bounds)
+{
+	bvh.itemBounds[item] = bounds;
+	for (uint32_t nodeIndex = bvh.itemLeaves[item]; nodeIndex != kBvhNoParent; nodeIndex = bvh.parents[nodeIndex]) {
+		BvhNode& node = bvh.nodes[nodeIndex];
+		const Aabb newBounds = ComputeBvhNodeBounds(bvh, node);
+		if (std::memcmp(&newBounds, &node.bounds, sizeof(Aabb)) == 0) {
+			break;
+		}
+		node.bounds = newBounds;
+	}
+}
+
+/// <summary>
+/// すべてのノードの箱を計算し直す（たくさんの物体が動いたとき用。木の形は変えない）
+/// </summary>
+inline void RefitInstanceBvh(InstanceBvh& bvh)
+{
+	for (size_t i = bvh.nodes.size(); i-- > 0;) {
+		bvh.nodes[i].bounds = ComputeBvhNodeBounds(bvh, bvh.nodes[i]);
+	}
+}
+
+/// <summary>
+/// BVH の SAH コスト（根の表面積に対する、ノードをたどる回数と物体と比べる回数の期待値）。
+/// 作り直した木と比べると、refit を続けて木の質がどれだけ落ちたかが分かる
+/// </summary>
+inline float GetInstanceBvhCost(const InstanceBvh& bvh)
+{
+	const float rootArea = GetSurfaceArea(bvh.nodes[0].bounds);
+	if (rootArea <= 0.0f) {
+		return 0.0f;
+	}
+	float cost = 0.0f;
+	for (const BvhNode& node : bvh.nodes) {
+		cost += GetSurfaceArea(node.bounds) * ((node.count == 0) ? 1.0f : float(node.count));
+	}
+	return cost / rootArea;
+}
+
+/// <summary>
+/// 視錐台と重なる物体の番号を書き出す。ノードが視錐台の完全に内側なら、その下は比べずにすべて書き出す
+/// </summary>
+/// <param name="visible">書き込み先（物体の数だけ入ること）</param>
+/// <returns>見える物体の数</returns>
+inline size_t CullInstanceBvh(const InstanceBvh& bvh, const Frustum& frustum, uint32_t* visible)
+{
+	if (bvh.items.empty()) {
+		return 0;
+	}
+
+	// 箱が視錐台の外なら -1、完全に内側なら 1、またがっていれば 0
+	auto classify = [&frustum](const Aabb& box) {
+		const Vector3 center = { (box.minimum.x + box.maximum.x) * 0.5f, (box.minimum.y + box.maximum.y) * 0.5f, (box.minimum.z + box.maximum.z) * 0.5f };
+		const Vector3 extent = { (box.maximum.x - box.minimum.x) * 0.5f, (box.maximum.y - box.minimum.y) * 0.5f, (box.maximum.z - box.minimum.z) * 0.5f };
+		int result = 1;
+		for (const Vector4& plane : frustum.planes) {
+			const float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+			const float radius = fabsf(plane.x) * extent.x + fabsf(plane.y) * extent.y + fabsf(plane.z) * extent.z;
+			if (distance < -radius) {
+				return -1;
+			}
+			if (distance < radius) {
+				result = 0;
+			}
+		}
+		return result;
+	};
+
+	size_t visibleCount = 0;
+	// 完全に内側の部分木の物体をすべて書き出す（葉の物体は items の中で連続していないので、木をたどる）
+	auto emitSubtree = [&](uint32_t root) {
+		BvhTraversalStack<uint32_t> stack;
+		PushBvhStack(stack, root);
+		while (stack.size > 0) {
+			const BvhNode& node = bvh.nodes[PopBvhStack(stack)];
+			if (node.count > 0) {
+				for (uint32_t i = 0; i < node.count; ++i) {
+					visible[visibleCount++] = bvh.items[node.firstOrChild + i];
+				}
+			} else {
+				PushBvhStack(stack, node.firstOrChild);
+				PushBvhStack(stack, node.firstOrChild + 1);
+			}
+		}
+	};
+
+	BvhTraversalStack<uint32_t> stack;
+	PushBvhStack(stack, 0u);
+	while (stack.size > 0) {
+		const uint32_t nodeIndex = PopBvhStack(stack);
+		const BvhNode& node = bvh.nodes[nodeIndex];
+		const int classification = classify(node.bounds);
+		if (classification < 0) {
+			continue;
+		}
+		if (classification > 0) {
+			emitSubtree(nodeIndex);
+			continue;
+		}
+		if (node.count > 0) {
+			for (uint32_t i = 0; i < node.count; ++i) {
+				const uint32_t item = bvh.items[node.firstOrChild + i];
+				if (classify(bvh.itemBounds[item]) >= 0) {
+					visible[visibleCount++] = item;
+				}
+			}
+		} else {
+			PushBvhStack(stack, node.firstOrChild);
+			PushBvhStack(stack, node.firstOrChild + 1);
+		}
+	}
+	return visibleCount;
+}
+
+/// <summary>
+/// レイが最初に当たるものを BVH で探す。近い子から順にたどり、見つかった交差より遠いノードは飛ばす
+/// </summary>
+/// <param name="intersectLeaf">葉との交差判定。bool(葉のノード番号, レイ, それより遠い交差は無視する距離, 交差した距離の書き込み先, 当たった物体の番号の書き込み先)</param>
+/// <param name="hitDistance">当たった距離（direction の長さが単位）</param>
+/// <returns>当たった物体の番号。当たらなければ UINT32_MAX</returns>
+template <typename IntersectLeaf>
+uint32_t RaycastBvh(const InstanceBvh& bvh, const Ray& ray, float& hitDistance, IntersectLeaf&& intersectLeaf)
+{
+	hitDistance = FLT_MAX;
+	uint32_t hitItem = UINT32_MAX;
+	if (bvh.items.empty()) {
+		return hitItem;
+	}
+
+	const Vector3 inverseDirection = GetInverseDirection(ray);
+	float rootDistance = 0.0f;
+	if (!IntersectRayAabb(ray, inverseDirection, bvh.nodes[0].bounds, hitDistance, rootDistance)) {
+		return hitItem;
+	}
+
+	// ノードの番号と、そのノードの箱にレイが入る距離
+	struct StackEntry {
+		uint32_t node;
+		float distance;
+	};
+	BvhTraversalStack<StackEntry> stack;
+	PushBvhStack(stack, StackEntry{ 0, rootDistance });
+	while (stack.size > 0) {
+		const StackEntry entry = PopBvhStack(stack);
+		if (entry.distance >= hitDistance) {
+			continue;
+		}
+		const uint32_t nodeIndex = entry.node;
+		const BvhNode& node = bvh.nodes[nodeIndex];
+		if (node.count > 0) {
+			float distance = 0.0f;
+			uint32_t item = UINT32_MAX;
+			if (intersectLeaf(nodeIndex, ray, hitDistance, distance, item) && distance < hitDistance) {
+				hitDistance = distance;
+				hitItem = item;
+			}
+			continue;
+		}
+
+		// 近い方の子を後に積んで先に調べる
+		float nearDistance = 0.0f;
+		float farDistance = 0.0f;
+		uint32_t nearChild = node.firstOrChild;
+		uint32_t farChild = node.firstOrChild + 1;
+		bool hitNear = IntersectRayAabb(ray, inverseDirection, bvh.nodes[nearChild].bounds, hitDistance, nearDistance);
+		bool hitFar = IntersectRayAabb(ray, inverseDirection, bvh.nodes[farChild].bounds, hitDistance, farDistance);
+		if (hitNear && hitFar && farDistance < nearDistance) {
+			std::swap(nearChild, farChild);
+			std::swap(nearDistance, farDistance);
+		} else if (!hitNear && hitFar) {
+			std::swap(nearChild, farChild);
+			std::swap(nearDistance, farDistance);
+			std::swap(hitNear, hitFar);
+		}
+		if (hitFar) {
+			PushBvhStack(stack, StackEntry{ farChild, farDistance });
+		}
+		if (hitNear) {
+			PushBvhStack(stack, StackEntry{ nearChild, nearDistance });
+		}
+	}
+	return hitItem;
+}
+
+/// <summary>
+/// レイが最初に当たる物体を探す
+/// </summary>
+/// <param name="intersectItem">物体との交差判定。bool(物体の番号, レイ, それより遠い交差は無視する距離, 交差した距離の書き込み先)</param>
+/// <param name="hitDistance">当たった距離（direction の長さが単位）</param>
+/// <returns>当たった物体の番号。当たらなければ UINT32_MAX</returns>
+template <typename IntersectItem>
+uint32_t RaycastInstanceBvh(const InstanceBvh& bvh, const Ray& ray, float& hitDistance, IntersectItem&& intersectItem)
+{
+	return RaycastBvh(bvh, ray, hitDistance, [&](uint32_t nodeIndex, const Ray& leafRay, float maxDistance, float& distance, uint32_t& item) {
+		const BvhNode& leaf = bvh.nodes[nodeIndex];
+		distance = maxDistance;
+		for (uint32_t i = 0; i < leaf.count; ++i) {
+			const uint32_t candidate = bvh.items[leaf.firstOrChild + i];
+			float candidateDistance = 0.0f;
+			if (intersectItem(candidate, leafRay, distance, candidateDistance) && candidateDistance < distance) {
+				distance = candidateDistance;
+				item = candidate;
+			}
+		}
+		return item != UINT32_MAX;
+	});
+}
+
+/// <summary>
+/// レイが最初に当たる物体を、物体を囲む箱との交差で探す
+/// </summary>
+inline uint32_t RaycastInstanceBvh(const InstanceBvh& bvh, const Ray& ray, float& hitDistance)
+{
+	return RaycastInstanceBvh(bvh, ray, hitDistance, [&bvh](uint32_t item, const Ray& itemRay, float maxDistance, float& distance) {
+		return IntersectRayAabb(itemRay, GetInverseDirection(itemRay), bvh.itemBounds[item], maxDistance, distance);
+	});
+}
+
+/// <summary>
+/// 画面上の位置（クライアント座標のピクセル）から、カメラを通るワールド空間のレイを作る
+/// </summary>
+/// <param name="inverseViewProjection">Inverse(Multiply(view, projection))</param>
+inline Ray MakeRayFromScreen(float x, float y, float width, float height, const Matrix4x4& inverseViewProjection)
+{
+	const float ndcX = x / width * 2.0f - 1.0f;
+	const float ndcY = 1.0f - y / height * 2.0f;
+	// 近クリップ面（z = 0）と遠クリップ面（z = 1）の点をワールド空間へ戻す
+	auto unproject = [&inverseViewProjection](float ndcX, float ndcY, float ndcZ) {
+		const Matrix4x4& m = inverseViewProjection;
+		const float px = ndcX * m.m[0][0] + ndcY * m.m[1][0] + ndcZ * m.m[2][0] + m.m[3][0];
+		const float py = ndcX * m.m[0][1] + ndcY * m.m[1][1] + ndcZ * m.m[2][1] + m.m[3][1];
+		const float pz = ndcX * m.m[0][2] + ndcY * m.m[1][2] + ndcZ * m.m[2][2] + m.m[3][2];
+		const float pw = ndcX * m.m[0][3] + ndcY * m.m[1][3] + ndcZ * m.m[2][3] + m.m[3][3];
+		return Vector3{ px / pw, py / pw, pz / pw };
+	};
+	const Vector3 nearPoint = unproject(ndcX, ndcY, 0.0f);
+	const Vector3 farPoint = unproject(ndcX, ndcY, 1.0f);
+	return { nearPoint, Normalize(Vector3{ farPoint.x - nearPoint.x, farPoint.y - nearPoint.y, farPoint.z - nearPoint.z }) };
+}
@@ -0,0 +1,1552 @@
+#pragma once
+// 行列・ベクトル・クォータニオンの型と演算（SSE4.1 / AVX2 のカーネルを含む）。
+// Windows のヘッダーに依存しないので、tests/ の Linux 向けのテストとベンチマークからもそのまま使う
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h> // SSE / AVX2 の組み込み関数
+#if defined(_MSC_VER)
+#include <intrin.h>    // __cpuid 用
+#endif
+#endif
+
+// Vector4型を定義する
+struct Vector4 {
+	float x, y, z, w;
+};
+
+struct Vector3 {
+	float x, y, z;
+};
+
+struct Vector2 {
+	float x, y;
+};
+
+struct Matrix4x4 {
+	float m[4][4];
+};
+
+struct Matrix3x3 {
+	float m[3][3];
+};
+
+// 回転を表す単位クォータニオン（x, y, z がベクトル部、w がスカラー部）
+struct Quaternion {
+	float x, y, z, w;
+};
+
+struct Transform {
+	Vector3 scale;
+	Vector3 rotate;
+	Vector3 translate;
+};
+
+// 回転をオイラー角の代わりにクォータニオンで持つ Transform（行列にするときに三角関数がいらない）
+struct QuaternionTransform {
+	Vector3 scale;
+	Quaternion rotate;
+	Vector3 translate;
+};
+
+struct TransformationMatrix {
+	Matrix4x4 WVP;
+	Matrix4x4 World;
+};
+
+/// <summary>
+/// 単位行列
+/// </summary>
+/// <returns>単位行列</returns>
+inline Matrix4x4 MakeIdentity4x4();
+/// <summary>
+/// スケール、回転、平行移動の各要素からアフィン変換行列（4x4）を生成。
+/// </summary>
+/// <param name="scale">拡大縮小を表すスケールベクトル。</param>
+/// <param name="rotate">回転を表すオイラー角（ラジアン）ベクトル。</param>
+/// <param name="translate">位置を表す平行移動ベクトル。</param>
+/// <returns>アフィン変換を表す 4x4 行列。</returns>
+inline Matrix4x4 MakeAffineMatrix(const Vector3& scale, const Vector3& rotate, const Vector3& translate);
+/// <summary>
+/// 垂直方向の視野角、アスペクト比、近距離および遠距離クリップ面を元に透視投影行列（4x4）を生成。
+/// </summary>
+/// <param name="fovY">垂直方向の視野角（ラジアン単位）。</param>
+/// <param name="aspect">アスペクト比（横幅 ÷ 高さ）。</param>
+/// <param name="nearZ">近距離クリップ面の距離。</param>
+/// <param name="farZ">遠距離クリップ面の距離。</param>
+/// <returns>透視投影を表す 4x4 行列。</returns>
+inline Matrix4x4 MakePerspectiveFovMatrix(float fovY, float aspect, float nearZ, float farZ);
+/// <summary>
+/// 2つの 4x4 行列の積を計算し、合成された変換行列を返します。
+/// </summary>
+/// <param name="a">左側の行列（先に適用される変換）。</param>
+/// <param name="b">右側の行列（後に適用される変換）。</param>
+/// <returns>掛け算の結果となる 4x4 行列。</returns>
+inline Matrix4x4 Multiply(const Matrix4x4& a, const Matrix4x4& b);
+/// <summary>
+/// 指定された 4x4 行列の逆行列を計算して返します。
+/// </summary>
+/// <param name="m">逆行列を求める対象の 4x4 行列。</param>
+/// <returns>指定された行列の逆行列（Matrix4x4 型）。</returns>
+inline Matrix4x4 Inverse(const Matrix4x4& m);
+/// <summary>
+/// 行列の種類。種類がわかっていれば、一般の逆行列より速い方法で逆行列を求められる
+/// </summary>
+enum class MatrixType {
+	General,              // 何もわからない（透視投影など）
+	Affine,               // 4列目が (0, 0, 0, 1)
+	ScaleRotateTranslate, // MakeAffineMatrix で作った行列（各行が直交している）
+	Rigid,                // 回転と平行移動だけ（拡大縮小なし）
+};
+/// <summary>
+/// 行列の種類に合わせた方法で逆行列を計算して返します。
+/// </summary>
+/// <param name="m">逆行列を求める対象の 4x4 行列。</param>
+/// <param name="type">m の種類。General の場合は Inverse(m) と同じ。</param>
+/// <returns>指定された行列の逆行列。</returns>
+inline Matrix4x4 Inverse(const Matrix4x4& m, MatrixType type);
+/// <summary>
+/// カメラの Transform からビュー行列を直接作る（Inverse(MakeAffineMatrix(...)) と同じ行列になる）
+/// </summary>
+/// <param name="camera">カメラの拡大縮小・回転・位置。</param>
+/// <returns>ワールド座標をカメラ座標に変換する 4x4 行列。</returns>
+inline Matrix4x4 MakeViewMatrix(const Transform& camera);
+
+// ---------------------------------------------------------------------------
+// 行列演算の SIMD 化
+// x64 では SSE4.1 / AVX2 のカーネルをビルドしておき、起動時に CPU を調べて使うものを選ぶ。
+// MATH_SIMD_SCALAR_ONLY を定義すると SIMD のコードはビルドされず、常にスカラー版を使う。
+// ---------------------------------------------------------------------------
+#if (defined(_M_X64) || defined(__x86_64__)) && !defined(MATH_SIMD_SCALAR_ONLY)
+#define MATH_SIMD_X86 1
+#endif
+
+#if defined(MATH_SIMD_X86) && !defined(_MSC_VER)
+// GCC / Clang はビルドオプションより新しい命令を使う関数に target 属性が必要（MSVC は不要）
+#define MATH_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define MATH_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define MATH_TARGET_SSE41
+#define MATH_TARGET_AVX2
+#endif
+
+/// <summary>
+/// 行列演算に使う命令セット
+/// </summary>
+enum class MathBackend {
+	Scalar,
+	SSE41,
+	AVX2,
+};
+
+/// <summary>
+/// 命令セットごとの行列演算の関数
+/// </summary>
+struct MathKernels {
+	MathBackend backend;
+	Matrix4x4(*multiply)(const Matrix4x4& a, const Matrix4x4& b);
+	Matrix4x4(*inverse)(const Matrix4x4& m);
+	// 種類がわかっている行列（General 以外）の逆行列
+	Matrix4x4(*inverseAffine)(const Matrix4x4& m, MatrixType type);
+	// angles[i] の sin と cos をまとめて求める
+	void (*sinCos)(const float* angles, float* sines, float* cosines, size_t count);
+	// 3軸の回転角の sin と cos を求める（MakeAffineMatrix 用）
+	void (*sinCosVector3)(const Vector3& angles, Vector3& sines, Vector3& cosines);
+	// カメラの Transform からビュー行列を作る
+	Matrix4x4(*makeViewMatrix)(const Transform& camera);
+};
+
+inline Matrix4x4 MultiplyScalar(const Matrix4x4& a, const Matrix4x4& b);
+inline Matrix4x4 InverseScalar(const Matrix4x4& m);
+inline Matrix4x4 InverseAffineScalar(const Matrix4x4& m, MatrixType type);
+inline Matrix4x4 MakeViewMatrixScalar(const Transform& camera);
+
+/// <summary>
+/// sinf / cosf をそのまま並べた sin・cos（スカラー版）
+/// </summary>
+inline void SinCosScalar(const float* angles, float* sines, float* cosines, size_t count)
+{
+	for (size_t i = 0; i < count; ++i) {
+		sines[i] = sinf(angles[i]);
+		cosines[i] = cosf(angles[i]);
+	}
+}
+
+/// <summary>
+/// 3軸の回転角の sin と cos（スカラー版）
+/// </summary>
+inline void SinCosVector3Scalar(const Vector3& angles, Vector3& sines, Vector3& cosines)
+{
+	sines = { sinf(angles.x), sinf(angles.y), sinf(angles.z) };
+	cosines = { cosf(angles.x), cosf(angles.y), cosf(angles.z) };
+}
+
+/// <summary>
+/// 命令セットの名前（ログ用）
+/// </summary>
+inline const wchar_t* GetMathBackendName(MathBackend backend)
+{
+	switch (backend) {
+	case MathBackend::SSE41: return L"SSE4.1";
+	case MathBackend::AVX2: return L"AVX2";
+	default: return L"Scalar";
+	}
+}
+
+#if defined(MATH_SIMD_X86)
+
+// sin / cos の多項式近似の係数（Cephes の sinf / cosf と同じもの。|x| <= π/4 で誤差は 1ulp 程度）
+const float kSinCoefficient1 = -1.6666654611e-1f;
+const float kSinCoefficient2 = 8.3321608736e-3f;
+const float kSinCoefficient3 = -1.9515295891e-4f;
+const float kCosCoefficient1 = 4.166664568298827e-2f;
+const float kCosCoefficient2 = -1.388731625493765e-3f;
+const float kCosCoefficient3 = 2.443315711809948e-5f;
+// π/2 を3つに分けたもの（j * kPiOver2Part1 が丸めなしで計算できるよう、上の桁ほどビットを少なくしてある）
+const float kPiOver2Part1 = 1.5703125f;
+const float kPiOver2Part2 = 4.837512969970703125e-4f;
+const float kPiOver2Part3 = 7.54978995489188216e-8f;
+const float kTwoOverPi = 0.636619772367581343f;
+
+/// <summary>
+/// 4x4 行列の積（SSE4.1）。行ベクトルなので r の行 i は a の行 i の各要素で b の行を重み付けして足したもの
+/// </summary>
+MATH_TARGET_SSE41 inline Matrix4x4 MultiplySSE41(const Matrix4x4& a, const Matrix4x4& b)
+{
+	const __m128 b0 = _mm_loadu_ps(b.m[0]);
+	const __m128 b1 = _mm_loadu_ps(b.m[1]);
+	const __m128 b2 = _mm_loadu_ps(b.m[2]);
+	const __m128 b3 = _mm_loadu_ps(b.m[3]);
+
+	Matrix4x4 r;
+	for (int row = 0; row < 4; ++row) {
+		__m128 result = _mm_mul_ps(_mm_set1_ps(a.m[row][0]), b0);
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(a.m[row][1]), b1));
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(a.m[row][2]), b2));
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(a.m[row][3]), b3));
+		_mm_storeu_ps(r.m[row], result);
+	}
+	return r;
+}
+
+/// <summary>
+/// 4x4 行列の積（AVX2 + FMA）。2行ずつ 256bit レジスタに載せて計算する
+/// </summary>
+MATH_TARGET_AVX2 inline Matrix4x4 MultiplyAVX2(const Matrix4x4& a, const Matrix4x4& b)
+{
+	const __m256 b0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b.m[0]));
+	const __m256 b1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b.m[1]));
+	const __m256 b2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b.m[2]));
+	const __m256 b3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b.m[3]));
+
+	Matrix4x4 r;
+	for (int row = 0; row < 4; row += 2) {
+		const __m256 rows = _mm256_loadu_ps(a.m[row]);
+		__m256 result = _mm256_mul_ps(_mm256_shuffle_ps(rows, rows, 0x00), b0);
+		result = _mm256_fmadd_ps(_mm256_shuffle_ps(rows, rows, 0x55), b1, result);
+		result = _mm256_fmadd_ps(_mm256_shuffle_ps(rows, rows, 0xAA), b2, result);
+		result = _mm256_fmadd_ps(_mm256_shuffle_ps(rows, rows, 0xFF), b3, result);
+		_mm256_storeu_ps(r.m[row], result);
+	}
+	return r;
+}
+
+// __m128 に 2x2 行列 | x y | を (x, y, z, w) の順で入れて扱う
+//                    | z w |
+#define MATH_SHUFFLE_MASK(x, y, z, w) ((x) | ((y) << 2) | ((z) << 4) | ((w) << 6))
+#define MATH_SWIZZLE(v, x, y, z, w) _mm_shuffle_ps(v, v, MATH_SHUFFLE_MASK(x, y, z, w))
+#define MATH_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps(a, b, MATH_SHUFFLE_MASK(x, y, z, w))
+
+/// <summary>
+/// 2x2 行列の積 a * b
+/// </summary>
+MATH_TARGET_SSE41 inline __m128 Multiply2x2(__m128 a, __m128 b)
+{
+	return _mm_add_ps(_mm_mul_ps(a, MATH_SWIZZLE(b, 0, 3, 0, 3)), _mm_mul_ps(MATH_SWIZZLE(a, 1, 0, 3, 2), MATH_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+/// <summary>
+/// 2x2 行列の積 adj(a) * b（adj は余因子行列）
+/// </summary>
+MATH_TARGET_SSE41 inline __m128 AdjugateMultiply2x2(__m128 a, __m128 b)
+{
+	return _mm_sub_ps(_mm_mul_ps(MATH_SWIZZLE(a, 3, 3, 0, 0), b), _mm_mul_ps(MATH_SWIZZLE(a, 1, 1, 2, 2), MATH_SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+/// <summary>
+/// 2x2 行列の積 a * adj(b)
+/// </summary>
+MATH_TARGET_SSE41 inline __m128 MultiplyAdjugate2x2(__m128 a, __m128 b)
+{
+	return _mm_sub_ps(_mm_mul_ps(a, MATH_SWIZZLE(b, 3, 0, 3, 0)), _mm_mul_ps(MATH_SWIZZLE(a, 1, 0, 3, 2), MATH_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+/// <summary>
+/// 一般の 4x4 逆行列（SSE4.1）。2x2 のブロックに分けて、ブロックの余因子行列から組み立てる
+/// </summary>
+MATH_TARGET_SSE41 inline Matrix4x4 InverseSSE41(const Matrix4x4& m)
+{
+	const __m128 row0 = _mm_loadu_ps(m.m[0]);
+	const __m128 row1 = _mm_loadu_ps(m.m[1]);
+	const __m128 row2 = _mm_loadu_ps(m.m[2]);
+	const __m128 row3 = _mm_loadu_ps(m.m[3]);
+
+	// m = | A B |
+	//     | C D |
+	const __m128 a = _mm_movelh_ps(row0, row1);
+	const __m128 b = _mm_movehl_ps(row1, row0);
+	const __m128 c = _mm_movelh_ps(row2, row3);
+	const __m128 d = _mm_movehl_ps(row3, row2);
+
+	// 4つのブロックの行列式 (|A|, |B|, |C|, |D|)
+	const __m128 blockDeterminants = _mm_sub_ps(
+		_mm_mul_ps(MATH_SHUFFLE(row0, row2, 0, 2, 0, 2), MATH_SHUFFLE(row1, row3, 1, 3, 1, 3)),
+		_mm_mul_ps(MATH_SHUFFLE(row0, row2, 1, 3, 1, 3), MATH_SHUFFLE(row1, row3, 0, 2, 0, 2)));
+	const __m128 determinantA = MATH_SWIZZLE(blockDeterminants, 0, 0, 0, 0);
+	const __m128 determinantB = MATH_SWIZZLE(blockDeterminants, 1, 1, 1, 1);
+	const __m128 determinantC = MATH_SWIZZLE(blockDeterminants, 2, 2, 2, 2);
+	const __m128 determinantD = MATH_SWIZZLE(blockDeterminants, 3, 3, 3, 3);
+
+	// 逆行列を 1/|M| * | X Y | としたときの、各ブロックの余因子行列を求める
+	//                  | Z W |
+	const __m128 adjugateDC = AdjugateMultiply2x2(d, c);
+	const __m128 adjugateAB = AdjugateMultiply2x2(a, b);
+	__m128 x = _mm_sub_ps(_mm_mul_ps(determinantD, a), Multiply2x2(b, adjugateDC));
+	__m128 w = _mm_sub_ps(_mm_mul_ps(determinantA, d), Multiply2x2(c, adjugateAB));
+	__m128 y = _mm_sub_ps(_mm_mul_ps(determinantB, c), MultiplyAdjugate2x2(d, adjugateAB));
+	__m128 z = _mm_sub_ps(_mm_mul_ps(determinantC, b), MultiplyAdjugate2x2(a, adjugateDC));
+
+	// |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+	__m128 trace = _mm_mul_ps(adjugateAB, MATH_SWIZZLE(adjugateDC, 0, 2, 1, 3));
+	trace = _mm_hadd_ps(trace, trace);
+	trace = _mm_hadd_ps(trace, trace);
+	const __m128 determinant = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(determinantA, determinantD), _mm_mul_ps(determinantB, determinantC)), trace);
+	if (_mm_cvtss_f32(determinant) == 0.0f) {
+		// 逆行列なし（特異行列）。スカラー版と同じく単位行列を返す
+		return MakeIdentity4x4();
+	}
+
+	// 余因子行列の符号もここでまとめて掛ける
+	const __m128 inverseDeterminant = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), determinant);
+	x = _mm_mul_ps(x, inverseDeterminant);
+	y = _mm_mul_ps(y, inverseDeterminant);
+	z = _mm_mul_ps(z, inverseDeterminant);
+	w = _mm_mul_ps(w, inverseDeterminant);
+
+	// 余因子行列を取る並べ替えと、行に戻す並べ替えを一度に行う
+	Matrix4x4 r;
+	_mm_storeu_ps(r.m[0], MATH_SHUFFLE(x, y, 3, 1, 3, 1));
+	_mm_storeu_ps(r.m[1], MATH_SHUFFLE(x, y, 2, 0, 2, 0));
+	_mm_storeu_ps(r.m[2], MATH_SHUFFLE(z, w, 3, 1, 3, 1));
+	_mm_storeu_ps(r.m[3], MATH_SHUFFLE(z, w, 2, 0, 2, 0));
+	return r;
+}
+
+/// <summary>
+/// 3次元の外積（w は 0 になる）
+/// </summary>
+MATH_TARGET_SSE41 inline __m128 Cross3(__m128 a, __m128 b)
+{
+	return _mm_sub_ps(_mm_mul_ps(MATH_SWIZZLE(a, 1, 2, 0, 3), MATH_SWIZZLE(b, 2, 0, 1, 3)), _mm_mul_ps(MATH_SWIZZLE(a, 2, 0, 1, 3), MATH_SWIZZLE(b, 1, 2, 0, 3)));
+}
+
+/// <summary>
+/// 種類がわかっている行列の逆行列（SSE4.1）。左上 3x3 だけを逆行列にして、平行移動は -t * (3x3 の逆行列) で求める
+/// </summary>
+MATH_TARGET_SSE41 inline Matrix4x4 InverseAffineSSE41(const Matrix4x4& m, MatrixType type)
+{
+	// 左上 3x3 の各行（w は 0 にする）
+	const __m128 xyzMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+	__m128 row0 = _mm_and_ps(_mm_loadu_ps(m.m[0]), xyzMask);
+	__m128 row1 = _mm_and_ps(_mm_loadu_ps(m.m[1]), xyzMask);
+	__m128 row2 = _mm_and_ps(_mm_loadu_ps(m.m[2]), xyzMask);
+	__m128 row3 = _mm_setzero_ps();
+
+	if (type == MatrixType::Affine) {
+		// 3x3 の逆行列の列は、行どうしの外積を行列式で割ったもの
+		__m128 column0 = Cross3(row1, row2);
+		__m128 column1 = Cross3(row2, row0);
+		__m128 column2 = Cross3(row0, row1);
+		const __m128 determinant = _mm_dp_ps(row0, column0, 0x7F);
+		if (_mm_cvtss_f32(determinant) == 0.0f) {
+			// 逆行列なし（特異行列）
+			return MakeIdentity4x4();
+		}
+		_MM_TRANSPOSE4_PS(column0, column1, column2, row3);
+		const __m128 inverseDeterminant = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+		row0 = _mm_mul_ps(column0, inverseDeterminant);
+		row1 = _mm_mul_ps(column1, inverseDeterminant);
+		row2 = _mm_mul_ps(column2, inverseDeterminant);
+	} else {
+		// 回転行列の逆行列は転置
+		_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+		if (type == MatrixType::ScaleRotateTranslate) {
+			// 転置すると、元の行 j の長さの2乗はレーン j に集まるので、各列をそれで割る
+			__m128 scaleSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(row0, row0), _mm_mul_ps(row1, row1)), _mm_mul_ps(row2, row2));
+			if (_mm_movemask_ps(_mm_cmpeq_ps(scaleSquared, _mm_setzero_ps())) & 0x7) {
+				// 逆行列なし（特異行列）
+				return MakeIdentity4x4();
+			}
+			scaleSquared = _mm_blend_ps(scaleSquared, _mm_set1_ps(1.0f), 0x8);
+			const __m128 inverseScaleSquared = _mm_div_ps(_mm_set1_ps(1.0f), scaleSquared);
+			row0 = _mm_mul_ps(row0, inverseScaleSquared);
+			row1 = _mm_mul_ps(row1, inverseScaleSquared);
+			row2 = _mm_mul_ps(row2, inverseScaleSquared);
+		}
+	}
+
+	// 平行移動 -t * (3x3 の逆行列)。w は 1 にする
+	__m128 translate = _mm_mul_ps(_mm_set1_ps(m.m[3][0]), row0);
+	translate = _mm_add_ps(translate, _mm_mul_ps(_mm_set1_ps(m.m[3][1]), row1));
+	translate = _mm_add_ps(translate, _mm_mul_ps(_mm_set1_ps(m.m[3][2]), row2));
+	translate = _mm_blend_ps(_mm_sub_ps(_mm_setzero_ps(), translate), _mm_set1_ps(1.0f), 0x8);
+
+	Matrix4x4 r;
+	_mm_storeu_ps(r.m[0], row0);
+	_mm_storeu_ps(r.m[1], row1);
+	_mm_storeu_ps(r.m[2], row2);
+	_mm_storeu_ps(r.m[3], translate);
+	return r;
+}
+
+/// <summary>
+/// 4つの角度の sin と cos（SSE4.1）。π/2 単位で範囲を縮めてから多項式で近似する
+/// </summary>
+MATH_TARGET_SSE41 inline void SinCos4(__m128 angles, __m128& sines, __m128& cosines)
+{
+	// 一番近い π/2 の倍数 j を引いて [-π/4, π/4] に収める
+	const __m128 jFloat = _mm_round_ps(_mm_mul_ps(angles, _mm_set1_ps(kTwoOverPi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	const __m128i j = _mm_cvtps_epi32(jFloat);
+	__m128 x = _mm_sub_ps(angles, _mm_mul_ps(jFloat, _mm_set1_ps(kPiOver2Part1)));
+	x = _mm_sub_ps(x, _mm_mul_ps(jFloat, _mm_set1_ps(kPiOver2Part2)));
+	x = _mm_sub_ps(x, _mm_mul_ps(jFloat, _mm_set1_ps(kPiOver2Part3)));
+
+	const __m128 x2 = _mm_mul_ps(x, x);
+	__m128 sinPolynomial = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(kSinCoefficient3), x2), _mm_set1_ps(kSinCoefficient2));
+	sinPolynomial = _mm_add_ps(_mm_mul_ps(sinPolynomial, x2), _mm_set1_ps(kSinCoefficient1));
+	sinPolynomial = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPolynomial, x2), x), x);
+	__m128 cosPolynomial = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(kCosCoefficient3), x2), _mm_set1_ps(kCosCoefficient2));
+	cosPolynomial = _mm_add_ps(_mm_mul_ps(cosPolynomial, x2), _mm_set1_ps(kCosCoefficient1));
+	cosPolynomial = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(cosPolynomial, x2), x2), _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), x2)));
+
+	// j の下位2ビット（象限）で sin と cos の入れ替えと符号を決める
+	const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+	const __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), 30));
+	const __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+	sines = _mm_xor_ps(_mm_blendv_ps(sinPolynomial, cosPolynomial, swap), sinSign);
+	cosines = _mm_xor_ps(_mm_blendv_ps(cosPolynomial, sinPolynomial, swap), cosSign);
+}
+
+/// <summary>
+/// sin と cos をまとめて求める（SSE4.1）。端数はゼロで埋めて4つ分計算する
+/// </summary>
+MATH_TARGET_SSE41 inline void SinCosSSE41(const float* angles, float* sines, float* cosines, size_t count)
+{
+	size_t i = 0;
+	__m128 s, c;
+	for (; i + 4 <= count; i += 4) {
+		SinCos4(_mm_loadu_ps(angles + i), s, c);
+		_mm_storeu_ps(sines + i, s);
+		_mm_storeu_ps(cosines + i, c);
+	}
+	if (i < count) {
+		alignas(16) float rest[3][4] = {};
+		std::copy(angles + i, angles + count, rest[0]);
+		SinCos4(_mm_load_ps(rest[0]), s, c);
+		_mm_store_ps(rest[1], s);
+		_mm_store_ps(rest[2], c);
+		std::copy(rest[1], rest[1] + (count - i), sines + i);
+		std::copy(rest[2], rest[2] + (count - i), cosines + i);
+	}
+}
+
+/// <summary>
+/// 3軸の回転角の sin と cos（SSE4.1）。配列を経由するとストアからロードへの転送が効かず遅くなるので、レジスタに直接組み立てる
+/// </summary>
+MATH_TARGET_SSE41 inline void SinCosVector3SSE41(const Vector3& angles, Vector3& sines, Vector3& cosines)
+{
+	__m128 s, c;
+	SinCos4(_mm_setr_ps(angles.x, angles.y, angles.z, 0.0f), s, c);
+	alignas(16) float result[2][4];
+	_mm_store_ps(result[0], s);
+	_mm_store_ps(result[1], c);
+	sines = { result[0][0], result[0][1], result[0][2] };
+	cosines = { result[1][0], result[1][1], result[1][2] };
+}
+
+/// <summary>
+/// カメラの Transform からビュー行列を作る（SSE4.1）。MakeAffineMatrix と同じ回転行列 R をレジスタ上で作り、
+/// (S R T)^-1 = T^-1 R^T S^-1 を転置と列ごとの割り算で求める（行列を一度メモリに書いてから読み直すと遅い）
+/// </summary>
+MATH_TARGET_SSE41 inline Matrix4x4 MakeViewMatrixSSE41(const Transform& camera)
+{
+	if (camera.scale.x == 0.0f || camera.scale.y == 0.0f || camera.scale.z == 0.0f) {
+		// 逆行列なし（特異行列）
+		return MakeIdentity4x4();
+	}
+
+	__m128 s, c;
+	SinCos4(_mm_setr_ps(camera.rotate.x, camera.rotate.y, camera.rotate.z, 0.0f), s, c);
+	const float sinX = _mm_cvtss_f32(s);
+	const float sinY = _mm_cvtss_f32(MATH_SWIZZLE(s, 1, 1, 1, 1));
+	const float sinZ = _mm_cvtss_f32(MATH_SWIZZLE(s, 2, 2, 2, 2));
+	const float cosX = _mm_cvtss_f32(c);
+	const float cosY = _mm_cvtss_f32(MATH_SWIZZLE(c, 1, 1, 1, 1));
+	const float cosZ = _mm_cvtss_f32(MATH_SWIZZLE(c, 2, 2, 2, 2));
+
+	__m128 row0 = _mm_setr_ps(cosY * cosZ, cosY * sinZ, -sinY, 0.0f);
+	__m128 row1 = _mm_setr_ps(sinX * sinY * cosZ - cosX * sinZ, sinX * sinY * sinZ + cosX * cosZ, sinX * cosY, 0.0f);
+	__m128 row2 = _mm_setr_ps(cosX * sinY * cosZ + sinX * sinZ, cosX * sinY * sinZ - sinX * cosZ, cosX * cosY, 0.0f);
+	__m128 row3 = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+	const __m128 inverseScale = _mm_div_ps(_mm_set1_ps(1.0f), _mm_setr_ps(camera.scale.x, camera.scale.y, camera.scale.z, 1.0f));
+	row0 = _mm_mul_ps(row0, inverseScale);
+	row1 = _mm_mul_ps(row1, inverseScale);
+	row2 = _mm_mul_ps(row2, inverseScale);
+
+	__m128 translate = _mm_mul_ps(_mm_set1_ps(camera.translate.x), row0);
+	translate = _mm_add_ps(translate, _mm_mul_ps(_mm_set1_ps(camera.translate.y), row1));
+	translate = _mm_add_ps(translate, _mm_mul_ps(_mm_set1_ps(camera.translate.z), row2));
+	translate = _mm_blend_ps(_mm_sub_ps(_mm_setzero_ps(), translate), _mm_set1_ps(1.0f), 0x8);
+
+	Matrix4x4 view;
+	_mm_storeu_ps(view.m[0], row0);
+	_mm_storeu_ps(view.m[1], row1);
+	_mm_storeu_ps(view.m[2], row2);
+	_mm_storeu_ps(view.m[3], translate);
+	return view;
+}
+
+/// <summary>
+/// 8つの角度の sin と cos（AVX2 + FMA）。計算は SinCos4 と同じ
+/// </summary>
+MATH_TARGET_AVX2 inline void SinCos8(__m256 angles, __m256& sines, __m256& cosines)
+{
+	const __m256 jFloat = _mm256_round_ps(_mm256_mul_ps(angles, _mm256_set1_ps(kTwoOverPi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	const __m256i j = _mm256_cvtps_epi32(jFloat);
+	__m256 x = _mm256_fnmadd_ps(jFloat, _mm256_set1_ps(kPiOver2Part1), angles);
+	x = _mm256_fnmadd_ps(jFloat, _mm256_set1_ps(kPiOver2Part2), x);
+	x = _mm256_fnmadd_ps(jFloat, _mm256_set1_ps(kPiOver2Part3), x);
+
+	const __m256 x2 = _mm256_mul_ps(x, x);
+	__m256 sinPolynomial = _mm256_fmadd_ps(_mm256_set1_ps(kSinCoefficient3), x2, _mm256_set1_ps(kSinCoefficient2));
+	sinPolynomial = _mm256_fmadd_ps(sinPolynomial, x2, _mm256_set1_ps(kSinCoefficient1));
+	sinPolynomial = _mm256_fmadd_ps(_mm256_mul_ps(sinPolynomial, x2), x, x);
+	__m256 cosPolynomial = _mm256_fmadd_ps(_mm256_set1_ps(kCosCoefficient3), x2, _mm256_set1_ps(kCosCoefficient2));
+	cosPolynomial = _mm256_fmadd_ps(cosPolynomial, x2, _mm256_set1_ps(kCosCoefficient1));
+	cosPolynomial = _mm256_fmadd_ps(_mm256_mul_ps(cosPolynomial, x2), x2, _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), x2, _mm256_set1_ps(1.0f)));
+
+	const __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+	const __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), 30));
+	const __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+	sines = _mm256_xor_ps(_mm256_blendv_ps(sinPolynomial, cosPolynomial, swap), sinSign);
+	cosines = _mm256_xor_ps(_mm256_blendv_ps(cosPolynomial, sinPolynomial, swap), cosSign);
+}
+
+/// <summary>
+/// sin と cos をまとめて求める（AVX2 + FMA）。8つに満たない残りは SSE4.1 版に任せる
+/// </summary>
+MATH_TARGET_AVX2 inline void SinCosAVX2(const float* angles, float* sines, float* cosines, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 s, c;
+		SinCos8(_mm256_loadu_ps(angles + i), s, c);
+		_mm256_storeu_ps(sines + i, s);
+		_mm256_storeu_ps(cosines + i, c);
+	}
+	if (i < count) {
+		SinCosSSE41(angles + i, sines + i, cosines + i, count - i);
+	}
+}
+
+/// <summary>
+/// CPU とOSが対応している一番新しい命令セットを調べる
+/// </summary>
+inline MathBackend DetectMathBackend()
+{
+#if defined(_MSC_VER)
+	int info[4] = {};
+	__cpuid(info, 0);
+	const int maxLeaf = info[0];
+	__cpuid(info, 1);
+	const bool hasSSE41 = (info[2] & (1 << 19)) != 0;
+	const bool hasFMA = (info[2] & (1 << 12)) != 0;
+	// AVX は CPU だけでなく OS が YMM レジスタを保存してくれる（OSXSAVE と XCR0）ことも必要
+	const bool hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+	const bool hasAVX = (info[2] & (1 << 28)) != 0;
+	bool hasAVX2 = false;
+	if (maxLeaf >= 7 && hasOSXSAVE && hasAVX && (_xgetbv(0) & 0x6) == 0x6) {
+		__cpuidex(info, 7, 0);
+		hasAVX2 = (info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	const bool hasSSE41 = __builtin_cpu_supports("sse4.1");
+	const bool hasFMA = __builtin_cpu_supports("fma");
+	const bool hasAVX2 = __builtin_cpu_supports("avx2");
+#endif
+	if (hasAVX2 && hasFMA) {
+		return MathBackend::AVX2;
+	}
+	if (hasSSE41) {
+		return MathBackend::SSE41;
+	}
+	return MathBackend::Scalar;
+}
+
+#else
+
+inline MathBackend DetectMathBackend()
+{
+	return MathBackend::Scalar;
+}
+
+#endif
+
+/// <summary>
+/// 命令セットに対応する関数をまとめる（ビルドされていない命令セットはスカラー版になる）
+/// </summary>
+inline MathKernels MakeMathKernels(MathBackend backend)
+{
+#if defined(MATH_SIMD_X86)
+	if (backend == MathBackend::AVX2) {
+		// 逆行列と3つだけの sin / cos は 256bit にしても得がないので SSE4.1 版を使う
+		return { MathBackend::AVX2, MultiplyAVX2, InverseSSE41, InverseAffineSSE41, SinCosAVX2, SinCosVector3SSE41, MakeViewMatrixSSE41 };
+	}
+	if (backend == MathBackend::SSE41) {
+		return { MathBackend::SSE41, MultiplySSE41, InverseSSE41, InverseAffineSSE41, SinCosSSE41, SinCosVector3SSE41, MakeViewMatrixSSE41 };
+	}
+#endif
+	(void)backend;
+	return { MathBackend::Scalar, MultiplyScalar, InverseScalar, InverseAffineScalar, SinCosScalar, SinCosVector3Scalar, MakeViewMatrixScalar };
+}
+
+// 起動時に選んだ行列演算の関数（ベンチマークでは SetMathBackend で切り替える）
+inline MathKernels gMathKernels = MakeMathKernels(DetectMathBackend());
+
+/// <summary>
+/// 使う命令セットを切り替える。CPU が対応していないものを指定した場合は切り替えずに false を返す
+/// </summary>
+inline bool SetMathBackend(MathBackend backend)
+{
+	if (static_cast<int>(backend) > static_cast<int>(DetectMathBackend())) {
+		return false;
+	}
+	gMathKernels = MakeMathKernels(backend);
+	return gMathKernels.backend == backend;
+}
+
+/// <summary>
+/// sin と cos をまとめて求める（今選ばれている命令セットで計算する）
+/// </summary>
+inline void SinCosBatch(const float* angles, float* sines, float* cosines, size_t count)
+{
+	gMathKernels.sinCos(angles, sines, cosines, count);
+}
+
+/// <summary>
+/// たくさんの物体の Transform を、成分ごとの配列（SoA）で持つ。
+/// 同じ成分が連続して並ぶので、SIMD で4つ / 8つの物体をまとめて計算できる
+/// </summary>
+struct TransformSoA {
+	std::vector<float> scaleX, scaleY, scaleZ;
+	std::vector<float> rotateX, rotateY, rotateZ;
+	std::vector<float> translateX, translateY, translateZ;
+};
+
+/// <summary>
+/// 物体の数
+/// </summary>
+inline size_t GetTransformCount(const TransformSoA& transforms)
+{
+	return transforms.scaleX.size();
+}
+
+/// <summary>
+/// i 番目の物体の Transform を書き換える
+/// </summary>
+inline void SetTransform(TransformSoA& transforms, size_t index, const Transform& transform)
+{
+	transforms.scaleX[index] = transform.scale.x;
+	transforms.scaleY[index] = transform.scale.y;
+	transforms.scaleZ[index] = transform.scale.z;
+	transforms.rotateX[index] = transform.rotate.x;
+	transforms.rotateY[index] = transform.rotate.y;
+	transforms.rotateZ[index] = transform.rotate.z;
+	transforms.translateX[index] = transform.translate.x;
+	transforms.translateY[index] = transform.translate.y;
+	transforms.translateZ[index] = transform.translate.z;
+}
+
+/// <summary>
+/// i 番目の物体の Transform を取り出す
+/// </summary>
+inline Transform GetTransform(const TransformSoA& transforms, size_t index)
+{
+	return {
+		{ transforms.scaleX[index], transforms.scaleY[index], transforms.scaleZ[index] },
+		{ transforms.rotateX[index], transforms.rotateY[index], transforms.rotateZ[index] },
+		{ transforms.translateX[index], transforms.translateY[index], transforms.translateZ[index] } };
+}
+
+/// <summary>
+/// 物体を追加する
+/// </summary>
+/// <returns>追加した物体の番号</returns>
+inline size_t AddTransform(TransformSoA& transforms, const Transform& transform)
+{
+	const size_t index = GetTransformCount(transforms);
+	for (std::vector<float>* component : { &transforms.scaleX, &transforms.scaleY, &transforms.scaleZ,
+		&transforms.rotateX, &transforms.rotateY, &transforms.rotateZ,
+		&transforms.translateX, &transforms.translateY, &transforms.translateZ }) {
+		component->push_back(0.0f);
+	}
+	SetTransform(transforms, index, transform);
+	return index;
+}
+
+/// <summary>
+/// 出力先の index 番目の TransformationMatrix（stride バイトおきに並んでいる）
+/// </summary>
+inline TransformationMatrix* GetTransformationMatrixAt(uint8_t* output, size_t stride, size_t index)
+{
+	return reinterpret_cast<TransformationMatrix*>(output + stride * index);
+}
+
+/// <summary>
+/// 出力先の index 番目の Matrix4x4（stride バイトおきに並んでいる）
+/// </summary>
+inline Matrix4x4* GetMatrixAt(uint8_t* output, size_t stride, size_t index)
+{
+	return reinterpret_cast<Matrix4x4*>(output + stride * index);
+}
+
+#if defined(MATH_SIMD_X86)
+
+/// <summary>
+/// i 番目から4つの物体の World を、要素ごとに4つの物体分まとめて求める（MakeAffineMatrix と同じ式、SSE4.1）
+/// </summary>
+MATH_TARGET_SSE41 inline void ComputeWorld4(const TransformSoA& transforms, size_t i, __m128 world[4][4])
+{
+	__m128 sinX, cosX, sinY, cosY, sinZ, cosZ;
+	SinCos4(_mm_loadu_ps(&transforms.rotateX[i]), sinX, cosX);
+	SinCos4(_mm_loadu_ps(&transforms.rotateY[i]), sinY, cosY);
+	SinCos4(_mm_loadu_ps(&transforms.rotateZ[i]), sinZ, cosZ);
+	const __m128 scaleX = _mm_loadu_ps(&transforms.scaleX[i]);
+	const __m128 scaleY = _mm_loadu_ps(&transforms.scaleY[i]);
+	const __m128 scaleZ = _mm_loadu_ps(&transforms.scaleZ[i]);
+
+	const __m128 sinXsinY = _mm_mul_ps(sinX, sinY);
+	const __m128 cosXsinY = _mm_mul_ps(cosX, sinY);
+	world[0][0] = _mm_mul_ps(scaleX, _mm_mul_ps(cosY, cosZ));
+	world[0][1] = _mm_mul_ps(scaleX, _mm_mul_ps(cosY, sinZ));
+	world[0][2] = _mm_mul_ps(scaleX, _mm_sub_ps(_mm_setzero_ps(), sinY));
+	world[0][3] = _mm_setzero_ps();
+	world[1][0] = _mm_mul_ps(scaleY, _mm_sub_ps(_mm_mul_ps(sinXsinY, cosZ), _mm_mul_ps(cosX, sinZ)));
+	world[1][1] = _mm_mul_ps(scaleY, _mm_add_ps(_mm_mul_ps(sinXsinY, sinZ), _mm_mul_ps(cosX, cosZ)));
+	world[1][2] = _mm_mul_ps(scaleY, _mm_mul_ps(sinX, cosY));
+	world[1][3] = _mm_setzero_ps();
+	world[2][0] = _mm_mul_ps(scaleZ, _mm_add_ps(_mm_mul_ps(cosXsinY, cosZ), _mm_mul_ps(sinX, sinZ)));
+	world[2][1] = _mm_mul_ps(scaleZ, _mm_sub_ps(_mm_mul_ps(cosXsinY, sinZ), _mm_mul_ps(sinX, cosZ)));
+	world[2][2] = _mm_mul_ps(scaleZ, _mm_mul_ps(cosX, cosY));
+	world[2][3] = _mm_setzero_ps();
+	world[3][0] = _mm_loadu_ps(&transforms.translateX[i]);
+	world[3][1] = _mm_loadu_ps(&transforms.translateY[i]);
+	world[3][2] = _mm_loadu_ps(&transforms.translateZ[i]);
+	world[3][3] = _mm_set1_ps(1.0f);
+}
+
+/// <summary>
+/// [begin, end) の物体の World だけを4つずつ計算する（SSE4.1）
+/// </summary>
+/// <returns>計算し終えた位置（4つに満たない残りは呼び出し側で計算する）</returns>
+MATH_TARGET_SSE41 inline size_t ComputeWorldMatricesSSE41(const TransformSoA& transforms, uint8_t* output, size_t stride, size_t begin, size_t end)
+{
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4) {
+		__m128 world[4][4];
+		ComputeWorld4(transforms, i, world);
+		for (int row = 0; row < 4; ++row) {
+			__m128 worldRow[4] = { world[row][0], world[row][1], world[row][2], world[row][3] };
+			_MM_TRANSPOSE4_PS(worldRow[0], worldRow[1], worldRow[2], worldRow[3]);
+			for (int object = 0; object < 4; ++object) {
+				_mm_storeu_ps(GetMatrixAt(output, stride, i + object)->m[row], worldRow[object]);
+			}
+		}
+	}
+	return i;
+}
+
+/// <summary>
+/// [begin, end) の物体の World と WVP を4つずつ計算する（SSE4.1）
+/// </summary>
+/// <returns>計算し終えた位置（4つに満たない残りは呼び出し側で計算する）</returns>
+MATH_TARGET_SSE41 inline size_t ComputeTransformationMatricesSSE41(const TransformSoA& transforms, const Matrix4x4& viewProjection, uint8_t* output, size_t stride, size_t begin, size_t end)
+{
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4) {
+		__m128 world[4][4];
+		ComputeWorld4(transforms, i, world);
+
+		for (int row = 0; row < 4; ++row) {
+			// WVP の行 = World の行 * VP（World の4列目は 0 か 1 なので、3列分だけ掛けて最後の行だけ VP の4行目を足す）
+			__m128 wvp[4];
+			for (int col = 0; col < 4; ++col) {
+				__m128 sum = _mm_mul_ps(world[row][0], _mm_set1_ps(viewProjection.m[0][col]));
+				sum = _mm_add_ps(sum, _mm_mul_ps(world[row][1], _mm_set1_ps(viewProjection.m[1][col])));
+				sum = _mm_add_ps(sum, _mm_mul_ps(world[row][2], _mm_set1_ps(viewProjection.m[2][col])));
+				if (row == 3) {
+					sum = _mm_add_ps(sum, _mm_set1_ps(viewProjection.m[3][col]));
+				}
+				wvp[col] = sum;
+			}
+
+			// 要素ごとに並んでいるものを、物体ごとの行に並べ替えて書き込む
+			_MM_TRANSPOSE4_PS(wvp[0], wvp[1], wvp[2], wvp[3]);
+			__m128 worldRow[4] = { world[row][0], world[row][1], world[row][2], world[row][3] };
+			_MM_TRANSPOSE4_PS(worldRow[0], worldRow[1], worldRow[2], worldRow[3]);
+			for (int object = 0; object < 4; ++object) {
+				TransformationMatrix* destination = GetTransformationMatrixAt(output, stride, i + object);
+				_mm_storeu_ps(destination->WVP.m[row], wvp[object]);
+				_mm_storeu_ps(destination->World.m[row], worldRow[object]);
+			}
+		}
+	}
+	return i;
+}
+
+/// <summary>
+/// 128bit の半分ごとに 4x4 の転置をする（下半分と上半分で別々の4つの物体を並べ替える）
+/// </summary>
+MATH_TARGET_AVX2 inline void TransposeHalves4x4(__m256& row0, __m256& row1, __m256& row2, __m256& row3)
+{
+	const __m256 t0 = _mm256_unpacklo_ps(row0, row1);
+	const __m256 t1 = _mm256_unpacklo_ps(row2, row3);
+	const __m256 t2 = _mm256_unpackhi_ps(row0, row1);
+	const __m256 t3 = _mm256_unpackhi_ps(row2, row3);
+	row0 = _mm256_shuffle_ps(t0, t1, 0x44);
+	row1 = _mm256_shuffle_ps(t0, t1, 0xEE);
+	row2 = _mm256_shuffle_ps(t2, t3, 0x44);
+	row3 = _mm256_shuffle_ps(t2, t3, 0xEE);
+}
+
+/// <summary>
+/// i 番目から8つの物体の World を、要素ごとに8つの物体分まとめて求める（AVX2 + FMA）。計算は SSE4.1 版と同じ
+/// </summary>
+MATH_TARGET_AVX2 inline void ComputeWorld8(const TransformSoA& transforms, size_t i, __m256 world[4][4])
+{
+	__m256 sinX, cosX, sinY, cosY, sinZ, cosZ;
+	SinCos8(_mm256_loadu_ps(&transforms.rotateX[i]), sinX, cosX);
+	SinCos8(_mm256_loadu_ps(&transforms.rotateY[i]), sinY, cosY);
+	SinCos8(_mm256_loadu_ps(&transforms.rotateZ[i]), sinZ, cosZ);
+	const __m256 scaleX = _mm256_loadu_ps(&transforms.scaleX[i]);
+	const __m256 scaleY = _mm256_loadu_ps(&transforms.scaleY[i]);
+	const __m256 scaleZ = _mm256_loadu_ps(&transforms.scaleZ[i]);
+
+	const __m256 sinXsinY = _mm256_mul_ps(sinX, sinY);
+	const __m256 cosXsinY = _mm256_mul_ps(cosX, sinY);
+	world[0][0] = _mm256_mul_ps(scaleX, _mm256_mul_ps(cosY, cosZ));
+	world[0][1] = _mm256_mul_ps(scaleX, _mm256_mul_ps(cosY, sinZ));
+	world[0][2] = _mm256_mul_ps(scaleX, _mm256_sub_ps(_mm256_setzero_ps(), sinY));
+	world[0][3] = _mm256_setzero_ps();
+	world[1][0] = _mm256_mul_ps(scaleY, _mm256_fmsub_ps(sinXsinY, cosZ, _mm256_mul_ps(cosX, sinZ)));
+	world[1][1] = _mm256_mul_ps(scaleY, _mm256_fmadd_ps(sinXsinY, sinZ, _mm256_mul_ps(cosX, cosZ)));
+	world[1][2] = _mm256_mul_ps(scaleY, _mm256_mul_ps(sinX, cosY));
+	world[1][3] = _mm256_setzero_ps();
+	world[2][0] = _mm256_mul_ps(scaleZ, _mm256_fmadd_ps(cosXsinY, cosZ, _mm256_mul_ps(sinX, sinZ)));
+	world[2][1] = _mm256_mul_ps(scaleZ, _mm256_fmsub_ps(cosXsinY, sinZ, _mm256_mul_ps(sinX, cosZ)));
+	world[2][2] = _mm256_mul_ps(scaleZ, _mm256_mul_ps(cosX, cosY));
+	world[2][3] = _mm256_setzero_ps();
+	world[3][0] = _mm256_loadu_ps(&transforms.translateX[i]);
+	world[3][1] = _mm256_loadu_ps(&transforms.translateY[i]);
+	world[3][2] = _mm256_loadu_ps(&transforms.translateZ[i]);
+	world[3][3] = _mm256_set1_ps(1.0f);
+}
+
+/// <summary>
+/// [begin, end) の物体の World だけを8つずつ計算する（AVX2 + FMA）
+/// </summary>
+/// <returns>計算し終えた位置（8つに満たない残りは呼び出し側で計算する）</returns>
+MATH_TARGET_AVX2 inline size_t ComputeWorldMatricesAVX2(const TransformSoA& transforms, uint8_t* output, size_t stride, size_t begin, size_t end)
+{
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8) {
+		__m256 world[4][4];
+		ComputeWorld8(transforms, i, world);
+		for (int row = 0; row < 4; ++row) {
+			__m256 worldRow[4] = { world[row][0], world[row][1], world[row][2], world[row][3] };
+			TransposeHalves4x4(worldRow[0], worldRow[1], worldRow[2], worldRow[3]);
+			for (int object = 0; object < 4; ++object) {
+				_mm_storeu_ps(GetMatrixAt(output, stride, i + object)->m[row], _mm256_castps256_ps128(worldRow[object]));
+				_mm_storeu_ps(GetMatrixAt(output, stride, i + 4 + object)->m[row], _mm256_extractf128_ps(worldRow[object], 1));
+			}
+		}
+	}
+	return i;
+}
+
+/// <summary>
+/// [begin, end) の物体の World と WVP を8つずつ計算する（AVX2 + FMA）。計算は SSE4.1 版と同じ
+/// </summary>
+/// <returns>計算し終えた位置（8つに満たない残りは呼び出し側で計算する）</returns>
+MATH_TARGET_AVX2 inline size_t ComputeTransformationMatricesAVX2(const TransformSoA& transforms, const Matrix4x4& viewProjection, uint8_t* output, size_t stride, size_t begin, size_t end)
+{
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8) {
+		__m256 world[4][4];
+		ComputeWorld8(transforms, i, world);
+
+		for (int row = 0; row < 4; ++row) {
+			__m256 wvp[4];
+			for (int col = 0; col < 4; ++col) {
+				__m256 sum = _mm256_mul_ps(world[row][0], _mm256_set1_ps(viewProjection.m[0][col]));
+				sum = _mm256_fmadd_ps(world[row][1], _mm256_set1_ps(viewProjection.m[1][col]), sum);
+				sum = _mm256_fmadd_ps(world[row][2], _mm256_set1_ps(viewProjection.m[2][col]), sum);
+				if (row == 3) {
+					sum = _mm256_add_ps(sum, _mm256_set1_ps(viewProjection.m[3][col]));
+				}
+				wvp[col] = sum;
+			}
+
+			// 下半分に物体 0～3、上半分に物体 4～7 の行が入る
+			TransposeHalves4x4(wvp[0], wvp[1], wvp[2], wvp[3]);
+			__m256 worldRow[4] = { world[row][0], world[row][1], world[row][2], world[row][3] };
+			TransposeHalves4x4(worldRow[0], worldRow[1], worldRow[2], worldRow[3]);
+			for (int object = 0; object < 4; ++object) {
+				TransformationMatrix* lower = GetTransformationMatrixAt(output, stride, i + object);
+				TransformationMatrix* upper = GetTransformationMatrixAt(output, stride, i + 4 + object);
+				_mm_storeu_ps(lower->WVP.m[row], _mm256_castps256_ps128(wvp[object]));
+				_mm_storeu_ps(upper->WVP.m[row], _mm256_extractf128_ps(wvp[object], 1));
+				_mm_storeu_ps(lower->World.m[row], _mm256_castps256_ps128(worldRow[object]));
+				_mm_storeu_ps(upper->World.m[row], _mm256_extractf128_ps(worldRow[object], 1));
+			}
+		}
+	}
+	return i;
+}
+
+#endif
+
+/// <summary>
+/// [begin, end) の物体の World だけを計算する（シーングラフのローカル行列など、WVP がいらないとき）
+/// </summary>
+/// <param name="output">書き込み先（output の begin 番目から並んでいること）</param>
+/// <param name="stride">書き込み先の間隔</param>
+inline void ComputeWorldMatrices(const TransformSoA& transforms, Matrix4x4* output, size_t stride, size_t begin, size_t end)
+{
+	uint8_t* bytes = reinterpret_cast<uint8_t*>(output);
+	size_t i = begin;
+#if defined(MATH_SIMD_X86)
+	if (gMathKernels.backend == MathBackend::AVX2) {
+		i = ComputeWorldMatricesAVX2(transforms, bytes, stride, i, end);
+	}
+	if (gMathKernels.backend != MathBackend::Scalar) {
+		i = ComputeWorldMatricesSSE41(transforms, bytes, stride, i, end);
+	}
+#endif
+	for (; i < end; ++i) {
+		*GetMatrixAt(bytes, stride, i) = MakeAffineMatrix(
+			{ transforms.scaleX[i], transforms.scaleY[i], transforms.scaleZ[i] },
+			{ transforms.rotateX[i], transforms.rotateY[i], transforms.rotateZ[i] },
+			{ transforms.translateX[i], transforms.translateY[i], transforms.translateZ[i] });
+	}
+}
+
+/// <summary>
+/// すべての物体の World と WVP を一度に計算する。VP はフレームごとに一度だけ計算して渡す
+/// </summary>
+/// <param name="transforms">物体の Transform</param>
+/// <param name="viewProjection">Multiply(view, projection)</param>
+/// <param name="output">書き込み先（物体の数だけ並んでいること）</param>
+/// <param name="stride">書き込み先の間隔（定数バッファにそのまま書く場合は 256 バイト）</param>
+inline void ComputeTransformationMatrices(const TransformSoA& transforms, const Matrix4x4& viewProjection, TransformationMatrix* output, size_t stride = sizeof(TransformationMatrix))
+{
+	uint8_t* bytes = reinterpret_cast<uint8_t*>(output);
+	const size_t count = GetTransformCount(transforms);
+	size_t i = 0;
+#if defined(MATH_SIMD_X86)
+	if (gMathKernels.backend == MathBackend::AVX2) {
+		i = ComputeTransformationMatricesAVX2(transforms, viewProjection, bytes, stride, i, count);
+	}
+	if (gMathKernels.backend != MathBackend::Scalar) {
+		i = ComputeTransformationMatricesSSE41(transforms, viewProjection, bytes, stride, i, count);
+	}
+#endif
+	// SIMD の幅に満たない残り（スカラー版ではすべて）
+	for (; i < count; ++i) {
+		TransformationMatrix* destination = GetTransformationMatrixAt(bytes, stride, i);
+		destination->World = MakeAffineMatrix(
+			{ transforms.scaleX[i], transforms.scaleY[i], transforms.scaleZ[i] },
+			{ transforms.rotateX[i], transforms.rotateY[i], transforms.rotateZ[i] },
+			{ transforms.translateX[i], transforms.translateY[i], transforms.translateZ[i] });
+		destination->WVP = Multiply(destination->World, viewProjection);
+	}
+}
+
+inline Vector3 Normalize(const Vector3& v) {
+	float length = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+	if (length == 0.0f) return { 0.0f, 0.0f, 0.0f };
+	return { v.x / length, v.y / length, v.z / length };
+}
+
+inline Matrix4x4 MakeScaleMatrix(const Vector3& scale) {
+	Matrix4x4 result = {};
+	result.m[0][0] = scale.x;
+	result.m[1][1] = scale.y;
+	result.m[2][2] = scale.z;
+	result.m[3][3] = 1.0f;
+	return result;
+}
+
+inline Matrix4x4 MakeRotateZMatrix(float angle) {
+	Matrix4x4 result = {};
+	float c = cosf(angle);
+	float s = sinf(angle);
+
+	result.m[0][0] = c;
+	result.m[0][1] = -s;
+	result.m[1][0] = s;
+	result.m[1][1] = c;
+	result.m[2][2] = 1.0f;
+	result.m[3][3] = 1.0f;
+	return result;
+}
+
+inline Matrix4x4 MakeTranslateMatrix(const Vector3& translate) {
+	Matrix4x4 result = {};
+	result.m[0][0] = 1.0f;
+	result.m[1][1] = 1.0f;
+	result.m[2][2] = 1.0f;
+	result.m[3][3] = 1.0f;
+
+	result.m[3][0] = translate.x;
+	result.m[3][1] = translate.y;
+	result.m[3][2] = translate.z;
+	return result;
+}
+
+/// <summary>
+/// 単位クォータニオン（回転なし）
+/// </summary>
+inline Quaternion MakeIdentityQuaternion()
+{
+	return { 0.0f, 0.0f, 0.0f, 1.0f };
+}
+
+/// <summary>
+/// クォータニオンの積（ハミルトン積）。rhs の回転をしてから lhs の回転をする回転になる
+/// </summary>
+inline Quaternion Multiply(const Quaternion& lhs, const Quaternion& rhs)
+{
+	return {
+		lhs.w * rhs.x + lhs.x * rhs.w + lhs.y * rhs.z - lhs.z * rhs.y,
+		lhs.w * rhs.y - lhs.x * rhs.z + lhs.y * rhs.w + lhs.z * rhs.x,
+		lhs.w * rhs.z + lhs.x * rhs.y - lhs.y * rhs.x + lhs.z * rhs.w,
+		lhs.w * rhs.w - lhs.x * rhs.x - lhs.y * rhs.y - lhs.z * rhs.z };
+}
+
+/// <summary>
+/// 共役クォータニオン（単位クォータニオンなら逆回転）
+/// </summary>
+inline Quaternion Conjugate(const Quaternion& q)
+{
+	return { -q.x, -q.y, -q.z, q.w };
+}
+
+inline float Dot(const Quaternion& a, const Quaternion& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+
+inline Quaternion Normalize(const Quaternion& q)
+{
+	float length = sqrtf(Dot(q, q));
+	if (length == 0.0f) return MakeIdentityQuaternion();
+	return { q.x / length, q.y / length, q.z / length, q.w / length };
+}
+
+/// <summary>
+/// 任意軸回転のクォータニオン
+/// </summary>
+/// <param name="axis">回転軸（正規化されていなくてもよい）</param>
+/// <param name="angle">回転角（ラジアン）</param>
+inline Quaternion MakeRotateAxisAngleQuaternion(const Vector3& axis, float angle)
+{
+	const Vector3 n = Normalize(axis);
+	const float s = sinf(angle * 0.5f);
+	return { n.x * s, n.y * s, n.z * s, cosf(angle * 0.5f) };
+}
+
+/// <summary>
+/// オイラー角（MakeAffineMatrix と同じ X → Y → Z の順）からクォータニオンを作る
+/// </summary>
+inline Quaternion MakeQuaternionFromEuler(const Vector3& rotate)
+{
+	// 半分の角度の sin / cos を一度に求める
+	Vector3 sines;
+	Vector3 cosines;
+	gMathKernels.sinCosVector3({ rotate.x * 0.5f, rotate.y * 0.5f, rotate.z * 0.5f }, sines, cosines);
+	const Quaternion rotateX{ sines.x, 0.0f, 0.0f, cosines.x };
+	const Quaternion rotateY{ 0.0f, sines.y, 0.0f, cosines.y };
+	const Quaternion rotateZ{ 0.0f, 0.0f, sines.z, cosines.z };
+	return Multiply(rotateZ, Multiply(rotateY, rotateX));
+}
+
+/// <summary>
+/// 正規化線形補間。最短経路で補間し、結果は正規化する（Slerp より速いが、角速度は一定にならない）
+/// </summary>
+inline Quaternion Nlerp(const Quaternion& q0, const Quaternion& q1, float t)
+{
+	// 内積が負なら片方を反転して、遠回りしないようにする
+	const float sign = (Dot(q0, q1) < 0.0f) ? -1.0f : 1.0f;
+	return Normalize(Quaternion{
+		q0.x + (sign * q1.x - q0.x) * t,
+		q0.y + (sign * q1.y - q0.y) * t,
+		q0.z + (sign * q1.z - q0.z) * t,
+		q0.w + (sign * q1.w - q0.w) * t });
+}
+
+/// <summary>
+/// 球面線形補間。最短経路を一定の角速度で補間する
+/// </summary>
+inline Quaternion Slerp(const Quaternion& q0, const Quaternion& q1, float t)
+{
+	float dot = Dot(q0, q1);
+	Quaternion end = q1;
+	if (dot < 0.0f) {
+		end = { -q1.x, -q1.y, -q1.z, -q1.w };
+		dot = -dot;
+	}
+	// ほとんど同じ向きのときは sin(θ) が 0 に近く割り算が不安定になるので、Nlerp で済ませる
+	if (dot > 0.9995f) {
+		return Nlerp(q0, end, t);
+	}
+	const float theta = acosf(dot);
+	const float inverseSinTheta = 1.0f / sinf(theta);
+	const float scale0 = sinf((1.0f - t) * theta) * inverseSinTheta;
+	const float scale1 = sinf(t * theta) * inverseSinTheta;
+	return {
+		scale0 * q0.x + scale1 * end.x,
+		scale0 * q0.y + scale1 * end.y,
+		scale0 * q0.z + scale1 * end.z,
+		scale0 * q0.w + scale1 * end.w };
+}
+
+/// <summary>
+/// クォータニオンから回転行列を作る（行ベクトルに右から掛ける向き）
+/// </summary>
+inline Matrix4x4 MakeRotateMatrix(const Quaternion& q)
+{
+	const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	const float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+	Matrix4x4 result{};
+	result.m[0][0] = 1.0f - 2.0f * (yy + zz);
+	result.m[0][1] = 2.0f * (xy + wz);
+	result.m[0][2] = 2.0f * (xz - wy);
+	result.m[1][0] = 2.0f * (xy - wz);
+	result.m[1][1] = 1.0f - 2.0f * (xx + zz);
+	result.m[1][2] = 2.0f * (yz + wx);
+	result.m[2][0] = 2.0f * (xz + wy);
+	result.m[2][1] = 2.0f * (yz - wx);
+	result.m[2][2] = 1.0f - 2.0f * (xx + yy);
+	result.m[3][3] = 1.0f;
+	return result;
+}
+
+/// <summary>
+/// 拡大縮小・クォータニオンの回転・平行移動からアフィン変換行列を作る（三角関数を使わない）
+/// </summary>
+inline Matrix4x4 MakeAffineMatrix(const Vector3& scale, const Quaternion& rotate, const Vector3& translate)
+{
+	const float xx = rotate.x * rotate.x, yy = rotate.y * rotate.y, zz = rotate.z * rotate.z;
+	const float xy = rotate.x * rotate.y, xz = rotate.x * rotate.z, yz = rotate.y * rotate.z;
+	const float wx = rotate.w * rotate.x, wy = rotate.w * rotate.y, wz = rotate.w * rotate.z;
+	// MakeRotateMatrix の各行に拡大縮小を掛けたもの
+	return { {
+		{ scale.x * (1.0f - 2.0f * (yy + zz)), scale.x * 2.0f * (xy + wz), scale.x * 2.0f * (xz - wy), 0.0f },
+		{ scale.y * 2.0f * (xy - wz), scale.y * (1.0f - 2.0f * (xx + zz)), scale.y * 2.0f * (yz + wx), 0.0f },
+		{ scale.z * 2.0f * (xz + wy), scale.z * 2.0f * (yz - wx), scale.z * (1.0f - 2.0f * (xx + yy)), 0.0f },
+		{ translate.x, translate.y, translate.z, 1.0f } } };
+}
+
+/// <summary>
+/// 回転をクォータニオンで持つ Transform からアフィン変換行列を作る
+/// </summary>
+inline Matrix4x4 MakeAffineMatrix(const QuaternionTransform& transform)
+{
+	return MakeAffineMatrix(transform.scale, transform.rotate, transform.translate);
+}
+
+/// <summary>
+/// 回転をクォータニオンで持つカメラからビュー行列を作る。(S R T)^-1 = T^-1 R^-1 S^-1 で、R^-1 は共役の回転
+/// </summary>
+inline Matrix4x4 MakeViewMatrix(const QuaternionTransform& camera)
+{
+	if (camera.scale.x == 0.0f || camera.scale.y == 0.0f || camera.scale.z == 0.0f) {
+		// 逆行列なし（特異行列）
+		return MakeIdentity4x4();
+	}
+
+	Matrix4x4 view = MakeRotateMatrix(Conjugate(camera.rotate));
+	const float inverseScale[3] = { 1.0f / camera.scale.x, 1.0f / camera.scale.y, 1.0f / camera.scale.z };
+	for (int row = 0; row < 3; ++row) {
+		for (int col = 0; col < 3; ++col) {
+			view.m[row][col] *= inverseScale[col];
+		}
+	}
+	for (int col = 0; col < 3; ++col) {
+		view.m[3][col] = -(camera.translate.x * view.m[0][col] + camera.translate.y * view.m[1][col] + camera.translate.z * view.m[2][col]);
+	}
+	return view;
+}
+
+// ---------------------------------------------------------------------------
+// 上で宣言した行列の関数（スカラー版と、選ばれた命令セットへの振り分け）
+// ---------------------------------------------------------------------------
+inline Matrix4x4 MakeIdentity4x4() {
+	Matrix4x4 result = {};
+
+	result.m[0][0] = 1.0f;
+	result.m[1][1] = 1.0f;
+	result.m[2][2] = 1.0f;
+	result.m[3][3] = 1.0f;
+
+	return result;
+}
+inline Matrix4x4 MakeAffineMatrix(const Vector3& scale, const Vector3& rotate, const Vector3& translate)
+{
+	Matrix4x4 matrix = {};
+	// 3軸分の sin / cos を一度に求める
+	Vector3 sines;
+	Vector3 cosines;
+	gMathKernels.sinCosVector3(rotate, sines, cosines);
+	float cosX = cosines.x;
+	float sinX = sines.x;
+	float cosY = cosines.y;
+	float sinY = sines.y;
+	float cosZ = cosines.z;
+	float sinZ = sines.z;
+	matrix.m[0][0] = scale.x * (cosY * cosZ);
+	matrix.m[0][1] = scale.x * (cosY * sinZ);
+	matrix.m[0][2] = scale.x * (-sinY);
+	matrix.m[0][3] = 0.0f;
+	matrix.m[1][0] = scale.y * (sinX * sinY * cosZ - cosX * sinZ);
+	matrix.m[1][1] = scale.y * (sinX * sinY * sinZ + cosX * cosZ);
+	matrix.m[1][2] = scale.y * (sinX * cosY);
+	matrix.m[1][3] = 0.0f;
+	matrix.m[2][0] = scale.z * (cosX * sinY * cosZ + sinX * sinZ);
+	matrix.m[2][1] = scale.z * (cosX * sinY * sinZ - sinX * cosZ);
+	matrix.m[2][2] = scale.z * (cosX * cosY);
+	matrix.m[2][3] = 0.0f;
+	matrix.m[3][0] = translate.x;
+	matrix.m[3][1] = translate.y;
+	matrix.m[3][2] = translate.z;
+	matrix.m[3][3] = 1.0f;
+	return matrix;
+}
+inline Matrix4x4 MakePerspectiveFovMatrix(float fovY, float aspect, float nearZ, float farZ) {
+	Matrix4x4 m{};
+	float yScale = 1.0f / tanf(fovY / 2.0f);
+	float xScale = yScale / aspect;
+	float range = farZ - nearZ;
+
+	m.m[0][0] = xScale;
+	m.m[1][1] = yScale;
+	m.m[2][2] = farZ / range;
+	m.m[2][3] = 1.0f;
+	m.m[3][2] = -nearZ * farZ / range;
+
+	return m;
+}
+inline Matrix4x4 Multiply(const Matrix4x4& a, const Matrix4x4& b) {
+	return gMathKernels.multiply(a, b);
+}
+inline Matrix4x4 MultiplyScalar(const Matrix4x4& a, const Matrix4x4& b) {
+	Matrix4x4 r{};
+	for (int row = 0; row < 4; ++row) {
+		for (int col = 0; col < 4; ++col) {
+			for (int k = 0; k < 4; ++k) {
+				r.m[row][col] += a.m[row][k] * b.m[k][col];
+			}
+		}
+	}
+	return r;
+}
+inline Matrix4x4 Inverse(const Matrix4x4& m)
+{
+	return gMathKernels.inverse(m);
+}
+inline Matrix4x4 InverseScalar(const Matrix4x4& m)
+{
+	Matrix4x4 result;
+	float* inv = &result.m[0][0];
+	const float* mat = &m.m[0][0];
+
+	float invOut[16];
+
+	invOut[0] = mat[5] * mat[10] * mat[15] -
+		mat[5] * mat[11] * mat[14] -
+		mat[9] * mat[6] * mat[15] +
+		mat[9] * mat[7] * mat[14] +
+		mat[13] * mat[6] * mat[11] -
+		mat[13] * mat[7] * mat[10];
+
+	invOut[1] = -mat[1] * mat[10] * mat[15] +
+		mat[1] * mat[11] * mat[14] +
+		mat[9] * mat[2] * mat[15] -
+		mat[9] * mat[3] * mat[14] -
+		mat[13] * mat[2] * mat[11] +
+		mat[13] * mat[3] * mat[10];
+
+	invOut[2] = mat[1] * mat[6] * mat[15] -
+		mat[1] * mat[7] * mat[14] -
+		mat[5] * mat[2] * mat[15] +
+		mat[5] * mat[3] * mat[14] +
+		mat[13] * mat[2] * mat[7] -
+		mat[13] * mat[3] * mat[6];
+
+	invOut[3] = -mat[1] * mat[6] * mat[11] +
+		mat[1] * mat[7] * mat[10] +
+		mat[5] * mat[2] * mat[11] -
+		mat[5] * mat[3] * mat[10] -
+		mat[9] * mat[2] * mat[7] +
+		mat[9] * mat[3] * mat[6];
+
+	invOut[4] = -mat[4] * mat[10] * mat[15] +
+		mat[4] * mat[11] * mat[14] +
+		mat[8] * mat[6] * mat[15] -
+		mat[8] * mat[7] * mat[14] -
+		mat[12] * mat[6] * mat[11] +
+		mat[12] * mat[7] * mat[10];
+
+	invOut[5] = mat[0] * mat[10] * mat[15] -
+		mat[0] * mat[11] * mat[14] -
+		mat[8] * mat[2] * mat[15] +
+		mat[8] * mat[3] * mat[14] +
+		mat[12] * mat[2] * mat[11] -
+		mat[12] * mat[3] * mat[10];
+
+	invOut[6] = -mat[0] * mat[6] * mat[15] +
+		mat[0] * mat[7] * mat[14] +
+		mat[4] * mat[2] * mat[15] -
+		mat[4] * mat[3] * mat[14] -
+		mat[12] * mat[2] * mat[7] +
+		mat[12] * mat[3] * mat[6];
+
+	invOut[7] = mat[0] * mat[6] * mat[11] -
+		mat[0] * mat[7] * mat[10] -
+		mat[4] * mat[2] * mat[11] +
+		mat[4] * mat[3] * mat[10] +
+		mat[8] * mat[2] * mat[7] -
+		mat[8] * mat[3] * mat[6];
+
+	invOut[8] = mat[4] * mat[9] * mat[15] -
+		mat[4] * mat[11] * mat[13] -
+		mat[8] * mat[5] * mat[15] +
+		mat[8] * mat[7] * mat[13] +
+		mat[12] * mat[5] * mat[11] -
+		mat[12] * mat[7] * mat[9];
+
+	invOut[9] = -mat[0] * mat[9] * mat[15] +
+		mat[0] * mat[11] * mat[13] +
+		mat[8] * mat[1] * mat[15] -
+		mat[8] * mat[3] * mat[13] -
+		mat[12] * mat[1] * mat[11] +
+		mat[12] * mat[3] * mat[9];
+
+	invOut[10] = mat[0] * mat[5] * mat[15] -
+		mat[0] * mat[7] * mat[13] -
+		mat[4] * mat[1] * mat[15] +
+		mat[4] * mat[3] * mat[13] +
+		mat[12] * mat[1] * mat[7] -
+		mat[12] * mat[3] * mat[5];
+
+	invOut[11] = -mat[0] * mat[5] * mat[11] +
+		mat[0] * mat[7] * mat[9] +
+		mat[4] * mat[1] * mat[11] -
+		mat[4] * mat[3] * mat[9] -
+		mat[8] * mat[1] * mat[7] +
+		mat[8] * mat[3] * mat[5];
+
+	invOut[12] = -mat[4] * mat[9] * mat[14] +
+		mat[4] * mat[10] * mat[13] +
+		mat[8] * mat[5] * mat[14] -
+		mat[8] * mat[6] * mat[13] -
+		mat[12] * mat[5] * mat[10] +
+		mat[12] * mat[6] * mat[9];
+
+	invOut[13] = mat[0] * mat[9] * mat[14] -
+		mat[0] * mat[10] * mat[13] -
+		mat[8] * mat[1] * mat[14] +
+		mat[8] * mat[2] * mat[13] +
+		mat[12] * mat[1] * mat[10] -
+		mat[12] * mat[2] * mat[9];
+
+	invOut[14] = -mat[0] * mat[5] * mat[14] +
+		mat[0] * mat[6] * mat[13] +
+		mat[4] * mat[1] * mat[14] -
+		mat[4] * mat[2] * mat[13] -
+		mat[12] * mat[1] * mat[6] +
+		mat[12] * mat[2] * mat[5];
+
+	invOut[15] = mat[0] * mat[5] * mat[10] -
+		mat[0] * mat[6] * mat[9] -
+		mat[4] * mat[1] * mat[10] +
+		mat[4] * mat[2] * mat[9] +
+		mat[8] * mat[1] * mat[6] -
+		mat[8] * mat[2] * mat[5];
+
+	float det = mat[0] * invOut[0] + mat[1] * invOut[4] + mat[2] * invOut[8] + mat[3] * invOut[12];
+	if (det == 0.0f)
+	{
+		// 逆行列なし（特異行列）
+		return MakeIdentity4x4(); // または assert, エラーログ等
+	}
+
+	float invDet = 1.0f / det;
+	for (int i = 0; i < 16; ++i)
+	{
+		inv[i] = invOut[i] * invDet;
+	}
+
+	return result;
+}
+/// <summary>
+/// 左上 3x3 の逆行列 inverse3x3 から、アフィン行列の逆行列を組み立てる（平行移動は -t * inverse3x3）
+/// </summary>
+inline Matrix4x4 MakeAffineInverse(const float inverse3x3[3][3], const Matrix4x4& m)
+{
+	Matrix4x4 result{};
+	for (int row = 0; row < 3; ++row) {
+		for (int col = 0; col < 3; ++col) {
+			result.m[row][col] = inverse3x3[row][col];
+		}
+	}
+	for (int col = 0; col < 3; ++col) {
+		result.m[3][col] = -(m.m[3][0] * inverse3x3[0][col] + m.m[3][1] * inverse3x3[1][col] + m.m[3][2] * inverse3x3[2][col]);
+	}
+	result.m[3][3] = 1.0f;
+	return result;
+}
+inline Matrix4x4 Inverse(const Matrix4x4& m, MatrixType type)
+{
+	if (type == MatrixType::General) {
+		return Inverse(m);
+	}
+	return gMathKernels.inverseAffine(m, type);
+}
+inline Matrix4x4 InverseAffineScalar(const Matrix4x4& m, MatrixType type)
+{
+	float inverse3x3[3][3];
+	switch (type) {
+	case MatrixType::Rigid:
+		// 回転行列の逆行列は転置
+		for (int row = 0; row < 3; ++row) {
+			for (int col = 0; col < 3; ++col) {
+				inverse3x3[row][col] = m.m[col][row];
+			}
+		}
+		return MakeAffineInverse(inverse3x3, m);
+
+	case MatrixType::ScaleRotateTranslate: {
+		// 各行は「拡大率 × 回転後の軸」なので、転置してから各列を拡大率の2乗で割る
+		float inverseScaleSquared[3];
+		for (int row = 0; row < 3; ++row) {
+			const float scaleSquared = m.m[row][0] * m.m[row][0] + m.m[row][1] * m.m[row][1] + m.m[row][2] * m.m[row][2];
+			if (scaleSquared == 0.0f) {
+				// 逆行列なし（特異行列）
+				return MakeIdentity4x4();
+			}
+			inverseScaleSquared[row] = 1.0f / scaleSquared;
+		}
+		for (int row = 0; row < 3; ++row) {
+			for (int col = 0; col < 3; ++col) {
+				inverse3x3[row][col] = m.m[col][row] * inverseScaleSquared[col];
+			}
+		}
+		return MakeAffineInverse(inverse3x3, m);
+	}
+
+	case MatrixType::Affine: {
+		// 左上 3x3 だけを余因子で逆行列にする
+		const float cofactor00 = m.m[1][1] * m.m[2][2] - m.m[1][2] * m.m[2][1];
+		const float cofactor01 = m.m[1][2] * m.m[2][0] - m.m[1][0] * m.m[2][2];
+		const float cofactor02 = m.m[1][0] * m.m[2][1] - m.m[1][1] * m.m[2][0];
+		const float det = m.m[0][0] * cofactor00 + m.m[0][1] * cofactor01 + m.m[0][2] * cofactor02;
+		if (det == 0.0f) {
+			// 逆行列なし（特異行列）
+			return MakeIdentity4x4();
+		}
+		const float invDet = 1.0f / det;
+		inverse3x3[0][0] = cofactor00 * invDet;
+		inverse3x3[1][0] = cofactor01 * invDet;
+		inverse3x3[2][0] = cofactor02 * invDet;
+		inverse3x3[0][1] = (m.m[0][2] * m.m[2][1] - m.m[0][1] * m.m[2][2]) * invDet;
+		inverse3x3[1][1] = (m.m[0][0] * m.m[2][2] - m.m[0][2] * m.m[2][0]) * invDet;
+		inverse3x3[2][1] = (m.m[0][1] * m.m[2][0] - m.m[0][0] * m.m[2][1]) * invDet;
+		inverse3x3[0][2] = (m.m[0][1] * m.m[1][2] - m.m[0][2] * m.m[1][1]) * invDet;
+		inverse3x3[1][2] = (m.m[0][2] * m.m[1][0] - m.m[0][0] * m.m[1][2]) * invDet;
+		inverse3x3[2][2] = (m.m[0][0] * m.m[1][1] - m.m[0][1] * m.m[1][0]) * invDet;
+		return MakeAffineInverse(inverse3x3, m);
+	}
+
+	default:
+		return InverseScalar(m);
+	}
+}
+inline Matrix4x4 MakeViewMatrix(const Transform& camera)
+{
+	return gMathKernels.makeViewMatrix(camera);
+}
+inline Matrix4x4 MakeViewMatrixScalar(const Transform& camera)
+{
+	if (camera.scale.x == 0.0f || camera.scale.y == 0.0f || camera.scale.z == 0.0f) {
+		// 逆行列なし（特異行列）
+		return MakeIdentity4x4();
+	}
+
+	// MakeAffineMatrix と同じ回転行列 R を作り、(S R T)^-1 = T^-1 R^T S^-1 を直接組み立てる
+	Vector3 sines;
+	Vector3 cosines;
+	SinCosVector3Scalar(camera.rotate, sines, cosines);
+	const float rotation[3][3] = {
+		{ cosines.y * cosines.z, cosines.y * sines.z, -sines.y },
+		{ sines.x * sines.y * cosines.z - cosines.x * sines.z, sines.x * sines.y * sines.z + cosines.x * cosines.z, sines.x * cosines.y },
+		{ cosines.x * sines.y * cosines.z + sines.x * sines.z, cosines.x * sines.y * sines.z - sines.x * cosines.z, cosines.x * cosines.y },
+	};
+	const float inverseScale[3] = { 1.0f / camera.scale.x, 1.0f / camera.scale.y, 1.0f / camera.scale.z };
+
+	Matrix4x4 view{};
+	for (int row = 0; row < 3; ++row) {
+		for (int col = 0; col < 3; ++col) {
+			view.m[row][col] = rotation[col][row] * inverseScale[col];
+		}
+	}
+	for (int col = 0; col < 3; ++col) {
+		view.m[3][col] = -(camera.translate.x * view.m[0][col] + camera.translate.y * view.m[1][col] + camera.translate.z * view.m[2][col]);
+	}
+	view.m[3][3] = 1.0f;
+	return view;
+}
+
+/// <summary>
+/// 行列の要素ごとの差の最大値（要素が大きい行列では、一番大きい要素に対する割合で見る）
+/// </summary>
+inline float MaxMatrixDifference(const Matrix4x4& a, const Matrix4x4& b)
+{
+	float difference = 0.0f;
+	float scale = 1.0f;
+	for (int row = 0; row < 4; ++row) {
+		for (int col = 0; col < 4; ++col) {
+			difference = std::max(difference, fabsf(a.m[row][col] - b.m[row][col]));
+			scale = std::max(scale, std::max(fabsf(a.m[row][col]), fabsf(b.m[row][col])));
+		}
+	}
+	return difference / scale;
+}
@@ -0,0 +1,316 @@
+#pragma once
+// 焼き込み済みメッシュのキャッシュ（元の OBJ の内容と読み込み設定から作ったキーで引き、壊れたファイルや古いファイルは読まない）。
+// ObjLoader.h と同じく Windows 以外でも動くので、tests/ の Linux 向けのテストからもそのまま使う
+#include "ObjLoader.h"
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// バイト列の64bitハッシュ（FNV-1a を8バイト単位で回したもの）
+/// </summary>
+/// <param name="data">データの先頭</param>
+/// <param name="size">データのバイト数</param>
+/// <param name="seed">初期値。続けてハッシュする場合は前回の結果を渡す</param>
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0xCBF29CE484222325ull)
+{
+	const uint64_t kPrime = 0x100000001B3ull;
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = seed;
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, bytes + i, 8);
+		hash = (hash ^ word) * kPrime;
+		hash ^= hash >> 32;
+	}
+	for (; i < size; ++i) {
+		hash = (hash ^ bytes[i]) * kPrime;
+	}
+	return hash;
+}
+
+// 焼き込み済みメッシュファイルの形式のバージョン。レイアウトを変えたら上げる
+const uint32_t kCookedMeshVersion = 4;
+
+/// <summary>
+/// 焼き込み済みメッシュファイルのヘッダー。
+/// ファイルは ヘッダー → メッシュ範囲の配列 → 名前 → 頂点 → インデックス → メッシュレット → LODのインデックス → LOD の順に並ぶ
+/// </summary>
+struct CookedMeshHeader
+{
+	char magic[4];             // "CMSH"
+	uint32_t version;          // kCookedMeshVersion
+	uint64_t cacheKey;         // 元ファイルの内容と読み込み設定から作ったキー
+	uint32_t meshCount;
+	uint32_t vertexDataSize;   // sizeof(VertexData)。構造体を変えたら読まない
+	uint64_t namesOffset;
+	uint64_t vertexOffset;     // VertexData の配列（16バイト境界）
+	uint64_t indexOffset;      // uint32_t の配列
+	uint64_t meshletOffset;    // Meshlet の配列
+	uint64_t lodIndexOffset;   // LOD の uint32_t の配列
+	uint64_t lodOffset;        // MeshLod の配列
+	uint64_t fileSize;
+};
+
+// 焼き込み済みメッシュファイル内の1メッシュ分の範囲
+struct CookedMeshRange
+{
+	uint32_t nameOffset;       // 名前領域の中での位置
+	uint32_t nameLength;
+	uint32_t vertexOffset;     // 頂点領域の中での頂点番号
+	uint32_t vertexCount;
+	uint32_t indexOffset;      // インデックス領域の中での番号
+	uint32_t indexCount;
+	uint32_t meshletOffset;    // メッシュレット領域の中での番号
+	uint32_t meshletCount;
+	uint32_t lodIndexOffset;   // LODのインデックス領域の中での番号
+	uint32_t lodIndexCount;
+	uint32_t lodOffset;        // LOD領域の中での番号
+	uint32_t lodCount;
+	MeshBounds bounds;         // メッシュを囲む箱と球
+};
+
+// モデルの読み込み設定。キャッシュのキーにも使う
+struct ModelLoadOptions
+{
+	bool flipY;                // 右手系から左手系へ変換するかどうか
+	bool optimizeMesh;         // 頂点キャッシュ・オーバードロー・頂点読み込みの最適化をするかどうか
+};
+
+/// <summary>
+/// ファイルに応じたモデルの読み込み設定を作る
+/// </summary>
+/// <param name="filename">OBJのファイル名</param>
+/// <param name="optimizeMesh">メッシュを最適化するかどうか</param>
+inline ModelLoadOptions MakeModelLoadOptions(const std::string& filename, bool optimizeMesh)
+{
+	ModelLoadOptions options{};
+	options.flipY = (filename != "plane.obj");
+	options.optimizeMesh = optimizeMesh;
+	return options;
+}
+
+/// <summary>
+/// 焼き込み済みメッシュのキャッシュキーを作る
+/// </summary>
+/// <param name="sourceData">元のOBJファイルの内容</param>
+/// <param name="sourceSize">元のOBJファイルのサイズ</param>
+/// <param name="options">読み込み設定</param>
+inline uint64_t MakeCookedMeshKey(const char* sourceData, size_t sourceSize, const ModelLoadOptions& options)
+{
+	uint64_t key = HashBytes(sourceData, sourceSize);
+	const uint32_t settings[] = { kCookedMeshVersion, static_cast<uint32_t>(sizeof(VertexData)), options.flipY ? 1u : 0u, options.optimizeMesh ? 1u : 0u };
+	return HashBytes(settings, sizeof(settings), key);
+}
+
+// キャッシュキーに対応する焼き込み済みメッシュファイルのパス
+inline std::string GetCookedMeshPath(uint64_t cacheKey)
+{
+	char path[64];
+	std::snprintf(path, sizeof(path), "Cache/Mesh/%016llx.mesh", static_cast<unsigned long long>(cacheKey));
+	return path;
+}
+
+/// <summary>
+/// 焼き込み済みメッシュファイルを書き出す
+/// </summary>
+/// <param name="filePath">書き出し先</param>
+/// <param name="cacheKey">キャッシュキー</param>
+/// <param name="modelData">書き出すモデル</param>
+/// <returns>書き出せたら true</returns>
+inline bool WriteCookedMesh(const std::string& filePath, uint64_t cacheKey, const ModelData& modelData)
+{
+	auto alignUp = [](uint64_t value, uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; };
+
+	std::vector<CookedMeshRange> ranges;
+	std::string names;
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+	uint32_t meshletCount = 0;
+	uint32_t lodIndexCount = 0;
+	uint32_t lodCount = 0;
+	for (const MeshData& mesh : modelData.meshes) {
+		CookedMeshRange range{};
+		range.nameOffset = static_cast<uint32_t>(names.size());
+		range.nameLength = static_cast<uint32_t>(mesh.name.size());
+		range.vertexOffset = vertexCount;
+		range.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+		range.indexOffset = indexCount;
+		range.indexCount = static_cast<uint32_t>(mesh.indices.size());
+		range.meshletOffset = meshletCount;
+		range.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+		range.lodIndexOffset = lodIndexCount;
+		range.lodIndexCount = static_cast<uint32_t>(mesh.lodIndices.size());
+		range.lodOffset = lodCount;
+		range.lodCount = static_cast<uint32_t>(mesh.lods.size());
+		range.bounds = mesh.bounds;
+		ranges.push_back(range);
+
+		names += mesh.name;
+		vertexCount += range.vertexCount;
+		indexCount += range.indexCount;
+		meshletCount += range.meshletCount;
+		lodIndexCount += range.lodIndexCount;
+		lodCount += range.lodCount;
+	}
+
+	CookedMeshHeader header{};
+	memcpy(header.magic, "CMSH", 4);
+	header.version = kCookedMeshVersion;
+	header.cacheKey = cacheKey;
+	header.meshCount = static_cast<uint32_t>(ranges.size());
+	header.vertexDataSize = sizeof(VertexData);
+	header.namesOffset = sizeof(CookedMeshHeader) + sizeof(CookedMeshRange) * ranges.size();
+	header.vertexOffset = alignUp(header.namesOffset + names.size(), 16);
+	header.indexOffset = header.vertexOffset + sizeof(VertexData) * uint64_t(vertexCount);
+	header.meshletOffset = header.indexOffset + sizeof(uint32_t) * uint64_t(indexCount);
+	header.lodIndexOffset = header.meshletOffset + sizeof(Meshlet) * uint64_t(meshletCount);
+	header.lodOffset = header.lodIndexOffset + sizeof(uint32_t) * uint64_t(lodIndexCount);
+	header.fileSize = header.lodOffset + sizeof(MeshLod) * uint64_t(lodCount);
+
+	// 途中で失敗しても壊れたファイルが残らないよう、一時ファイルに書いてから置き換える
+	std::error_code errorCode;
+	std::filesystem::create_directories(std::filesystem::path(filePath).parent_path(), errorCode);
+	const std::string temporaryPath = filePath + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return false;
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(ranges.data()), sizeof(CookedMeshRange) * ranges.size());
+		file.write(names.data(), names.size());
+		const char padding[16] = {};
+		file.write(padding, header.vertexOffset - (header.namesOffset + names.size()));
+		for (const MeshData& mesh : modelData.meshes) {
+			file.write(reinterpret_cast<const char*>(mesh.vertices.data()), sizeof(VertexData) * mesh.vertices.size());
+		}
+		for (const MeshData& mesh : modelData.meshes) {
+			file.write(reinterpret_cast<const char*>(mesh.indices.data()), sizeof(uint32_t) * mesh.indices.size());
+		}
+		for (const MeshData& mesh : modelData.meshes) {
+			file.write(reinterpret_cast<const char*>(mesh.meshlets.data()), sizeof(Meshlet) * mesh.meshlets.size());
+		}
+		for (const MeshData& mesh : modelData.meshes) {
+			file.write(reinterpret_cast<const char*>(mesh.lodIndices.data()), sizeof(uint32_t) * mesh.lodIndices.size());
+		}
+		for (const MeshData& mesh : modelData.meshes) {
+			file.write(reinterpret_cast<const char*>(mesh.lods.data()), sizeof(MeshLod) * mesh.lods.size());
+		}
+		if (!file.good()) {
+			return false;
+		}
+	}
+
+	std::filesystem::rename(temporaryPath, filePath, errorCode);
+	return !errorCode;
+}
+
+/// <summary>
+/// 焼き込み済みメッシュファイルの領域がヘッダーの順に並んでファイルに収まり、メッシュごとの範囲がそれぞれの領域に収まっているか調べる。
+/// 途中で切れたり壊れたりしたファイルを読み進めて、マップした外を読まないようにする
+/// </summary>
+/// <param name="header">ファイルの先頭のヘッダー（fileSize はマップしたサイズと比べておくこと）</param>
+/// <param name="ranges">ヘッダーの直後にある meshCount 個の範囲</param>
+/// <returns>すべて収まっていれば true</returns>
+inline bool ValidateCookedMeshLayout(const CookedMeshHeader& header, const CookedMeshRange* ranges)
+{
+	// 各領域は前の領域の後ろから始まり、要素の大きさで割り切れ、要素の型の境界にそろっていること
+	auto getSectionCount = [](uint64_t begin, uint64_t end, uint64_t elementSize, uint64_t alignment, uint64_t& count) {
+		if (begin > end || (end - begin) % elementSize != 0 || begin % alignment != 0) {
+			return false;
+		}
+		count = (end - begin) / elementSize;
+		return true;
+	};
+	uint64_t nameBytes = 0;
+	uint64_t vertexCount = 0;
+	uint64_t indexCount = 0;
+	uint64_t meshletCount = 0;
+	uint64_t lodIndexCount = 0;
+	uint64_t lodCount = 0;
+	if (!getSectionCount(header.namesOffset, header.vertexOffset, 1, 1, nameBytes) ||
+		!getSectionCount(header.vertexOffset, header.indexOffset, sizeof(VertexData), 16, vertexCount) ||
+		!getSectionCount(header.indexOffset, header.meshletOffset, sizeof(uint32_t), alignof(uint32_t), indexCount) ||
+		!getSectionCount(header.meshletOffset, header.lodIndexOffset, sizeof(Meshlet), alignof(Meshlet), meshletCount) ||
+		!getSectionCount(header.lodIndexOffset, header.lodOffset, sizeof(uint32_t), alignof(uint32_t), lodIndexCount) ||
+		!getSectionCount(header.lodOffset, header.fileSize, sizeof(MeshLod), alignof(MeshLod), lodCount)) {
+		return false;
+	}
+
+	// 32ビットどうしの足し算があふれないよう、64ビットで比べる
+	auto isInside = [](uint32_t offset, uint32_t count, uint64_t sectionCount) { return uint64_t(offset) + uint64_t(count) <= sectionCount; };
+	for (uint32_t i = 0; i < header.meshCount; ++i) {
+		const CookedMeshRange& range = ranges[i];
+		if (!isInside(range.nameOffset, range.nameLength, nameBytes) ||
+			!isInside(range.vertexOffset, range.vertexCount, vertexCount) ||
+			!isInside(range.indexOffset, range.indexCount, indexCount) ||
+			!isInside(range.meshletOffset, range.meshletCount, meshletCount) ||
+			!isInside(range.lodIndexOffset, range.lodIndexCount, lodIndexCount) ||
+			!isInside(range.lodOffset, range.lodCount, lodCount)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/// <summary>
+/// 焼き込み済みメッシュファイルをメモリマップして読む（テキストの解析は行わない）
+/// </summary>
+/// <param name="filePath">読むファイル</param>
+/// <param name="cacheKey">期待するキャッシュキー</param>
+/// <param name="modelData">読んだモデルの書き込み先</param>
+/// <returns>有効なファイルが読めたら true</returns>
+inline bool ReadCookedMesh(const std::string& filePath, uint64_t cacheKey, ModelData& modelData)
+{
+	MappedFile mappedFile = MapFileReadOnly(filePath);
+	if (!IsFileMapped(mappedFile)) {
+		return false;
+	}
+
+	// ヘッダーが壊れていたり古かったりする場合はキャッシュが無いものとして扱う
+	const CookedMeshHeader* header = reinterpret_cast<const CookedMeshHeader*>(mappedFile.data);
+	bool isValid = mappedFile.size >= sizeof(CookedMeshHeader) &&
+		memcmp(header->magic, "CMSH", 4) == 0 &&
+		header->version == kCookedMeshVersion &&
+		header->cacheKey == cacheKey &&
+		header->vertexDataSize == sizeof(VertexData) &&
+		header->fileSize == mappedFile.size &&
+		header->namesOffset == sizeof(CookedMeshHeader) + sizeof(CookedMeshRange) * uint64_t(header->meshCount);
+	// 範囲の配列は名前の領域の手前にあるので、領域の並びを調べるまでは読まない
+	const CookedMeshRange* ranges = reinterpret_cast<const CookedMeshRange*>(mappedFile.data + sizeof(CookedMeshHeader));
+	isValid = isValid && ValidateCookedMeshLayout(*header, ranges);
+	if (!isValid) {
+		UnmapFile(&mappedFile);
+		return false;
+	}
+
+	const char* names = mappedFile.data + header->namesOffset;
+	const VertexData* vertices = reinterpret_cast<const VertexData*>(mappedFile.data + header->vertexOffset);
+	const uint32_t* indices = reinterpret_cast<const uint32_t*>(mappedFile.data + header->indexOffset);
+	const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(mappedFile.data + header->meshletOffset);
+	const uint32_t* lodIndices = reinterpret_cast<const uint32_t*>(mappedFile.data + header->lodIndexOffset);
+	const MeshLod* lods = reinterpret_cast<const MeshLod*>(mappedFile.data + header->lodOffset);
+
+	modelData.meshes.resize(header->meshCount);
+	for (uint32_t i = 0; i < header->meshCount; ++i) {
+		const CookedMeshRange& range = ranges[i];
+		MeshData& mesh = modelData.meshes[i];
+		mesh.name.assign(names + range.nameOffset, range.nameLength);
+		mesh.vertices.assign(vertices + range.vertexOffset, vertices + range.vertexOffset + range.vertexCount);
+		mesh.indices.assign(indices + range.indexOffset, indices + range.indexOffset + range.indexCount);
+		mesh.meshlets.assign(meshlets + range.meshletOffset, meshlets + range.meshletOffset + range.meshletCount);
+		mesh.lodIndices.assign(lodIndices + range.lodIndexOffset, lodIndices + range.lodIndexOffset + range.lodIndexCount);
+		mesh.lods.assign(lods + range.lodOffset, lods + range.lodOffset + range.lodCount);
+		mesh.bounds = range.bounds;
+	}
+
+	UnmapFile(&mappedFile);
+	return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+// モデルのデータ（頂点・インデックス・メッシュレット・LOD・カリング用の箱と球）。OBJ の読み込みやメッシュの最適化が作り、描画が使う。
+// Windows のヘッダーに依存しないので、tests/ の Linux 向けのテストからもそのまま使う
+#include "FrustumCulling.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct VertexData {
+	Vector4 position;
+	Vector2 texcoord;
+	Vector3 normal;
+	float pad;
+};
+
+// メッシュを小さく分けたクラスタ。三角形はメッシュのインデックス配列の中で連続している
+struct Meshlet {
+	uint32_t indexOffset;   // メッシュのインデックス配列の中での開始位置
+	uint32_t indexCount;    // 三角形の数 × 3
+	uint32_t vertexCount;   // 使っている頂点の数
+	Vector3 center;         // バウンディングスフィアの中心（モデル空間）
+	float radius;           // バウンディングスフィアの半径
+	Vector3 coneApex;       // 法線コーンの頂点
+	Vector3 coneAxis;       // 法線コーンの軸（面の向きの平均）
+	float coneCutoff;       // 法線コーンの判定値。1 なら背面カリングしない
+};
+
+// 三角形を減らした詳細度（LOD）。頂点は元のメッシュと共有する
+struct MeshLod {
+	uint32_t indexOffset;   // メッシュの lodIndices の中での開始位置
+	uint32_t indexCount;
+	float error;            // 元の形からのずれの目安（モデル空間の単位）
+};
+
+struct MeshData {
+	std::string name;
+	std::vector<VertexData> vertices; // 重複を除いた頂点
+	std::vector<uint32_t> indices;    // 三角形リストのインデックス
+	std::vector<Meshlet> meshlets;    // カリング用のクラスタ
+	std::vector<uint32_t> lodIndices; // LOD1 以降のインデックスを続けて並べたもの
+	std::vector<MeshLod> lods;        // LOD1 以降（細かい順）
+	MeshBounds bounds;                // 視錐台カリング用
+};
+
+struct ModelData {
+	std::vector<MeshData> meshes;
+};
@@ -0,0 +1,403 @@
+#pragma once
+// メッシュの LOD（二次誤差行列による辺の縮約で三角形を減らした詳細度）の生成と、画面上の誤差による LOD の選択。
+// Windows のヘッダーに依存しないので、tests/ の Linux 向けのテストからもそのまま使う
+#include "MeshData.h"
+#include "MeshOptimization.h"
+#include "ObjLoader.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// 二次誤差行列（Garland と Heckbert の Quadric Error Metrics）。足し合わせた平面との距離の二乗和を表す
+struct Quadric
+{
+	float a00, a11, a22;
+	float a10, a20, a21;
+	float b0, b1, b2;
+	float c;
+	float weight;   // 足し合わせた平面の重みの合計
+};
+
+/// <summary>
+/// 平面 dot(normal, p) + distance = 0 との距離の二乗を表す二次誤差行列を作る
+/// </summary>
+/// <param name="normal">平面の単位法線</param>
+/// <param name="distance">平面の原点からの距離</param>
+/// <param name="weight">重み（三角形の面積など）</param>
+inline Quadric MakePlaneQuadric(const Vector3& normal, float distance, float weight)
+{
+	Quadric q{};
+	q.a00 = weight * normal.x * normal.x;
+	q.a11 = weight * normal.y * normal.y;
+	q.a22 = weight * normal.z * normal.z;
+	q.a10 = weight * normal.y * normal.x;
+	q.a20 = weight * normal.z * normal.x;
+	q.a21 = weight * normal.z * normal.y;
+	q.b0 = weight * normal.x * distance;
+	q.b1 = weight * normal.y * distance;
+	q.b2 = weight * normal.z * distance;
+	q.c = weight * distance * distance;
+	q.weight = weight;
+	return q;
+}
+
+inline void AddQuadric(Quadric& q, const Quadric& r)
+{
+	q.a00 += r.a00; q.a11 += r.a11; q.a22 += r.a22;
+	q.a10 += r.a10; q.a20 += r.a20; q.a21 += r.a21;
+	q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+	q.c += r.c;
+	q.weight += r.weight;
+}
+
+// 点 p での誤差（重み付きの距離の二乗和）
+inline float EvaluateQuadric(const Quadric& q, const Vector3& p)
+{
+	const float rx = q.a00 * p.x + q.a10 * p.y + q.a20 * p.z + q.b0 * 2.0f;
+	const float ry = q.a10 * p.x + q.a11 * p.y + q.a21 * p.z + q.b1 * 2.0f;
+	const float rz = q.a20 * p.x + q.a21 * p.y + q.a22 * p.z + q.b2 * 2.0f;
+	return fabsf(rx * p.x + ry * p.y + rz * p.z + q.c);
+}
+
+/// <summary>
+/// 辺の縮約で三角形の数を減らす（頂点は元の頂点配列のものをそのまま使うので、LODで頂点バッファを共有できる）。
+/// UVや法線だけが違う同じ位置の頂点はまとめて動かし、縮約先では属性が一番近い頂点を選ぶ
+/// </summary>
+/// <param name="vertices">頂点</param>
+/// <param name="indices">元の三角形リストのインデックス</param>
+/// <param name="targetIndexCount">目標のインデックス数。縮約できる辺が無くなったらそこで止まる</param>
+/// <param name="resultError">縮約で生じた誤差（元の面からの距離の目安、モデル空間の単位）の書き込み先</param>
+/// <returns>減らした三角形リストのインデックス</returns>
+inline std::vector<uint32_t> SimplifyMesh(const std::vector<VertexData>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float* resultError)
+{
+	// 同じ位置の頂点に共通の番号を振る（-0 と 0 を同じにするため 0 を足す）
+	std::vector<uint32_t> positionIds(vertices.size());
+	std::vector<Vector3> positions;
+	{
+		ObjVertexTable table;
+		for (size_t v = 0; v < vertices.size(); ++v) {
+			const Vector4& p = vertices[v].position;
+			ObjVertexKey key{ 0, 0, 0, 0 };
+			const float x = p.x + 0.0f, y = p.y + 0.0f, z = p.z + 0.0f;
+			memcpy(&key.position, &x, 4);
+			memcpy(&key.texcoord, &y, 4);
+			memcpy(&key.normal, &z, 4);
+			positionIds[v] = table.FindOrInsert(key, static_cast<uint32_t>(positions.size()));
+			if (positionIds[v] == positions.size()) {
+				positions.push_back({ p.x, p.y, p.z });
+			}
+		}
+	}
+	const size_t positionCount = positions.size();
+
+	// 位置ごとの頂点の一覧
+	std::vector<uint32_t> wedgeOffsets(positionCount + 1, 0);
+	std::vector<uint32_t> wedges(vertices.size());
+	for (uint32_t id : positionIds) {
+		++wedgeOffsets[id + 1];
+	}
+	for (size_t p = 0; p < positionCount; ++p) {
+		wedgeOffsets[p + 1] += wedgeOffsets[p];
+	}
+	{
+		std::vector<uint32_t> cursors(wedgeOffsets.begin(), wedgeOffsets.end() - 1);
+		for (size_t v = 0; v < vertices.size(); ++v) {
+			wedges[cursors[positionIds[v]]++] = static_cast<uint32_t>(v);
+		}
+	}
+
+	auto cross = [](const Vector3& a, const Vector3& b) { return Vector3{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; };
+	auto subtract = [](const Vector3& a, const Vector3& b) { return Vector3{ a.x - b.x, a.y - b.y, a.z - b.z }; };
+	auto dot = [](const Vector3& a, const Vector3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; };
+	auto makeEdgeKey = [](uint32_t a, uint32_t b) { return (uint64_t(std::min(a, b)) << 32) | std::max(a, b); };
+
+	std::vector<uint32_t> result = indices;
+
+	// 辺をキーの順に並べ、1つの三角形にしか使われない辺（境界）と3つ以上に使われる辺（非多様体）を調べる
+	std::vector<uint64_t> edgeKeys;
+	auto collectEdges = [&]() {
+		edgeKeys.clear();
+		for (size_t i = 0; i + 3 <= result.size(); i += 3) {
+			for (uint32_t k = 0; k < 3; ++k) {
+				edgeKeys.push_back(makeEdgeKey(positionIds[result[i + k]], positionIds[result[i + (k + 1) % 3]]));
+			}
+		}
+		std::sort(edgeKeys.begin(), edgeKeys.end());
+	};
+	auto countEdge = [&edgeKeys](uint64_t key) {
+		auto range = std::equal_range(edgeKeys.begin(), edgeKeys.end(), key);
+		return static_cast<size_t>(range.second - range.first);
+	};
+
+	// 三角形の平面の誤差を頂点に集め、境界の辺には面に垂直な平面も足して輪郭が崩れないようにする
+	const float kBorderWeight = 10.0f;
+	std::vector<Quadric> quadrics(positionCount, Quadric{});
+	collectEdges();
+	for (size_t i = 0; i + 3 <= result.size(); i += 3) {
+		const uint32_t corners[3] = { positionIds[result[i]], positionIds[result[i + 1]], positionIds[result[i + 2]] };
+		const Vector3 normal = cross(subtract(positions[corners[1]], positions[corners[0]]), subtract(positions[corners[2]], positions[corners[0]]));
+		const float area = sqrtf(dot(normal, normal));
+		if (area == 0.0f) {
+			continue;
+		}
+		const Vector3 unitNormal = { normal.x / area, normal.y / area, normal.z / area };
+		const Quadric face = MakePlaneQuadric(unitNormal, -dot(unitNormal, positions[corners[0]]), area * 0.5f);
+		for (uint32_t k = 0; k < 3; ++k) {
+			AddQuadric(quadrics[corners[k]], face);
+
+			const uint32_t a = corners[k];
+			const uint32_t b = corners[(k + 1) % 3];
+			if (countEdge(makeEdgeKey(a, b)) == 1) {
+				const Vector3 edge = subtract(positions[b], positions[a]);
+				const Vector3 borderNormal = Normalize(cross(edge, unitNormal));
+				const Quadric border = MakePlaneQuadric(borderNormal, -dot(borderNormal, positions[a]), dot(edge, edge) * kBorderWeight);
+				AddQuadric(quadrics[a], border);
+				AddQuadric(quadrics[b], border);
+			}
+		}
+	}
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		float cost;
+	};
+	struct UniqueEdge
+	{
+		uint32_t a;
+		uint32_t b;
+		bool isBorder;
+	};
+	std::vector<Collapse> collapses;
+	std::vector<UniqueEdge> uniqueEdges;
+	std::vector<uint8_t> isBorder(positionCount);
+	std::vector<uint8_t> isLocked(positionCount);
+	std::vector<uint8_t> isTouched(positionCount);
+	std::vector<uint32_t> collapseTargets(positionCount);
+	std::vector<uint32_t> adjacencyOffsets(positionCount + 1);
+	std::vector<uint32_t> adjacency;
+	float maximumError = 0.0f;
+
+	while (result.size() > targetIndexCount) {
+		// 境界の頂点は境界に沿ってしか動かさない。非多様体の頂点は動かさない
+		collectEdges();
+		std::fill(isBorder.begin(), isBorder.end(), uint8_t(0));
+		std::fill(isLocked.begin(), isLocked.end(), uint8_t(0));
+		uniqueEdges.clear();
+		for (size_t i = 0; i < edgeKeys.size();) {
+			size_t j = i + 1;
+			while (j < edgeKeys.size() && edgeKeys[j] == edgeKeys[i]) {
+				++j;
+			}
+			const uint32_t a = static_cast<uint32_t>(edgeKeys[i] >> 32);
+			const uint32_t b = static_cast<uint32_t>(edgeKeys[i] & 0xFFFFFFFF);
+			if (j - i == 1) {
+				isBorder[a] = isBorder[b] = 1;
+			} else if (j - i > 2) {
+				isLocked[a] = isLocked[b] = 1;
+			}
+			uniqueEdges.push_back({ a, b, j - i == 1 });
+			i = j;
+		}
+
+		// 位置ごとの三角形の一覧
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0u);
+		for (uint32_t index : result) {
+			++adjacencyOffsets[positionIds[index] + 1];
+		}
+		for (size_t p = 0; p < positionCount; ++p) {
+			adjacencyOffsets[p + 1] += adjacencyOffsets[p];
+		}
+		adjacency.resize(result.size());
+		{
+			std::vector<uint32_t> cursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < result.size(); ++i) {
+				adjacency[cursors[positionIds[result[i]]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		// 縮約の候補を誤差の小さい順に並べる
+		collapses.clear();
+		for (const UniqueEdge& edge : uniqueEdges) {
+			for (const auto& [from, to] : { std::pair{ edge.a, edge.b }, std::pair{ edge.b, edge.a } }) {
+				if (from == to || isLocked[from] || (isBorder[from] && !edge.isBorder)) {
+					continue;
+				}
+				Quadric q = quadrics[from];
+				AddQuadric(q, quadrics[to]);
+				collapses.push_back({ from, to, EvaluateQuadric(q, positions[to]) });
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) { return lhs.cost < rhs.cost; });
+
+		// 周りが重ならない縮約を誤差の小さい順にまとめて行う。
+		// 重なりで飛ばされた分を誤差の大きい縮約で埋めないよう、必要な数番目の誤差の1.5倍までにとどめて次の回に回す
+		const size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+		const size_t collapseGoal = std::min(trianglesToRemove, collapses.size() - 1);
+		const float errorLimit = collapses.empty() ? 0.0f : collapses[collapseGoal].cost * 1.5f;
+		std::fill(isTouched.begin(), isTouched.end(), uint8_t(0));
+		for (size_t p = 0; p < positionCount; ++p) {
+			collapseTargets[p] = static_cast<uint32_t>(p);
+		}
+		size_t removedTriangles = 0;
+		size_t appliedCount = 0;
+		for (const Collapse& collapse : collapses) {
+			if (removedTriangles >= trianglesToRemove || collapse.cost > errorLimit) {
+				break;
+			}
+			if (isTouched[collapse.from] || isTouched[collapse.to]) {
+				continue;
+			}
+
+			// 動かした後に裏返る三角形があれば縮約しない
+			bool hasFlip = false;
+			size_t collapsedTriangles = 0;
+			for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && !hasFlip; ++a) {
+				const uint32_t t = adjacency[a];
+				uint32_t corners[3] = { positionIds[result[t * 3]], positionIds[result[t * 3 + 1]], positionIds[result[t * 3 + 2]] };
+				if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to) {
+					++collapsedTriangles;
+					continue;
+				}
+				const Vector3 before = cross(subtract(positions[corners[1]], positions[corners[0]]), subtract(positions[corners[2]], positions[corners[0]]));
+				for (uint32_t& corner : corners) {
+					corner = (corner == collapse.from) ? collapse.to : corner;
+				}
+				const Vector3 after = cross(subtract(positions[corners[1]], positions[corners[0]]), subtract(positions[corners[2]], positions[corners[0]]));
+				hasFlip = dot(before, after) <= 0.0f;
+			}
+			if (hasFlip) {
+				continue;
+			}
+
+			// 動かす頂点の周りの三角形の形が変わるので、この回ではもう触らない
+			for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; ++a) {
+				const uint32_t t = adjacency[a];
+				isTouched[positionIds[result[t * 3]]] = 1;
+				isTouched[positionIds[result[t * 3 + 1]]] = 1;
+				isTouched[positionIds[result[t * 3 + 2]]] = 1;
+			}
+
+			collapseTargets[collapse.from] = collapse.to;
+			AddQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+			const float weight = quadrics[collapse.to].weight;
+			maximumError = std::max(maximumError, weight > 0.0f ? sqrtf(collapse.cost / weight) : 0.0f);
+			removedTriangles += collapsedTriangles;
+			++appliedCount;
+		}
+		if (appliedCount == 0) {
+			break;
+		}
+
+		// 動かした位置を指すインデックスを、縮約先の頂点のうちUVと法線が一番近いものに付け替える
+		std::vector<uint32_t> vertexRemap(vertices.size());
+		for (size_t v = 0; v < vertices.size(); ++v) {
+			vertexRemap[v] = static_cast<uint32_t>(v);
+			const uint32_t target = collapseTargets[positionIds[v]];
+			if (target == positionIds[v]) {
+				continue;
+			}
+			float bestDistance = FLT_MAX;
+			for (uint32_t w = wedgeOffsets[target]; w < wedgeOffsets[target + 1]; ++w) {
+				const VertexData& a = vertices[v];
+				const VertexData& b = vertices[wedges[w]];
+				const float du = a.texcoord.x - b.texcoord.x;
+				const float dv = a.texcoord.y - b.texcoord.y;
+				const float distance = du * du + dv * dv + (1.0f - dot(a.normal, b.normal));
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					vertexRemap[v] = wedges[w];
+				}
+			}
+		}
+
+		// 付け替えて潰れた三角形を取り除く
+		size_t writeIndex = 0;
+		for (size_t i = 0; i + 3 <= result.size(); i += 3) {
+			const uint32_t a = vertexRemap[result[i]];
+			const uint32_t b = vertexRemap[result[i + 1]];
+			const uint32_t c = vertexRemap[result[i + 2]];
+			if (positionIds[a] == positionIds[b] || positionIds[b] == positionIds[c] || positionIds[c] == positionIds[a]) {
+				continue;
+			}
+			result[writeIndex++] = a;
+			result[writeIndex++] = b;
+			result[writeIndex++] = c;
+		}
+		result.resize(writeIndex);
+	}
+
+	if (resultError != nullptr) {
+		*resultError = maximumError;
+	}
+	return result;
+}
+
+// LODを作るときの、元の三角形数に対する割合（LOD1 以降）
+const float kMeshLodRatios[] = { 0.5f, 0.25f, 0.125f };
+
+/// <summary>
+/// メッシュの LOD を作る。LOD1 以降のインデックスは mesh.lodIndices に続けて入れ、頂点は LOD0 と共有する
+/// </summary>
+/// <param name="mesh">LODを作るメッシュ。頂点やインデックスの最適化は済ませておく</param>
+inline void BuildMeshLods(MeshData& mesh)
+{
+	mesh.lods.clear();
+	mesh.lodIndices.clear();
+
+	// 1つ前のLODから続けて減らす。誤差は前のLODからの分を足していく
+	std::vector<uint32_t> previous = mesh.indices;
+	float previousError = 0.0f;
+	for (float ratio : kMeshLodRatios) {
+		const size_t targetIndexCount = size_t(float(mesh.indices.size() / 3) * ratio) * 3;
+		if (targetIndexCount < 3 || previous.size() <= targetIndexCount) {
+			break;
+		}
+
+		float error = 0.0f;
+		std::vector<uint32_t> lodIndices = SimplifyMesh(mesh.vertices, previous, targetIndexCount, &error);
+		if (lodIndices.empty() || lodIndices.size() >= previous.size()) {
+			break; // これ以上減らせない
+		}
+		OptimizeVertexCache(lodIndices, mesh.vertices.size());
+
+		MeshLod lod{};
+		lod.indexOffset = static_cast<uint32_t>(mesh.lodIndices.size());
+		lod.indexCount = static_cast<uint32_t>(lodIndices.size());
+		lod.error = previousError + error;
+		mesh.lods.push_back(lod);
+		mesh.lodIndices.insert(mesh.lodIndices.end(), lodIndices.begin(), lodIndices.end());
+
+		previous.swap(lodIndices);
+		previousError = lod.error;
+	}
+}
+
+/// <summary>
+/// 画面上での誤差が閾値以下になる中で一番粗い LOD を選ぶ
+/// </summary>
+/// <param name="mesh">メッシュ</param>
+/// <param name="distance">カメラからの距離（ワールド空間）</param>
+/// <param name="worldScale">ワールド行列の拡大率（モデル空間の誤差をワールド空間に直す）</param>
+/// <param name="projectionScaleY">透視投影行列の m[1][1]（1 / tan(fovY / 2)）</param>
+/// <param name="viewportHeight">ビューポートの高さ（ピクセル）</param>
+/// <param name="pixelThreshold">許す誤差（ピクセル）</param>
+/// <returns>0 なら元のメッシュ、1 以降は mesh.lods[レベル - 1]</returns>
+inline uint32_t SelectMeshLod(const MeshData& mesh, float distance, float worldScale, float projectionScaleY, float viewportHeight, float pixelThreshold = 1.0f)
+{
+	// 距離 distance にある長さ 1 のものが画面上で何ピクセルになるか
+	const float pixelsPerUnit = projectionScaleY * viewportHeight * 0.5f / std::max(distance, 1e-4f);
+
+	uint32_t level = 0;
+	for (size_t i = 0; i < mesh.lods.size(); ++i) {
+		if (mesh.lods[i].error * worldScale * pixelsPerUnit > pixelThreshold) {
+			break;
+		}
+		level = static_cast<uint32_t>(i + 1);
+	}
+	return level;
+}
@@ -0,0 +1,391 @@
+#pragma once
+// メッシュの最適化（Forsyth の頂点キャッシュ最適化・オーバードロー最適化・頂点の読み込み順の最適化）と、頂点キャッシュの効率の計測。
+// Windows のヘッダーに依存しないので、tests/ の Linux 向けのテストからもそのまま使う
+#include "MeshData.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// 頂点キャッシュ最適化で想定するキャッシュのサイズ（Forsyth のスコア計算用）
+const uint32_t kVertexCacheSize = 32;
+
+// スコアを表引きする、残りの三角形の数の上限。これより多い頂点は式で計算する
+const uint32_t kForsythValenceTableSize = 32;
+
+// Forsyth のスコアの表（powf を三角形ごとに何度も呼ばないようにする）
+struct ForsythScoreTable
+{
+	float cache[kVertexCacheSize];            // キャッシュ内の位置ごとのスコア
+	float valence[kForsythValenceTableSize];  // 残りの三角形の数ごとのスコア
+};
+
+/// <summary>
+/// Forsyth のスコアの表を作る
+/// </summary>
+inline ForsythScoreTable MakeForsythScoreTable()
+{
+	ForsythScoreTable table{};
+	for (uint32_t i = 0; i < kVertexCacheSize; ++i) {
+		if (i < 3) {
+			// 直前の三角形の頂点は、同じ向きの三角形が続かないように固定の値にする
+			table.cache[i] = 0.75f;
+		} else {
+			const float scaler = 1.0f / float(kVertexCacheSize - 3);
+			table.cache[i] = powf(1.0f - float(i - 3) * scaler, 1.5f);
+		}
+	}
+	for (uint32_t i = 1; i < kForsythValenceTableSize; ++i) {
+		// 残りの三角形が少ない頂点を優先して、頂点を早く使い切る
+		table.valence[i] = 2.0f * powf(float(i), -0.5f);
+	}
+	return table;
+}
+
+/// <summary>
+/// Forsyth の頂点キャッシュ最適化で使う頂点のスコア
+/// </summary>
+/// <param name="cachePosition">キャッシュ内の位置。キャッシュに無ければ -1</param>
+/// <param name="liveTriangleCount">まだ出力していない、この頂点を使う三角形の数</param>
+inline float ScoreForsythVertex(int32_t cachePosition, uint32_t liveTriangleCount)
+{
+	static const ForsythScoreTable table = MakeForsythScoreTable();
+
+	// 使う三角形が残っていない頂点は選ばない
+	if (liveTriangleCount == 0) {
+		return -1.0f;
+	}
+
+	float score = cachePosition >= 0 ? table.cache[cachePosition] : 0.0f;
+	if (liveTriangleCount < kForsythValenceTableSize) {
+		score += table.valence[liveTriangleCount];
+	} else {
+		score += 2.0f * powf(float(liveTriangleCount), -0.5f);
+	}
+	return score;
+}
+
+/// <summary>
+/// 頂点キャッシュの効率が良くなるように三角形の順番を並べ替える（Tom Forsyth の線形速度アルゴリズム）
+/// </summary>
+/// <param name="indices">三角形リストのインデックス。並べ替えた結果で上書きする</param>
+/// <param name="vertexCount">頂点の数</param>
+inline void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// 頂点ごとに、その頂点を使う三角形の一覧を作る
+	std::vector<uint32_t> liveTriangleCounts(vertexCount, 0);
+	for (uint32_t index : indices) {
+		++liveTriangleCounts[index];
+	}
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangleCounts[v];
+	}
+	std::vector<uint32_t> adjacency(indices.size());
+	{
+		std::vector<uint32_t> cursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); ++i) {
+			adjacency[cursors[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+
+	std::vector<int32_t> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		vertexScores[v] = ScoreForsythVertex(-1, liveTriangleCounts[v]);
+	}
+
+	std::vector<float> triangleScores(triangleCount);
+	std::vector<uint8_t> isEmitted(triangleCount, 0);
+	int64_t bestTriangle = 0;
+	for (size_t t = 0; t < triangleCount; ++t) {
+		triangleScores[t] = vertexScores[indices[t * 3 + 0]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+		if (triangleScores[t] > triangleScores[bestTriangle]) {
+			bestTriangle = static_cast<int64_t>(t);
+		}
+	}
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	uint32_t cache[kVertexCacheSize + 3];
+	uint32_t newCache[kVertexCacheSize + 3];
+	uint32_t cacheCount = 0;
+	size_t inputCursor = 0;
+
+	while (result.size() < indices.size()) {
+		if (bestTriangle < 0) {
+			// キャッシュ内の頂点から続けられる三角形が無いので、入力順で次の未出力の三角形から始める
+			while (isEmitted[inputCursor]) {
+				++inputCursor;
+			}
+			bestTriangle = static_cast<int64_t>(inputCursor);
+		}
+
+		const uint32_t* triangle = &indices[size_t(bestTriangle) * 3];
+		result.insert(result.end(), triangle, triangle + 3);
+		isEmitted[size_t(bestTriangle)] = 1;
+
+		// 出力した三角形の頂点をキャッシュの先頭に入れ、残りを後ろにずらす
+		uint32_t newCacheCount = 0;
+		for (uint32_t k = 0; k < 3; ++k) {
+			if (std::find(newCache, newCache + newCacheCount, triangle[k]) == newCache + newCacheCount) {
+				newCache[newCacheCount++] = triangle[k];
+			}
+		}
+		for (uint32_t i = 0; i < cacheCount; ++i) {
+			if (cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2]) {
+				newCache[newCacheCount++] = cache[i];
+			}
+		}
+
+		// 出力した三角形を頂点の隣接リストから外す
+		for (uint32_t k = 0; k < 3; ++k) {
+			const uint32_t v = triangle[k];
+			uint32_t* begin = &adjacency[adjacencyOffsets[v]];
+			uint32_t* end = begin + liveTriangleCounts[v];
+			uint32_t* found = std::find(begin, end, static_cast<uint32_t>(bestTriangle));
+			assert(found != end);
+			*found = *(end - 1);
+			--liveTriangleCounts[v];
+		}
+
+		// キャッシュの位置が変わった頂点（押し出された頂点を含む）のスコアと、その三角形のスコアを更新する
+		for (uint32_t i = 0; i < newCacheCount; ++i) {
+			const uint32_t v = newCache[i];
+			cachePositions[v] = (i < kVertexCacheSize) ? static_cast<int32_t>(i) : -1;
+			const float score = ScoreForsythVertex(cachePositions[v], liveTriangleCounts[v]);
+			const float delta = score - vertexScores[v];
+			vertexScores[v] = score;
+			for (uint32_t a = 0; a < liveTriangleCounts[v]; ++a) {
+				triangleScores[adjacency[adjacencyOffsets[v] + a]] += delta;
+			}
+		}
+
+		cacheCount = std::min(newCacheCount, kVertexCacheSize);
+		std::copy(newCache, newCache + cacheCount, cache);
+
+		// 次はキャッシュ内の頂点を使う三角形から、スコアが一番高いものを選ぶ
+		bestTriangle = -1;
+		float bestScore = 0.0f;
+		for (uint32_t i = 0; i < cacheCount; ++i) {
+			const uint32_t v = cache[i];
+			for (uint32_t a = 0; a < liveTriangleCounts[v]; ++a) {
+				const uint32_t t = adjacency[adjacencyOffsets[v] + a];
+				if (bestTriangle < 0 || triangleScores[t] > bestScore) {
+					bestTriangle = t;
+					bestScore = triangleScores[t];
+				}
+			}
+		}
+	}
+
+	indices.swap(result);
+}
+
+/// <summary>
+/// FIFO の頂点キャッシュをシミュレートし、三角形1つ分のキャッシュミスの数を返す
+/// </summary>
+/// <param name="triangle">三角形の3つのインデックス</param>
+/// <param name="cacheSize">キャッシュのサイズ</param>
+/// <param name="timestamps">頂点ごとの、キャッシュに入った時刻</param>
+/// <param name="timestamp">現在の時刻。ミスするたびに進む</param>
+inline uint32_t SimulateVertexCache(const uint32_t* triangle, uint32_t cacheSize, std::vector<uint32_t>& timestamps, uint32_t& timestamp)
+{
+	uint32_t misses = 0;
+	for (uint32_t k = 0; k < 3; ++k) {
+		// 最後に入ってから cacheSize 回より多くミスしていれば押し出されている
+		if (timestamp - timestamps[triangle[k]] > cacheSize) {
+			timestamps[triangle[k]] = timestamp++;
+			++misses;
+		}
+	}
+	return misses;
+}
+
+// 頂点キャッシュの効率
+struct VertexCacheStatistics
+{
+	uint32_t misses;   // 頂点シェーダーが実行される回数
+	float acmr;        // 三角形あたりのキャッシュミス数（Average Cache Miss Ratio）。理想は 0.5 付近
+	float atvr;        // 頂点あたりのキャッシュミス数（Average Transformed Vertex Ratio）。理想は 1.0
+};
+
+/// <summary>
+/// FIFO の頂点キャッシュをシミュレートして、インデックスの順番のキャッシュ効率を調べる
+/// </summary>
+/// <param name="indices">三角形リストのインデックス</param>
+/// <param name="vertexCount">頂点の数</param>
+/// <param name="cacheSize">シミュレートするキャッシュのサイズ</param>
+inline VertexCacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	uint32_t timestamp = cacheSize + 1;
+
+	VertexCacheStatistics statistics{};
+	for (size_t i = 0; i + 3 <= indices.size(); i += 3) {
+		statistics.misses += SimulateVertexCache(&indices[i], cacheSize, timestamps, timestamp);
+	}
+
+	const size_t triangleCount = indices.size() / 3;
+	statistics.acmr = triangleCount == 0 ? 0.0f : float(statistics.misses) / float(triangleCount);
+	statistics.atvr = vertexCount == 0 ? 0.0f : float(statistics.misses) / float(vertexCount);
+	return statistics;
+}
+
+/// <summary>
+/// 重ね描き（オーバードロー）が減るように三角形の塊の順番を並べ替える（Sander らの手法）。
+/// 頂点キャッシュ最適化の後に呼ぶと、キャッシュ効率をほぼ保ったまま外側を向いた塊から描くようになる
+/// </summary>
+/// <param name="indices">三角形リストのインデックス。並べ替えた結果で上書きする</param>
+/// <param name="vertices">頂点</param>
+/// <param name="threshold">塊に分けるときに許す ACMR の悪化の割合（1.05 なら 5%）</param>
+inline void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<VertexData>& vertices, float threshold)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	const uint32_t kCacheSize = 16;
+	std::vector<uint32_t> timestamps(vertices.size(), 0);
+	uint32_t timestamp = kCacheSize + 1;
+
+	// 3頂点ともキャッシュミスする三角形は、前とつながっていない新しい塊の始まりとみなす
+	std::vector<size_t> hardBoundaries;
+	for (size_t t = 0; t < triangleCount; ++t) {
+		if (SimulateVertexCache(&indices[t * 3], kCacheSize, timestamps, timestamp) == 3 || t == 0) {
+			hardBoundaries.push_back(t);
+		}
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	// 塊の中で ACMR が塊全体の値の threshold 倍以下になったところでさらに区切る
+	std::vector<size_t> clusters;
+	for (size_t h = 0; h + 1 < hardBoundaries.size(); ++h) {
+		const size_t start = hardBoundaries[h];
+		const size_t end = hardBoundaries[h + 1];
+
+		timestamp += kCacheSize + 1;
+		uint32_t clusterMisses = 0;
+		for (size_t t = start; t < end; ++t) {
+			clusterMisses += SimulateVertexCache(&indices[t * 3], kCacheSize, timestamps, timestamp);
+		}
+		const float clusterThreshold = threshold * float(clusterMisses) / float(end - start);
+
+		clusters.push_back(start);
+		timestamp += kCacheSize + 1;
+		uint32_t runningMisses = 0;
+		uint32_t runningTriangles = 0;
+		for (size_t t = start; t < end; ++t) {
+			runningMisses += SimulateVertexCache(&indices[t * 3], kCacheSize, timestamps, timestamp);
+			++runningTriangles;
+			if (float(runningMisses) / float(runningTriangles) <= clusterThreshold) {
+				clusters.push_back(t + 1);
+				timestamp += kCacheSize + 1;
+				runningMisses = 0;
+				runningTriangles = 0;
+			}
+		}
+
+		// 最後の塊は目標に届かずに終わるので、一つ前の塊とつなげる
+		if (clusters.back() != start) {
+			clusters.pop_back();
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	// メッシュの中心
+	Vector3 meshCenter{ 0.0f, 0.0f, 0.0f };
+	for (const VertexData& vertex : vertices) {
+		meshCenter.x += vertex.position.x;
+		meshCenter.y += vertex.position.y;
+		meshCenter.z += vertex.position.z;
+	}
+	const float inverseVertexCount = 1.0f / float(std::max<size_t>(vertices.size(), 1));
+	meshCenter = { meshCenter.x * inverseVertexCount, meshCenter.y * inverseVertexCount, meshCenter.z * inverseVertexCount };
+
+	// 塊ごとに、面積で重み付けした中心と法線から「どれだけ外側を向いているか」を求める
+	const size_t clusterCount = clusters.size() - 1;
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t c = 0; c < clusterCount; ++c) {
+		Vector3 center{ 0.0f, 0.0f, 0.0f };
+		Vector3 normal{ 0.0f, 0.0f, 0.0f };
+		float totalArea = 0.0f;
+		for (size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+			const Vector4& a = vertices[indices[t * 3 + 0]].position;
+			const Vector4& b = vertices[indices[t * 3 + 1]].position;
+			const Vector4& d = vertices[indices[t * 3 + 2]].position;
+			const Vector3 ab{ b.x - a.x, b.y - a.y, b.z - a.z };
+			const Vector3 ad{ d.x - a.x, d.y - a.y, d.z - a.z };
+			const Vector3 cross{ ab.y * ad.z - ab.z * ad.y, ab.z * ad.x - ab.x * ad.z, ab.x * ad.y - ab.y * ad.x };
+			const float area = sqrtf(cross.x * cross.x + cross.y * cross.y + cross.z * cross.z);
+
+			center.x += (a.x + b.x + d.x) * (area / 3.0f);
+			center.y += (a.y + b.y + d.y) * (area / 3.0f);
+			center.z += (a.z + b.z + d.z) * (area / 3.0f);
+			normal.x += cross.x;
+			normal.y += cross.y;
+			normal.z += cross.z;
+			totalArea += area;
+		}
+
+		const float inverseArea = totalArea == 0.0f ? 0.0f : 1.0f / totalArea;
+		center = { center.x * inverseArea, center.y * inverseArea, center.z * inverseArea };
+		const float normalLength = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+		const float inverseNormalLength = normalLength == 0.0f ? 0.0f : 1.0f / normalLength;
+
+		sortKeys[c] = ((center.x - meshCenter.x) * normal.x + (center.y - meshCenter.y) * normal.y + (center.z - meshCenter.z) * normal.z) * inverseNormalLength;
+	}
+
+	// 外側を向いている塊ほど手前にあって他を隠しやすいので先に描く
+	std::vector<uint32_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; ++c) {
+		order[c] = static_cast<uint32_t>(c);
+	}
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t lhs, uint32_t rhs) { return sortKeys[lhs] > sortKeys[rhs]; });
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (uint32_t c : order) {
+		result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+	}
+	indices.swap(result);
+}
+
+/// <summary>
+/// 頂点をインデックスで最初に使われる順に並べ替え、頂点の読み込みのメモリ局所性を良くする
+/// </summary>
+/// <param name="mesh">並べ替えるメッシュ。使われていない頂点は取り除く</param>
+inline void OptimizeVertexFetch(MeshData& mesh)
+{
+	const uint32_t kUnused = 0xFFFFFFFF;
+	std::vector<uint32_t> remap(mesh.vertices.size(), kUnused);
+	std::vector<VertexData> vertices;
+	vertices.reserve(mesh.vertices.size());
+
+	for (uint32_t& index : mesh.indices) {
+		if (remap[index] == kUnused) {
+			remap[index] = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+	mesh.vertices.swap(vertices);
+}
+
+/// <summary>
+/// メッシュをGPUで描きやすい順番に並べ替える（頂点キャッシュ → オーバードロー → 頂点の読み込み の順）
+/// </summary>
+/// <param name="mesh">並べ替えるメッシュ</param>
+inline void OptimizeMesh(MeshData& mesh)
+{
+	OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+	OptimizeOverdraw(mesh.indices, mesh.vertices, 1.05f);
+	OptimizeVertexFetch(mesh);
+}
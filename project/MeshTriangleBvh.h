@@ -0,0 +1,357 @@
+#pragma once
+// メッシュの三角形の BVH とレイの交差判定（葉の三角形は8個ずつ SIMD で Möller–Trumbore 法を使って比べる）。
+// Windows のヘッダーに依存しないので、tests/ の Linux 向けのテストからもそのまま使う
+#include "InstanceBvh.h"
+#include "MeshData.h"
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+// 三角形の BVH の葉に入れる三角形の最大数（AVX2 で一度に比べられる数）
+const uint32_t kTrianglePacketWidth = 8;
+
+// 葉の三角形を SIMD で比べられるよう、成分ごとに8個ずつ並べたもの。
+// 頂点0と、頂点0から頂点1・頂点2への辺で持つ。使わない枠は辺が 0 の三角形（どのレイとも交差しない）
+struct TrianglePacket {
+	alignas(32) float vertex0X[kTrianglePacketWidth];
+	alignas(32) float vertex0Y[kTrianglePacketWidth];
+	alignas(32) float vertex0Z[kTrianglePacketWidth];
+	alignas(32) float edge1X[kTrianglePacketWidth];
+	alignas(32) float edge1Y[kTrianglePacketWidth];
+	alignas(32) float edge1Z[kTrianglePacketWidth];
+	alignas(32) float edge2X[kTrianglePacketWidth];
+	alignas(32) float edge2Y[kTrianglePacketWidth];
+	alignas(32) float edge2Z[kTrianglePacketWidth];
+	uint32_t triangles[kTrianglePacketWidth]; // メッシュの三角形の番号
+	uint32_t count;
+};
+
+/// <summary>
+/// メッシュの三角形の BVH（モデル空間）。頂点は動かないので一度だけ作る
+/// </summary>
+struct MeshTriangleBvh {
+	InstanceBvh bvh;                    // 三角形を囲む箱で作った BVH（葉の三角形は kTrianglePacketWidth 個まで）
+	std::vector<TrianglePacket> packets;
+	std::vector<uint32_t> leafPackets;  // ノードの番号から、その葉の三角形を並べた packets の番号
+};
+
+// レイと三角形の交差の結果
+struct RayTriangleHit {
+	uint32_t triangle;  // メッシュの三角形の番号（インデックス配列の triangle * 3 から3つ）
+	float distance;     // レイの direction の長さを単位にした距離
+	float u, v;         // 重心座標（頂点1と頂点2の重み。頂点0の重みは 1 - u - v）
+	Vector2 texcoord;   // 当たった位置の UV
+};
+
+/// <summary>
+/// メッシュの三角形の BVH を作る
+/// </summary>
+inline void BuildMeshTriangleBvh(MeshTriangleBvh& triangleBvh, const MeshData& mesh)
+{
+	const uint32_t triangleCount = static_cast<uint32_t>(mesh.indices.size() / 3);
+	auto position = [&mesh](uint32_t triangle, uint32_t corner) {
+		const Vector4& p = mesh.vertices[mesh.indices[triangle * 3 + corner]].position;
+		return Vector3{ p.x, p.y, p.z };
+	};
+
+	std::vector<Aabb> triangleBounds(triangleCount);
+	for (uint32_t triangle = 0; triangle < triangleCount; ++triangle) {
+		Aabb box = MakeEmptyAabb();
+		for (uint32_t corner = 0; corner < 3; ++corner) {
+			const Vector3 p = position(triangle, corner);
+			box = Union(box, Aabb{ p, p });
+		}
+		triangleBounds[triangle] = box;
+	}
+	BuildInstanceBvh(triangleBvh.bvh, triangleBounds, kTrianglePacketWidth);
+
+	// 葉ごとに三角形を1つのパケットへ詰める
+	triangleBvh.packets.clear();
+	triangleBvh.leafPackets.assign(triangleBvh.bvh.nodes.size(), UINT32_MAX);
+	for (size_t nodeIndex = 0; nodeIndex < triangleBvh.bvh.nodes.size(); ++nodeIndex) {
+		const BvhNode& node = triangleBvh.bvh.nodes[nodeIndex];
+		if (node.count == 0) {
+			continue;
+		}
+		assert(node.count <= kTrianglePacketWidth);
+		TrianglePacket packet{};
+		packet.count = node.count;
+		for (uint32_t lane = 0; lane < node.count; ++lane) {
+			const uint32_t triangle = triangleBvh.bvh.items[node.firstOrChild + lane];
+			const Vector3 p0 = position(triangle, 0);
+			const Vector3 p1 = position(triangle, 1);
+			const Vector3 p2 = position(triangle, 2);
+			packet.vertex0X[lane] = p0.x;
+			packet.vertex0Y[lane] = p0.y;
+			packet.vertex0Z[lane] = p0.z;
+			packet.edge1X[lane] = p1.x - p0.x;
+			packet.edge1Y[lane] = p1.y - p0.y;
+			packet.edge1Z[lane] = p1.z - p0.z;
+			packet.edge2X[lane] = p2.x - p0.x;
+			packet.edge2Y[lane] = p2.y - p0.y;
+			packet.edge2Z[lane] = p2.z - p0.z;
+			packet.triangles[lane] = triangle;
+		}
+		triangleBvh.leafPackets[nodeIndex] = static_cast<uint32_t>(triangleBvh.packets.size());
+		triangleBvh.packets.push_back(packet);
+	}
+}
+
+// これより行列式の絶対値が小さい三角形は、レイと平行（または面積が無い）とみなす
+const float kRayTriangleEpsilon = 1.0e-12f;
+
+/// <summary>
+/// パケットの1つの三角形とレイの交差判定（Möller–Trumbore 法。裏からの交差も当たりにする）
+/// </summary>
+inline bool IntersectRayTrianglePacketLane(const Ray& ray, const TrianglePacket& packet, uint32_t lane, float maxDistance, float& distance, float& u, float& v)
+{
+	auto cross = [](const Vector3& a, const Vector3& b) { return Vector3{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; };
+	const Vector3 edge1 = { packet.edge1X[lane], packet.edge1Y[lane], packet.edge1Z[lane] };
+	const Vector3 edge2 = { packet.edge2X[lane], packet.edge2Y[lane], packet.edge2Z[lane] };
+	const Vector3 p = cross(ray.direction, edge2);
+	const float determinant = edge1.x * p.x + edge1.y * p.y + edge1.z * p.z;
+	if (fabsf(determinant) < kRayTriangleEpsilon) {
+		return false;
+	}
+	const float inverseDeterminant = 1.0f / determinant;
+	const Vector3 toOrigin = { ray.origin.x - packet.vertex0X[lane], ray.origin.y - packet.vertex0Y[lane], ray.origin.z - packet.vertex0Z[lane] };
+	u = (toOrigin.x * p.x + toOrigin.y * p.y + toOrigin.z * p.z) * inverseDeterminant;
+	const Vector3 q = cross(toOrigin, edge1);
+	v = (ray.direction.x * q.x + ray.direction.y * q.y + ray.direction.z * q.z) * inverseDeterminant;
+	distance = (edge2.x * q.x + edge2.y * q.y + edge2.z * q.z) * inverseDeterminant;
+	return u >= 0.0f && v >= 0.0f && u + v <= 1.0f && distance >= 0.0f && distance < maxDistance;
+}
+
+/// <summary>
+/// パケットの三角形とレイの交差判定（スカラー版）
+/// </summary>
+/// <returns>一番近く当たった枠の番号。当たらなければ -1</returns>
+inline int IntersectRayTrianglePacketScalar(const Ray& ray, const TrianglePacket& packet, float maxDistance, float& distance, float& u, float& v)
+{
+	int hitLane = -1;
+	for (uint32_t lane = 0; lane < packet.count; ++lane) {
+		float laneDistance = 0.0f;
+		float laneU = 0.0f;
+		float laneV = 0.0f;
+		if (IntersectRayTrianglePacketLane(ray, packet, lane, maxDistance, laneDistance, laneU, laneV)) {
+			maxDistance = laneDistance;
+			distance = laneDistance;
+			u = laneU;
+			v = laneV;
+			hitLane = int(lane);
+		}
+	}
+	return hitLane;
+}
+
+#if defined(MATH_SIMD_X86)
+
+/// <summary>
+/// パケットの三角形4つずつとレイの交差判定（SSE4.1）
+/// </summary>
+/// <returns>一番近く当たった枠の番号。当たらなければ -1</returns>
+MATH_TARGET_SSE41 inline int IntersectRayTrianglePacketSSE41(const Ray& ray, const TrianglePacket& packet, float maxDistance, float& distance, float& u, float& v)
+{
+	const __m128 directionX = _mm_set1_ps(ray.direction.x);
+	const __m128 directionY = _mm_set1_ps(ray.direction.y);
+	const __m128 directionZ = _mm_set1_ps(ray.direction.z);
+	const __m128 originX = _mm_set1_ps(ray.origin.x);
+	const __m128 originY = _mm_set1_ps(ray.origin.y);
+	const __m128 originZ = _mm_set1_ps(ray.origin.z);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 epsilon = _mm_set1_ps(kRayTriangleEpsilon);
+
+	int hitLane = -1;
+	for (uint32_t base = 0; base < packet.count; base += 4) {
+		const __m128 edge1X = _mm_load_ps(&packet.edge1X[base]);
+		const __m128 edge1Y = _mm_load_ps(&packet.edge1Y[base]);
+		const __m128 edge1Z = _mm_load_ps(&packet.edge1Z[base]);
+		const __m128 edge2X = _mm_load_ps(&packet.edge2X[base]);
+		const __m128 edge2Y = _mm_load_ps(&packet.edge2Y[base]);
+		const __m128 edge2Z = _mm_load_ps(&packet.edge2Z[base]);
+
+		// p = direction × edge2
+		const __m128 pX = _mm_sub_ps(_mm_mul_ps(directionY, edge2Z), _mm_mul_ps(directionZ, edge2Y));
+		const __m128 pY = _mm_sub_ps(_mm_mul_ps(directionZ, edge2X), _mm_mul_ps(directionX, edge2Z));
+		const __m128 pZ = _mm_sub_ps(_mm_mul_ps(directionX, edge2Y), _mm_mul_ps(directionY, edge2X));
+		const __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1X, pX), _mm_mul_ps(edge1Y, pY)), _mm_mul_ps(edge1Z, pZ));
+		const __m128 inverseDeterminant = _mm_div_ps(one, determinant);
+
+		const __m128 toOriginX = _mm_sub_ps(originX, _mm_load_ps(&packet.vertex0X[base]));
+		const __m128 toOriginY = _mm_sub_ps(originY, _mm_load_ps(&packet.vertex0Y[base]));
+		const __m128 toOriginZ = _mm_sub_ps(originZ, _mm_load_ps(&packet.vertex0Z[base]));
+		const __m128 laneU = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(toOriginX, pX), _mm_mul_ps(toOriginY, pY)), _mm_mul_ps(toOriginZ, pZ)), inverseDeterminant);
+
+		// q = toOrigin × edge1
+		const __m128 qX = _mm_sub_ps(_mm_mul_ps(toOriginY, edge1Z), _mm_mul_ps(toOriginZ, edge1Y));
+		const __m128 qY = _mm_sub_ps(_mm_mul_ps(toOriginZ, edge1X), _mm_mul_ps(toOriginX, edge1Z));
+		const __m128 qZ = _mm_sub_ps(_mm_mul_ps(toOriginX, edge1Y), _mm_mul_ps(toOriginY, edge1X));
+		const __m128 laneV = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, qX), _mm_mul_ps(directionY, qY)), _mm_mul_ps(directionZ, qZ)), inverseDeterminant);
+		const __m128 laneDistance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2X, qX), _mm_mul_ps(edge2Y, qY)), _mm_mul_ps(edge2Z, qZ)), inverseDeterminant);
+
+		__m128 hit = _mm_cmpge_ps(_mm_and_ps(determinant, absMask), epsilon);
+		hit = _mm_and_ps(hit, _mm_cmpge_ps(laneU, zero));
+		hit = _mm_and_ps(hit, _mm_cmpge_ps(laneV, zero));
+		hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(laneU, laneV), one));
+		hit = _mm_and_ps(hit, _mm_cmpge_ps(laneDistance, zero));
+		hit = _mm_and_ps(hit, _mm_cmplt_ps(laneDistance, _mm_set1_ps(maxDistance)));
+		uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(hit));
+		if (mask == 0) {
+			continue;
+		}
+
+		// 当たった中で一番近いもの（当たった数は少ないので、取り出して比べる）
+		alignas(16) float distances[4];
+		alignas(16) float us[4];
+		alignas(16) float vs[4];
+		_mm_store_ps(distances, laneDistance);
+		_mm_store_ps(us, laneU);
+		_mm_store_ps(vs, laneV);
+		while (mask != 0) {
+			const uint32_t lane = std::countr_zero(mask);
+			mask &= mask - 1;
+			if (distances[lane] < maxDistance) {
+				maxDistance = distances[lane];
+				distance = distances[lane];
+				u = us[lane];
+				v = vs[lane];
+				hitLane = int(base + lane);
+			}
+		}
+	}
+	return hitLane;
+}
+
+/// <summary>
+/// パケットの三角形8つとレイの交差判定（AVX2）
+/// </summary>
+/// <returns>一番近く当たった枠の番号。当たらなければ -1</returns>
+MATH_TARGET_AVX2 inline int IntersectRayTrianglePacketAVX2(const Ray& ray, const TrianglePacket& packet, float maxDistance, float& distance, float& u, float& v)
+{
+	const __m256 directionX = _mm256_set1_ps(ray.direction.x);
+	const __m256 directionY = _mm256_set1_ps(ray.direction.y);
+	const __m256 directionZ = _mm256_set1_ps(ray.direction.z);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+	const __m256 edge1X = _mm256_load_ps(packet.edge1X);
+	const __m256 edge1Y = _mm256_load_ps(packet.edge1Y);
+	const __m256 edge1Z = _mm256_load_ps(packet.edge1Z);
+	const __m256 edge2X = _mm256_load_ps(packet.edge2X);
+	const __m256 edge2Y = _mm256_load_ps(packet.edge2Y);
+	const __m256 edge2Z = _mm256_load_ps(packet.edge2Z);
+
+	// p = direction × edge2
+	const __m256 pX = _mm256_fmsub_ps(directionY, edge2Z, _mm256_mul_ps(directionZ, edge2Y));
+	const __m256 pY = _mm256_fmsub_ps(directionZ, edge2X, _mm256_mul_ps(directionX, edge2Z));
+	const __m256 pZ = _mm256_fmsub_ps(directionX, edge2Y, _mm256_mul_ps(directionY, edge2X));
+	const __m256 determinant = _mm256_fmadd_ps(edge1Z, pZ, _mm256_fmadd_ps(edge1Y, pY, _mm256_mul_ps(edge1X, pX)));
+	const __m256 inverseDeterminant = _mm256_div_ps(one, determinant);
+
+	const __m256 toOriginX = _mm256_sub_ps(_mm256_set1_ps(ray.origin.x), _mm256_load_ps(packet.vertex0X));
+	const __m256 toOriginY = _mm256_sub_ps(_mm256_set1_ps(ray.origin.y), _mm256_load_ps(packet.vertex0Y));
+	const __m256 toOriginZ = _mm256_sub_ps(_mm256_set1_ps(ray.origin.z), _mm256_load_ps(packet.vertex0Z));
+	const __m256 laneU = _mm256_mul_ps(_mm256_fmadd_ps(toOriginZ, pZ, _mm256_fmadd_ps(toOriginY, pY, _mm256_mul_ps(toOriginX, pX))), inverseDeterminant);
+
+	// q = toOrigin × edge1
+	const __m256 qX = _mm256_fmsub_ps(toOriginY, edge1Z, _mm256_mul_ps(toOriginZ, edge1Y));
+	const __m256 qY = _mm256_fmsub_ps(toOriginZ, edge1X, _mm256_mul_ps(toOriginX, edge1Z));
+	const __m256 qZ = _mm256_fmsub_ps(toOriginX, edge1Y, _mm256_mul_ps(toOriginY, edge1X));
+	const __m256 laneV = _mm256_mul_ps(_mm256_fmadd_ps(directionZ, qZ, _mm256_fmadd_ps(directionY, qY, _mm256_mul_ps(directionX, qX))), inverseDeterminant);
+	const __m256 laneDistance = _mm256_mul_ps(_mm256_fmadd_ps(edge2Z, qZ, _mm256_fmadd_ps(edge2Y, qY, _mm256_mul_ps(edge2X, qX))), inverseDeterminant);
+
+	__m256 hit = _mm256_cmp_ps(_mm256_and_ps(determinant, absMask), _mm256_set1_ps(kRayTriangleEpsilon), _CMP_GE_OQ);
+	hit = _mm256_and_ps(hit, _mm256_cmp_ps(laneU, zero, _CMP_GE_OQ));
+	hit = _mm256_and_ps(hit, _mm256_cmp_ps(laneV, zero, _CMP_GE_OQ));
+	hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_add_ps(laneU, laneV), one, _CMP_LE_OQ));
+	hit = _mm256_and_ps(hit, _mm256_cmp_ps(laneDistance, zero, _CMP_GE_OQ));
+	hit = _mm256_and_ps(hit, _mm256_cmp_ps(laneDistance, _mm256_set1_ps(maxDistance), _CMP_LT_OQ));
+	uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(hit));
+	if (mask == 0) {
+		return -1;
+	}
+
+	alignas(32) float distances[8];
+	alignas(32) float us[8];
+	alignas(32) float vs[8];
+	_mm256_store_ps(distances, laneDistance);
+	_mm256_store_ps(us, laneU);
+	_mm256_store_ps(vs, laneV);
+	int hitLane = -1;
+	while (mask != 0) {
+		const uint32_t lane = std::countr_zero(mask);
+		mask &= mask - 1;
+		if (distances[lane] < maxDistance) {
+			maxDistance = distances[lane];
+			distance = distances[lane];
+			u = us[lane];
+			v = vs[lane];
+			hitLane = int(lane);
+		}
+	}
+	return hitLane;
+}
+
+#endif // MATH_SIMD_X86
+
+/// <summary>
+/// パケットの三角形とレイの交差判定（使える SIMD の命令で）
+/// </summary>
+/// <returns>一番近く当たった枠の番号。当たらなければ -1</returns>
+inline int IntersectRayTrianglePacket(const Ray& ray, const TrianglePacket& packet, float maxDistance, float& distance, float& u, float& v)
+{
+#if defined(MATH_SIMD_X86)
+	if (gMathKernels.backend == MathBackend::AVX2) {
+		return IntersectRayTrianglePacketAVX2(ray, packet, maxDistance, distance, u, v);
+	}
+	if (gMathKernels.backend == MathBackend::SSE41) {
+		return IntersectRayTrianglePacketSSE41(ray, packet, maxDistance, distance, u, v);
+	}
+#endif
+	return IntersectRayTrianglePacketScalar(ray, packet, maxDistance, distance, u, v);
+}
+
+/// <summary>
+/// レイとメッシュの三角形の交差判定。一番近く当たった三角形と、その位置の重心座標・UV を返す
+/// </summary>
+/// <param name="ray">モデル空間のレイ</param>
+/// <param name="maxDistance">これより遠い交差は無視する</param>
+/// <param name="hit">当たった三角形の情報の書き込み先</param>
+/// <returns>当たったら true</returns>
+inline bool RaycastMesh(const MeshTriangleBvh& triangleBvh, const MeshData& mesh, const Ray& ray, float maxDistance, RayTriangleHit& hit)
+{
+	float u = 0.0f;
+	float v = 0.0f;
+	float hitDistance = 0.0f;
+	const uint32_t triangle = RaycastBvh(triangleBvh.bvh, ray, hitDistance, [&](uint32_t nodeIndex, const Ray& leafRay, float leafMaxDistance, float& distance, uint32_t& item) {
+		const TrianglePacket& packet = triangleBvh.packets[triangleBvh.leafPackets[nodeIndex]];
+		float leafU = 0.0f;
+		float leafV = 0.0f;
+		const int lane = IntersectRayTrianglePacket(leafRay, packet, std::min(leafMaxDistance, maxDistance), distance, leafU, leafV);
+		if (lane < 0) {
+			return false;
+		}
+		item = packet.triangles[lane];
+		u = leafU;
+		v = leafV;
+		return true;
+	});
+	if (triangle == UINT32_MAX) {
+		return false;
+	}
+
+	const Vector2& texcoord0 = mesh.vertices[mesh.indices[triangle * 3 + 0]].texcoord;
+	const Vector2& texcoord1 = mesh.vertices[mesh.indices[triangle * 3 + 1]].texcoord;
+	const Vector2& texcoord2 = mesh.vertices[mesh.indices[triangle * 3 + 2]].texcoord;
+	const float w = 1.0f - u - v;
+	hit.triangle = triangle;
+	hit.distance = hitDistance;
+	hit.u = u;
+	hit.v = v;
+	hit.texcoord = { texcoord0.x * w + texcoord1.x * u + texcoord2.x * v, texcoord0.y * w + texcoord1.y * u + texcoord2.y * v };
+	return true;
+}
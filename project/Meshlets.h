@@ -0,0 +1,244 @@
+#pragma once
+// メッシュレット（インデックスが連続した小さな三角形の塊）への分割と、メッシュレット単位の視錐台カリング・法線コーンによる背面カリング。
+// Windows のヘッダーに依存しないので、tests/ の Linux 向けのテストからもそのまま使う
+#include "MeshData.h"
+#include "DrawList.h"
+#include "FrustumCulling.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// メッシュレット1つあたりの頂点数と三角形数の上限
+const uint32_t kMeshletMaxVertices = 64;
+const uint32_t kMeshletMaxTriangles = 124;
+
+/// <summary>
+/// メッシュレットのバウンディングスフィアと法線コーンを求める
+/// </summary>
+/// <param name="mesh">メッシュ</param>
+/// <param name="meshlet">インデックスの範囲が決まっているメッシュレット。境界を書き込む</param>
+inline void ComputeMeshletBounds(const MeshData& mesh, Meshlet& meshlet)
+{
+	auto position = [&mesh, &meshlet](uint32_t corner) {
+		const Vector4& p = mesh.vertices[mesh.indices[meshlet.indexOffset + corner]].position;
+		return Vector3{ p.x, p.y, p.z };
+	};
+	auto distanceSquared = [](const Vector3& a, const Vector3& b) {
+		return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z);
+	};
+	auto dot = [](const Vector3& a, const Vector3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; };
+
+	// Ritter の方法で、遠い2点を直径とした球から始めて全点を含むまで広げる
+	Vector3 first = position(0);
+	Vector3 second = first;
+	for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+		if (distanceSquared(position(i), first) > distanceSquared(second, first)) {
+			second = position(i);
+		}
+	}
+	Vector3 third = second;
+	for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+		if (distanceSquared(position(i), second) > distanceSquared(third, second)) {
+			third = position(i);
+		}
+	}
+	Vector3 center = { (second.x + third.x) * 0.5f, (second.y + third.y) * 0.5f, (second.z + third.z) * 0.5f };
+	float radius = sqrtf(distanceSquared(second, third)) * 0.5f;
+	for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+		const Vector3 p = position(i);
+		const float distance = sqrtf(distanceSquared(p, center));
+		if (distance > radius) {
+			const float newRadius = (radius + distance) * 0.5f;
+			const float k = (newRadius - radius) / distance;
+			center = { center.x + (p.x - center.x) * k, center.y + (p.y - center.y) * k, center.z + (p.z - center.z) * k };
+			radius = newRadius;
+		}
+	}
+	meshlet.center = center;
+	meshlet.radius = radius;
+
+	// 三角形の面の向き（外向き）を集める
+	std::vector<Vector3> normals;
+	normals.reserve(meshlet.indexCount / 3);
+	Vector3 axis{ 0.0f, 0.0f, 0.0f };
+	for (uint32_t i = 0; i < meshlet.indexCount; i += 3) {
+		const Vector3 a = position(i);
+		const Vector3 b = position(i + 1);
+		const Vector3 c = position(i + 2);
+		const Vector3 ab{ b.x - a.x, b.y - a.y, b.z - a.z };
+		const Vector3 ac{ c.x - a.x, c.y - a.y, c.z - a.z };
+		const Vector3 normal = Normalize(Vector3{ ab.y * ac.z - ab.z * ac.y, ab.z * ac.x - ab.x * ac.z, ab.x * ac.y - ab.y * ac.x });
+		if (dot(normal, normal) == 0.0f) {
+			continue; // 面積の無い三角形は向きを持たない
+		}
+		normals.push_back(normal);
+		axis = { axis.x + normal.x, axis.y + normal.y, axis.z + normal.z };
+	}
+
+	// 背面カリングできないときは cutoff を 1 にしておく
+	meshlet.coneApex = center;
+	meshlet.coneAxis = Normalize(axis);
+	meshlet.coneCutoff = 1.0f;
+	if (normals.empty() || dot(meshlet.coneAxis, meshlet.coneAxis) == 0.0f) {
+		return;
+	}
+
+	float minimumDot = 1.0f;
+	for (const Vector3& normal : normals) {
+		minimumDot = std::min(minimumDot, dot(normal, meshlet.coneAxis));
+	}
+	// 面の向きがほぼ90度以上ばらついていると、どこから見ても表の面が残る
+	if (minimumDot <= 0.1f) {
+		return;
+	}
+
+	// すべての三角形の平面の裏側にある点をコーンの頂点にする
+	float maximumT = 0.0f;
+	for (uint32_t i = 0, n = 0; i < meshlet.indexCount; i += 3) {
+		const Vector3 a = position(i);
+		const Vector3 b = position(i + 1);
+		const Vector3 c = position(i + 2);
+		const Vector3 ab{ b.x - a.x, b.y - a.y, b.z - a.z };
+		const Vector3 ac{ c.x - a.x, c.y - a.y, c.z - a.z };
+		const Vector3 cross{ ab.y * ac.z - ab.z * ac.y, ab.z * ac.x - ab.x * ac.z, ab.x * ac.y - ab.y * ac.x };
+		if (dot(cross, cross) == 0.0f) {
+			continue;
+		}
+		const Vector3& normal = normals[n++];
+		const float t = dot({ center.x - a.x, center.y - a.y, center.z - a.z }, normal) / dot(meshlet.coneAxis, normal);
+		maximumT = std::max(maximumT, t);
+	}
+	meshlet.coneApex = { center.x - meshlet.coneAxis.x * maximumT, center.y - meshlet.coneAxis.y * maximumT, center.z - meshlet.coneAxis.z * maximumT };
+	meshlet.coneCutoff = sqrtf(1.0f - minimumDot * minimumDot);
+}
+
+/// <summary>
+/// メッシュを、インデックスが連続した範囲になるメッシュレットに分ける。
+/// 三角形の順番は変えないので、頂点キャッシュ最適化の後に呼ぶと近い三角形同士がまとまる
+/// </summary>
+/// <param name="mesh">分けるメッシュ。結果は mesh.meshlets に入る</param>
+/// <param name="maxVertices">メッシュレット1つあたりの頂点数の上限</param>
+/// <param name="maxTriangles">メッシュレット1つあたりの三角形数の上限</param>
+inline void BuildMeshlets(MeshData& mesh, uint32_t maxVertices = kMeshletMaxVertices, uint32_t maxTriangles = kMeshletMaxTriangles)
+{
+	mesh.meshlets.clear();
+	if (mesh.indices.empty()) {
+		return;
+	}
+
+	// 頂点ごとに、最後に使ったメッシュレットの番号を覚えておく
+	std::vector<uint32_t> lastMeshlet(mesh.vertices.size(), 0xFFFFFFFF);
+	uint32_t meshletIndex = 0;
+	Meshlet meshlet{};
+
+	for (size_t i = 0; i + 3 <= mesh.indices.size(); i += 3) {
+		const uint32_t a = mesh.indices[i + 0];
+		const uint32_t b = mesh.indices[i + 1];
+		const uint32_t c = mesh.indices[i + 2];
+		uint32_t newVertexCount = (lastMeshlet[a] != meshletIndex) +
+			(lastMeshlet[b] != meshletIndex && b != a) +
+			(lastMeshlet[c] != meshletIndex && c != a && c != b);
+
+		if (meshlet.vertexCount + newVertexCount > maxVertices || meshlet.indexCount / 3 >= maxTriangles) {
+			mesh.meshlets.push_back(meshlet);
+			++meshletIndex;
+			meshlet = {};
+			meshlet.indexOffset = static_cast<uint32_t>(i);
+			newVertexCount = 1 + (b != a) + (c != a && c != b);
+		}
+
+		lastMeshlet[a] = lastMeshlet[b] = lastMeshlet[c] = meshletIndex;
+		meshlet.vertexCount += newVertexCount;
+		meshlet.indexCount += 3;
+	}
+	mesh.meshlets.push_back(meshlet);
+
+	for (Meshlet& m : mesh.meshlets) {
+		ComputeMeshletBounds(mesh, m);
+	}
+}
+
+/// <summary>
+/// メッシュを囲む箱と球を頂点から求める
+/// </summary>
+inline void ComputeMeshBounds(MeshData& mesh)
+{
+	if (mesh.vertices.empty()) {
+		mesh.bounds = {};
+		return;
+	}
+
+	Vector3 minimum{ FLT_MAX, FLT_MAX, FLT_MAX };
+	Vector3 maximum{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (const VertexData& vertex : mesh.vertices) {
+		minimum = { std::min(minimum.x, vertex.position.x), std::min(minimum.y, vertex.position.y), std::min(minimum.z, vertex.position.z) };
+		maximum = { std::max(maximum.x, vertex.position.x), std::max(maximum.y, vertex.position.y), std::max(maximum.z, vertex.position.z) };
+	}
+	mesh.bounds.center = { (minimum.x + maximum.x) * 0.5f, (minimum.y + maximum.y) * 0.5f, (minimum.z + maximum.z) * 0.5f };
+	mesh.bounds.extent = { (maximum.x - minimum.x) * 0.5f, (maximum.y - minimum.y) * 0.5f, (maximum.z - minimum.z) * 0.5f };
+
+	// 球は箱の中心を中心にして、一番遠い頂点までを半径にする（箱の対角線より小さくなることが多い）
+	float radiusSquared = 0.0f;
+	for (const VertexData& vertex : mesh.vertices) {
+		const float dx = vertex.position.x - mesh.bounds.center.x;
+		const float dy = vertex.position.y - mesh.bounds.center.y;
+		const float dz = vertex.position.z - mesh.bounds.center.z;
+		radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+	}
+	mesh.bounds.radius = sqrtf(radiusSquared);
+}
+
+// メッシュレットのカリング結果
+struct MeshletCullStatistics
+{
+	uint32_t totalTriangles;
+	uint32_t frustumCulledTriangles;  // 視錐台の外で捨てた三角形
+	uint32_t backfaceCulledTriangles; // 法線コーンで裏向きと分かって捨てた三角形
+};
+
+/// <summary>
+/// メッシュレット単位で視錐台カリングと背面カリングを行い、描画するインデックスの範囲を作る。
+/// 隣り合った見えるメッシュレットは1つの範囲にまとめる
+/// </summary>
+/// <param name="mesh">メッシュ</param>
+/// <param name="frustum">モデル空間の視錐台</param>
+/// <param name="cameraPosition">モデル空間のカメラの位置</param>
+/// <param name="drawRanges">描画する範囲の追加先</param>
+/// <param name="statistics">カリング結果の加算先</param>
+inline void CullMeshlets(const MeshData& mesh, const Frustum& frustum, const Vector3& cameraPosition, std::vector<IndexRange>& drawRanges, MeshletCullStatistics& statistics)
+{
+	statistics.totalTriangles += static_cast<uint32_t>(mesh.indices.size() / 3);
+
+	// メッシュレットを作っていないメッシュはそのまま全部描く
+	if (mesh.meshlets.empty()) {
+		if (!mesh.indices.empty()) {
+			drawRanges.push_back({ 0, static_cast<uint32_t>(mesh.indices.size()) });
+		}
+		return;
+	}
+
+	const size_t firstRange = drawRanges.size();
+	for (const Meshlet& meshlet : mesh.meshlets) {
+		if (!IsSphereInFrustum(frustum, meshlet.center, meshlet.radius)) {
+			statistics.frustumCulledTriangles += meshlet.indexCount / 3;
+			continue;
+		}
+
+		// コーンの頂点から見てカメラがコーンの裏側の範囲にあれば、すべての三角形が裏を向いている
+		if (meshlet.coneCutoff < 1.0f) {
+			const Vector3 view = Normalize(Vector3{ meshlet.coneApex.x - cameraPosition.x, meshlet.coneApex.y - cameraPosition.y, meshlet.coneApex.z - cameraPosition.z });
+			if (view.x * meshlet.coneAxis.x + view.y * meshlet.coneAxis.y + view.z * meshlet.coneAxis.z >= meshlet.coneCutoff) {
+				statistics.backfaceCulledTriangles += meshlet.indexCount / 3;
+				continue;
+			}
+		}
+
+		if (drawRanges.size() > firstRange && drawRanges.back().indexOffset + drawRanges.back().indexCount == meshlet.indexOffset) {
+			drawRanges.back().indexCount += meshlet.indexCount;
+		} else {
+			drawRanges.push_back({ meshlet.indexOffset, meshlet.indexCount });
+		}
+	}
+}
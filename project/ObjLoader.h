@@ -0,0 +1,875 @@
+#pragma once
+// OBJ ファイルの読み込み（メモリマップしたテキストをその場で解析し、大きいファイルはワーカープールで並列に解析する）。
+// メモリマップは Windows では CreateFileMapping、それ以外では mmap を使うので、tests/ の Linux 向けのテストからもそのまま使う
+#include "MeshData.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// <summary>
+/// 読み取り専用でメモリマップしたファイル
+/// </summary>
+struct MappedFile
+{
+#if defined(_WIN32)
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int file = -1;                  // ファイルディスクリプタ
+#endif
+	const char* data = nullptr;
+	size_t size = 0;
+};
+
+/// <summary>
+/// ファイルを開けたか（空のファイルは開けても data が nullptr で size が 0 になる）
+/// </summary>
+inline bool IsFileMapped(const MappedFile& mappedFile)
+{
+#if defined(_WIN32)
+	return mappedFile.file != INVALID_HANDLE_VALUE;
+#else
+	return mappedFile.file >= 0;
+#endif
+}
+
+/// <summary>
+/// ファイルを読み取り専用でメモリマップする
+/// </summary>
+/// <param name="filePath">マップするファイルのパス</param>
+/// <returns>マップしたファイル。開けなかった場合は IsFileMapped が false になる</returns>
+inline MappedFile MapFileReadOnly(const std::string& filePath)
+{
+	MappedFile mappedFile{};
+#if defined(_WIN32)
+	mappedFile.file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (mappedFile.file == INVALID_HANDLE_VALUE) {
+		return mappedFile;
+	}
+
+	LARGE_INTEGER fileSize{};
+	GetFileSizeEx(mappedFile.file, &fileSize);
+	mappedFile.size = static_cast<size_t>(fileSize.QuadPart);
+
+	// 空のファイルはマップできないので、サイズ0のまま返す
+	if (mappedFile.size == 0) {
+		return mappedFile;
+	}
+
+	mappedFile.mapping = CreateFileMappingA(mappedFile.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	assert(mappedFile.mapping != nullptr);
+	mappedFile.data = static_cast<const char*>(MapViewOfFile(mappedFile.mapping, FILE_MAP_READ, 0, 0, 0));
+	assert(mappedFile.data != nullptr);
+#else
+	mappedFile.file = open(filePath.c_str(), O_RDONLY);
+	if (mappedFile.file < 0) {
+		return mappedFile;
+	}
+
+	struct stat fileStatus{};
+	fstat(mappedFile.file, &fileStatus);
+	mappedFile.size = static_cast<size_t>(fileStatus.st_size);
+
+	// 空のファイルはマップできないので、サイズ0のまま返す
+	if (mappedFile.size == 0) {
+		return mappedFile;
+	}
+
+	void* data = mmap(nullptr, mappedFile.size, PROT_READ, MAP_PRIVATE, mappedFile.file, 0);
+	assert(data != MAP_FAILED);
+	// 前から順に読むことを伝えて、先読みを増やしてもらう（FILE_FLAG_SEQUENTIAL_SCAN と同じ）
+	madvise(data, mappedFile.size, MADV_SEQUENTIAL);
+	mappedFile.data = static_cast<const char*>(data);
+#endif
+	return mappedFile;
+}
+
+// メモリマップの解放
+inline void UnmapFile(MappedFile* mappedFile)
+{
+#if defined(_WIN32)
+	if (mappedFile->data) {
+		UnmapViewOfFile(mappedFile->data);
+	}
+	if (mappedFile->mapping) {
+		CloseHandle(mappedFile->mapping);
+	}
+	if (mappedFile->file != INVALID_HANDLE_VALUE) {
+		CloseHandle(mappedFile->file);
+	}
+#else
+	if (mappedFile->data) {
+		munmap(const_cast<char*>(mappedFile->data), mappedFile->size);
+	}
+	if (mappedFile->file >= 0) {
+		close(mappedFile->file);
+	}
+#endif
+	*mappedFile = MappedFile{};
+}
+
+// 改行以外の空白を読み飛ばす
+inline const char* SkipObjSpaces(const char* p, const char* end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+		++p;
+	}
+	return p;
+}
+
+// 次の空白までを1トークンとして読み飛ばす
+inline const char* SkipObjToken(const char* p, const char* end)
+{
+	while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+		++p;
+	}
+	return p;
+}
+
+inline bool IsObjDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+/// <summary>
+/// 文字列から float を読む（ストリームもstd::stringも使わない）
+/// </summary>
+/// <param name="p">読み始める位置</param>
+/// <param name="end">行の終わり</param>
+/// <param name="out">読んだ値の書き込み先</param>
+/// <returns>読み終えた位置。数値が無かった場合は p をそのまま返す</returns>
+inline const char* ParseObjFloat(const char* p, const char* end, float& out)
+{
+	// 10^0 ～ 10^22 は double で正確に表せる
+	static const double kPow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	const char* start = SkipObjSpaces(p, end);
+	const char* cursor = start;
+	bool negative = false;
+	if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+		negative = (*cursor == '-');
+		++cursor;
+	}
+
+	uint64_t mantissa = 0;
+	int32_t significantDigits = 0;
+	int32_t exponent = 0;
+	bool hasDigits = false;
+	bool truncated = false;
+
+	// 整数部
+	while (cursor < end && IsObjDigit(*cursor)) {
+		hasDigits = true;
+		if (significantDigits < 19) {
+			mantissa = mantissa * 10 + static_cast<uint64_t>(*cursor - '0');
+			if (mantissa != 0) {
+				++significantDigits;
+			}
+		} else {
+			++exponent;
+			truncated = true;
+		}
+		++cursor;
+	}
+
+	// 小数部
+	if (cursor < end && *cursor == '.') {
+		++cursor;
+		while (cursor < end && IsObjDigit(*cursor)) {
+			hasDigits = true;
+			if (significantDigits < 19) {
+				mantissa = mantissa * 10 + static_cast<uint64_t>(*cursor - '0');
+				if (mantissa != 0) {
+					++significantDigits;
+				}
+				--exponent;
+			} else {
+				truncated = true;
+			}
+			++cursor;
+		}
+	}
+
+	if (!hasDigits) {
+		return p;
+	}
+
+	// 指数部
+	if (cursor < end && (*cursor == 'e' || *cursor == 'E')) {
+		const char* exponentCursor = cursor + 1;
+		bool negativeExponent = false;
+		if (exponentCursor < end && (*exponentCursor == '-' || *exponentCursor == '+')) {
+			negativeExponent = (*exponentCursor == '-');
+			++exponentCursor;
+		}
+		if (exponentCursor < end && IsObjDigit(*exponentCursor)) {
+			int32_t value = 0;
+			while (exponentCursor < end && IsObjDigit(*exponentCursor)) {
+				if (value < 10000) {
+					value = value * 10 + (*exponentCursor - '0');
+				}
+				++exponentCursor;
+			}
+			exponent += negativeExponent ? -value : value;
+			cursor = exponentCursor;
+		}
+	}
+
+	// 仮数が2^53以下で指数が±22以内なら double の1回の乗除算で正確に求まる
+	if (!truncated && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+		double value = static_cast<double>(mantissa);
+		value = (exponent < 0) ? value / kPow10[-exponent] : value * kPow10[exponent];
+		out = static_cast<float>(negative ? -value : value);
+		return cursor;
+	}
+
+	// 桁が多すぎる値はまれなので標準の変換に任せる
+	const char* fallbackStart = (*start == '+') ? start + 1 : start;
+	float value = 0.0f;
+	std::from_chars(fallbackStart, cursor, value);
+	out = value;
+	return cursor;
+}
+
+/// <summary>
+/// 文字列から符号付き整数を読む。int32_t に収まらない値は ±INT32_MAX にする（インデックスとしては必ず範囲外になる）
+/// </summary>
+/// <returns>読み終えた位置。数値が無かった場合は p をそのまま返す</returns>
+inline const char* ParseObjInt(const char* p, const char* end, int32_t& out)
+{
+	const char* cursor = p;
+	bool negative = false;
+	if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+		negative = (*cursor == '-');
+		++cursor;
+	}
+	if (cursor >= end || !IsObjDigit(*cursor)) {
+		return p;
+	}
+
+	int64_t value = 0;
+	while (cursor < end && IsObjDigit(*cursor)) {
+		value = (std::min)(value * 10 + (*cursor - '0'), int64_t(INT32_MAX));
+		++cursor;
+	}
+	out = static_cast<int32_t>(negative ? -value : value);
+	return cursor;
+}
+
+/// <summary>
+/// 面の頂点定義（v, v/vt, v//vn, v/vt/vn）を読む
+/// </summary>
+/// <param name="elementIndices">位置・UV・法線のインデックス。省略された要素は0になる</param>
+/// <returns>読み終えた位置。頂点定義が無かった場合は p をそのまま返す</returns>
+inline const char* ParseObjFaceVertex(const char* p, const char* end, int32_t elementIndices[3])
+{
+	elementIndices[0] = 0;
+	elementIndices[1] = 0;
+	elementIndices[2] = 0;
+
+	const char* cursor = SkipObjSpaces(p, end);
+	const char* next = ParseObjInt(cursor, end, elementIndices[0]);
+	if (next == cursor) {
+		return p;
+	}
+	cursor = next;
+
+	for (int32_t element = 1; element < 3; ++element) {
+		if (cursor >= end || *cursor != '/') {
+			break;
+		}
+		++cursor;
+		cursor = ParseObjInt(cursor, end, elementIndices[element]);
+	}
+	return cursor;
+}
+
+// OBJのインデックス（1始まり、負数は末尾からの相対）を0始まりに直す。IsObjIndexInRange で確かめてから使うこと
+inline size_t ResolveObjIndex(int32_t index, size_t count)
+{
+	return (index < 0) ? count - static_cast<size_t>(-int64_t(index)) : static_cast<size_t>(index) - 1;
+}
+
+// OBJのインデックスが count 個の要素のどれかを指しているか（0 と、先頭より前・末尾より後ろを指すものは範囲外）
+inline bool IsObjIndexInRange(int32_t index, size_t count)
+{
+	return (index > 0) ? size_t(index) <= count : (index < 0 && size_t(-int64_t(index)) <= count);
+}
+
+// 面の頂点定義を識別するキー。UVと法線は省略時 0、それ以外は 1 始まり
+struct ObjVertexKey
+{
+	uint32_t mesh;
+	uint32_t position;
+	uint32_t texcoord;
+	uint32_t normal;
+
+	bool operator==(const ObjVertexKey& other) const {
+		return mesh == other.mesh && position == other.position && texcoord == other.texcoord && normal == other.normal;
+	}
+};
+
+inline size_t HashObjVertexKey(const ObjVertexKey& key)
+{
+	uint64_t hash = key.position * 0x9E3779B97F4A7C15ull;
+	hash ^= (key.texcoord + 0x7F4A7C15ull) * 0xC2B2AE3D27D4EB4Full;
+	hash ^= (key.normal + 0x165667B1ull) * 0x165667B19E3779F9ull;
+	hash ^= key.mesh * 0x27D4EB2F165667C5ull;
+	return static_cast<size_t>(hash ^ (hash >> 29));
+}
+
+/// <summary>
+/// ObjVertexKey → 値 を引くオープンアドレス法のハッシュ表
+/// </summary>
+class ObjVertexTable
+{
+public:
+	ObjVertexTable()
+	{
+		keys_.assign(kInitialCapacity, ObjVertexKey{ kEmpty, 0, 0, 0 });
+		values_.assign(kInitialCapacity, 0);
+	}
+
+	/// <summary>
+	/// キーを探し、無ければ value で登録する
+	/// </summary>
+	/// <returns>見つかった、または登録した値</returns>
+	uint32_t FindOrInsert(const ObjVertexKey& key, uint32_t value)
+	{
+		// 使用率が半分を超えたら広げる
+		if ((count_ + 1) * 2 > keys_.size()) {
+			Grow();
+		}
+
+		const size_t mask = keys_.size() - 1;
+		size_t slot = HashObjVertexKey(key) & mask;
+		while (keys_[slot].mesh != kEmpty) {
+			if (keys_[slot] == key) {
+				return values_[slot];
+			}
+			slot = (slot + 1) & mask;
+		}
+
+		keys_[slot] = key;
+		values_[slot] = value;
+		++count_;
+		return value;
+	}
+
+private:
+	static constexpr uint32_t kEmpty = 0xFFFFFFFFu;
+	static constexpr size_t kInitialCapacity = 1024;
+
+	void Grow()
+	{
+		std::vector<ObjVertexKey> oldKeys = std::move(keys_);
+		std::vector<uint32_t> oldValues = std::move(values_);
+		keys_.assign(oldKeys.size() * 2, ObjVertexKey{ kEmpty, 0, 0, 0 });
+		values_.assign(oldKeys.size() * 2, 0);
+
+		const size_t mask = keys_.size() - 1;
+		for (size_t i = 0; i < oldKeys.size(); ++i) {
+			if (oldKeys[i].mesh == kEmpty) {
+				continue;
+			}
+			size_t slot = HashObjVertexKey(oldKeys[i]) & mask;
+			while (keys_[slot].mesh != kEmpty) {
+				slot = (slot + 1) & mask;
+			}
+			keys_[slot] = oldKeys[i];
+			values_[slot] = oldValues[i];
+		}
+	}
+
+	std::vector<ObjVertexKey> keys_;
+	std::vector<uint32_t> values_;
+	size_t count_ = 0;
+};
+
+// 負のインデックス（相対指定）の補正情報
+struct ObjRelativeIndex
+{
+	size_t slot;          // faceIndices 内の位置
+	size_t localCount;    // その時点でチャンク内に読まれていた要素数
+};
+
+// o / g によるメッシュの区切り
+struct ObjMeshBoundary
+{
+	std::string name;
+	size_t faceIndex;     // この区切りより前にチャンク内で読まれていた面の数
+};
+
+/// <summary>
+/// OBJテキストの一部（行単位で区切ったチャンク）を解析した結果
+/// </summary>
+struct ObjChunkData
+{
+	std::vector<Vector4> positions;
+	std::vector<Vector2> texcoords;
+	std::vector<Vector3> normals;
+	std::vector<int32_t> faceIndices;         // 面の頂点ごとに (位置, UV, 法線) のOBJインデックス。省略は0
+	std::vector<uint32_t> faceCornerCounts;   // 面ごとの頂点数
+	std::vector<ObjRelativeIndex> relativeIndices;
+	std::vector<ObjMeshBoundary> meshBoundaries;
+
+	// 以下は結合時に求める
+	size_t cornerOffset = 0;                  // ファイル全体での最初の面頂点の番号
+	std::vector<std::pair<size_t, uint32_t>> meshStarts;  // (面の番号, メッシュ番号) の切り替わり
+};
+
+/// <summary>
+/// OBJテキストのチャンクから v / vt / vn / f / o / g を読み出す
+/// </summary>
+/// <param name="begin">チャンクの先頭（行の先頭であること）</param>
+/// <param name="end">チャンクの終わり（行の終わりであること）</param>
+/// <param name="chunk">読み出した結果の書き込み先</param>
+inline void ParseObjChunk(const char* begin, const char* end, ObjChunkData& chunk)
+{
+	const char* lineStart = begin;
+	while (lineStart < end) {
+		const char* lineEnd = static_cast<const char*>(memchr(lineStart, '\n', static_cast<size_t>(end - lineStart)));
+		if (lineEnd == nullptr) {
+			lineEnd = end;
+		}
+
+		const char* identifier = SkipObjSpaces(lineStart, lineEnd);
+		const char* cursor = SkipObjToken(identifier, lineEnd);
+		const size_t identifierLength = static_cast<size_t>(cursor - identifier);
+
+		if (identifierLength == 1 && identifier[0] == 'v') {
+			Vector4 position = { 0.0f, 0.0f, 0.0f, 1.0f };
+			cursor = ParseObjFloat(cursor, lineEnd, position.x);
+			cursor = ParseObjFloat(cursor, lineEnd, position.y);
+			cursor = ParseObjFloat(cursor, lineEnd, position.z);
+			chunk.positions.push_back(position);
+		} else if (identifierLength == 2 && identifier[0] == 'v' && identifier[1] == 't') {
+			Vector2 texcoord = { 0.0f, 0.0f };
+			cursor = ParseObjFloat(cursor, lineEnd, texcoord.x);
+			cursor = ParseObjFloat(cursor, lineEnd, texcoord.y);
+			texcoord.y = 1.0f - texcoord.y;
+			chunk.texcoords.push_back(texcoord);
+		} else if (identifierLength == 2 && identifier[0] == 'v' && identifier[1] == 'n') {
+			Vector3 normal = { 0.0f, 0.0f, 0.0f };
+			cursor = ParseObjFloat(cursor, lineEnd, normal.x);
+			cursor = ParseObjFloat(cursor, lineEnd, normal.y);
+			cursor = ParseObjFloat(cursor, lineEnd, normal.z);
+			chunk.normals.push_back(normal);
+		} else if (identifierLength == 1 && identifier[0] == 'f') {
+			const size_t localCounts[3] = { chunk.positions.size(), chunk.texcoords.size(), chunk.normals.size() };
+			uint32_t cornerCount = 0;
+			while (true) {
+				int32_t elementIndices[3];
+				const char* next = ParseObjFaceVertex(cursor, lineEnd, elementIndices);
+				if (next == cursor) {
+					break;
+				}
+				cursor = next;
+
+				for (int32_t element = 0; element < 3; ++element) {
+					// 負のインデックスは、チャンクの開始位置が分かる結合時に補正する
+					if (elementIndices[element] < 0) {
+						chunk.relativeIndices.push_back({ chunk.faceIndices.size(), localCounts[element] });
+					}
+					chunk.faceIndices.push_back(elementIndices[element]);
+				}
+				++cornerCount;
+			}
+			chunk.faceCornerCounts.push_back(cornerCount);
+		} else if (identifierLength == 1 && (identifier[0] == 'o' || identifier[0] == 'g')) {
+			const char* nameStart = SkipObjSpaces(cursor, lineEnd);
+			const char* nameEnd = SkipObjToken(nameStart, lineEnd);
+			chunk.meshBoundaries.push_back({ std::string(nameStart, nameEnd), chunk.faceCornerCounts.size() });
+		}
+
+		lineStart = lineEnd + 1;
+	}
+}
+
+/// <summary>
+/// チャンクごとの解析結果を結合してモデルデータを作る
+/// </summary>
+/// <param name="chunks">ファイル内の順番に並んだチャンク</param>
+/// <param name="flipY">右手系から左手系へ変換するかどうか</param>
+/// <param name="workerPool">重複除去を分担させるワーカープール。nullptr なら呼び出したスレッドだけで処理する</param>
+/// <returns>結合したモデルデータ（スレッド数に関わらず同じ結果になる）</returns>
+inline ModelData BuildObjModel(std::vector<ObjChunkData>& chunks, bool flipY, WorkerPool* workerPool)
+{
+	auto parallelFor = [workerPool](size_t count, const std::function<void(size_t)>& function) {
+		if (workerPool) {
+			workerPool->ParallelFor(count, function);
+		} else {
+			for (size_t i = 0; i < count; ++i) {
+				function(i);
+			}
+		}
+	};
+
+	// 1. チャンクの開始位置を求めて、属性を1つの配列にまとめる
+	std::vector<Vector4> positions;
+	std::vector<Vector2> texcoords;
+	std::vector<Vector3> normals;
+	size_t cornerCount = 0;
+	for (ObjChunkData& chunk : chunks) {
+		const size_t offsets[3] = { positions.size(), texcoords.size(), normals.size() };
+
+		// 相対指定のインデックスを全体での1始まりのインデックスに直す
+		for (const ObjRelativeIndex& relative : chunk.relativeIndices) {
+			const size_t element = relative.slot % 3;
+			int32_t& index = chunk.faceIndices[relative.slot];
+			index = static_cast<int32_t>(offsets[element] + relative.localCount) + index + 1;
+		}
+
+		positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+		texcoords.insert(texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+		normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+	}
+
+	// 範囲外のインデックス（0・無い要素・桁あふれ）を含む面は、頂点の配列の外を読まないよう面ごと捨てる（チャンクごとに並列）。
+	// 三角形にならない頂点が 1・2 個の面も捨てるので、残る面はすべて三角形を1枚以上作る。
+	// 面の頂点は詰めて、面の数は o / g の区切りの位置が変わらないよう頂点数 0 の面として残す
+	parallelFor(chunks.size(), [&](size_t chunkIndex) {
+		ObjChunkData& chunk = chunks[chunkIndex];
+		int32_t* source = chunk.faceIndices.data();
+		int32_t* destination = source;
+		for (uint32_t& faceCornerCount : chunk.faceCornerCounts) {
+			bool isValid = (faceCornerCount >= 3);
+			for (uint32_t corner = 0; corner < faceCornerCount; ++corner) {
+				const int32_t* faceIndex = source + corner * 3;
+				isValid = isValid && IsObjIndexInRange(faceIndex[0], positions.size()) &&
+					(faceIndex[1] == 0 || IsObjIndexInRange(faceIndex[1], texcoords.size())) &&
+					(faceIndex[2] == 0 || IsObjIndexInRange(faceIndex[2], normals.size()));
+			}
+			if (isValid) {
+				std::memmove(destination, source, sizeof(int32_t) * faceCornerCount * 3);
+				destination += faceCornerCount * 3;
+			}
+			source += faceCornerCount * 3;
+			faceCornerCount = isValid ? faceCornerCount : 0;
+		}
+		chunk.faceIndices.resize(static_cast<size_t>(destination - chunk.faceIndices.data()));
+	});
+	for (ObjChunkData& chunk : chunks) {
+		chunk.cornerOffset = cornerCount;
+		cornerCount += chunk.faceIndices.size() / 3;
+	}
+
+	// 2. o / g の区切りからメッシュを決める。三角形を作る面の無い区切りは名前だけ差し替える
+	std::vector<std::string> meshNames = { "Default" };
+	bool currentMeshHasTriangles = false;
+	for (ObjChunkData& chunk : chunks) {
+		chunk.meshStarts.push_back({ 0, static_cast<uint32_t>(meshNames.size() - 1) });
+		size_t face = 0;
+		for (const ObjMeshBoundary& boundary : chunk.meshBoundaries) {
+			for (; face < boundary.faceIndex; ++face) {
+				currentMeshHasTriangles |= (chunk.faceCornerCounts[face] >= 3);
+			}
+			if (currentMeshHasTriangles) {
+				meshNames.push_back(boundary.name);
+				chunk.meshStarts.push_back({ boundary.faceIndex, static_cast<uint32_t>(meshNames.size() - 1) });
+				currentMeshHasTriangles = false;
+			} else {
+				meshNames.back() = boundary.name;
+			}
+		}
+		for (; face < chunk.faceCornerCounts.size(); ++face) {
+			currentMeshHasTriangles |= (chunk.faceCornerCounts[face] >= 3);
+		}
+	}
+
+	// 3. 面の頂点ごとにキーを作る（チャンクごとに並列）
+	std::vector<ObjVertexKey> cornerKeys(cornerCount);
+	parallelFor(chunks.size(), [&](size_t chunkIndex) {
+		const ObjChunkData& chunk = chunks[chunkIndex];
+		const int32_t* faceIndex = chunk.faceIndices.data();
+		ObjVertexKey* key = cornerKeys.data() + chunk.cornerOffset;
+		size_t meshStart = 0;
+		for (size_t face = 0; face < chunk.faceCornerCounts.size(); ++face) {
+			while (meshStart + 1 < chunk.meshStarts.size() && chunk.meshStarts[meshStart + 1].first == face) {
+				++meshStart;
+			}
+			const uint32_t mesh = chunk.meshStarts[meshStart].second;
+			for (uint32_t corner = 0; corner < chunk.faceCornerCounts[face]; ++corner, faceIndex += 3, ++key) {
+				key->mesh = mesh;
+				key->position = static_cast<uint32_t>(ResolveObjIndex(faceIndex[0], positions.size()));
+				key->texcoord = (faceIndex[1] != 0) ? static_cast<uint32_t>(ResolveObjIndex(faceIndex[1], texcoords.size()) + 1) : 0;
+				key->normal = (faceIndex[2] != 0) ? static_cast<uint32_t>(ResolveObjIndex(faceIndex[2], normals.size()) + 1) : 0;
+			}
+		}
+	});
+
+	// 4. キーのハッシュで担当を分け、担当ごとに並列で「同じキーが最初に現れた面頂点」を求める。
+	//    ハッシュを求めるのは1つの面頂点につき1回だけで、チャンクごとに（並列で）担当のリストへ振り分けておき、
+	//    担当はチャンクの順に自分のリストだけをなめる。各担当はファイルの順番どおりに見るので、結果はスレッド数に依存しない
+	const size_t chunkCount = chunks.size();
+	auto getChunkCornerEnd = [&](size_t chunkIndex) { return chunks[chunkIndex].cornerOffset + chunks[chunkIndex].faceIndices.size() / 3; };
+	const size_t shardCount = workerPool ? (std::max)(1u, workerPool->GetThreadCount()) : 1;
+	std::vector<uint32_t> firstCorner(cornerCount);
+	if (shardCount == 1) {
+		ObjVertexTable table;
+		for (size_t corner = 0; corner < cornerCount; ++corner) {
+			firstCorner[corner] = table.FindOrInsert(cornerKeys[corner], static_cast<uint32_t>(corner));
+		}
+	} else {
+		// 表の中の位置はハッシュの下位ビットで決まるので、担当は混ぜ直した上位ビットで決める
+		// （下位ビットで分けると、担当の表では一部の位置しか使われずに衝突が増える）
+		auto getShard = [shardCount](const ObjVertexKey& key) {
+			return static_cast<size_t>(((uint64_t(HashObjVertexKey(key)) * 0x9E3779B97F4A7C15ull) >> 32) % shardCount);
+		};
+		// chunkShardCorners[チャンク * shardCount + 担当] に、その担当の面頂点をファイルの順に並べる
+		std::vector<std::vector<uint32_t>> chunkShardCorners(chunkCount * shardCount);
+		parallelFor(chunkCount, [&](size_t chunkIndex) {
+			std::vector<uint32_t>* shardCorners = chunkShardCorners.data() + chunkIndex * shardCount;
+			for (size_t corner = chunks[chunkIndex].cornerOffset; corner < getChunkCornerEnd(chunkIndex); ++corner) {
+				shardCorners[getShard(cornerKeys[corner])].push_back(static_cast<uint32_t>(corner));
+			}
+		});
+		parallelFor(shardCount, [&](size_t shard) {
+			ObjVertexTable table;
+			for (size_t chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex) {
+				for (uint32_t corner : chunkShardCorners[chunkIndex * shardCount + shard]) {
+					firstCorner[corner] = table.FindOrInsert(cornerKeys[corner], corner);
+				}
+			}
+		});
+	}
+
+	// 5. 最初に現れた順にメッシュ内の頂点番号を振る。
+	//    チャンクごとにメッシュ別の新しい頂点の数を数え（並列）、チャンクの順に足して各チャンクの最初の番号を決めてから番号を振る（並列）
+	const size_t meshCount = meshNames.size();
+	ModelData modelData;
+	modelData.meshes.resize(meshCount);
+	// chunkMeshVertexBase[チャンク * meshCount + メッシュ]。数えた後で、そのチャンクの最初の番号に置き換える
+	std::vector<uint32_t> chunkMeshVertexBase(chunkCount * meshCount, 0);
+	parallelFor(chunkCount, [&](size_t chunkIndex) {
+		uint32_t* meshVertexCounts = chunkMeshVertexBase.data() + chunkIndex * meshCount;
+		for (size_t corner = chunks[chunkIndex].cornerOffset; corner < getChunkCornerEnd(chunkIndex); ++corner) {
+			if (firstCorner[corner] == corner) {
+				++meshVertexCounts[cornerKeys[corner].mesh];
+			}
+		}
+	});
+	std::vector<std::vector<uint32_t>> uniqueCorners(meshCount);
+	{
+		std::vector<uint32_t> meshVertexCounts(meshCount, 0);
+		for (size_t chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex) {
+			for (size_t mesh = 0; mesh < meshCount; ++mesh) {
+				uint32_t& base = chunkMeshVertexBase[chunkIndex * meshCount + mesh];
+				const uint32_t count = base;
+				base = meshVertexCounts[mesh];
+				meshVertexCounts[mesh] += count;
+			}
+		}
+		for (size_t mesh = 0; mesh < meshCount; ++mesh) {
+			uniqueCorners[mesh].resize(meshVertexCounts[mesh]);
+		}
+	}
+	std::vector<uint32_t> cornerVertex(cornerCount);
+	parallelFor(chunkCount, [&](size_t chunkIndex) {
+		std::vector<uint32_t> nextVertex(chunkMeshVertexBase.begin() + chunkIndex * meshCount, chunkMeshVertexBase.begin() + (chunkIndex + 1) * meshCount);
+		for (size_t corner = chunks[chunkIndex].cornerOffset; corner < getChunkCornerEnd(chunkIndex); ++corner) {
+			if (firstCorner[corner] == corner) {
+				const uint32_t mesh = cornerKeys[corner].mesh;
+				cornerVertex[corner] = nextVertex[mesh]++;
+				uniqueCorners[mesh][cornerVertex[corner]] = static_cast<uint32_t>(corner);
+			}
+		}
+	});
+	// 2回目以降に現れた面頂点は、最初に現れた面頂点（前のチャンクのこともある）の番号を使う
+	parallelFor(chunkCount, [&](size_t chunkIndex) {
+		for (size_t corner = chunks[chunkIndex].cornerOffset; corner < getChunkCornerEnd(chunkIndex); ++corner) {
+			if (firstCorner[corner] != corner) {
+				cornerVertex[corner] = cornerVertex[firstCorner[corner]];
+			}
+		}
+	});
+
+	// 6. 頂点を作る（メッシュごとに並列）
+	// 左手系への変換で使う回転（毎頂点で sin/cos を呼ばないように先に求めておく）
+	const float rad = 3.141592f;
+	const float flipCos = cosf(rad);
+	const float flipSin = sinf(rad);
+	parallelFor(meshNames.size(), [&](size_t meshIndex) {
+		MeshData& mesh = modelData.meshes[meshIndex];
+		mesh.name = meshNames[meshIndex];
+		mesh.vertices.resize(uniqueCorners[meshIndex].size());
+		for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+			const ObjVertexKey& key = cornerKeys[uniqueCorners[meshIndex][i]];
+			Vector4 position = positions[key.position];
+			Vector2 texcoord = { 0.0f, 0.0f };
+			Vector3 normal = { 0.0f, 0.0f, 0.0f };
+			if (key.texcoord != 0) {
+				texcoord = texcoords[key.texcoord - 1];
+			}
+			if (key.normal != 0) {
+				normal = normals[key.normal - 1];
+			}
+
+			if (flipY) {
+				position.x *= -1.0f;
+				normal.x *= -1.0f;
+
+				float x = position.x;
+				float z = position.z;
+				position.x = x * flipCos - z * flipSin;
+				position.z = x * flipSin + z * flipCos;
+			}
+
+			mesh.vertices[i] = { position, texcoord, normal, 0.0f };
+		}
+	});
+
+	// 7. 多角形は先頭の頂点を軸に扇状に三角形へ分割してインデックスを作る。
+	//    5 と同じように、チャンクごとにメッシュ別のインデックスの数を数えて書き込む位置を決めてから、並列に書き込む
+	std::vector<size_t> chunkMeshIndexBase(chunkCount * meshCount, 0);
+	parallelFor(chunkCount, [&](size_t chunkIndex) {
+		size_t* meshIndexCounts = chunkMeshIndexBase.data() + chunkIndex * meshCount;
+		size_t corner = chunks[chunkIndex].cornerOffset;
+		for (uint32_t faceCornerCount : chunks[chunkIndex].faceCornerCounts) {
+			if (faceCornerCount >= 3) {
+				meshIndexCounts[cornerKeys[corner].mesh] += size_t(faceCornerCount - 2) * 3;
+			}
+			corner += faceCornerCount;
+		}
+	});
+	{
+		std::vector<size_t> meshIndexCounts(meshCount, 0);
+		for (size_t chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex) {
+			for (size_t mesh = 0; mesh < meshCount; ++mesh) {
+				size_t& base = chunkMeshIndexBase[chunkIndex * meshCount + mesh];
+				const size_t count = base;
+				base = meshIndexCounts[mesh];
+				meshIndexCounts[mesh] += count;
+			}
+		}
+		for (size_t mesh = 0; mesh < meshCount; ++mesh) {
+			modelData.meshes[mesh].indices.resize(meshIndexCounts[mesh]);
+		}
+	}
+	parallelFor(chunkCount, [&](size_t chunkIndex) {
+		std::vector<size_t> nextIndex(chunkMeshIndexBase.begin() + chunkIndex * meshCount, chunkMeshIndexBase.begin() + (chunkIndex + 1) * meshCount);
+		size_t corner = chunks[chunkIndex].cornerOffset;
+		for (uint32_t faceCornerCount : chunks[chunkIndex].faceCornerCounts) {
+			if (faceCornerCount >= 3) {
+				const uint32_t mesh = cornerKeys[corner].mesh;
+				uint32_t* indices = modelData.meshes[mesh].indices.data() + nextIndex[mesh];
+				for (uint32_t i = 2; i < faceCornerCount; ++i) {
+					*indices++ = cornerVertex[corner + i];
+					*indices++ = cornerVertex[corner + i - 1];
+					*indices++ = cornerVertex[corner];
+				}
+				nextIndex[mesh] += size_t(faceCornerCount - 2) * 3;
+			}
+			corner += faceCornerCount;
+		}
+	});
+
+	// 三角形の無いメッシュは除く（空のインデックスバッファを作って描かないように）
+	std::erase_if(modelData.meshes, [](const MeshData& mesh) { return mesh.indices.empty(); });
+
+	return modelData;
+}
+
+/// <summary>
+/// メモリ上のOBJテキストを解析する
+/// </summary>
+/// <param name="begin">テキストの先頭</param>
+/// <param name="end">テキストの終わり</param>
+/// <param name="flipY">右手系から左手系へ変換するかどうか</param>
+/// <returns>解析したモデルデータ</returns>
+inline ModelData ParseObjText(const char* begin, const char* end, bool flipY)
+{
+	std::vector<ObjChunkData> chunks(1);
+	ParseObjChunk(begin, end, chunks[0]);
+	return BuildObjModel(chunks, flipY, nullptr);
+}
+
+/// <summary>
+/// OBJテキストを改行位置で分割し、ワーカープールで並列に解析する
+/// </summary>
+/// <param name="begin">テキストの先頭</param>
+/// <param name="end">テキストの終わり</param>
+/// <param name="flipY">右手系から左手系へ変換するかどうか</param>
+/// <param name="workerPool">解析に使うワーカープール</param>
+/// <param name="chunkCount">分割数</param>
+/// <returns>解析したモデルデータ。ParseObjText と同じ結果になる</returns>
+inline ModelData ParseObjTextParallel(const char* begin, const char* end, bool flipY, WorkerPool& workerPool, uint32_t chunkCount)
+{
+	const size_t size = static_cast<size_t>(end - begin);
+	chunkCount = (std::max)(1u, chunkCount);
+
+	// おおよそ等分した位置から次の改行の直後までずらして、行の途中で切らないようにする
+	std::vector<const char*> splits;
+	splits.push_back(begin);
+	for (uint32_t i = 1; i < chunkCount; ++i) {
+		const char* split = begin + size / chunkCount * i;
+		if (split <= splits.back()) {
+			continue;
+		}
+		const char* newline = static_cast<const char*>(memchr(split, '\n', static_cast<size_t>(end - split)));
+		if (newline == nullptr) {
+			break;
+		}
+		splits.push_back(newline + 1);
+	}
+	splits.push_back(end);
+
+	std::vector<ObjChunkData> chunks(splits.size() - 1);
+	workerPool.ParallelFor(chunks.size(), [&](size_t i) { ParseObjChunk(splits[i], splits[i + 1], chunks[i]); });
+
+	return BuildObjModel(chunks, flipY, &workerPool);
+}
+
+/// <summary>
+/// OBJファイルを読み込む
+/// </summary>
+/// <param name="directoryPath">ファイルのあるディレクトリ</param>
+/// <param name="filename">ファイル名</param>
+/// <param name="threadCount">解析に使うスレッド数。0なら大きいファイルだけ共有ワーカープールで並列に解析する</param>
+/// <returns>読み込んだモデルデータ</returns>
+inline ModelData LoadObjFile(const std::string& directoryPath, const std::string& filename, uint32_t threadCount = 0) {
+	// これより小さいファイルはスレッドを使うより1スレッドで読んだ方が速い
+	const size_t kParallelThreshold = 1024 * 1024;
+
+	MappedFile mappedFile = MapFileReadOnly(directoryPath + "/" + filename);
+	bool flipY = (filename != "plane.obj");
+	assert(IsFileMapped(mappedFile));
+
+	// ファイルをメモリマップしたまま、その場でトークンを切り出して解析する
+	const char* begin = mappedFile.data;
+	const char* end = mappedFile.data + mappedFile.size;
+	ModelData modelData;
+	if (threadCount == 0 && mappedFile.size >= kParallelThreshold) {
+		WorkerPool& workerPool = GetWorkerPool();
+		modelData = ParseObjTextParallel(begin, end, flipY, workerPool, workerPool.GetThreadCount());
+	} else if (threadCount > 1) {
+		modelData = ParseObjTextParallel(begin, end, flipY, GetWorkerPool(), threadCount);
+	} else {
+		modelData = ParseObjText(begin, end, flipY);
+	}
+
+	UnmapFile(&mappedFile);
+	return modelData;
+}
@@ -17,13 +17,16 @@ struct Material
 {
     float4 color;
     int lightingType;
-    float3 padding;
+    uint textureIndex; // mainBindless で使う、gTextures の中での番号
+    float2 padding;
     float4x4 uvTransform;
 };
 
 ConstantBuffer<Material> gMaterial : register(b0);
 ConstantBuffer<DirectionalLight> gDirectionalLight : register(b1);
 Texture2D<float4> gTexture : register(t0);
+// bindless のときは SRV のヒープ全体を1つの表として見る（t1 のインスタンスの行列と重ならないよう space1 に置く）
+Texture2D<float4> gTextures[] : register(t0, space1);
 SamplerState gSampler : register(s0);
 
 
@@ -32,12 +35,14 @@ struct PixelShaderOutput
     float4 color : SV_TARGET0;
 };
 
-PixelShaderOutput main(VertexShaderOutput input)
+float2 TransformUV(float2 texcoord)
+{
+    return mul(float4(texcoord, 0.0f, 1.0f), gMaterial.uvTransform).xy;
+}
+
+PixelShaderOutput Shade(VertexShaderOutput input, float4 textureColor)
 {
     PixelShaderOutput output;
-    
-    float4 transformedUV = mul(float4(input.texcoord, 0.0f, 1.0f), gMaterial.uvTransform);
-    float4 textureColor = gTexture.Sample(gSampler, transformedUV.xy);
 
     float3 finalColor = gMaterial.color.rgb * textureColor.rgb;
 
@@ -63,5 +68,13 @@ PixelShaderOutput main(VertexShaderOutput input)
     return output;
 }
 
+PixelShaderOutput main(VertexShaderOutput input)
+{
+    return Shade(input, gTexture.Sample(gSampler, TransformUV(input.texcoord)));
+}
 
-
+PixelShaderOutput mainBindless(VertexShaderOutput input)
+{
+    // テクスチャの番号は描画ごとに同じ（定数バッファの値）なので、NonUniformResourceIndex は要らない
+    return Shade(input, gTextures[gMaterial.textureIndex].Sample(gSampler, TransformUV(input.texcoord)));
+}
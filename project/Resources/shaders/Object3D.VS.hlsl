@@ -17,22 +17,68 @@ struct TransformationMatrix
     float4x4 WVP;
     float4x4 World;
 };
-ConstantBuffer<TransformationMatrix> gTransformationMatrix : register(b2);
+
+// インスタンスごとの行列（mainInstanced / mainCompactInstanced で使う）
+StructuredBuffer<TransformationMatrix> gInstances : register(t1);
+
+// SV_InstanceID は StartInstanceLocation を含まないので、この描画で使う先頭の位置を別に受け取る
+struct InstanceOffset
+{
+    uint firstInstance;
+};
+ConstantBuffer<InstanceOffset> gInstanceOffset : register(b4);
+
+// 圧縮頂点の位置を元に戻すための、メッシュを囲む箱（mainCompactInstanced でだけ使う）
+struct VertexQuantization
+{
+    float3 positionMin;
+    float padding0;
+    float3 positionExtent;
+    float padding1;
+};
+ConstantBuffer<VertexQuantization> gVertexQuantization : register(b3);
 
 struct VertexShaderInput
 {
-    float4 position : POSITION0; 
+    float4 position : POSITION0;
     float2 texcoord : TEXCOORD0;
     float3 normal : NORMAL0;
 };
 
+// 圧縮頂点（16バイト）。位置は箱の中での unorm16、UV は half、法線は八面体写像した snorm16
+struct CompactVertexShaderInput
+{
+    float4 position : POSITION0;
+    float2 texcoord : TEXCOORD0;
+    float2 normal : NORMAL0;
+};
 
-VertexShaderOutput main(VertexShaderInput input)
+VertexShaderOutput TransformVertex(TransformationMatrix transformation, float4 position, float2 texcoord, float3 normal)
 {
     VertexShaderOutput output;
-    output.position = mul(input.position, gTransformationMatrix.WVP);
-    output.texcoord = input.texcoord;
-    output.normal = normalize(mul(input.normal, (float3x3) gTransformationMatrix.World));
-
+    output.position = mul(position, transformation.WVP);
+    output.texcoord = texcoord;
+    output.normal = normalize(mul(normal, (float3x3) transformation.World));
     return output;
 }
+
+// 八面体写像した法線を3次元の単位ベクトルに戻す
+float3 DecodeOctahedralNormal(float2 encoded)
+{
+    float3 normal = float3(encoded.x, encoded.y, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float t = saturate(-normal.z);
+    normal.x += normal.x >= 0.0f ? -t : t;
+    normal.y += normal.y >= 0.0f ? -t : t;
+    return normalize(normal);
+}
+
+VertexShaderOutput mainInstanced(VertexShaderInput input, uint instanceId : SV_InstanceID)
+{
+    return TransformVertex(gInstances[gInstanceOffset.firstInstance + instanceId], input.position, input.texcoord, input.normal);
+}
+
+VertexShaderOutput mainCompactInstanced(CompactVertexShaderInput input, uint instanceId : SV_InstanceID)
+{
+    float3 position = gVertexQuantization.positionMin + input.position.xyz * gVertexQuantization.positionExtent;
+    return TransformVertex(gInstances[gInstanceOffset.firstInstance + instanceId], float4(position, 1.0f), input.texcoord, DecodeOctahedralNormal(input.normal));
+}
@@ -0,0 +1,128 @@
+#pragma once
+// 親子関係のあるシーン（親が子より前に来る平らな配列で持ち、印のついたノードとその子孫だけワールド行列を計算し直す）。
+// Windows のヘッダーに依存しないので、tests/ の Linux 向けのテストからもそのまま使う
+#include "MathKernels.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// ノードに親がないことを表す番号
+const int32_t kSceneNoParent = -1;
+
+/// <summary>
+/// 親子関係のあるシーン。ノードは親が必ず子より前に来る順に平らな配列で持つ（深さ順に並べ替えてはいない）。
+/// 前から一度なめるだけで、子を計算するときには親のワールド行列が決まっている。
+/// ローカルの Transform は SoA で持ち、ローカル行列は ComputeWorldMatrices でまとめて（SIMD で）計算する
+/// </summary>
+struct SceneGraph {
+	TransformSoA localTransforms;           // 親から見た Transform
+	std::vector<int32_t> parents;           // 親の番号（ルートは kSceneNoParent）
+	std::vector<Matrix4x4> worldMatrices;
+	std::vector<uint8_t> dirty;             // ワールド行列を計算し直す必要がある（子孫も計算し直す）
+	size_t firstDirty = SIZE_MAX;           // これより前のノードはすべて計算済み
+};
+
+/// <summary>
+/// ノードの数
+/// </summary>
+inline size_t GetSceneNodeCount(const SceneGraph& scene)
+{
+	return scene.parents.size();
+}
+
+/// <summary>
+/// ノードを追加する。親は先に追加しておくこと（これで配列が親 → 子の順に並ぶ）
+/// </summary>
+/// <param name="parent">親の番号（ルートにするなら kSceneNoParent）</param>
+/// <returns>追加したノードの番号</returns>
+inline uint32_t AddSceneNode(SceneGraph& scene, int32_t parent, const Transform& localTransform)
+{
+	const uint32_t index = static_cast<uint32_t>(GetSceneNodeCount(scene));
+	assert(parent == kSceneNoParent || (parent >= 0 && uint32_t(parent) < index));
+	AddTransform(scene.localTransforms, localTransform);
+	scene.parents.push_back(parent);
+	scene.worldMatrices.push_back(MakeIdentity4x4());
+	scene.dirty.push_back(1);
+	scene.firstDirty = std::min(scene.firstDirty, size_t(index));
+	return index;
+}
+
+/// <summary>
+/// ノードの（親から見た）Transform を書き換える。値が変わったときだけ計算し直す印をつける
+/// </summary>
+inline void SetSceneNodeTransform(SceneGraph& scene, uint32_t node, const Transform& localTransform)
+{
+	assert(node < GetSceneNodeCount(scene));
+	const Transform current = GetTransform(scene.localTransforms, node);
+	if (std::memcmp(&current, &localTransform, sizeof(Transform)) == 0) {
+		return;
+	}
+	SetTransform(scene.localTransforms, node, localTransform);
+	scene.dirty[node] = 1;
+	scene.firstDirty = std::min(scene.firstDirty, size_t(node));
+}
+
+/// <summary>
+/// 印のついたノードとその子孫だけワールド行列を計算し直す。
+/// 印のついた一番前のノードから後ろを一度なめて、印のないノードは親の印を見て飛ばす（調べるのは firstDirty 以降のすべてのノード）
+/// </summary>
+/// <returns>計算し直したノードの数</returns>
+inline size_t UpdateSceneGraph(SceneGraph& scene)
+{
+	const size_t count = GetSceneNodeCount(scene);
+	if (scene.firstDirty >= count) {
+		return 0;
+	}
+
+	// 1. 親が計算し直されるなら子も計算し直す（親は必ず前にあるので、印はもう伝わっている）
+	size_t updatedCount = 0;
+	for (size_t i = scene.firstDirty; i < count; ++i) {
+		const int32_t parent = scene.parents[i];
+		if (!scene.dirty[i] && parent != kSceneNoParent && scene.dirty[parent]) {
+			scene.dirty[i] = 1;
+		}
+		updatedCount += scene.dirty[i];
+	}
+
+	// 2. 印の続く範囲ごとに、ローカル行列を worldMatrices にまとめて書き込む
+	for (size_t i = scene.firstDirty; i < count;) {
+		if (!scene.dirty[i]) {
+			++i;
+			continue;
+		}
+		size_t runEnd = i + 1;
+		while (runEnd < count && scene.dirty[runEnd]) {
+			++runEnd;
+		}
+		ComputeWorldMatrices(scene.localTransforms, scene.worldMatrices.data(), sizeof(Matrix4x4), i, runEnd);
+		i = runEnd;
+	}
+
+	// 3. 親のあるノードは、前から順に親のワールド行列を掛ける（行ベクトルなので、ローカル → 親のワールドの順）
+	for (size_t i = scene.firstDirty; i < count; ++i) {
+		const int32_t parent = scene.parents[i];
+		if (scene.dirty[i] && parent != kSceneNoParent) {
+			scene.worldMatrices[i] = Multiply(scene.worldMatrices[i], scene.worldMatrices[parent]);
+		}
+	}
+
+	std::fill(scene.dirty.begin() + scene.firstDirty, scene.dirty.end(), uint8_t(0));
+	scene.firstDirty = SIZE_MAX;
+	return updatedCount;
+}
+
+/// <summary>
+/// すべてのノードの World と WVP を書き出す。ワールド行列は UpdateSceneGraph で計算し終えていること
+/// </summary>
+/// <param name="viewProjection">Multiply(view, projection)</param>
+/// <param name="output">書き込み先（ノードの数だけ並んでいること）</param>
+inline void ComputeTransformationMatrices(const SceneGraph& scene, const Matrix4x4& viewProjection, TransformationMatrix* output)
+{
+	const size_t count = GetSceneNodeCount(scene);
+	for (size_t i = 0; i < count; ++i) {
+		output[i].World = scene.worldMatrices[i];
+		output[i].WVP = Multiply(scene.worldMatrices[i], viewProjection);
+	}
+}
@@ -0,0 +1,212 @@
+#pragma once
+// テクスチャのクック（ミップマップを作ってブロック圧縮し、DDS に書き出す。tools/TextureCooker と WinMain が使う）。
+// TextureLoading.h と同じく、DDS / TGA / HDR の画像なら Windows 以外でもクックできる
+#include "TextureLoading.h"
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <chrono>
+#include <algorithm>
+#include <cassert>
+
+// ----------------------------------------------------------------------------
+// テクスチャのクック（オフラインでの変換）
+// 元の画像からミップマップを作ってブロック圧縮（BC1 / BC3 / BC7）し、DDS に書き出しておく。
+// 読み込むときは元の画像より新しい DDS があればそちらを読むので（ResolveCookedTexturePath）、
+// 起動するたびのミップマップの作成がなくなり、GPU に置くテクスチャも RGBA8 の 1/8（BC1）～ 1/4（BC3 / BC7）になる
+// ----------------------------------------------------------------------------
+
+// シーンで使うテクスチャ（WinMain で読み込み、TextureCooker でクックする）
+const char* const kSceneTextureFilePaths[] = {
+	"Resources/uvChecker.png",
+	"Resources/monsterBall.png",
+	"Resources/checkerBoard.png",
+};
+
+enum class TextureCookFormat : uint8_t {
+	BC1, // 4bpp。アルファなし（1ビットのみ）
+	BC3, // 8bpp。色は BC1 と同じで、アルファを別に持つ
+	BC7, // 8bpp。一番きれいだが圧縮に時間がかかる
+};
+
+/// <summary>
+/// クックしたときの大きさと、段ごとにかかった時間
+/// </summary>
+struct TextureCookResult
+{
+	HRESULT result = S_OK;
+	DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+	size_t width = 0;
+	size_t height = 0;
+	size_t mipLevels = 0;
+	// ミップマップまで含めた、圧縮前と圧縮後のバイト数
+	size_t sourceBytes = 0;
+	size_t cookedBytes = 0;
+	// 書き出した DDS のファイルの大きさ（ヘッダーを含む）
+	uintmax_t fileBytes = 0;
+	double decodeMilliseconds = 0.0;
+	double mipMilliseconds = 0.0;
+	double compressMilliseconds = 0.0;
+	double saveMilliseconds = 0.0;
+};
+
+/// <summary>
+/// クックの形式を DXGI のフォーマットにする。元の画像が sRGB なら sRGB のまま圧縮する
+/// </summary>
+inline DXGI_FORMAT GetCookedTextureFormat(TextureCookFormat format, bool srgb)
+{
+	switch (format) {
+	case TextureCookFormat::BC1: return srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+	case TextureCookFormat::BC3: return srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+	case TextureCookFormat::BC7: return srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+	}
+	return DXGI_FORMAT_UNKNOWN;
+}
+
+inline const wchar_t* GetTextureCookFormatName(TextureCookFormat format)
+{
+	switch (format) {
+	case TextureCookFormat::BC1: return L"BC1";
+	case TextureCookFormat::BC3: return L"BC3";
+	case TextureCookFormat::BC7: return L"BC7";
+	}
+	return L"?";
+}
+
+/// <summary>
+/// 圧縮の速さと画質の兼ね合い。BC7 のときだけ差が出る（BC1 / BC3 はどちらでも同じ）
+/// </summary>
+enum class TextureCookQuality : uint8_t {
+	Fast,    // BC7 はモード 6 だけを試す（TEX_COMPRESS_BC7_QUICK）。何倍も速いが、色の変化の多いブロックは粗くなる
+	Quality, // BC7 の 3 分割以外のモードをすべて試す
+};
+
+inline const wchar_t* GetTextureCookQualityName(TextureCookQuality quality)
+{
+	return (quality == TextureCookQuality::Fast) ? L"fast" : L"quality";
+}
+
+inline DirectX::TEX_COMPRESS_FLAGS GetTextureCompressFlags(TextureCookQuality quality)
+{
+	return (quality == TextureCookQuality::Fast) ? DirectX::TEX_COMPRESS_BC7_QUICK : DirectX::TEX_COMPRESS_DEFAULT;
+}
+
+/// <summary>
+/// 1枚の画像をブロックの行（高さ4画素）に分けて、複数のスレッドでブロック圧縮する。
+/// ブロックはそれぞれ独立に圧縮されるので、スレッドの数によらず DirectX::Compress で1度に圧縮したものと同じになる。
+/// 行の塊は共有のカウンターから早い者勝ちで取るので、圧縮に時間のかかる行が偏っても手の空いたスレッドが残りを引き受ける
+/// </summary>
+/// <param name="destination">source と同じ大きさで、format の画像（ScratchImage::Initialize2D で確保したもの）</param>
+/// <param name="threadCount">同時に圧縮するスレッドの数。1 なら呼び出したスレッドだけで圧縮する</param>
+inline HRESULT CompressImageParallel(const DirectX::Image& source, DXGI_FORMAT format, DirectX::TEX_COMPRESS_FLAGS flags, const DirectX::Image& destination,
+	WorkerPool& workerPool, uint32_t threadCount)
+{
+	assert(destination.width == source.width && destination.height == source.height && destination.format == format);
+	const size_t blockRowCount = (source.height + 3) / 4;
+	// 1つの塊は、スレッドあたり 16 個ほどに分かれる大きさにする（小さすぎると Compress を呼ぶ手間が目立つ）
+	const size_t blockRowsPerChunk = (std::max)(size_t(1), blockRowCount / (size_t(threadCount) * 16));
+	const size_t chunkCount = (blockRowCount + blockRowsPerChunk - 1) / blockRowsPerChunk;
+	std::atomic<size_t> nextChunk{ 0 };
+	std::atomic<HRESULT> result{ S_OK };
+
+	auto compressChunks = [&](size_t) {
+		for (size_t chunk = nextChunk.fetch_add(1); chunk < chunkCount; chunk = nextChunk.fetch_add(1)) {
+			const size_t firstBlockRow = chunk * blockRowsPerChunk;
+			const size_t blockRows = (std::min)(blockRowsPerChunk, blockRowCount - firstBlockRow);
+			// この塊の画素の行だけを指す画像（画素はコピーしない）
+			DirectX::Image slice = source;
+			slice.height = (std::min)(blockRows * 4, source.height - firstBlockRow * 4);
+			slice.pixels = source.pixels + firstBlockRow * 4 * source.rowPitch;
+			slice.slicePitch = slice.height * source.rowPitch;
+
+			DirectX::ScratchImage compressed{};
+			const HRESULT hr = DirectX::Compress(slice, format, flags, DirectX::TEX_THRESHOLD_DEFAULT, compressed);
+			const DirectX::Image* blocks = compressed.GetImage(0, 0, 0);
+			if (FAILED(hr) || blocks->rowPitch != destination.rowPitch) {
+				result.store(FAILED(hr) ? hr : E_FAIL);
+				continue;
+			}
+			std::memcpy(destination.pixels + firstBlockRow * destination.rowPitch, blocks->pixels, blockRows * destination.rowPitch);
+		}
+	};
+
+	if (threadCount <= 1) {
+		compressChunks(0);
+	} else {
+		workerPool.ParallelFor(threadCount, compressChunks);
+	}
+	return result.load();
+}
+
+/// <summary>
+/// 元の画像を読んでミップマップを作り、ブロック圧縮して DDS に書き出す
+/// </summary>
+/// <param name="sourcePath">元の画像（png などは WIC で読むので Windows のみ。DDS / TGA / HDR はどこでも読める）</param>
+/// <param name="cookedPath">書き出す DDS（ふつうは GetCookedTexturePath(sourcePath)）</param>
+/// <param name="workerPool">圧縮を分担させるワーカープール（すべてのスレッドを使う）</param>
+inline TextureCookResult CookTexture(const std::filesystem::path& sourcePath, const std::filesystem::path& cookedPath, TextureCookFormat format,
+	TextureCookQuality quality, WorkerPool& workerPool)
+{
+	TextureCookResult cook{};
+	auto start = std::chrono::high_resolution_clock::now();
+	auto elapsedMilliseconds = [&start]() {
+		const auto now = std::chrono::high_resolution_clock::now();
+		const double milliseconds = std::chrono::duration<double, std::milli>(now - start).count();
+		start = now;
+		return milliseconds;
+	};
+
+	// クック済みの DDS ではなく、必ず元の画像から作る
+	DirectX::ScratchImage image{};
+	cook.result = DecodeTextureFile(sourcePath, image);
+	cook.decodeMilliseconds = elapsedMilliseconds();
+	if (FAILED(cook.result)) {
+		return cook;
+	}
+	const DirectX::TexMetadata& sourceMetadata = image.GetMetadata();
+	// 圧縮済みのものはクックし直さない。一番上のミップの幅と高さはブロック（4x4）の倍数でなければ作れない。配列やキューブは扱わない
+	if (DirectX::IsCompressed(sourceMetadata.format) || sourceMetadata.width % 4 != 0 || sourceMetadata.height % 4 != 0 ||
+		sourceMetadata.dimension != DirectX::TEX_DIMENSION_TEXTURE2D || sourceMetadata.arraySize != 1) {
+		cook.result = E_INVALIDARG;
+		return cook;
+	}
+	const DXGI_FORMAT cookedFormat = GetCookedTextureFormat(format, DirectX::IsSRGB(sourceMetadata.format));
+
+	DirectX::ScratchImage mipImages{};
+	cook.result = BuildTextureMips(image, mipImages);
+	cook.mipMilliseconds = elapsedMilliseconds();
+	if (FAILED(cook.result)) {
+		return cook;
+	}
+
+	// ミップマップを1枚ずつ、ブロックの行に分けて全スレッドで圧縮する
+	const DirectX::TexMetadata& mipMetadata = mipImages.GetMetadata();
+	DirectX::ScratchImage compressedImages{};
+	cook.result = compressedImages.Initialize2D(cookedFormat, mipMetadata.width, mipMetadata.height, 1, mipMetadata.mipLevels);
+	for (size_t mipLevel = 0; SUCCEEDED(cook.result) && mipLevel < mipMetadata.mipLevels; ++mipLevel) {
+		cook.result = CompressImageParallel(*mipImages.GetImage(mipLevel, 0, 0), cookedFormat, GetTextureCompressFlags(quality),
+			*compressedImages.GetImage(mipLevel, 0, 0), workerPool, workerPool.GetThreadCount());
+	}
+	cook.compressMilliseconds = elapsedMilliseconds();
+	if (FAILED(cook.result)) {
+		return cook;
+	}
+
+	const DirectX::TexMetadata& cookedMetadata = compressedImages.GetMetadata();
+	cook.result = DirectX::SaveToDDSFile(compressedImages.GetImages(), compressedImages.GetImageCount(), cookedMetadata,
+		DirectX::DDS_FLAGS_NONE, cookedPath.wstring().c_str());
+	cook.saveMilliseconds = elapsedMilliseconds();
+	if (FAILED(cook.result)) {
+		return cook;
+	}
+
+	cook.format = cookedMetadata.format;
+	cook.width = cookedMetadata.width;
+	cook.height = cookedMetadata.height;
+	cook.mipLevels = cookedMetadata.mipLevels;
+	cook.sourceBytes = mipImages.GetPixelsSize();
+	cook.cookedBytes = compressedImages.GetPixelsSize();
+	std::error_code error;
+	cook.fileBytes = std::filesystem::file_size(cookedPath, error);
+	return cook;
+}
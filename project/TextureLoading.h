@@ -0,0 +1,200 @@
+#pragma once
+// テクスチャの非同期読み込み（拡張子でのデコード・ミップマップの作成・クック済みの DDS の選択・ワーカーでの読み込みのハンドル）。
+// DirectXTex の WIC を使わないコーデック（DDS / TGA / HDR）なら Windows 以外でも動くので、tests/ の Linux 向けのテストからもそのまま使う
+#include "externals/DirectXTex/DirectXTex.h"
+#include "WorkerPool.h"
+#include <filesystem>
+#include <string>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <cassert>
+
+// ----------------------------------------------------------------------------
+// テクスチャの非同期読み込み
+// ファイルのデコードとミップマップの作成は CPU だけの重い処理なので、ワーカーで行ってハンドルを返す。
+// 描画スレッドは毎フレーム読み終えたものだけを GPU のリソースにし、それまではプレースホルダーを見せる。
+// DDS / TGA / HDR は WIC を使わない DirectXTex のコーデックで読むので、この2つの段は Windows 以外でも確かめられる
+// ----------------------------------------------------------------------------
+
+/// <summary>
+/// 拡張子でコーデックを選んで、テクスチャのファイルをデコードする（ミップマップは作らない）
+/// </summary>
+inline HRESULT DecodeTextureFile(const std::filesystem::path& filePath, DirectX::ScratchImage& image)
+{
+	std::wstring extension = filePath.extension().wstring();
+	for (wchar_t& c : extension) {
+		if (c >= L'A' && c <= L'Z') {
+			c = c - L'A' + L'a';
+		}
+	}
+	const std::wstring filePathW = filePath.wstring();
+	if (extension == L".dds") {
+		return DirectX::LoadFromDDSFile(filePathW.c_str(), DirectX::DDS_FLAGS_NONE, nullptr, image);
+	}
+	// TGA は色空間の情報がなければ、WIC で読むときと同じく sRGB として扱う
+	if (extension == L".tga") {
+		return DirectX::LoadFromTGAFile(filePathW.c_str(), DirectX::TGA_FLAGS_DEFAULT_SRGB, nullptr, image);
+	}
+	if (extension == L".hdr") {
+		return DirectX::LoadFromHDRFile(filePathW.c_str(), nullptr, image);
+	}
+#if defined(_WIN32)
+	return DirectX::LoadFromWICFile(filePathW.c_str(), DirectX::WIC_FLAGS_FORCE_SRGB, nullptr, image);
+#else
+	return E_NOTIMPL;
+#endif
+}
+
+/// <summary>
+/// デコードした画像からミップマップを作る。圧縮済み・ミップマップ付き・1x1 の画像はそのまま mipImages に移す
+/// </summary>
+/// <param name="image">デコードした画像。呼んだ後は中身がなくなる</param>
+inline HRESULT BuildTextureMips(DirectX::ScratchImage& image, DirectX::ScratchImage& mipImages)
+{
+	const DirectX::TexMetadata& metadata = image.GetMetadata();
+	if (metadata.mipLevels > 1 || DirectX::IsCompressed(metadata.format) || (metadata.width == 1 && metadata.height == 1)) {
+		mipImages = std::move(image);
+		return S_OK;
+	}
+	// sRGB の画像は線形に戻してから平均する。HDR などの線形の画像はそのまま
+	const DirectX::TEX_FILTER_FLAGS filter = DirectX::IsSRGB(metadata.format) ? DirectX::TEX_FILTER_SRGB : DirectX::TEX_FILTER_DEFAULT;
+	HRESULT hr = DirectX::GenerateMipMaps(image.GetImages(), image.GetImageCount(), metadata, filter, 0, mipImages);
+	image.Release();
+	return hr;
+}
+
+/// <summary>
+/// 元の画像をクックした DDS を置く場所（同じフォルダーの、拡張子だけを .dds にしたファイル）
+/// </summary>
+inline std::filesystem::path GetCookedTexturePath(const std::filesystem::path& sourcePath)
+{
+	std::filesystem::path cookedPath = sourcePath;
+	cookedPath.replace_extension(".dds");
+	return cookedPath;
+}
+
+/// <summary>
+/// 元の画像より新しいクック済みの DDS があればそのパスを、なければ元のパスを返す。
+/// 更新時刻が同じときは、クックした後に元の画像を直したのかわからないので元の画像を使う。
+/// 元の画像がなく DDS だけがある（クックしたものだけを配った）ときは DDS を使う
+/// </summary>
+inline std::filesystem::path ResolveCookedTexturePath(const std::filesystem::path& sourcePath)
+{
+	const std::filesystem::path cookedPath = GetCookedTexturePath(sourcePath);
+	if (cookedPath == sourcePath) {
+		return sourcePath;
+	}
+	std::error_code error;
+	const std::filesystem::file_time_type cookedTime = std::filesystem::last_write_time(cookedPath, error);
+	if (error) {
+		return sourcePath;
+	}
+	const std::filesystem::file_time_type sourceTime = std::filesystem::last_write_time(sourcePath, error);
+	if (error || cookedTime > sourceTime) {
+		return cookedPath;
+	}
+	return sourcePath;
+}
+
+/// <summary>
+/// デコードとミップマップの作成をまとめて行い、それぞれにかかった時間を返す。
+/// クック済みの DDS があればそちらを読むので、ミップマップは作らずに済む
+/// </summary>
+inline HRESULT DecodeTextureWithMips(const std::filesystem::path& filePath, DirectX::ScratchImage& mipImages, double& decodeMilliseconds, double& mipMilliseconds)
+{
+	const auto decodeStart = std::chrono::high_resolution_clock::now();
+	DirectX::ScratchImage image{};
+	HRESULT hr = DecodeTextureFile(ResolveCookedTexturePath(filePath), image);
+	const auto decodeEnd = std::chrono::high_resolution_clock::now();
+	decodeMilliseconds = std::chrono::duration<double, std::milli>(decodeEnd - decodeStart).count();
+	mipMilliseconds = 0.0;
+	if (FAILED(hr)) {
+		return hr;
+	}
+	hr = BuildTextureMips(image, mipImages);
+	mipMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - decodeEnd).count();
+	return hr;
+}
+
+enum class TextureLoadState : uint8_t {
+	Pending, // ワーカーで処理中
+	Ready,   // mipImages を使える
+	Failed,  // 読めなかった（result に理由）
+};
+
+/// <summary>
+/// ワーカーで読んでいる1枚のテクスチャ。state が Pending でなくなった後は、ワーカーはもう触らない
+/// </summary>
+struct TextureLoadJob
+{
+	std::filesystem::path filePath;
+	std::atomic<TextureLoadState> state{ TextureLoadState::Pending };
+	HRESULT result = S_OK;
+	DirectX::ScratchImage mipImages;
+	double decodeMilliseconds = 0.0;
+	double mipMilliseconds = 0.0;
+};
+
+// 呼んだ側とワーカーの両方が持つので、どちらが先に手放してもよい
+using TextureLoadHandle = std::shared_ptr<TextureLoadJob>;
+
+/// <summary>
+/// テクスチャのデコードとミップマップの作成をワーカーに積み、すぐにハンドルを返す
+/// </summary>
+inline TextureLoadHandle LoadTextureAsync(const std::filesystem::path& filePath, WorkerPool& workerPool)
+{
+	TextureLoadHandle job = std::make_shared<TextureLoadJob>();
+	job->filePath = filePath;
+	workerPool.Submit([job]() {
+		job->result = DecodeTextureWithMips(job->filePath, job->mipImages, job->decodeMilliseconds, job->mipMilliseconds);
+		if (FAILED(job->result)) {
+			job->mipImages.Release();
+		}
+		// 結果を書き終えてから state を変える（release で公開し、描画スレッドは acquire で読む）
+		job->state.store(SUCCEEDED(job->result) ? TextureLoadState::Ready : TextureLoadState::Failed, std::memory_order_release);
+		job->state.notify_all();
+	});
+	return job;
+}
+
+/// <summary>
+/// 読み込みが終わっていれば（成功でも失敗でも）true。待たない
+/// </summary>
+inline bool IsTextureLoadFinished(const TextureLoadJob& job)
+{
+	return job.state.load(std::memory_order_acquire) != TextureLoadState::Pending;
+}
+
+/// <summary>
+/// 読み込みが終わるまで待ち、結果の状態を返す
+/// </summary>
+inline TextureLoadState WaitForTextureLoad(const TextureLoadJob& job)
+{
+	job.state.wait(TextureLoadState::Pending, std::memory_order_acquire);
+	return job.state.load(std::memory_order_acquire);
+}
+
+/// <summary>
+/// 読み込みが終わるまで見せる、8x8 マスの市松模様（sRGB、ミップマップなし）
+/// </summary>
+inline DirectX::ScratchImage MakePlaceholderTexture()
+{
+	const size_t kSize = 64;
+	const size_t kCellSize = 8;
+	DirectX::ScratchImage image{};
+	[[maybe_unused]] HRESULT hr = image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, kSize, kSize, 1, 1);
+	assert(SUCCEEDED(hr));
+	const DirectX::Image* pixels = image.GetImage(0, 0, 0);
+	for (size_t y = 0; y < kSize; ++y) {
+		uint8_t* row = pixels->pixels + y * pixels->rowPitch;
+		for (size_t x = 0; x < kSize; ++x) {
+			const uint8_t value = (((x / kCellSize) + (y / kCellSize)) % 2 == 0) ? 0xFF : 0x80;
+			row[x * 4 + 0] = value;
+			row[x * 4 + 1] = value;
+			row[x * 4 + 2] = value;
+			row[x * 4 + 3] = 0xFF;
+		}
+	}
+	return image;
+}
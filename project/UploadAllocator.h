@@ -0,0 +1,161 @@
+#pragma once
+// アップロード用メモリの切り出し（大きなページを先頭から順に切り出し、フェンスの値で使い回す UploadPageAllocator）。
+// Windows のヘッダーに依存しないので、tests/ の Linux 向けのテストからもそのまま使う
+#include <cstdint>
+#include <cassert>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <bit>
+
+// ----------------------------------------------------------------------------
+// アップロード用メモリの切り出し
+// バッファごとに CreateCommittedResource すると、小さなバッファでも1つずつヒープを取ることになる（バッファは 64KiB 単位で確保される）。
+// 大きなページを作っておき、その中を先頭から順に切り出して使う。ページの作成はデバイスに依存するので PageBackend に任せ、
+// ここではどのページのどこを使うかだけを決める。
+// 毎フレーム書き換える定数などは、フレームの終わりに使ったページへフェンスの値を付け、GPU がその値を過ぎたら使い回す。
+// 静的なジオメトリは使い回さず（FinishFrameUploads を呼ばない）、ページを詰めて使うだけにする
+// ----------------------------------------------------------------------------
+const uint32_t kNoUploadPage = UINT32_MAX;
+// D3D12 のバッファは 64KiB 境界に置かれるので、ページの大きさもその倍数にする
+const uint64_t kUploadPageGranularity = 64 * 1024;
+
+/// <summary>
+/// 切り出した領域。ページの番号と、ページの先頭からの位置
+/// </summary>
+struct UploadAllocation
+{
+	uint32_t pageIndex = kNoUploadPage;
+	uint64_t offset = 0;
+	uint64_t size = 0;
+};
+
+struct UploadPage
+{
+	uint64_t size;
+	// 先頭から使った量
+	uint64_t usedBytes;
+	// このページを最後に使ったフレームの終わりで Signal した値
+	uint64_t fenceValue;
+};
+
+struct UploadPageAllocator
+{
+	uint64_t pageSize = 0;
+	std::vector<UploadPage> pages;
+	// いま切り出しているページ
+	uint32_t currentPage = kNoUploadPage;
+	// 今のフレームで使い切ったページ（フレームの終わりにフェンスの値を付けて retiredPages へ移す）
+	std::vector<uint32_t> framePages;
+	// GPU が読み終えるのを待っているページ（フェンスの値の小さい順）
+	std::deque<uint32_t> retiredPages;
+	// 使い回せるページ
+	std::vector<uint32_t> freePages;
+
+	// 統計（切り出した回数、要求された量、境界をそろえるために空けた量）
+	uint64_t allocationCount = 0;
+	uint64_t requestedBytes = 0;
+	uint64_t paddingBytes = 0;
+};
+
+inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+	assert(std::has_single_bit(alignment));
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+inline void InitializeUploadPageAllocator(UploadPageAllocator& allocator, uint64_t pageSize)
+{
+	assert(pageSize > 0 && pageSize % kUploadPageGranularity == 0);
+	allocator = {};
+	allocator.pageSize = pageSize;
+}
+
+/// <summary>
+/// minimumSize 以上の空いているページを使い回すか、なければ作る。ページより大きな要求には、その大きさのページを作る
+/// </summary>
+template<typename PageBackend>
+uint32_t AcquireUploadPage(UploadPageAllocator& allocator, PageBackend& backend, uint64_t minimumSize)
+{
+	for (size_t i = 0; i < allocator.freePages.size(); ++i) {
+		const uint32_t pageIndex = allocator.freePages[i];
+		if (allocator.pages[pageIndex].size >= minimumSize) {
+			allocator.freePages[i] = allocator.freePages.back();
+			allocator.freePages.pop_back();
+			allocator.pages[pageIndex].usedBytes = 0;
+			return pageIndex;
+		}
+	}
+	const uint32_t pageIndex = static_cast<uint32_t>(allocator.pages.size());
+	const uint64_t size = std::max(allocator.pageSize, AlignUp(minimumSize, kUploadPageGranularity));
+	allocator.pages.push_back({ size, 0, 0 });
+	backend.CreatePage(pageIndex, size);
+	return pageIndex;
+}
+
+/// <summary>
+/// size バイトを alignment（2のべき乗）の境界にそろえて切り出す。今のページに入らなければ次のページへ移る
+/// </summary>
+/// <typeparam name="PageBackend">CreatePage(pageIndex, size) でページのメモリを用意する型</typeparam>
+template<typename PageBackend>
+UploadAllocation AllocateUpload(UploadPageAllocator& allocator, PageBackend& backend, uint64_t size, uint64_t alignment)
+{
+	assert(size > 0);
+	assert(alignment <= kUploadPageGranularity);
+	uint64_t offset = 0;
+	if (allocator.currentPage != kNoUploadPage) {
+		offset = AlignUp(allocator.pages[allocator.currentPage].usedBytes, alignment);
+	}
+	if (allocator.currentPage == kNoUploadPage || offset + size > allocator.pages[allocator.currentPage].size) {
+		if (allocator.currentPage != kNoUploadPage) {
+			allocator.framePages.push_back(allocator.currentPage);
+		}
+		allocator.currentPage = AcquireUploadPage(allocator, backend, size);
+		offset = 0;
+	}
+	UploadPage& page = allocator.pages[allocator.currentPage];
+	allocator.paddingBytes += offset - page.usedBytes;
+	allocator.requestedBytes += size;
+	++allocator.allocationCount;
+	page.usedBytes = offset + size;
+	return { allocator.currentPage, offset, size };
+}
+
+/// <summary>
+/// フレームの終わりに呼ぶ。このフレームで使ったページに、このフレームの終わりで Signal した値を付ける
+/// （今のページは次のフレームでも続けて使うので、使い切るまでは回収しない）
+/// </summary>
+inline void FinishFrameUploads(UploadPageAllocator& allocator, uint64_t fenceValue)
+{
+	for (uint32_t pageIndex : allocator.framePages) {
+		allocator.pages[pageIndex].fenceValue = fenceValue;
+		allocator.retiredPages.push_back(pageIndex);
+	}
+	allocator.framePages.clear();
+	if (allocator.currentPage != kNoUploadPage) {
+		allocator.pages[allocator.currentPage].fenceValue = fenceValue;
+	}
+}
+
+/// <summary>
+/// GPU が completedFenceValue まで終えていれば、それまでに使い終えたページを使い回せるようにする
+/// </summary>
+inline void RecycleUploadPages(UploadPageAllocator& allocator, uint64_t completedFenceValue)
+{
+	while (!allocator.retiredPages.empty() && allocator.pages[allocator.retiredPages.front()].fenceValue <= completedFenceValue) {
+		allocator.freePages.push_back(allocator.retiredPages.front());
+		allocator.retiredPages.pop_front();
+	}
+}
+
+/// <summary>
+/// 作ったページの大きさの合計
+/// </summary>
+inline uint64_t GetUploadPageBytes(const UploadPageAllocator& allocator)
+{
+	uint64_t bytes = 0;
+	for (const UploadPage& page : allocator.pages) {
+		bytes += page.size;
+	}
+	return bytes;
+}
@@ -0,0 +1,113 @@
+#pragma once
+// 固定数のスレッドでタスクを処理するワーカープールと、アプリ全体で共有するもの（GetWorkerPool）。
+// Windows のヘッダーに依存しないので、tests/ の Linux 向けのテストからもそのまま使う
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+/// <summary>
+/// 固定数のスレッドでタスクを処理するワーカープール
+/// </summary>
+class WorkerPool
+{
+public:
+	explicit WorkerPool(uint32_t threadCount)
+	{
+		for (uint32_t i = 0; i < threadCount; ++i) {
+			threads_.emplace_back([this]() { WorkerMain(); });
+		}
+	}
+
+	~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			isStopping_ = true;
+		}
+		taskCondition_.notify_all();
+		for (std::thread& thread : threads_) {
+			thread.join();
+		}
+	}
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// タスクを積む（終了は待たない）
+	void Submit(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			tasks_.push_back(std::move(task));
+		}
+		taskCondition_.notify_one();
+	}
+
+	/// <summary>
+	/// function(0) ～ function(count - 1) をワーカーで実行し、すべて終わるまで待つ
+	/// </summary>
+	void ParallelFor(size_t count, const std::function<void(size_t)>& function)
+	{
+		if (count == 1 || threads_.empty()) {
+			for (size_t i = 0; i < count; ++i) {
+				function(i);
+			}
+			return;
+		}
+
+		// このバッチの残り数だけを数える（他から積まれたタスクは待たない）
+		std::mutex doneMutex;
+		std::condition_variable doneCondition;
+		size_t remaining = count;
+		for (size_t i = 0; i < count; ++i) {
+			Submit([&, i]() {
+				function(i);
+				std::lock_guard<std::mutex> lock(doneMutex);
+				if (--remaining == 0) {
+					doneCondition.notify_one();
+				}
+			});
+		}
+
+		std::unique_lock<std::mutex> lock(doneMutex);
+		doneCondition.wait(lock, [&]() { return remaining == 0; });
+	}
+
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(threads_.size()); }
+
+private:
+	void WorkerMain()
+	{
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				taskCondition_.wait(lock, [this]() { return isStopping_ || !tasks_.empty(); });
+				if (tasks_.empty()) {
+					return;
+				}
+				task = std::move(tasks_.front());
+				tasks_.pop_front();
+			}
+			task();
+		}
+	}
+
+	std::vector<std::thread> threads_;
+	std::deque<std::function<void()>> tasks_;
+	std::mutex mutex_;
+	std::condition_variable taskCondition_;
+	bool isStopping_ = false;
+};
+
+// アプリ全体で共有するワーカープール（ハードウェアスレッド数で作る）
+inline WorkerPool& GetWorkerPool()
+{
+	static WorkerPool workerPool((std::max)(1u, std::thread::hardware_concurrency()));
+	return workerPool;
+}
@@ -1,4 +1,5 @@
 // 必要なヘッダー
+#define NOMINMAX // Windows.h の min / max マクロが std::min / std::max を壊さないようにする
 #include <Windows.h>
 #include <filesystem>
 #include <d3d12.h>
@@ -16,10 +17,47 @@
 #include "externals/imgui/imgui_impl_dx12.h"
 #include "externals/imgui/imgui_impl_win32.h"
 #include "externals/DirectXTex/DirectXTex.h" // DirectXTexヘッダーをインクルード
+#include "MathKernels.h"                     // 行列・ベクトルの型と演算
+#include "FrustumCulling.h"                  // 視錐台カリング
+#include "DrawList.h"                        // インスタンス描画の一覧
+#include "FrameRing.h"                       // フレームの多重化
+#include "UploadAllocator.h"                 // アップロード用メモリの切り出し
+#include "DescriptorAllocator.h"             // ディスクリプタの割り当て
+#include "WorkerPool.h"                      // ワーカープール
+#include "TextureLoading.h"                  // テクスチャの非同期読み込み
+#include "MeshData.h"                        // モデルのデータ
+#include "ObjLoader.h"                       // OBJ の読み込み
+#include "MeshCache.h"                       // 焼き込み済みメッシュのキャッシュ
+#include "MeshOptimization.h"                // メッシュの最適化
+#include "Meshlets.h"                        // メッシュレット
+#include "MeshLod.h"                         // メッシュの LOD
+#include "CompactVertex.h"                   // 圧縮した頂点
+#include "SceneGraph.h"                      // シーングラフ
+#include "InstanceBvh.h"                     // 物体の BVH
+#include "MeshTriangleBvh.h"                 // 三角形の BVH とレイの交差
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <fstream>   // ifstream 用
-#include <sstream>   // istringstream 用（後で使う）
+#include <sstream>   // istringstream 用
+#include <charconv>  // from_chars 用
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cfloat>
+#include <random>
+#include <bit>
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h> // SSE / AVX2 の組み込み関数
+#if defined(_MSC_VER)
+#include <intrin.h>    // __cpuid 用
+#endif
+#endif
 #include <xaudio2.h>
 #include <wrl.h>
 #include <Xinput.h>
@@ -45,6 +83,7 @@ enum class DisplayMode {
 	Teapot,
 	Bunny,
 	MultiMesh,
+	Instancing,
 	Count
 };
 
@@ -88,65 +127,17 @@ enum class LightingType {
 	HalfLambert
 };
 
-
-// Vector4型を定義する
-struct Vector4 {
-	float x, y, z, w;
-};
-
-struct Vector3 {
-	float x, y, z;
-};
-
-struct Vector2 {
-	float x, y;
-};
-
-struct Matrix4x4 {
-	float m[4][4];
-};
-
-struct Matrix3x3 {
-	float m[3][3];
-};
-
-struct Transform {
-	Vector3 scale;
-	Vector3 rotate;
-	Vector3 translate;
-};
-
-struct VertexData {
-	Vector4 position;
-	Vector2 texcoord;
-	Vector3 normal;
-	float pad;
-};
-
-struct MeshData {
-	std::string name;
-	std::vector<VertexData> vertices;
-};
-
-struct ModelData {
-	std::vector<MeshData> meshes;
-};
-
 extern std::vector<ModelData> allModels;
 
 struct Material {
 	Vector4 color;
 	int32_t lightingType;     // ← ここをリネーム
-	float padding[3];         // ← 既にパディング済みなのでそのままOK
+	uint32_t textureIndex;    // bindless のとき、テクスチャの表（フレームの使い捨ての領域）の中でのテクスチャの番号
+	float padding[2];
 	Matrix4x4 uvTransform;
 };
 
 
-struct TransformationMatrix {
-	Matrix4x4 WVP;
-	Matrix4x4 World;
-};
-
 struct DirectionalLight {
 	Vector4 color;        // ライトの色
 	Vector3 direction;    // ライトの向き（単位ベクトル）
@@ -206,170 +197,137 @@ static Transform multiMeshTransform = {
 /// <param name="shaderVisible">シェーダーから参照可能にするかどうか</param>
 /// <returns>作成された ID3D12DescriptorHeap のポインタ。失敗した場合は nullptr。</returns>
 ID3D12DescriptorHeap* CreateDescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE heapType, UINT numDescriptors, bool shaderVisible);
+
+// DrawList.h の SubmitInstancedDrawList から D3D12 のコマンドリストへ出す部分（Windows でだけ使う）
+
 /// <summary>
-/// 単位行列
-/// </summary>
-/// <returns>単位行列</returns>
-Matrix4x4 MakeIdentity4x4();
-/// <summary>
-/// スケール、回転、平行移動の各要素からアフィン変換行列（4x4）を生成。
-/// </summary>
-/// <param name="scale">拡大縮小を表すスケールベクトル。</param>
-/// <param name="rotate">回転を表すオイラー角（ラジアン）ベクトル。</param>
-/// <param name="translate">位置を表す平行移動ベクトル。</param>
-/// <returns>アフィン変換を表す 4x4 行列。</returns>
-Matrix4x4 MakeAffineMatrix(const Vector3& scale, const Vector3& rotate, const Vector3& translate);
-/// <summary>
-/// 垂直方向の視野角、アスペクト比、近距離および遠距離クリップ面を元に透視投影行列（4x4）を生成。
-/// </summary>
-/// <param name="fovY">垂直方向の視野角（ラジアン単位）。</param>
-/// <param name="aspect">アスペクト比（横幅 ÷ 高さ）。</param>
-/// <param name="nearZ">近距離クリップ面の距離。</param>
-/// <param name="farZ">遠距離クリップ面の距離。</param>
-/// <returns>透視投影を表す 4x4 行列。</returns>
-Matrix4x4 MakePerspectiveFovMatrix(float fovY, float aspect, float nearZ, float farZ);
-/// <summary>
-/// 2つの 4x4 行列の積を計算し、合成された変換行列を返します。
+/// D3D12 のコマンドリストに出す backend。PSO・マテリアル・テクスチャは DrawState の番号で引く表を持ち、
+/// メッシュごとのバッファのビューはモデルの番号の順に並んだ配列を指す
 /// </summary>
-/// <param name="a">左側の行列（先に適用される変換）。</param>
-/// <param name="b">右側の行列（後に適用される変換）。</param>
-/// <returns>掛け算の結果となる 4x4 行列。</returns>
-Matrix4x4 Multiply(const Matrix4x4& a, const Matrix4x4& b);
+struct D3D12CommandBackend
+{
+	ID3D12GraphicsCommandList* commandList;
+	std::vector<ID3D12PipelineState*> pipelines;
+	std::vector<D3D12_GPU_VIRTUAL_ADDRESS> materials;
+	std::vector<D3D12_GPU_DESCRIPTOR_HANDLE> textures;
+	const std::vector<std::vector<D3D12_VERTEX_BUFFER_VIEW>>* vertexBufferViews;
+	const std::vector<std::vector<D3D12_INDEX_BUFFER_VIEW>>* indexBufferViews;
+	const std::vector<std::vector<VertexQuantization>>* vertexQuantizations;
+
+	void SetPipeline(uint32_t pipeline)
+	{
+		commandList->SetPipelineState(pipelines[pipeline]);
+	}
+	void SetMaterial(uint32_t material)
+	{
+		commandList->SetGraphicsRootConstantBufferView(0, materials[material]);
+	}
+	void SetTexture(uint32_t texture)
+	{
+		commandList->SetGraphicsRootDescriptorTable(2, textures[texture]);
+	}
+	void SetPrimitiveTopology()
+	{
+		commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	}
+	void SetMesh(uint32_t modelIndex, uint32_t meshIndex)
+	{
+		commandList->SetGraphicsRoot32BitConstants(3, sizeof(VertexQuantization) / sizeof(uint32_t), &(*vertexQuantizations)[modelIndex][meshIndex], 0);
+		commandList->IASetVertexBuffers(0, 1, &(*vertexBufferViews)[modelIndex][meshIndex]);
+		commandList->IASetIndexBuffer(&(*indexBufferViews)[modelIndex][meshIndex]);
+	}
+	void SetFirstInstance(uint32_t firstInstance)
+	{
+		// SV_InstanceID は StartInstanceLocation を含まないので、先頭の位置はルート定数（b4）で渡す
+		commandList->SetGraphicsRoot32BitConstant(5, firstInstance, 0);
+	}
+	void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndexLocation)
+	{
+		commandList->DrawIndexedInstanced(indexCount, instanceCount, startIndexLocation, 0, 0);
+	}
+};
+
 /// <summary>
-/// 指定された 4x4 行列の逆行列を計算して返します。
+/// D3D12 のコマンドキューとフェンスで FrameRing を動かすためのもの
 /// </summary>
-/// <param name="m">逆行列を求める対象の 4x4 行列。</param>
-/// <returns>指定された行列の逆行列（Matrix4x4 型）。</returns>
-Matrix4x4 Inverse(const Matrix4x4& m);
-
-Vector3 Normalize(const Vector3& v) {
-	float length = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
-	if (length == 0.0f) return { 0.0f, 0.0f, 0.0f };
-	return { v.x / length, v.y / length, v.z / length };
-}
-
-Matrix4x4 MakeScaleMatrix(const Vector3& scale) {
-	Matrix4x4 result = {};
-	result.m[0][0] = scale.x;
-	result.m[1][1] = scale.y;
-	result.m[2][2] = scale.z;
-	result.m[3][3] = 1.0f;
-	return result;
-}
-
-Matrix4x4 MakeRotateZMatrix(float angle) {
-	Matrix4x4 result = {};
-	float c = cosf(angle);
-	float s = sinf(angle);
-
-	result.m[0][0] = c;
-	result.m[0][1] = -s;
-	result.m[1][0] = s;
-	result.m[1][1] = c;
-	result.m[2][2] = 1.0f;
-	result.m[3][3] = 1.0f;
-	return result;
-}
-
-Matrix4x4 MakeTranslateMatrix(const Vector3& translate) {
-	Matrix4x4 result = {};
-	result.m[0][0] = 1.0f;
-	result.m[1][1] = 1.0f;
-	result.m[2][2] = 1.0f;
-	result.m[3][3] = 1.0f;
-
-	result.m[3][0] = translate.x;
-	result.m[3][1] = translate.y;
-	result.m[3][2] = translate.z;
-	return result;
-}
-
-ModelData LoadObjFile(const std::string& directoryPath, const std::string& filename) {
-	ModelData modelData;
-	std::vector<Vector4> positions;
-	std::vector<Vector3> normals;
-	std::vector<Vector2> texcoords;
-	std::string line;
-
-	std::ifstream file(directoryPath + "/" + filename);
-	bool flipY = (filename != "plane.obj");
-	assert(file.is_open());
-
-	MeshData currentMesh;
-	currentMesh.name = "Default";
-
-	while (std::getline(file, line)) {
-		std::string identifier;
-		std::istringstream s(line);
-		s >> identifier;
-
-		if (identifier == "v") {
-			Vector4 position;
-			s >> position.x >> position.y >> position.z;
-			position.w = 1.0f;
-			positions.push_back(position);
-		} else if (identifier == "vt") {
-			Vector2 texcoord;
-			s >> texcoord.x >> texcoord.y;
-			texcoord.y = 1.0f - texcoord.y;
-			texcoords.push_back(texcoord);
-		} else if (identifier == "vn") {
-			Vector3 normal;
-			s >> normal.x >> normal.y >> normal.z;
-			normals.push_back(normal);
-		} else if (identifier == "f") {
-			VertexData triangle[3];
-			for (int32_t faceVertex = 0; faceVertex < 3; ++faceVertex) {
-				std::string vertexDefinition;
-				s >> vertexDefinition;
-
-				std::istringstream v(vertexDefinition);
-				uint32_t elementIndices[3];
-				for (int32_t element = 0; element < 3; ++element) {
-					std::string index;
-					std::getline(v, index, '/');
-					elementIndices[element] = std::stoi(index);
-				}
-
-				Vector4 position = positions[elementIndices[0] - 1];
-				Vector2 texcoord = texcoords[elementIndices[1] - 1];
-				Vector3 normal = normals[elementIndices[2] - 1];
+struct D3D12FrameFence
+{
+	ID3D12CommandQueue* commandQueue;
+	ID3D12Fence* fence;
+	HANDLE fenceEvent;
 
-				if (flipY) {
-					position.x *= -1.0f;
-					normal.x *= -1.0f;
+	uint64_t GetCompletedValue()
+	{
+		return fence->GetCompletedValue();
+	}
+	void Signal(uint64_t value)
+	{
+		HRESULT hr = commandQueue->Signal(fence, value);
+		assert(SUCCEEDED(hr));
+	}
+	void WaitForValue(uint64_t value)
+	{
+		HRESULT hr = fence->SetEventOnCompletion(value, fenceEvent);
+		assert(SUCCEEDED(hr));
+		WaitForSingleObject(fenceEvent, INFINITE);
+	}
+};
 
-					float rad = 3.141592f;
-					float x = position.x;
-					float z = position.z;
-					position.x = x * cos(rad) - z * sin(rad);
-					position.z = x * sin(rad) + z * cos(rad);
-				}
+// ----------------------------------------------------------------------------
+// bindless テクスチャ
+// ピクセルシェーダーはフレームのテクスチャの表（使い捨ての領域に並べた SRV）を1つの配列として見て、マテリアルに入れたテクスチャの番号で引く。
+// 描画の一覧のマテリアルとテクスチャの組ごとに1つのマテリアルを作り、描画はその番号だけを持つようにするので、
+// テクスチャを切り替えるコマンドがなくなる（テクスチャの表は、フレームの最初の描画で1回だけ設定される）
+// ----------------------------------------------------------------------------
 
-				triangle[faceVertex] = { position, texcoord, normal };
-			}
+// 作るマテリアル1つぶん。元のマテリアルの番号と、入れるテクスチャの表の中での番号
+struct BindlessMaterialEntry
+{
+	uint32_t material;
+	uint32_t textureDescriptorIndex;
+};
 
-			currentMesh.vertices.push_back(triangle[2]);
-			currentMesh.vertices.push_back(triangle[1]);
-			currentMesh.vertices.push_back(triangle[0]);
-		} else if (identifier == "o" || identifier == "g") {
-			if (!currentMesh.vertices.empty()) {
-				modelData.meshes.push_back(currentMesh);
-				currentMesh = MeshData();
-			}
+struct BindlessMaterialTable
+{
+	std::vector<BindlessMaterialEntry> entries;
+	// (マテリアル, テクスチャ) の組から entries の番号を引く作業用の表（フレームをまたいで使い回す）
+	std::vector<uint32_t> slots;
+};
 
-			std::string meshName;
-			s >> meshName;
-			currentMesh.name = meshName;
+/// <summary>
+/// 描画の一覧のマテリアルとテクスチャの組に、出てきた順に番号を振る。各描画の DrawState はマテリアルをその番号にし、
+/// テクスチャを 0 にして、並べ替えのキーも作り直す（SortInstancedDrawList の前に呼ぶ）
+/// </summary>
+/// <param name="textureDescriptorIndices">DrawState.texture の番号で引く、テクスチャのヒープの中での番号</param>
+void AssignBindlessMaterials(BindlessMaterialTable& table, InstancedDrawList& drawList, uint32_t materialCount, const uint32_t* textureDescriptorIndices, uint32_t textureCount)
+{
+	table.entries.clear();
+	table.slots.assign(size_t(materialCount) * textureCount, kInvalidDescriptorIndex);
+	// 深さ・メッシュ・モデルの桁は元のキーのまま残す
+	const uint64_t lowBitsMask = (uint64_t(1) << (kDrawKeyModelBits + kDrawKeyMeshBits + kDrawKeyDepthBits)) - 1;
+	for (InstancedDraw& draw : drawList.draws) {
+		assert(draw.state.material < materialCount && draw.state.texture < textureCount);
+		uint32_t& slot = table.slots[size_t(draw.state.material) * textureCount + draw.state.texture];
+		if (slot == kInvalidDescriptorIndex) {
+			slot = static_cast<uint32_t>(table.entries.size());
+			table.entries.push_back({ draw.state.material, textureDescriptorIndices[draw.state.texture] });
 		}
+		draw.state.material = slot;
+		draw.state.texture = 0;
+		draw.sortKey = (MakeDrawSortKey(draw.state, 0, 0, 0.0f) & ~lowBitsMask) | (draw.sortKey & lowBitsMask);
 	}
+}
 
-	// 最後のメッシュも忘れずに追加
-	if (!currentMesh.vertices.empty()) {
-		modelData.meshes.push_back(currentMesh);
+/// <summary>
+/// 番号を振ったマテリアルを、元のマテリアルの値にテクスチャの番号を入れて、stride バイトおきに書き出す
+/// </summary>
+void WriteBindlessMaterials(const BindlessMaterialTable& table, const Material* materials, uint8_t* destination, size_t stride)
+{
+	for (size_t i = 0; i < table.entries.size(); ++i) {
+		Material material = materials[table.entries[i].material];
+		material.textureIndex = table.entries[i].textureDescriptorIndex;
+		std::memcpy(destination + stride * i, &material, sizeof(Material));
 	}
-
-	return modelData;
 }
 
 Vector3 Add(const Vector3& a, const Vector3& b) {
@@ -557,7 +515,7 @@ ID3D12Resource* CreateDepthStencilTextureResource(ID3D12Device* device, int32_t
 	return resource;
 }
 
-IDxcBlob* CompileShader(const std::wstring& filePath, const wchar_t* profile, IDxcUtils* dxcUtils, IDxcCompiler3* dxcCompiler, IDxcIncludeHandler* includeHandler);
+IDxcBlob* CompileShader(const std::wstring& filePath, const wchar_t* profile, IDxcUtils* dxcUtils, IDxcCompiler3* dxcCompiler, IDxcIncludeHandler* includeHandler, const wchar_t* entryPoint = L"main");
 
 D3D12_CPU_DESCRIPTOR_HANDLE GetCPUDescriptorHandle(ID3D12DescriptorHeap* descriptorHeap, uint32_t descriptorSize, uint32_t index)
 {
@@ -584,10 +542,80 @@ std::wstring ConvertString(const std::string& str) {
 
 ID3D12Resource* CreateBufferResource(ID3D12Device* device, size_t sizeInBytes);
 
+/// <summary>
+/// UploadPageAllocator のページを、アップロードヒープのバッファとして作る。ページは作ったときに Map したままにする
+/// </summary>
+struct D3D12UploadPages
+{
+	ID3D12Device* device;
+	std::vector<ID3D12Resource*> resources;
+	std::vector<uint8_t*> mappedData;
+
+	void CreatePage(uint32_t pageIndex, uint64_t size)
+	{
+		assert(pageIndex == resources.size());
+		ID3D12Resource* resource = CreateBufferResource(device, size_t(size));
+		uint8_t* data = nullptr;
+		HRESULT hr = resource->Map(0, nullptr, reinterpret_cast<void**>(&data));
+		assert(SUCCEEDED(hr));
+		resources.push_back(resource);
+		mappedData.push_back(data);
+	}
+	uint8_t* CpuAddress(const UploadAllocation& allocation) const
+	{
+		return mappedData[allocation.pageIndex] + allocation.offset;
+	}
+	D3D12_GPU_VIRTUAL_ADDRESS GpuAddress(const UploadAllocation& allocation) const
+	{
+		return resources[allocation.pageIndex]->GetGPUVirtualAddress() + allocation.offset;
+	}
+	void Release()
+	{
+		for (ID3D12Resource* resource : resources) {
+			resource->Release();
+		}
+		resources.clear();
+		mappedData.clear();
+	}
+};
+
+// Log を書き込む標準出力（ベンチマークのときだけ EnableConsoleLog でつなぐ。つないでいなければ nullptr）
+HANDLE gLogOutput = nullptr;
+
 // 2. Log関数
 void Log(const std::wstring& message) {
 	OutputDebugStringW(message.c_str());
 	OutputDebugStringW(L"\n"); // 改行も出す
+	if (gLogOutput) {
+		const std::wstring line = message + L"\n";
+		DWORD written = 0;
+		if (!WriteConsoleW(gLogOutput, line.c_str(), static_cast<DWORD>(line.size()), &written, nullptr)) {
+			// コンソールでなくファイルやパイプへリダイレクトされているときは UTF-8 で書く
+			const int size = WideCharToMultiByte(CP_UTF8, 0, line.c_str(), static_cast<int>(line.size()), nullptr, 0, nullptr, nullptr);
+			std::string utf8(size, '\0');
+			WideCharToMultiByte(CP_UTF8, 0, line.c_str(), static_cast<int>(line.size()), utf8.data(), size, nullptr, nullptr);
+			WriteFile(gLogOutput, utf8.data(), static_cast<DWORD>(utf8.size()), &written, nullptr);
+		}
+	}
+}
+
+/// <summary>
+/// Log を標準出力にも書くようにする。WinMain のアプリはコンソールを持たないので、標準出力がリダイレクトされていなければ
+/// 起動したコンソールにつなぐ（エクスプローラーから起動したときなど、つなぐコンソールが無ければ OutputDebugString だけのまま）
+/// </summary>
+void EnableConsoleLog()
+{
+	HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+	if (output == nullptr || output == INVALID_HANDLE_VALUE) {
+		if (!AttachConsole(ATTACH_PARENT_PROCESS)) {
+			return;
+		}
+		output = CreateFileW(L"CONOUT$", GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr);
+		if (output == INVALID_HANDLE_VALUE) {
+			return;
+		}
+	}
+	gLogOutput = output;
 }
 
 // DXGI_DEBUG系のGUID定義
@@ -603,14 +631,14 @@ const int32_t kClientHeight = 720;
 ID3D12Device* device = nullptr;
 IDXGIFactory7* dxgiFactory = nullptr;
 ID3D12CommandQueue* commandQueue = nullptr;
-ID3D12CommandAllocator* commandAllocator = nullptr;
+// コマンドアロケーターは GPU が読み終えるまで Reset できないので、同時に進めるフレームの数だけ持つ
+ID3D12CommandAllocator* commandAllocators[kMaxFramesInFlight] = {};
 ID3D12GraphicsCommandList* commandList = nullptr;
 IDXGISwapChain4* swapChain = nullptr;
 ID3D12DescriptorHeap* rtvDescriptorHeap = nullptr;
 ID3D12Resource* swapChainResources[2] = { nullptr, nullptr };
 D3D12_CPU_DESCRIPTOR_HANDLE rtvHandles[2];
 ID3D12Fence* fence = nullptr;
-UINT64 fenceValue = 0;
 HANDLE fenceEvent = nullptr;
 ComPtr<IXAudio2> xAudio2;
 IXAudio2MasteringVoice* masteringVoice;
@@ -620,6 +648,565 @@ LightingType currentLighting = LightingType::Lambert;
 
 SoundData soundData1 = SoundLoadWave("Resources/fanfare.wav");
 
+/// <summary>
+/// モデルを読み込む。元ファイルの内容と設定が同じ焼き込み済みメッシュがあればそれを使い、
+/// 無ければOBJを解析し、最適化・メッシュレットの分割・LODの生成をしてから焼き込み済みメッシュを書き出す
+/// </summary>
+/// <param name="directoryPath">ファイルのあるディレクトリ</param>
+/// <param name="filename">OBJのファイル名</param>
+/// <param name="optimizeMesh">焼き込む前にメッシュを最適化するかどうか</param>
+/// <returns>読み込んだモデルデータ</returns>
+ModelData LoadModel(const std::string& directoryPath, const std::string& filename, bool optimizeMesh = true)
+{
+	const ModelLoadOptions options = MakeModelLoadOptions(filename, optimizeMesh);
+
+	MappedFile sourceFile = MapFileReadOnly(directoryPath + "/" + filename);
+	assert(IsFileMapped(sourceFile));
+	const uint64_t cacheKey = MakeCookedMeshKey(sourceFile.data, sourceFile.size, options);
+	const std::string cookedPath = GetCookedMeshPath(cacheKey);
+
+	ModelData modelData;
+	if (!ReadCookedMesh(cookedPath, cacheKey, modelData)) {
+		// キャッシュが無いのでOBJを解析して焼き込む
+		modelData = LoadObjFile(directoryPath, filename);
+		if (options.optimizeMesh) {
+			// 最適化の前後の ACMR / ATVR は tests/MeshOptimizationTest で見る
+			for (MeshData& mesh : modelData.meshes) {
+				OptimizeMesh(mesh);
+			}
+		}
+		for (MeshData& mesh : modelData.meshes) {
+			BuildMeshlets(mesh);
+			BuildMeshLods(mesh);
+			ComputeMeshBounds(mesh);
+		}
+		if (!WriteCookedMesh(cookedPath, cacheKey, modelData)) {
+			Log(std::format(L"Failed to write cooked mesh: {}", ConvertString(cookedPath)));
+		}
+	}
+
+	UnmapFile(&sourceFile);
+	return modelData;
+}
+
+/// <summary>
+/// 行列演算を命令セットごとに測り、速度とスカラー版との誤差をログに出す
+/// </summary>
+void BenchmarkMathKernels()
+{
+	const size_t kMatrixCount = 1024;
+	const size_t kAngleCount = 4096;
+	const int32_t kIterations = 2000;
+	// 誤差の許容範囲（積はスカラー版との差、逆行列は M * M^-1 と単位行列の差、sin / cos は倍精度の値との差）
+	const float kMultiplyTolerance = 1.0e-6f;
+	const float kInverseTolerance = 1.0e-5f;
+	const float kSinCosTolerance = 1.0e-6f;
+
+	// 半分はアフィン行列、残りは対角を大きくして条件数を抑えた一般の行列
+	std::mt19937 random(20250419);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<Matrix4x4> matrices(kMatrixCount);
+	std::vector<Transform> transforms(kMatrixCount);
+	const MathBackend detectedBackend = DetectMathBackend();
+	SetMathBackend(MathBackend::Scalar);
+	for (size_t i = 0; i < kMatrixCount; ++i) {
+		transforms[i] = {
+			{ 1.25f + 0.75f * unit(random), 1.25f + 0.75f * unit(random), 1.25f + 0.75f * unit(random) },
+			{ 3.14159265f * unit(random), 3.14159265f * unit(random), 3.14159265f * unit(random) },
+			{ 10.0f * unit(random), 10.0f * unit(random), 10.0f * unit(random) } };
+		if (i % 2 == 0) {
+			matrices[i] = MakeAffineMatrix(transforms[i].scale, transforms[i].rotate, transforms[i].translate);
+		} else {
+			for (int row = 0; row < 4; ++row) {
+				for (int col = 0; col < 4; ++col) {
+					matrices[i].m[row][col] = unit(random) + (row == col ? 4.0f : 0.0f);
+				}
+			}
+		}
+	}
+	std::vector<float> angles(kAngleCount);
+	for (float& angle : angles) {
+		angle = 100.0f * unit(random);
+	}
+
+	// スカラー版の結果を基準にする
+	std::vector<Matrix4x4> referenceProducts(kMatrixCount);
+	for (size_t i = 0; i < kMatrixCount; ++i) {
+		referenceProducts[i] = Multiply(matrices[i], matrices[(i + 1) % kMatrixCount]);
+	}
+
+	Log(std::format(L"[bench-math] detected backend: {}", GetMathBackendName(detectedBackend)));
+
+	std::vector<Matrix4x4> results(kMatrixCount);
+	std::vector<float> sines(kAngleCount);
+	std::vector<float> cosines(kAngleCount);
+	double scalarNanoseconds[4] = {};
+	for (MathBackend backend : { MathBackend::Scalar, MathBackend::SSE41, MathBackend::AVX2 }) {
+		if (!SetMathBackend(backend)) {
+			Log(std::format(L"[bench-math] {}: not supported on this CPU / build", GetMathBackendName(backend)));
+			continue;
+		}
+
+		// 1回あたりのナノ秒を測る
+		auto measure = [&](auto&& body, size_t count) {
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int32_t iteration = 0; iteration < kIterations; ++iteration) {
+				body();
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+			return std::chrono::duration<double, std::nano>(end - start).count() / (double(kIterations) * count);
+		};
+		const double nanoseconds[4] = {
+			measure([&] {
+				for (size_t i = 0; i < kMatrixCount; ++i) {
+					results[i] = Multiply(matrices[i], matrices[(i + 1) % kMatrixCount]);
+				}
+			}, kMatrixCount),
+			measure([&] {
+				for (size_t i = 0; i < kMatrixCount; ++i) {
+					results[i] = Inverse(matrices[i]);
+				}
+			}, kMatrixCount),
+			measure([&] {
+				SinCosBatch(angles.data(), sines.data(), cosines.data(), kAngleCount);
+			}, kAngleCount),
+			measure([&] {
+				for (size_t i = 0; i < kMatrixCount; ++i) {
+					results[i] = MakeAffineMatrix(transforms[i].scale, transforms[i].rotate, transforms[i].translate);
+				}
+			}, kMatrixCount),
+		};
+		if (backend == MathBackend::Scalar) {
+			std::copy(nanoseconds, nanoseconds + 4, scalarNanoseconds);
+		}
+
+		// 誤差を調べる
+		float multiplyError = 0.0f;
+		float inverseError = 0.0f;
+		for (size_t i = 0; i < kMatrixCount; ++i) {
+			multiplyError = std::max(multiplyError, MaxMatrixDifference(Multiply(matrices[i], matrices[(i + 1) % kMatrixCount]), referenceProducts[i]));
+			inverseError = std::max(inverseError, MaxMatrixDifference(MultiplyScalar(matrices[i], Inverse(matrices[i])), MakeIdentity4x4()));
+		}
+		SinCosBatch(angles.data(), sines.data(), cosines.data(), kAngleCount);
+		float sinCosError = 0.0f;
+		for (size_t i = 0; i < kAngleCount; ++i) {
+			sinCosError = std::max(sinCosError, float(fabs(sines[i] - sin(double(angles[i])))));
+			sinCosError = std::max(sinCosError, float(fabs(cosines[i] - cos(double(angles[i])))));
+		}
+		const bool isWithinTolerance = multiplyError <= kMultiplyTolerance && inverseError <= kInverseTolerance && sinCosError <= kSinCosTolerance;
+
+		Log(std::format(L"[bench-math] {}: multiply {:.2f} ns (x{:.2f}), inverse {:.2f} ns (x{:.2f}), sincos {:.2f} ns/angle (x{:.2f}), MakeAffineMatrix {:.2f} ns (x{:.2f})",
+			GetMathBackendName(backend),
+			nanoseconds[0], scalarNanoseconds[0] / nanoseconds[0], nanoseconds[1], scalarNanoseconds[1] / nanoseconds[1],
+			nanoseconds[2], scalarNanoseconds[2] / nanoseconds[2], nanoseconds[3], scalarNanoseconds[3] / nanoseconds[3]));
+		Log(std::format(L"[bench-math] {}: max error multiply {:.2e} (<= {:.0e}), inverse {:.2e} (<= {:.0e}), sincos {:.2e} (<= {:.0e}) {}",
+			GetMathBackendName(backend), multiplyError, kMultiplyTolerance, inverseError, kInverseTolerance,
+			sinCosError, kSinCosTolerance, isWithinTolerance ? L"PASS" : L"FAIL"));
+	}
+
+	SetMathBackend(detectedBackend);
+}
+
+/// <summary>
+/// 逆行列の求め方ごとに速度と精度を測り、ログに出す（一般の Inverse と、行列の種類を使う方法の比較）
+/// </summary>
+void BenchmarkMatrixInverse()
+{
+	const size_t kMatrixCount = 1024;
+	const int32_t kIterations = 2000;
+	// M * M^-1 と単位行列の差、MakeViewMatrix と Inverse(MakeAffineMatrix) の差の許容範囲
+	const float kInverseTolerance = 1.0e-5f;
+
+	// 拡大率がばらばらの SRT 行列と、拡大縮小なしの剛体変換
+	std::mt19937 random(20250420);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<Transform> transforms(kMatrixCount);
+	std::vector<Matrix4x4> scaleRotateTranslateMatrices(kMatrixCount);
+	std::vector<Matrix4x4> rigidMatrices(kMatrixCount);
+	for (size_t i = 0; i < kMatrixCount; ++i) {
+		transforms[i] = {
+			{ 1.25f + 0.75f * unit(random), 1.25f + 0.75f * unit(random), 1.25f + 0.75f * unit(random) },
+			{ 3.14159265f * unit(random), 3.14159265f * unit(random), 3.14159265f * unit(random) },
+			{ 10.0f * unit(random), 10.0f * unit(random), 10.0f * unit(random) } };
+		scaleRotateTranslateMatrices[i] = MakeAffineMatrix(transforms[i].scale, transforms[i].rotate, transforms[i].translate);
+		rigidMatrices[i] = MakeAffineMatrix({ 1.0f, 1.0f, 1.0f }, transforms[i].rotate, transforms[i].translate);
+	}
+
+	std::vector<Matrix4x4> results(kMatrixCount);
+	auto measure = [&](const wchar_t* name, const std::vector<Matrix4x4>& matrices, auto&& invert) {
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int32_t iteration = 0; iteration < kIterations; ++iteration) {
+			for (size_t i = 0; i < kMatrixCount; ++i) {
+				results[i] = invert(i);
+			}
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+
+		float error = 0.0f;
+		for (size_t i = 0; i < kMatrixCount; ++i) {
+			error = std::max(error, MaxMatrixDifference(MultiplyScalar(matrices[i], invert(i)), MakeIdentity4x4()));
+		}
+		Log(std::format(L"[bench-inverse] {}: {:.2f} ns, max |M * M^-1 - I| {:.2e} {}",
+			name, std::chrono::duration<double, std::nano>(end - start).count() / (double(kIterations) * kMatrixCount),
+			error, error <= kInverseTolerance ? L"PASS" : L"FAIL"));
+	};
+
+	Log(std::format(L"[bench-inverse] math backend: {}", GetMathBackendName(gMathKernels.backend)));
+	measure(L"SRT  InverseScalar", scaleRotateTranslateMatrices, [&](size_t i) { return InverseScalar(scaleRotateTranslateMatrices[i]); });
+	measure(L"SRT  Inverse (general)", scaleRotateTranslateMatrices, [&](size_t i) { return Inverse(scaleRotateTranslateMatrices[i]); });
+	measure(L"SRT  Inverse (Affine)", scaleRotateTranslateMatrices, [&](size_t i) { return Inverse(scaleRotateTranslateMatrices[i], MatrixType::Affine); });
+	measure(L"SRT  Inverse (ScaleRotateTranslate)", scaleRotateTranslateMatrices, [&](size_t i) { return Inverse(scaleRotateTranslateMatrices[i], MatrixType::ScaleRotateTranslate); });
+	measure(L"Rigid Inverse (general)", rigidMatrices, [&](size_t i) { return Inverse(rigidMatrices[i]); });
+	measure(L"Rigid Inverse (Rigid)", rigidMatrices, [&](size_t i) { return Inverse(rigidMatrices[i], MatrixType::Rigid); });
+	measure(L"Camera Inverse(MakeAffineMatrix)", scaleRotateTranslateMatrices, [&](size_t i) {
+		return Inverse(MakeAffineMatrix(transforms[i].scale, transforms[i].rotate, transforms[i].translate));
+	});
+	measure(L"Camera MakeViewMatrix", scaleRotateTranslateMatrices, [&](size_t i) { return MakeViewMatrix(transforms[i]); });
+
+	// 毎フレームの Inverse(cameraMatrix) を置き換えても同じビュー行列になることを確かめる
+	float viewDifference = 0.0f;
+	for (size_t i = 0; i < kMatrixCount; ++i) {
+		viewDifference = std::max(viewDifference, MaxMatrixDifference(MakeViewMatrix(transforms[i]), InverseScalar(scaleRotateTranslateMatrices[i])));
+	}
+	Log(std::format(L"[bench-inverse] max |MakeViewMatrix - InverseScalar(MakeAffineMatrix)| {:.2e} {}",
+		viewDifference, viewDifference <= kInverseTolerance ? L"PASS" : L"FAIL"));
+}
+
+/// <summary>
+/// 1k / 10k / 100k 個の物体の World と WVP を、物体ごとに計算する今までの方法と SoA でまとめて計算する方法で測り、ログに出す
+/// </summary>
+void BenchmarkTransformBatch()
+{
+	// 今までの方法との差の許容範囲
+	const float kTolerance = 1.0e-5f;
+	const Matrix4x4 viewMatrix = MakeViewMatrix(Transform{ { 1.0f, 1.0f, 1.0f }, { 0.3f, 0.5f, 0.0f }, { 0.0f, 2.0f, -20.0f } });
+	const Matrix4x4 projectionMatrix = MakePerspectiveFovMatrix(0.45f, float(kClientWidth) / float(kClientHeight), 0.1f, 100.0f);
+	const MathBackend detectedBackend = gMathKernels.backend;
+
+	std::mt19937 random(20250421);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	for (size_t objectCount : { size_t(1000), size_t(10000), size_t(100000) }) {
+		// 1回の計測で合計 200 万個ほど計算するよう繰り返す
+		const size_t iterations = std::max<size_t>(1, 2000000 / objectCount);
+
+		std::vector<Transform> objects(objectCount);
+		TransformSoA transforms;
+		for (Transform& object : objects) {
+			object = {
+				{ 1.0f + 0.5f * unit(random), 1.0f + 0.5f * unit(random), 1.0f + 0.5f * unit(random) },
+				{ 3.14159265f * unit(random), 3.14159265f * unit(random), 3.14159265f * unit(random) },
+				{ 50.0f * unit(random), 50.0f * unit(random), 50.0f * unit(random) } };
+			AddTransform(transforms, object);
+		}
+
+		// 今までの方法（物体ごとに MakeAffineMatrix と Multiply を2回）
+		SetMathBackend(detectedBackend);
+		std::vector<TransformationMatrix> reference(objectCount);
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t iteration = 0; iteration < iterations; ++iteration) {
+			for (size_t i = 0; i < objectCount; ++i) {
+				const Matrix4x4 worldMatrix = MakeAffineMatrix(objects[i].scale, objects[i].rotate, objects[i].translate);
+				reference[i].WVP = Multiply(worldMatrix, Multiply(viewMatrix, projectionMatrix));
+				reference[i].World = worldMatrix;
+			}
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		const double perObjectNanoseconds = std::chrono::duration<double, std::nano>(end - start).count() / double(iterations * objectCount);
+		Log(std::format(L"[bench-transforms] {} objects, per-object path ({}): {:.2f} ns/object",
+			objectCount, GetMathBackendName(detectedBackend), perObjectNanoseconds));
+
+		std::vector<TransformationMatrix> batched(objectCount);
+		for (MathBackend backend : { MathBackend::Scalar, MathBackend::SSE41, MathBackend::AVX2 }) {
+			if (!SetMathBackend(backend)) {
+				continue;
+			}
+
+			start = std::chrono::high_resolution_clock::now();
+			for (size_t iteration = 0; iteration < iterations; ++iteration) {
+				ComputeTransformationMatrices(transforms, Multiply(viewMatrix, projectionMatrix), batched.data());
+			}
+			end = std::chrono::high_resolution_clock::now();
+			const double batchedNanoseconds = std::chrono::duration<double, std::nano>(end - start).count() / double(iterations * objectCount);
+
+			float error = 0.0f;
+			for (size_t i = 0; i < objectCount; ++i) {
+				error = std::max(error, MaxMatrixDifference(batched[i].WVP, reference[i].WVP));
+				error = std::max(error, MaxMatrixDifference(batched[i].World, reference[i].World));
+			}
+			Log(std::format(L"[bench-transforms] {} objects, SoA batch ({}): {:.2f} ns/object (x{:.2f}), max error {:.2e} {}",
+				objectCount, GetMathBackendName(backend), batchedNanoseconds, perObjectNanoseconds / batchedNanoseconds,
+				error, error <= kTolerance ? L"PASS" : L"FAIL"));
+		}
+	}
+
+	SetMathBackend(detectedBackend);
+}
+
+/// <summary>
+/// オイラー角の MakeAffineMatrix とクォータニオンの MakeAffineMatrix、補間（Slerp / Nlerp）の速度を比べ、ログに出す
+/// </summary>
+void BenchmarkQuaternionTransforms()
+{
+	const size_t kObjectCount = 100000;
+	const int32_t kIterations = 20;
+	// オイラー角から作った行列と、同じ回転のクォータニオンから作った行列の差の許容範囲
+	const float kTolerance = 1.0e-5f;
+
+	std::mt19937 random(20250422);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<Transform> eulerTransforms(kObjectCount);
+	std::vector<QuaternionTransform> quaternionTransforms(kObjectCount);
+	std::vector<Quaternion> targetRotations(kObjectCount);
+	for (size_t i = 0; i < kObjectCount; ++i) {
+		eulerTransforms[i] = {
+			{ 1.0f + 0.5f * unit(random), 1.0f + 0.5f * unit(random), 1.0f + 0.5f * unit(random) },
+			{ 3.14159265f * unit(random), 3.14159265f * unit(random), 3.14159265f * unit(random) },
+			{ 50.0f * unit(random), 50.0f * unit(random), 50.0f * unit(random) } };
+		quaternionTransforms[i] = { eulerTransforms[i].scale, MakeQuaternionFromEuler(eulerTransforms[i].rotate), eulerTransforms[i].translate };
+		targetRotations[i] = MakeQuaternionFromEuler({ 3.14159265f * unit(random), 3.14159265f * unit(random), 3.14159265f * unit(random) });
+	}
+
+	std::vector<Matrix4x4> eulerMatrices(kObjectCount);
+	std::vector<Matrix4x4> quaternionMatrices(kObjectCount);
+	auto measure = [&](auto&& body) {
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int32_t iteration = 0; iteration < kIterations; ++iteration) {
+			body(iteration);
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::nano>(end - start).count() / (double(kIterations) * kObjectCount);
+	};
+
+	const double eulerNanoseconds = measure([&](int32_t) {
+		for (size_t i = 0; i < kObjectCount; ++i) {
+			eulerMatrices[i] = MakeAffineMatrix(eulerTransforms[i].scale, eulerTransforms[i].rotate, eulerTransforms[i].translate);
+		}
+	});
+	const double quaternionNanoseconds = measure([&](int32_t) {
+		for (size_t i = 0; i < kObjectCount; ++i) {
+			quaternionMatrices[i] = MakeAffineMatrix(quaternionTransforms[i]);
+		}
+	});
+	// 毎フレーム目標の向きへ補間してから行列にする場合
+	std::vector<Quaternion> rotations(kObjectCount);
+	const double nlerpNanoseconds = measure([&](int32_t iteration) {
+		const float t = float(iteration + 1) / float(kIterations);
+		for (size_t i = 0; i < kObjectCount; ++i) {
+			rotations[i] = Nlerp(quaternionTransforms[i].rotate, targetRotations[i], t);
+			quaternionMatrices[i] = MakeAffineMatrix(quaternionTransforms[i].scale, rotations[i], quaternionTransforms[i].translate);
+		}
+	});
+	const double slerpNanoseconds = measure([&](int32_t iteration) {
+		const float t = float(iteration + 1) / float(kIterations);
+		for (size_t i = 0; i < kObjectCount; ++i) {
+			rotations[i] = Slerp(quaternionTransforms[i].rotate, targetRotations[i], t);
+			quaternionMatrices[i] = MakeAffineMatrix(quaternionTransforms[i].scale, rotations[i], quaternionTransforms[i].translate);
+		}
+	});
+
+	// 同じ回転から同じ行列ができていること、Slerp の両端が元の回転になっていることを確かめる
+	float matrixError = 0.0f;
+	float slerpError = 0.0f;
+	for (size_t i = 0; i < kObjectCount; ++i) {
+		matrixError = std::max(matrixError, MaxMatrixDifference(MakeAffineMatrix(quaternionTransforms[i]), eulerMatrices[i]));
+		slerpError = std::max(slerpError, MaxMatrixDifference(MakeRotateMatrix(Slerp(quaternionTransforms[i].rotate, targetRotations[i], 0.0f)), MakeRotateMatrix(quaternionTransforms[i].rotate)));
+		slerpError = std::max(slerpError, MaxMatrixDifference(MakeRotateMatrix(Slerp(quaternionTransforms[i].rotate, targetRotations[i], 1.0f)), MakeRotateMatrix(targetRotations[i])));
+	}
+
+	Log(std::format(L"[bench-quaternion] {} objects ({}): Euler MakeAffineMatrix {:.2f} ns, quaternion MakeAffineMatrix {:.2f} ns (x{:.2f}), Nlerp + matrix {:.2f} ns, Slerp + matrix {:.2f} ns",
+		kObjectCount, GetMathBackendName(gMathKernels.backend), eulerNanoseconds, quaternionNanoseconds, eulerNanoseconds / quaternionNanoseconds,
+		nlerpNanoseconds, slerpNanoseconds));
+	Log(std::format(L"[bench-quaternion] max |Euler - quaternion| {:.2e}, max Slerp endpoint error {:.2e} {}",
+		matrixError, slerpError, (matrixError <= kTolerance && slerpError <= kTolerance) ? L"PASS" : L"FAIL"));
+}
+
+/// <summary>
+/// --bench-bindless: AssignBindlessMaterials でマテリアルとテクスチャの組に番号を振った一覧を、記録する backend に出し、
+/// 各描画が元と同じマテリアルとテクスチャで描かれること・テクスチャを設定するコマンドが1回になることを確かめる。
+/// WriteBindlessMaterials が書くマテリアルの中身と、番号を振る時間もログに出す
+/// </summary>
+void BenchmarkBindlessMaterials()
+{
+	const uint32_t kPipelineCount = 2;
+	const uint32_t kMaterialCount = 4;
+	const uint32_t kTextureCount = 8;
+	const uint32_t kModelCount = 8;
+	const uint32_t kMeshCount = 16;
+	const uint32_t kDrawCount = 10000;
+	// テクスチャのヒープの中での番号（0 は ImGui が使う想定で、とびとびにする）
+	uint32_t textureDescriptorIndices[kTextureCount];
+	for (uint32_t i = 0; i < kTextureCount; ++i) {
+		textureDescriptorIndices[i] = 1 + i * 3;
+	}
+	bool passed = true;
+
+	std::mt19937 random(22);
+	InstancedDrawList drawList;
+	std::fill_n(ReserveInstances(drawList, kDrawCount), kDrawCount, TransformationMatrix{ MakeIdentity4x4(), MakeIdentity4x4() });
+	std::uniform_real_distribution<float> depthDistribution(0.1f, 100.0f);
+	// 描画ごとに firstInstance が違うので、それで元のマテリアルとテクスチャを引く
+	std::vector<std::pair<uint32_t, uint32_t>> expected(kDrawCount);
+	for (uint32_t i = 0; i < kDrawCount; ++i) {
+		const DrawState state = { random() % kPipelineCount, random() % kMaterialCount, random() % kTextureCount };
+		const uint32_t meshIndex = random() % kMeshCount;
+		AddInstancedDraw(drawList, state, random() % kModelCount, meshIndex, { meshIndex * 600, 600 }, i, 1, depthDistribution(random));
+		expected[i] = { state.material, textureDescriptorIndices[state.texture] };
+	}
+
+	// 元の状態のまま並べ替えたもの
+	InstancedDrawList boundDrawList = drawList;
+	SortInstancedDrawList(boundDrawList);
+	RecordingCommandBackend boundBackend;
+	const DrawSubmitStatistics boundStatistics = SubmitInstancedDrawList(boundDrawList, boundBackend);
+
+	// bindless にして並べ替えたもの
+	BindlessMaterialTable table;
+	const int32_t kIterations = 100;
+	double assignMicroseconds = 0.0;
+	InstancedDrawList bindlessDrawList;
+	for (int32_t iteration = 0; iteration < kIterations; ++iteration) {
+		bindlessDrawList = drawList;
+		const auto start = std::chrono::high_resolution_clock::now();
+		AssignBindlessMaterials(table, bindlessDrawList, kMaterialCount, textureDescriptorIndices, kTextureCount);
+		assignMicroseconds += std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+	assignMicroseconds /= kIterations;
+	SortInstancedDrawList(bindlessDrawList);
+	RecordingCommandBackend bindlessBackend;
+	const DrawSubmitStatistics bindlessStatistics = SubmitInstancedDrawList(bindlessDrawList, bindlessBackend);
+
+	// 記録したコマンドを頭から追い、描画ごとに実際に使われるマテリアルとテクスチャを元と比べる
+	auto countMismatches = [&](const RecordingCommandBackend& backend, bool bindless) {
+		uint32_t material = 0;
+		uint32_t texture = 0;
+		uint32_t firstInstance = 0;
+		uint32_t mismatches = 0;
+		uint32_t drawn = 0;
+		for (const RecordedCommand& command : backend.commands) {
+			switch (command.type) {
+			case RecordedCommandType::SetMaterial: material = command.arguments[0]; break;
+			case RecordedCommandType::SetTexture: texture = command.arguments[0]; break;
+			case RecordedCommandType::SetFirstInstance: firstInstance = command.arguments[0]; break;
+			case RecordedCommandType::DrawIndexedInstanced: {
+				const std::pair<uint32_t, uint32_t> used = bindless ?
+					std::pair<uint32_t, uint32_t>{ table.entries[material].material, table.entries[material].textureDescriptorIndex } :
+					std::pair<uint32_t, uint32_t>{ material, textureDescriptorIndices[texture] };
+				mismatches += (used != expected[firstInstance]) ? 1 : 0;
+				++drawn;
+				break;
+			}
+			default: break;
+			}
+		}
+		return mismatches + (drawn == kDrawCount ? 0 : 1);
+	};
+	const uint32_t boundMismatches = countMismatches(boundBackend, false);
+	const uint32_t bindlessMismatches = countMismatches(bindlessBackend, true);
+
+	// 組は重ならず、深さの桁は元のキーのまま残っていること
+	uint32_t duplicateEntries = 0;
+	for (size_t i = 0; i < table.entries.size(); ++i) {
+		for (size_t j = i + 1; j < table.entries.size(); ++j) {
+			duplicateEntries += (table.entries[i].material == table.entries[j].material && table.entries[i].textureDescriptorIndex == table.entries[j].textureDescriptorIndex) ? 1 : 0;
+		}
+	}
+	const uint64_t depthMask = (uint64_t(1) << kDrawKeyDepthBits) - 1;
+	uint32_t depthMismatches = 0;
+	for (const InstancedDraw& draw : bindlessDrawList.draws) {
+		const InstancedDraw& original = drawList.draws[draw.firstInstance];
+		depthMismatches += ((draw.sortKey & depthMask) != (original.sortKey & depthMask)) ? 1 : 0;
+	}
+
+	// 書き出したマテリアルは、元の値にテクスチャの番号だけを入れたもの
+	Material materials[kMaterialCount]{};
+	for (uint32_t i = 0; i < kMaterialCount; ++i) {
+		materials[i].color = { float(i), 0.5f, 0.25f, 1.0f };
+		materials[i].lightingType = int32_t(i % 3);
+		materials[i].uvTransform = MakeIdentity4x4();
+		materials[i].uvTransform.m[3][0] = float(i);
+	}
+	const size_t kStride = 256;
+	std::vector<uint8_t> packed(kStride * table.entries.size());
+	WriteBindlessMaterials(table, materials, packed.data(), kStride);
+	uint32_t packingErrors = 0;
+	for (size_t i = 0; i < table.entries.size(); ++i) {
+		Material written;
+		std::memcpy(&written, packed.data() + kStride * i, sizeof(Material));
+		const Material& source = materials[table.entries[i].material];
+		packingErrors += (written.textureIndex != table.entries[i].textureDescriptorIndex) ? 1 : 0;
+		packingErrors += (written.color.x != source.color.x || written.lightingType != source.lightingType || written.uvTransform.m[3][0] != source.uvTransform.m[3][0]) ? 1 : 0;
+	}
+
+	auto countOf = [](const RecordingCommandBackend& backend, RecordedCommandType type) { return backend.commandCounts[static_cast<size_t>(type)]; };
+	const uint32_t boundTextureCommands = countOf(boundBackend, RecordedCommandType::SetTexture);
+	const uint32_t bindlessTextureCommands = countOf(bindlessBackend, RecordedCommandType::SetTexture);
+	passed = (boundMismatches == 0) && (bindlessMismatches == 0) && (duplicateEntries == 0) && (depthMismatches == 0) && (packingErrors == 0) &&
+		(bindlessTextureCommands == 1) && (table.entries.size() <= kMaterialCount * kTextureCount) &&
+		(bindlessStatistics.stateCommands <= boundStatistics.stateCommands);
+	Log(std::format(L"[bench-bindless] {} draws: bound textures {} state commands (texture {}, material {}), bindless {} state commands (texture {}, material {}), {} packed materials, AssignBindlessMaterials {:.1f} us",
+		kDrawCount, boundStatistics.stateCommands, boundTextureCommands, countOf(boundBackend, RecordedCommandType::SetMaterial),
+		bindlessStatistics.stateCommands, bindlessTextureCommands, countOf(bindlessBackend, RecordedCommandType::SetMaterial), table.entries.size(), assignMicroseconds));
+	Log(std::format(L"[bench-bindless] mismatches: bound {}, bindless {}, duplicate entries {}, depth {}, packing {}",
+		boundMismatches, bindlessMismatches, duplicateEntries, depthMismatches, packingErrors));
+	Log(std::format(L"[bench-bindless] {}", passed ? L"PASS" : L"FAIL"));
+}
+
+/// <summary>
+/// コマンドラインに指定した引数が含まれているか（空白区切りの単語単位で比べる）
+/// </summary>
+/// <param name="commandLine">WinMain に渡されたコマンドライン</param>
+/// <param name="option">探す引数（例: "--bench-math"）</param>
+bool HasCommandLineOption(const std::string& commandLine, const char* option)
+{
+	std::istringstream stream(commandLine);
+	for (std::string argument; stream >> argument;) {
+		if (argument == option) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/// <summary>
+/// コマンドライン引数で指定されたベンチマークを実行する
+/// </summary>
+/// <param name="commandLine">WinMain に渡されたコマンドライン</param>
+/// <returns>何か実行した場合は true（ウィンドウは作らずに終了する）</returns>
+bool RunBenchmarkMode(const std::string& commandLine)
+{
+	auto hasOption = [&commandLine](const char* option) {
+		return HasCommandLineOption(commandLine, option);
+	};
+
+	// コンソールから起動したときに結果が見えるよう、ベンチマークの Log は標準出力にも書く
+	if (commandLine.find("--bench-") != std::string::npos) {
+		EnableConsoleLog();
+	}
+
+	bool hasRun = false;
+	if (hasOption("--bench-math")) {
+		BenchmarkMathKernels();
+		hasRun = true;
+	}
+	if (hasOption("--bench-inverse")) {
+		BenchmarkMatrixInverse();
+		hasRun = true;
+	}
+	if (hasOption("--bench-transforms")) {
+		BenchmarkTransformBatch();
+		hasRun = true;
+	}
+	if (hasOption("--bench-quaternion")) {
+		BenchmarkQuaternionTransforms();
+		hasRun = true;
+	}
+	if (hasOption("--bench-bindless")) {
+		BenchmarkBindlessMaterials();
+		hasRun = true;
+	}
+	return hasRun;
+}
+
 // ウィンドウプロシージャ（標準）
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam) {
 	if (ImGui_ImplWin32_WndProcHandler(hwnd, msg, wparam, lparam)) {
@@ -635,7 +1222,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam) {
 }
 
 // エントリーポイント
-int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int) {
 
 
 	char exePath[MAX_PATH]{};
@@ -643,6 +1230,17 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 	std::filesystem::path exeDir = std::filesystem::path(exePath).parent_path();
 	std::filesystem::current_path(exeDir);
 
+	// ベンチマークの指定があれば実行して終了する
+	if (RunBenchmarkMode(lpCmdLine)) {
+		return 0;
+	}
+
+	// 比較用に --full-vertex-format で従来の 40 バイト頂点に戻せるようにする
+	const bool useCompactVertexFormat = !HasCommandLineOption(lpCmdLine, "--full-vertex-format");
+	// 比較用に --bound-textures で、描画ごとにテクスチャのディスクリプタテーブルを設定し直す方法に戻せるようにする
+	// （デバイスが bindless に対応していないときも、デバイスを作った後でこちらに切り替える）
+	bool useBindlessTextures = !HasCommandLineOption(lpCmdLine, "--bound-textures");
+
 
 	HRESULT hr = CoInitializeEx(0, COINIT_MULTITHREADED);
 
@@ -690,6 +1288,18 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 	hr = D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&device));
 	assert(SUCCEEDED(hr));
 
+	// 数を決めない SRV の範囲（bindless のテクスチャの表）は Resource Binding Tier 2 から使える。
+	// Tier 1 では SRV が 128 個までに限られるので、描画ごとにテーブルを設定し直す方法に戻す
+	if (useBindlessTextures) {
+		D3D12_FEATURE_DATA_D3D12_OPTIONS options{};
+		hr = device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options));
+		if (FAILED(hr) || options.ResourceBindingTier < D3D12_RESOURCE_BINDING_TIER_2) {
+			useBindlessTextures = false;
+			Log(std::format(L"Resource binding tier {} does not support bindless textures; falling back to --bound-textures",
+				SUCCEEDED(hr) ? static_cast<int>(options.ResourceBindingTier) : 0));
+		}
+	}
+
 	// DescriptorSizeを保存しておく
 	const uint32_t descriptorSizeSRV = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 	const uint32_t descriptorSizeRTV = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
@@ -698,20 +1308,33 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 	// RTV用のヒープでディスクリプタの数は２。
 	ID3D12DescriptorHeap* rtvDescriptorHeap = CreateDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, 2, false);
 
-	// SRV用のヒープでディスクリプタの数は128.
-	ID3D12DescriptorHeap* srvDescriptorHeap = CreateDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 128, true);
+	// 同時に進めるフレームの数。CPU は GPU より最大でこの数だけ先のフレームを作れる
+	const uint32_t kFramesInFlight = 2;
+
+	// SRV用のヒープ。テクスチャなどずっと使うディスクリプタの領域と、フレームごとに使い捨てる領域を DescriptorAllocator で配る
+	const uint32_t kPersistentSrvDescriptorCount = 4096;
+	const uint32_t kTransientSrvDescriptorCountPerFrame = 256;
+	DescriptorAllocator srvDescriptorAllocator;
+	InitializeDescriptorAllocator(srvDescriptorAllocator, 0, kPersistentSrvDescriptorCount, kTransientSrvDescriptorCountPerFrame, kFramesInFlight);
+	ID3D12DescriptorHeap* srvDescriptorHeap = CreateDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, GetDescriptorHeapSize(srvDescriptorAllocator), true);
+	// テクスチャの SRV はシェーダーから見えないヒープ（同じ番号）に作っておき、フレームごとに使い捨ての領域へコピーして使う。
+	// GPU はコピーしたものを読むので、ずっと使う領域のディスクリプタは差し替えたらすぐに解放できる
+	// （シェーダーから見えるヒープは CPU から読めないので、コピー元にはできない）
+	ID3D12DescriptorHeap* srvStagingDescriptorHeap = CreateDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, srvDescriptorAllocator.transientBase, false);
 
 	// コマンドキュー作成
 	D3D12_COMMAND_QUEUE_DESC queueDesc{};
 	hr = device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&commandQueue));
 	assert(SUCCEEDED(hr));
 
-	// コマンドアロケータ作成
-	hr = device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commandAllocator));
-	assert(SUCCEEDED(hr));
+	// コマンドアロケータ作成（フレームごと）
+	for (uint32_t frame = 0; frame < kFramesInFlight; ++frame) {
+		hr = device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commandAllocators[frame]));
+		assert(SUCCEEDED(hr));
+	}
 
 	// コマンドリスト作成
-	hr = device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, commandAllocator, nullptr, IID_PPV_ARGS(&commandList));
+	hr = device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, commandAllocators[0], nullptr, IID_PPV_ARGS(&commandList));
 	assert(SUCCEEDED(hr));
 
 	// スワップチェイン作成
@@ -736,7 +1359,11 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 	ImGui::CreateContext();
 	ImGui::StyleColorsDark();
 	ImGui_ImplWin32_Init(hwnd);
-	ImGui_ImplDX12_Init(device, swapChainDesc.BufferCount, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, srvDescriptorHeap, srvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), srvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+	// ImGui はフォントのテクスチャにディスクリプタを1つ使う
+	const DescriptorHandle imguiFontDescriptor = AllocateDescriptor(srvDescriptorAllocator);
+	const uint32_t imguiFontDescriptorIndex = GetDescriptorHeapIndex(srvDescriptorAllocator, imguiFontDescriptor);
+	ImGui_ImplDX12_Init(device, kFramesInFlight, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, srvDescriptorHeap,
+		GetCPUDescriptorHandle(srvDescriptorHeap, descriptorSizeSRV, imguiFontDescriptorIndex), GetGPUDescriptorHandle(srvDescriptorHeap, descriptorSizeSRV, imguiFontDescriptorIndex));
 
 	HRESULT result = XAudio2Create(&xAudio2, 0, XAUDIO2_DEFAULT_PROCESSOR);
 	assert(SUCCEEDED(result));
@@ -753,6 +1380,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 	assert(SUCCEEDED(hr));
 	fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 	assert(fenceEvent != nullptr);
+	D3D12FrameFence frameFence{ commandQueue, fence, fenceEvent };
+	FrameRing frameRing;
+	InitializeFrameRing(frameRing, kFramesInFlight);
 
 	// dxcCompilerを初期化
 	IDxcUtils* dxcUtils = nullptr;
@@ -766,69 +1396,33 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 	hr = dxcUtils->CreateDefaultIncludeHandler(&includeHandler);
 	assert(SUCCEEDED(hr));
 
-	// Textureを読んで転送する
-	DirectX::ScratchImage mipImages = LoadTexture("Resources/uvChecker.png");
-	const DirectX::TexMetadata& metadata = mipImages.GetMetadata();
-	ID3D12Resource* textureResource = CreateTextureResource(device, metadata);
-	UploadTextureData(textureResource, mipImages);
-
-	// 2枚目のTextureを読んで転送する
-	DirectX::ScratchImage mipImages2 = LoadTexture("Resources/monsterBall.png");
-	const DirectX::TexMetadata& metadata2 = mipImages2.GetMetadata();
-	ID3D12Resource* textureResource2 = CreateTextureResource(device, metadata2);
-	UploadTextureData(textureResource2, mipImages2);
-
-	// checkerBoard.png を読み込む
-	DirectX::ScratchImage mipImages3 = LoadTexture("Resources/checkerBoard.png");
-	const DirectX::TexMetadata& metadata3 = mipImages3.GetMetadata();
-	ID3D12Resource* textureResource3 = CreateTextureResource(device, metadata3);
-	UploadTextureData(textureResource3, mipImages3);
-
-	//metaDataを基にSRVの設定
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
-	srvDesc.Format = metadata.format;
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;// 2Dテクスチャ
-	srvDesc.Texture2D.MipLevels = UINT(metadata.mipLevels);
-
-	// SRVを作成するDescriptorHeapの場所を決める
-	D3D12_CPU_DESCRIPTOR_HANDLE textureSrvHandleCPU = srvDescriptorHeap->GetCPUDescriptorHandleForHeapStart();
-	D3D12_GPU_DESCRIPTOR_HANDLE textureSrvHandleGPU = srvDescriptorHeap->GetGPUDescriptorHandleForHeapStart();
-	// 先頭はImGuiが使っているのでその次を使う
-	textureSrvHandleCPU.ptr += device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-	textureSrvHandleGPU.ptr += device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-	// SRVを作成
-	device->CreateShaderResourceView(
-		textureResource,
-		&srvDesc,
-		textureSrvHandleCPU);
-
-	// metaDataを基にSRVの設定
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc2{};
-	srvDesc2.Format = metadata2.format;
-	srvDesc2.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc2.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D; // 2Dテクスチャ
-	srvDesc2.Texture2D.MipLevels = UINT(metadata2.mipLevels);
-
-	// SRVを作成するDescriptorHeapの場所を決める
-	D3D12_CPU_DESCRIPTOR_HANDLE textureSrvHandleCPU2 = GetCPUDescriptorHandle(srvDescriptorHeap, descriptorSizeSRV, 2);
-	D3D12_GPU_DESCRIPTOR_HANDLE textureSrvHandleGPU2 = GetGPUDescriptorHandle(srvDescriptorHeap, descriptorSizeSRV, 2);
-	// SRVを作成
-	device->CreateShaderResourceView(textureResource2, &srvDesc2, textureSrvHandleCPU2);
-
-	// checkerBoard.png のメタデータを元にSRV設定
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc3{};
-	srvDesc3.Format = metadata3.format;
-	srvDesc3.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc3.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc3.Texture2D.MipLevels = UINT(metadata3.mipLevels);
-
-	// SRVを作成するDescriptorHeap内の3番目のスロットを指定
-	D3D12_CPU_DESCRIPTOR_HANDLE textureSrvHandleCPU3 = GetCPUDescriptorHandle(srvDescriptorHeap, descriptorSizeSRV, 3);
-	D3D12_GPU_DESCRIPTOR_HANDLE textureSrvHandleGPU3 = GetGPUDescriptorHandle(srvDescriptorHeap, descriptorSizeSRV, 3);
-
-	// SRV作成
-	device->CreateShaderResourceView(textureResource3, &srvDesc3, textureSrvHandleCPU3);
+	// Textureはワーカーで読み込み（デコードとミップマップの作成）、転送は読み終えたフレームで描画スレッドが行う
+	// （TextureCooker でクックした DDS があれば、ミップマップを作らずにそちらを読む）
+	const uint32_t kSceneTextureCount = _countof(kSceneTextureFilePaths);
+	TextureLoadHandle textureLoads[kSceneTextureCount];
+	for (uint32_t i = 0; i < kSceneTextureCount; ++i) {
+		textureLoads[i] = LoadTextureAsync(kSceneTextureFilePaths[i], GetWorkerPool());
+	}
+	ID3D12Resource* textureResources[kSceneTextureCount] = {};
+
+	// metaDataを基にSRVをコピー元のヒープに作る（プレースホルダーと読み終えたTextureで共通）
+	auto createTextureSrv = [&](ID3D12Resource* resource, const DirectX::TexMetadata& metadata, uint32_t descriptorIndex) {
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc{};
+		srvDesc.Format = metadata.format;
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;// 2Dテクスチャ
+		srvDesc.Texture2D.MipLevels = UINT(metadata.mipLevels);
+		device->CreateShaderResourceView(resource, &srvDesc, GetCPUDescriptorHandle(srvStagingDescriptorHeap, descriptorSizeSRV, descriptorIndex));
+	};
+
+	// 読み終えるまで代わりに見せるプレースホルダーのTextureは、ここで作って転送する
+	DirectX::ScratchImage placeholderImage = MakePlaceholderTexture();
+	ID3D12Resource* placeholderTextureResource = CreateTextureResource(device, placeholderImage.GetMetadata());
+	UploadTextureData(placeholderTextureResource, placeholderImage);
+	// すべてのTextureを読み終えたら（プレースホルダーを指すものがなくなったら）解放する
+	DescriptorHandle placeholderDescriptor = AllocateDescriptor(srvDescriptorAllocator);
+	const uint32_t placeholderDescriptorIndex = GetDescriptorHeapIndex(srvDescriptorAllocator, placeholderDescriptor);
+	createTextureSrv(placeholderTextureResource, placeholderImage.GetMetadata(), placeholderDescriptorIndex);
 
 
 	// ディスクリプタヒープの設定
@@ -837,9 +1431,15 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 	descriptorRange.NumDescriptors = 1;
 	descriptorRange.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
 	descriptorRange.OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+	if (useBindlessTextures) {
+		// bindless のときはフレームのテクスチャの表の先頭から数を決めずに並べ、space1 の t0 からの配列として見る
+		descriptorRange.NumDescriptors = UINT_MAX;
+		descriptorRange.RegisterSpace = 1;
+		descriptorRange.OffsetInDescriptorsFromTableStart = 0;
+	}
 
 	// 1. RootParameter作成（CBV b0）
-	D3D12_ROOT_PARAMETER rootParameters[4] = {};
+	D3D12_ROOT_PARAMETER rootParameters[6] = {};
 
 	// [0] Material（b0）→ PixelShader用
 	rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
@@ -851,16 +1451,28 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 	rootParameters[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 	rootParameters[1].Descriptor.ShaderRegister = 1;
 
-	// [2] TransformationMatrix（b2）→ **VertexShader用**
-	rootParameters[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
-	rootParameters[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX; // ✅ ←重要
-	rootParameters[2].Descriptor.ShaderRegister = 2; // ✅ b2 を使う想定なら b2に
-
-	// [3] テクスチャ（t0）→ PixelShader用
-	rootParameters[3].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-	rootParameters[3].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
-	rootParameters[3].DescriptorTable.NumDescriptorRanges = 1;
-	rootParameters[3].DescriptorTable.pDescriptorRanges = &descriptorRange;
+	// [2] テクスチャ（t0）→ PixelShader用
+	rootParameters[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+	rootParameters[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+	rootParameters[2].DescriptorTable.NumDescriptorRanges = 1;
+	rootParameters[2].DescriptorTable.pDescriptorRanges = &descriptorRange;
+
+	// [3] 圧縮頂点の箱（b3）→ VertexShader用のルート定数
+	rootParameters[3].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+	rootParameters[3].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+	rootParameters[3].Constants.ShaderRegister = 3;
+	rootParameters[3].Constants.Num32BitValues = sizeof(VertexQuantization) / sizeof(uint32_t);
+
+	// [4] インスタンスごとの行列（t1）→ VertexShader用。StructuredBuffer なのでディスクリプタを作らずにルートで直接指す
+	rootParameters[4].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+	rootParameters[4].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+	rootParameters[4].Descriptor.ShaderRegister = 1;
+
+	// [5] インスタンスの先頭の位置（b4）→ VertexShader用のルート定数
+	rootParameters[5].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+	rootParameters[5].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+	rootParameters[5].Constants.ShaderRegister = 4;
+	rootParameters[5].Constants.Num32BitValues = 1;
 
 	D3D12_STATIC_SAMPLER_DESC staticSamplers[1] = {};
 	staticSamplers[0].Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR; // バイリニアフィルタ
@@ -992,29 +1604,40 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 	size_t vertexBufferSize = sizeof(VertexData) * vertexDataSphere.size();
 
 
+	// 頂点・インデックスバッファは、大きなページから切り出す（ページは終了まで解放しない）
+	const uint64_t kStaticUploadPageSize = 4 * 1024 * 1024;
+	UploadPageAllocator staticUploadAllocator;
+	InitializeUploadPageAllocator(staticUploadAllocator, kStaticUploadPageSize);
+	D3D12UploadPages staticUploadPages{ device };
+	// 毎フレーム書き換える定数とインスタンスの行列は、フレームごとにページから切り出し、GPU が読み終えたページを使い回す
+	const uint64_t kFrameUploadPageSize = 1024 * 1024;
+	UploadPageAllocator frameUploadAllocator;
+	InitializeUploadPageAllocator(frameUploadAllocator, kFrameUploadPageSize);
+	D3D12UploadPages frameUploadPages{ device };
+	// 頂点・インデックスの境界（頂点の要素の大きさの倍数にそろえる）
+	const uint64_t kGeometryAlignment = 16;
+
 	// --- Sprite用のリソースとビューを作成 ---
-	ID3D12Resource* vertexResourceSprite = CreateBufferResource(device, sizeof(VertexData) * 4);
-	ID3D12Resource* indexResourceSprite = CreateBufferResource(device, sizeof(uint32_t) * 6);
+	const UploadAllocation vertexAllocationSprite = AllocateUpload(staticUploadAllocator, staticUploadPages, sizeof(VertexData) * 4, kGeometryAlignment);
+	const UploadAllocation indexAllocationSprite = AllocateUpload(staticUploadAllocator, staticUploadPages, sizeof(uint32_t) * 6, kGeometryAlignment);
 
 	D3D12_VERTEX_BUFFER_VIEW vertexBufferViewSprite{};
-	vertexBufferViewSprite.BufferLocation = vertexResourceSprite->GetGPUVirtualAddress();
+	vertexBufferViewSprite.BufferLocation = staticUploadPages.GpuAddress(vertexAllocationSprite);
 	vertexBufferViewSprite.SizeInBytes = sizeof(VertexData) * 4;
 	vertexBufferViewSprite.StrideInBytes = sizeof(VertexData);
 
-	VertexData* vertexDataSprite = nullptr;
-	vertexResourceSprite->Map(0, nullptr, reinterpret_cast<void**>(&vertexDataSprite));
+	VertexData* vertexDataSprite = reinterpret_cast<VertexData*>(staticUploadPages.CpuAddress(vertexAllocationSprite));
 
 	D3D12_INDEX_BUFFER_VIEW indexBufferViewSprite{};
-	// リソースの先頭のアドレスから使う
-	indexBufferViewSprite.BufferLocation = indexResourceSprite->GetGPUVirtualAddress();
+	// 切り出した領域の先頭のアドレスから使う
+	indexBufferViewSprite.BufferLocation = staticUploadPages.GpuAddress(indexAllocationSprite);
 	// 使用するリソースのサイズはインデックス6つ分のサイズ
 	indexBufferViewSprite.SizeInBytes = sizeof(uint32_t) * 6;
 	// インデックスはuint32_tとする
 	indexBufferViewSprite.Format = DXGI_FORMAT_R32_UINT;
 
 	// インデックスリソースにデータを書き込む
-	uint32_t* indexDataSprite = nullptr;
-	indexResourceSprite->Map(0, nullptr, reinterpret_cast<void**>(&indexDataSprite));
+	uint32_t* indexDataSprite = reinterpret_cast<uint32_t*>(staticUploadPages.CpuAddress(indexAllocationSprite));
 	indexDataSprite[0] = 0;
 	indexDataSprite[1] = 1;
 	indexDataSprite[2] = 2;
@@ -1043,24 +1666,22 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 	vertexDataSprite[3].normal = { 0.0f, 0.0f, -1.0f };
 
 
-	// Sprite用マテリアルリソースを作成
-	// Sprite用マテリアルリソースを作成
-	ID3D12Resource* materialResourceSprite = CreateBufferResource(device, sizeof(Material));
-	Material* materialDataSprite = nullptr;
-	materialResourceSprite->Map(0, nullptr, reinterpret_cast<void**>(&materialDataSprite));
+	// マテリアルとライトは GPU が前のフレームで読んでいる間も書き換えるので、ここでは CPU 側に値を持ち、
+	// フレームの終わりに、そのフレームで frameUploadAllocator から切り出した定数バッファへ書き写す
+	Material modelMaterial{};
+	Material spriteMaterial{};
+	DirectionalLight directionalLight{};
+
+	// Sprite用マテリアル
+	Material* materialDataSprite = &spriteMaterial;
 	materialDataSprite->color = Vector4(1.0f, 1.0f, 1.0f, 1.0f);
 	materialDataSprite->lightingType = 0;
 	
 
-	// Sprite用のTransformationMatrix用のリソースを作る
-	ID3D12Resource* transformationMatrixResourceSprite = CreateBufferResource(device, sizeof(Matrix4x4));
-	TransformationMatrix* transformationMatrixDataSprite = nullptr;
-	transformationMatrixResourceSprite->Map(0, nullptr, reinterpret_cast<void**>(&transformationMatrixDataSprite));
+	// Sprite の行列もモデルと同じインスタンスバッファに置く
 
-	// 通常モデル用のマテリアルリソースを作成
-	ID3D12Resource* materialResource = CreateBufferResource(device, sizeof(Material));
-	Material* materialData = nullptr;
-	materialResource->Map(0, nullptr, reinterpret_cast<void**>(&materialData));
+	// 通常モデル用のマテリアル
+	Material* materialData = &modelMaterial;
 	materialData->color = Vector4(1.0f, 1.0f, 1.0f, 1.0f);
 	materialData->lightingType = static_cast<int>(currentLighting); // ← 修正
 
@@ -1076,46 +1697,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 
 
 
-	// WVP + World用の定数バッファリソースを作る
-	// 球用（Sphere）
-	ID3D12Resource* wvpResourceSphere = CreateBufferResource(device, sizeof(TransformationMatrix));
-	TransformationMatrix* wvpDataSphere = nullptr;
-	wvpResourceSphere->Map(0, nullptr, reinterpret_cast<void**>(&wvpDataSphere));
-	wvpDataSphere->WVP = MakeIdentity4x4();
-	wvpDataSphere->World = MakeIdentity4x4();
-
-	// モデル用（Model）
-	ID3D12Resource* wvpResourceModel = CreateBufferResource(device, sizeof(TransformationMatrix));
-	TransformationMatrix* wvpDataModel = nullptr;
-	wvpResourceModel->Map(0, nullptr, reinterpret_cast<void**>(&wvpDataModel));
-	wvpDataModel->WVP = MakeIdentity4x4();
-	wvpDataModel->World = MakeIdentity4x4();
-
-	ID3D12Resource* wvpResourceTeapot = CreateBufferResource(device, sizeof(TransformationMatrix));
-	TransformationMatrix* wvpDataTeapot = nullptr;
-	wvpResourceTeapot->Map(0, nullptr, reinterpret_cast<void**>(&wvpDataTeapot));
-	wvpDataTeapot->WVP = MakeIdentity4x4();
-	wvpDataTeapot->World = MakeIdentity4x4();
-
-	ID3D12Resource* wvpResourceBunny = CreateBufferResource(device, sizeof(TransformationMatrix));
-	TransformationMatrix* wvpDataBunny = nullptr;
-	wvpResourceBunny->Map(0, nullptr, reinterpret_cast<void**>(&wvpDataBunny));
-	wvpDataBunny->WVP = MakeIdentity4x4();
-	wvpDataBunny->World = MakeIdentity4x4();
-
-	ID3D12Resource* wvpResourceMultiMesh = CreateBufferResource(device, sizeof(TransformationMatrix));
-	TransformationMatrix* wvpDataMultiMesh = nullptr;
-	wvpResourceMultiMesh->Map(0, nullptr, reinterpret_cast<void**>(&wvpDataMultiMesh));
-	wvpDataMultiMesh->WVP = MakeIdentity4x4();
-	wvpDataMultiMesh->World = MakeIdentity4x4();
-
-
-	// ライト用の定数バッファリソースを作成
-	ID3D12Resource* directionalLightResource = CreateBufferResource(device, sizeof(DirectionalLight));
-	// 書き込み用ポインタの定義（これが必要）
-	DirectionalLight* directionalLightData = nullptr;
-	// マップしてアドレス取得
-	directionalLightResource->Map(0, nullptr, reinterpret_cast<void**>(&directionalLightData));
+
+	// ライト
+	DirectionalLight* directionalLightData = &directionalLight;
 	// 初期化（単位ベクトルで）
 	directionalLightData->color = Vector4(1.0f, 1.0f, 1.0f, 1.0f);
 	directionalLightData->direction = Vector3(0.0f, -1.0f, 0.0f); // 正規化されてること
@@ -1153,6 +1737,37 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 	inputLayoutDesc.pInputElementDescs = inputElementDescs;
 	inputLayoutDesc.NumElements = _countof(inputElementDescs);
 
+	// 圧縮頂点（CompactVertexData）用のインプットレイアウト
+	D3D12_INPUT_ELEMENT_DESC compactInputElementDescs[3] = {};
+
+	compactInputElementDescs[0].SemanticName = "POSITION";
+	compactInputElementDescs[0].SemanticIndex = 0;
+	compactInputElementDescs[0].Format = DXGI_FORMAT_R16G16B16A16_UNORM;
+	compactInputElementDescs[0].AlignedByteOffset = D3D12_APPEND_ALIGNED_ELEMENT;
+	compactInputElementDescs[0].InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+	compactInputElementDescs[0].InputSlot = 0;
+	compactInputElementDescs[0].InstanceDataStepRate = 0;
+
+	compactInputElementDescs[1].SemanticName = "TEXCOORD";
+	compactInputElementDescs[1].SemanticIndex = 0;
+	compactInputElementDescs[1].Format = DXGI_FORMAT_R16G16_FLOAT;
+	compactInputElementDescs[1].AlignedByteOffset = D3D12_APPEND_ALIGNED_ELEMENT;
+	compactInputElementDescs[1].InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+	compactInputElementDescs[1].InputSlot = 0;
+	compactInputElementDescs[1].InstanceDataStepRate = 0;
+
+	compactInputElementDescs[2].SemanticName = "NORMAL";
+	compactInputElementDescs[2].SemanticIndex = 0;
+	compactInputElementDescs[2].Format = DXGI_FORMAT_R16G16_SNORM;
+	compactInputElementDescs[2].AlignedByteOffset = D3D12_APPEND_ALIGNED_ELEMENT;
+	compactInputElementDescs[2].InputSlot = 0;
+	compactInputElementDescs[2].InputSlotClass = D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+	compactInputElementDescs[2].InstanceDataStepRate = 0;
+
+	D3D12_INPUT_LAYOUT_DESC compactInputLayoutDesc{};
+	compactInputLayoutDesc.pInputElementDescs = compactInputElementDescs;
+	compactInputLayoutDesc.NumElements = _countof(compactInputElementDescs);
+
 	// ブレンドステイト
 	D3D12_BLEND_DESC blendDesc{};
 	// すべての色要素を書き込む
@@ -1167,16 +1782,13 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 	rasterizerDesc.FillMode = D3D12_FILL_MODE_SOLID;
 
 	// Shaderをコンパイルする
-	IDxcBlob* vertexShaderBlob = CompileShader(L"Object3D.VS.hlsl", L"vs_6_0", dxcUtils, dxcCompiler, includeHandler);
-	assert(vertexShaderBlob != nullptr);
-	IDxcBlob* pixelShaderBlob = CompileShader(L"Object3D.PS.hlsl", L"ps_6_0", dxcUtils, dxcCompiler, includeHandler);
+	IDxcBlob* pixelShaderBlob = CompileShader(L"Object3D.PS.hlsl", L"ps_6_0", dxcUtils, dxcCompiler, includeHandler, useBindlessTextures ? L"mainBindless" : L"main");
 	assert(pixelShaderBlob != nullptr);
 
-	// PSOを生成
+	// PSOの共通の設定（頂点シェーダーはインスタンス描画用のものをそれぞれのPSOで設定する）
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC graphicsPipelineStateDesc{};
 	graphicsPipelineStateDesc.pRootSignature = rootSignature;
 	graphicsPipelineStateDesc.InputLayout = inputLayoutDesc;
-	graphicsPipelineStateDesc.VS = { vertexShaderBlob->GetBufferPointer(),vertexShaderBlob->GetBufferSize() };
 	graphicsPipelineStateDesc.PS = { pixelShaderBlob->GetBufferPointer(),pixelShaderBlob->GetBufferSize() };
 	graphicsPipelineStateDesc.BlendState = blendDesc;
 	graphicsPipelineStateDesc.RasterizerState = rasterizerDesc;
@@ -1201,29 +1813,40 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 	// どのように画面に色を打ち込むかの設定
 	graphicsPipelineStateDesc.SampleDesc.Count = 1;
 	graphicsPipelineStateDesc.SampleMask = D3D12_DEFAULT_SAMPLE_MASK;
-	// 実際に生成
-	ID3D12PipelineState* graphicsPipelineState = nullptr;
-	hr = device->CreateGraphicsPipelineState(&graphicsPipelineStateDesc, IID_PPV_ARGS(&graphicsPipelineState));
+
+	// インスタンス描画用のPSO（行列はインスタンスバッファから読む）
+	IDxcBlob* instancedVertexShaderBlob = CompileShader(L"Object3D.VS.hlsl", L"vs_6_0", dxcUtils, dxcCompiler, includeHandler, L"mainInstanced");
+	assert(instancedVertexShaderBlob != nullptr);
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC instancedGraphicsPipelineStateDesc = graphicsPipelineStateDesc;
+	instancedGraphicsPipelineStateDesc.VS = { instancedVertexShaderBlob->GetBufferPointer(),instancedVertexShaderBlob->GetBufferSize() };
+	ID3D12PipelineState* instancedGraphicsPipelineState = nullptr;
+	hr = device->CreateGraphicsPipelineState(&instancedGraphicsPipelineStateDesc, IID_PPV_ARGS(&instancedGraphicsPipelineState));
 	assert(SUCCEEDED(hr));
 
+	// 圧縮頂点用のインスタンス描画のPSO（さらにインプットレイアウトが違う）
+	IDxcBlob* compactVertexShaderBlob = CompileShader(L"Object3D.VS.hlsl", L"vs_6_0", dxcUtils, dxcCompiler, includeHandler, L"mainCompactInstanced");
+	assert(compactVertexShaderBlob != nullptr);
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC compactGraphicsPipelineStateDesc = graphicsPipelineStateDesc;
+	compactGraphicsPipelineStateDesc.InputLayout = compactInputLayoutDesc;
+	compactGraphicsPipelineStateDesc.VS = { compactVertexShaderBlob->GetBufferPointer(),compactVertexShaderBlob->GetBufferSize() };
+	ID3D12PipelineState* compactGraphicsPipelineState = nullptr;
+	hr = device->CreateGraphicsPipelineState(&compactGraphicsPipelineStateDesc, IID_PPV_ARGS(&compactGraphicsPipelineState));
+	assert(SUCCEEDED(hr));
 
-	ID3D12Resource* vertexResourceSphere = CreateBufferResource(
-		device, sizeof(VertexData) * vertexDataSphere.size());
 
-	VertexData* vertexDataSpherePtr = nullptr;
-	vertexResourceSphere->Map(0, nullptr, reinterpret_cast<void**>(&vertexDataSpherePtr));
-	memcpy(vertexDataSpherePtr, vertexDataSphere.data(), sizeof(VertexData) * vertexDataSphere.size());
-	vertexResourceSphere->Unmap(0, nullptr);
+	const UploadAllocation vertexAllocationSphere = AllocateUpload(
+		staticUploadAllocator, staticUploadPages, sizeof(VertexData) * vertexDataSphere.size(), kGeometryAlignment);
+	memcpy(staticUploadPages.CpuAddress(vertexAllocationSphere), vertexDataSphere.data(), sizeof(VertexData) * vertexDataSphere.size());
 
 	D3D12_VERTEX_BUFFER_VIEW vertexBufferViewSphere{};
-	vertexBufferViewSphere.BufferLocation = vertexResourceSphere->GetGPUVirtualAddress();
+	vertexBufferViewSphere.BufferLocation = staticUploadPages.GpuAddress(vertexAllocationSphere);
 	vertexBufferViewSphere.SizeInBytes = sizeof(VertexData) * static_cast<UINT>(vertexDataSphere.size());
 	vertexBufferViewSphere.StrideInBytes = sizeof(VertexData);
 
-	ModelData modelData = LoadObjFile("resources", "plane.obj");
-	ModelData teapotModel = LoadObjFile("resources", "teapot.obj");
-	ModelData modelDataBunny = LoadObjFile("Resources", "bunny.obj");
-	ModelData multiMeshModel = LoadObjFile("Resources", "multiMesh.obj");
+	ModelData modelData = LoadModel("resources", "plane.obj");
+	ModelData teapotModel = LoadModel("resources", "teapot.obj");
+	ModelData modelDataBunny = LoadModel("Resources", "bunny.obj");
+	ModelData multiMeshModel = LoadModel("Resources", "multiMesh.obj");
 
 
 
@@ -1235,39 +1858,195 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 		multiMeshModel     // 旧: multiMeshModel
 	};
 
+	// WVP + World用の定数バッファリソースを作る
+	// 3D の物体はシーングラフのノードにし、動いたノードとその子孫だけワールド行列を計算し直す。
+	// ルートの番号は ObjectIndex と同じにする
+	enum ObjectIndex : uint32_t {
+		kObjectSphere,
+		kObjectModel,     // Plane
+		kObjectTeapot,
+		kObjectBunny,
+		kObjectMultiMesh,
+		kObjectCount
+	};
+	SceneGraph scene;
+	for (const Transform* transform : { &sphereTransform, &modelTransform, &teapotTransform, &bunnyTransform, &multiMeshTransform }) {
+		AddSceneNode(scene, kSceneNoParent, *transform);
+	}
+
+	// マルチメッシュの各パーツは本体の子ノードにして、本体を動かすと一緒に動くようにする
+	const Transform identityTransform = { { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+	std::vector<uint32_t> multiMeshPartNodes;
+	for (size_t i = 0; i < multiMeshModel.meshes.size(); ++i) {
+		multiMeshPartNodes.push_back(AddSceneNode(scene, kObjectMultiMesh, identityTransform));
+	}
+
+	// モデルのメッシュごとに、どのノードの行列で描くか（allModels と同じ並び）
+	std::vector<std::vector<uint32_t>> meshNodesPerModel = {
+		std::vector<uint32_t>(modelData.meshes.size(), kObjectModel),
+		std::vector<uint32_t>(teapotModel.meshes.size(), kObjectTeapot),
+		std::vector<uint32_t>(modelDataBunny.meshes.size(), kObjectBunny),
+		multiMeshPartNodes
+	};
+
+	// 視錐台カリングの対象にする、シーンに置いたメッシュの一覧（モデルの順に並ぶ）
+	struct SceneMesh {
+		uint32_t modelIndex;
+		uint32_t meshIndex;
+		uint32_t node;
+	};
+	std::vector<SceneMesh> sceneMeshes;
+	for (uint32_t modelIndex = 0; modelIndex < meshNodesPerModel.size(); ++modelIndex) {
+		for (uint32_t meshIndex = 0; meshIndex < meshNodesPerModel[modelIndex].size(); ++meshIndex) {
+			sceneMeshes.push_back({ modelIndex, meshIndex, meshNodesPerModel[modelIndex][meshIndex] });
+		}
+	}
+	// メッシュのワールド空間の箱で BVH を作る。毎フレーム、動いたメッシュの箱だけ BVH に反映し、
+	// BVH で視錐台カリングして見えるメッシュの番号を詰めた一覧を作る。クリックで選ぶときもこの BVH にレイを飛ばす
+	auto getSceneMeshWorldBounds = [&](const SceneMesh& sceneMesh) {
+		return MakeAabb(TransformBounds(allModels[sceneMesh.modelIndex].meshes[sceneMesh.meshIndex].bounds, scene.worldMatrices[sceneMesh.node]));
+	};
+	UpdateSceneGraph(scene);
+	InstanceBvh sceneBvh;
+	{
+		std::vector<Aabb> sceneMeshBounds;
+		for (const SceneMesh& sceneMesh : sceneMeshes) {
+			sceneMeshBounds.push_back(getSceneMeshWorldBounds(sceneMesh));
+		}
+		BuildInstanceBvh(sceneBvh, sceneMeshBounds);
+	}
+	std::vector<uint32_t> visibleSceneMeshes(sceneMeshes.size());
+	size_t visibleSceneMeshCount = 0;
+	// クリック（ゲームパッドなら X ボタンで画面の中央）で選んだメッシュ。ImGui ではこのメッシュのノードを編集する
+	uint32_t selectedSceneMesh = UINT32_MAX;
+	RayTriangleHit selectedHit{};
+
+	// クリックしたときに実際の三角形と交差させるための、メッシュごとの三角形の BVH（モデル空間なので一度だけ作る）
+	std::vector<std::vector<MeshTriangleBvh>> triangleBvhsPerModel(allModels.size());
+	for (size_t modelIndex = 0; modelIndex < allModels.size(); ++modelIndex) {
+		triangleBvhsPerModel[modelIndex].resize(allModels[modelIndex].meshes.size());
+		for (size_t meshIndex = 0; meshIndex < allModels[modelIndex].meshes.size(); ++meshIndex) {
+			BuildMeshTriangleBvh(triangleBvhsPerModel[modelIndex][meshIndex], allModels[modelIndex].meshes[meshIndex]);
+		}
+	}
+
+	// 計算結果は CPU 側の連続した配列に置く（アップロードヒープは読み出しが遅いので、カリングなどではこちらを読む）
+	const uint32_t sceneNodeCount = static_cast<uint32_t>(GetSceneNodeCount(scene));
+	std::vector<TransformationMatrix> objectMatrices(sceneNodeCount, { MakeIdentity4x4(), MakeIdentity4x4() });
+
+	// インスタンス描画のモードで、ティーポットの Transform を基準に格子状に並べる数（一辺）と間隔
+	const uint32_t kInstanceGridSize = 16;
+	const float kInstanceGridSpacing = 3.0f;
+	const uint32_t instanceGridCount = kInstanceGridSize * kInstanceGridSize;
+	TransformSoA instanceGridTransforms;
+	for (uint32_t i = 0; i < instanceGridCount; ++i) {
+		AddTransform(instanceGridTransforms, teapotTransform);
+	}
+	std::vector<TransformationMatrix> instanceGridMatrices(instanceGridCount);
+	BoundsSoA instanceGridBounds;
+	std::vector<uint32_t> visibleGridInstances(instanceGridCount);
+	size_t visibleGridInstanceCount = 0;
+	// インスタンスはモデル単位でカリングするので、ティーポットのすべてのメッシュを囲む箱を使う
+	MeshBounds teapotBounds{};
+	{
+		Aabb box = MakeEmptyAabb();
+		for (const MeshData& mesh : teapotModel.meshes) {
+			box = Union(box, MakeAabb(mesh.bounds));
+		}
+		teapotBounds.center = { (box.minimum.x + box.maximum.x) * 0.5f, (box.minimum.y + box.maximum.y) * 0.5f, (box.minimum.z + box.maximum.z) * 0.5f };
+		teapotBounds.extent = { (box.maximum.x - box.minimum.x) * 0.5f, (box.maximum.y - box.minimum.y) * 0.5f, (box.maximum.z - box.minimum.z) * 0.5f };
+		teapotBounds.radius = sqrtf(teapotBounds.extent.x * teapotBounds.extent.x + teapotBounds.extent.y * teapotBounds.extent.y + teapotBounds.extent.z * teapotBounds.extent.z);
+	}
+
+	// すべての物体の行列を並べるインスタンスバッファ。先頭にシーンのノードの行列をノードの番号のまま並べ、
+	// その後ろにインスタンス描画で見えている分とスプライトを詰める。描画の一覧を作るときに、マップしたバッファへ直接詰める。
+	// GPU が前のフレームの行列を読んでいる間に書き換えないよう、毎フレーム frameUploadAllocator から切り出す
+	const size_t instanceCapacity = sceneNodeCount + instanceGridCount + 1;
+	InstancedDrawList drawList;
+	// シーンのノードの行列が並ぶ先頭の位置（ノード n の行列は sceneFirstInstance + n 番目）
+	uint32_t sceneFirstInstance = 0;
+
 	// 結果保存用
-	std::vector<std::vector<ID3D12Resource*>> vertexResourcesPerModel;
 	std::vector<std::vector<D3D12_VERTEX_BUFFER_VIEW>> vertexBufferViewsPerModel;
+	std::vector<std::vector<D3D12_INDEX_BUFFER_VIEW>> indexBufferViewsPerModel;
+	std::vector<std::vector<VertexQuantization>> vertexQuantizationsPerModel;
+
+	// モデルを描くときのPSO（圧縮頂点かどうかでインプットレイアウトが変わる。どちらもインスタンス描画）
+	ID3D12PipelineState* modelPipelineState = useCompactVertexFormat ? compactGraphicsPipelineState : instancedGraphicsPipelineState;
 
 	for (const auto& model : allModels) {
-		std::vector<ID3D12Resource*> vertexResources;
 		std::vector<D3D12_VERTEX_BUFFER_VIEW> vertexBufferViews;
+		std::vector<D3D12_INDEX_BUFFER_VIEW> indexBufferViews;
+		std::vector<VertexQuantization> vertexQuantizations;
 
 		for (const auto& mesh : model.meshes) {
-			// 頂点バッファリソース作成
-			ID3D12Resource* vertexResource = CreateBufferResource(
-				device, sizeof(VertexData) * mesh.vertices.size());
-			vertexResources.push_back(vertexResource);
-
-			// マッピングとコピー
-			VertexData* vertexData = nullptr;
-			vertexResource->Map(0, nullptr, reinterpret_cast<void**>(&vertexData));
-			std::memcpy(vertexData, mesh.vertices.data(),
-				sizeof(VertexData) * mesh.vertices.size());
-			vertexResource->Unmap(0, nullptr);
+			// 圧縮する場合は、GPUに送る前に誤差が許容範囲に収まっていることを確かめる
+			VertexQuantization quantization = ComputeVertexQuantization(mesh.vertices);
+			std::vector<CompactVertexData> compactVertices;
+			if (useCompactVertexFormat) {
+				compactVertices = EncodeCompactVertices(mesh.vertices, quantization);
+				assert(IsCompactVertexErrorWithinBounds(MeasureCompactVertexError(mesh.vertices, compactVertices, quantization)));
+			}
+			vertexQuantizations.push_back(quantization);
+
+			const void* vertexSource = useCompactVertexFormat ? static_cast<const void*>(compactVertices.data()) : static_cast<const void*>(mesh.vertices.data());
+			const UINT vertexStride = useCompactVertexFormat ? UINT(sizeof(CompactVertexData)) : UINT(sizeof(VertexData));
+			const size_t vertexBytes = size_t(vertexStride) * mesh.vertices.size();
+
+			// 頂点バッファを切り出してコピー
+			const UploadAllocation vertexAllocation = AllocateUpload(staticUploadAllocator, staticUploadPages, vertexBytes, kGeometryAlignment);
+			std::memcpy(staticUploadPages.CpuAddress(vertexAllocation), vertexSource, vertexBytes);
 
 			// ビュー作成
 			D3D12_VERTEX_BUFFER_VIEW vbv{};
-			vbv.BufferLocation = vertexResource->GetGPUVirtualAddress();
-			vbv.SizeInBytes = UINT(sizeof(VertexData) * mesh.vertices.size());
-			vbv.StrideInBytes = sizeof(VertexData);
+			vbv.BufferLocation = staticUploadPages.GpuAddress(vertexAllocation);
+			vbv.SizeInBytes = UINT(vertexBytes);
+			vbv.StrideInBytes = vertexStride;
 			vertexBufferViews.push_back(vbv);
+
+			// インデックスバッファを切り出してコピー（LOD0 の後ろに LOD1 以降を続ける）
+			const size_t indexCount = mesh.indices.size() + mesh.lodIndices.size();
+			const UploadAllocation indexAllocation = AllocateUpload(
+				staticUploadAllocator, staticUploadPages, sizeof(uint32_t) * indexCount, kGeometryAlignment);
+
+			uint32_t* indexData = reinterpret_cast<uint32_t*>(staticUploadPages.CpuAddress(indexAllocation));
+			std::memcpy(indexData, mesh.indices.data(),
+				sizeof(uint32_t) * mesh.indices.size());
+			std::memcpy(indexData + mesh.indices.size(), mesh.lodIndices.data(),
+				sizeof(uint32_t) * mesh.lodIndices.size());
+
+			D3D12_INDEX_BUFFER_VIEW ibv{};
+			ibv.BufferLocation = staticUploadPages.GpuAddress(indexAllocation);
+			ibv.SizeInBytes = UINT(sizeof(uint32_t) * indexCount);
+			ibv.Format = DXGI_FORMAT_R32_UINT;
+			indexBufferViews.push_back(ibv);
 		}
 
-		vertexResourcesPerModel.push_back(vertexResources);
 		vertexBufferViewsPerModel.push_back(vertexBufferViews);
+		indexBufferViewsPerModel.push_back(indexBufferViews);
+		vertexQuantizationsPerModel.push_back(vertexQuantizations);
 	}
 
+	// 球とスプライトもモデルと同じ描画の一覧で描けるよう、1メッシュのモデルとしてモデルの後ろに加える（頂点は従来の形式のまま）
+	const uint32_t kSphereModelIndex = static_cast<uint32_t>(vertexBufferViewsPerModel.size());
+	const uint32_t kSpriteModelIndex = kSphereModelIndex + 1;
+	// 球は頂点を三角形ごとに並べてあるので、インデックスは 0, 1, 2, ... をそのまま並べる
+	const UploadAllocation indexAllocationSphere = AllocateUpload(staticUploadAllocator, staticUploadPages, sizeof(uint32_t) * vertexDataSphere.size(), kGeometryAlignment);
+	uint32_t* indexDataSphere = reinterpret_cast<uint32_t*>(staticUploadPages.CpuAddress(indexAllocationSphere));
+	for (uint32_t i = 0; i < vertexDataSphere.size(); ++i) {
+		indexDataSphere[i] = i;
+	}
+	D3D12_INDEX_BUFFER_VIEW indexBufferViewSphere{};
+	indexBufferViewSphere.BufferLocation = staticUploadPages.GpuAddress(indexAllocationSphere);
+	indexBufferViewSphere.SizeInBytes = UINT(sizeof(uint32_t) * vertexDataSphere.size());
+	indexBufferViewSphere.Format = DXGI_FORMAT_R32_UINT;
+	vertexBufferViewsPerModel.push_back({ vertexBufferViewSphere });
+	indexBufferViewsPerModel.push_back({ indexBufferViewSphere });
+	vertexQuantizationsPerModel.push_back({ ComputeVertexQuantization(vertexDataSphere) });
+	vertexBufferViewsPerModel.push_back({ vertexBufferViewSprite });
+	indexBufferViewsPerModel.push_back({ indexBufferViewSprite });
+	vertexQuantizationsPerModel.push_back({ VertexQuantization{} });
+
 
 
 	// ビューポート
@@ -1325,22 +2104,177 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 
 	bool useMonsterBall = false;
 
+	// 画面上の大きさで LOD を選び、LOD0 はメッシュレット単位でカリングしてからモデルを描く
+	std::vector<IndexRange> meshletDrawRanges;
+	MeshletCullStatistics meshletCullStatistics{};
+	float lodPixelThreshold = 1.0f;
+	uint32_t selectedLodLevel = 0;
+	// 描画の一覧で使うPSOとマテリアルの番号（D3D12CommandBackend の表の並び）。テクスチャの番号は kSceneTextureFilePaths の並び
+	enum DrawPipeline : uint32_t {
+		kPipelineModel,    // モデル（圧縮頂点のこともある）
+		kPipelineStandard, // 従来の頂点形式（球とスプライト）
+	};
+	enum DrawMaterial : uint32_t {
+		kMaterialModel,
+		kMaterialSprite,
+		kMaterialCount,
+	};
+	// 並びは kSceneTextureFilePaths と同じ（uvChecker / monsterBall / checkerBoard）。
+	// 読み終えたTextureのディスクリプタ（読み終えるまでは無効なハンドルで、プレースホルダーを使う）
+	DescriptorHandle textureDescriptors[kSceneTextureCount];
+	// コピー元のヒープの中での番号（読み終えるまではどれもプレースホルダー）
+	uint32_t textureDescriptorIndices[kSceneTextureCount];
+	// フレームのテクスチャの表（使い捨ての領域に並べたもの）の先頭からの番号。bindless のときにマテリアルへ入れる
+	uint32_t frameTextureSlots[kSceneTextureCount];
+	for (uint32_t i = 0; i < kSceneTextureCount; ++i) {
+		textureDescriptorIndices[i] = placeholderDescriptorIndex;
+		frameTextureSlots[i] = i;
+	}
+	BindlessMaterialTable bindlessMaterials;
+	int selectedTextureIndex = 0;
+	// 描画の一覧をコマンドリストに出す backend と、前のフレームで出した結果
+	D3D12CommandBackend commandBackend{
+		commandList,
+		{ modelPipelineState, instancedGraphicsPipelineState },
+		{},  // マテリアルの場所は毎フレーム切り出すので、描画の一覧を作った後に設定する
+		// テクスチャの場所も毎フレーム使い捨ての領域に並べ直すので、そのときに設定する。
+		// bindless のときは表の先頭を1つだけ持ち、フレームの最初の描画で設定する
+		std::vector<D3D12_GPU_DESCRIPTOR_HANDLE>(useBindlessTextures ? 1 : kSceneTextureCount),
+		&vertexBufferViewsPerModel, &indexBufferViewsPerModel, &vertexQuantizationsPerModel };
+	DrawSubmitStatistics drawSubmitStatistics{};
+
+	// 視錐台カリングで残ったメッシュのうち、このモデルのものだけを、メッシュごとのノードの行列で描く一覧に加える
+	// （同じノードが続く間は視錐台などを作り直さない）
+	auto addModelDrawsWithMeshletCulling = [&](int modelIndex, const Matrix4x4& projectionMatrix) {
+		const DrawState modelState = { kPipelineModel, kMaterialModel, static_cast<uint32_t>(selectedTextureIndex) };
+		Frustum frustum{};
+		Vector3 cameraPosition{};
+		float distance = 0.0f;
+		float worldScale = 0.0f;
+		float depth = 0.0f;
+		uint32_t currentNode = UINT32_MAX;
+
+		for (size_t visibleIndex = 0; visibleIndex < visibleSceneMeshCount; ++visibleIndex) {
+			const SceneMesh& sceneMesh = sceneMeshes[visibleSceneMeshes[visibleIndex]];
+			if (sceneMesh.modelIndex != uint32_t(modelIndex)) {
+				continue;
+			}
+			const size_t i = sceneMesh.meshIndex;
+			const MeshData& mesh = allModels[modelIndex].meshes[i];
+			const uint32_t node = sceneMesh.node;
+			if (node != currentNode) {
+				currentNode = node;
+				const Matrix4x4& worldMatrix = objectMatrices[node].World;
+
+				// WVP から取り出すとモデル空間の視錐台になるので、メッシュレットの境界をそのまま使える
+				frustum = MakeFrustumFromMatrix(objectMatrices[node].WVP);
+				// 原点のクリップ座標の w がビュー空間の z（並べ替えに使う）
+				depth = objectMatrices[node].WVP.m[3][3];
+				// ワールド行列は親と子の積なので、拡大縮小が回転と混ざって各行が直交しているとは限らない（Affine で逆行列を求める）
+				cameraPosition = TransformPoint(cameraTransform.translate, Inverse(worldMatrix, MatrixType::Affine));
+
+				// モデルの原点までの距離と、ワールド行列の一番大きい拡大率
+				const Vector3 toModel = { worldMatrix.m[3][0] - cameraTransform.translate.x, worldMatrix.m[3][1] - cameraTransform.translate.y, worldMatrix.m[3][2] - cameraTransform.translate.z };
+				distance = sqrtf(toModel.x * toModel.x + toModel.y * toModel.y + toModel.z * toModel.z);
+				worldScale = 0.0f;
+				for (int row = 0; row < 3; ++row) {
+					worldScale = std::max(worldScale, sqrtf(worldMatrix.m[row][0] * worldMatrix.m[row][0] + worldMatrix.m[row][1] * worldMatrix.m[row][1] + worldMatrix.m[row][2] * worldMatrix.m[row][2]));
+				}
+			}
+
+			meshletDrawRanges.clear();
+			selectedLodLevel = SelectMeshLod(mesh, distance, worldScale, projectionMatrix.m[1][1], float(kClientHeight), lodPixelThreshold);
+			if (selectedLodLevel == 0) {
+				CullMeshlets(mesh, frustum, cameraPosition, meshletDrawRanges, meshletCullStatistics);
+			} else {
+				// LOD のインデックスはバッファの LOD0 の後ろに置いてある
+				const MeshLod& lod = mesh.lods[selectedLodLevel - 1];
+				meshletDrawRanges.push_back({ static_cast<uint32_t>(mesh.indices.size()) + lod.indexOffset, lod.indexCount });
+			}
+
+			for (const IndexRange& range : meshletDrawRanges) {
+				AddInstancedDraw(drawList, modelState, uint32_t(modelIndex), uint32_t(i), range, sceneFirstInstance + node, 1, depth);
+			}
+		}
+	};
+
 	// --- メインループ ---
 	MSG msg{};
 	bool wasYPressed = false;
+	bool wasXPressed = false;
+	// スティックで動かす目標の向き（cameraTransform.rotate）へ毎フレーム少しずつ Slerp で追いかける、実際のカメラの向き
+	Quaternion cameraOrientation = MakeQuaternionFromEuler(cameraTransform.rotate);
+	// 1フレームで目標の向きへ近づける割合（大きいほど素早く追いつく）
+	const float kCameraRotationSmoothing = 0.2f;
 	while (msg.message != WM_QUIT) {
 		if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
 			TranslateMessage(&msg);
 			DispatchMessage(&msg);
 		} else {
-			hr = commandAllocator->Reset();
+			// このフレームで使う組を GPU が読み終えていなければ待つ（前のフレームの完了は待たない）
+			const uint32_t frameIndex = BeginFrame(frameRing, frameFence);
+			BeginDescriptorFrame(srvDescriptorAllocator, frameIndex);
+
+			// ワーカーで読み終えたTextureを転送して、プレースホルダーと差し替える。
+			// 前のフレームが読むのは使い捨ての領域にコピーしたものなので、差し替えたディスクリプタはすぐに解放できる
+			for (uint32_t i = 0; i < kSceneTextureCount; ++i) {
+				if (!textureLoads[i] || !IsTextureLoadFinished(*textureLoads[i])) {
+					continue;
+				}
+				const TextureLoadHandle textureLoad = std::move(textureLoads[i]);
+				if (textureLoad->state.load(std::memory_order_acquire) == TextureLoadState::Failed) {
+					Log(std::format(L"Failed to load texture {}. HRESULT: {}", textureLoad->filePath.wstring(), textureLoad->result));
+					continue;
+				}
+				const DirectX::TexMetadata& loadedMetadata = textureLoad->mipImages.GetMetadata();
+				textureResources[i] = CreateTextureResource(device, loadedMetadata);
+				if (!textureResources[i]) {
+					continue;
+				}
+				UploadTextureData(textureResources[i], textureLoad->mipImages);
+				const DescriptorHandle textureDescriptor = AllocateDescriptor(srvDescriptorAllocator);
+				assert(textureDescriptor.index != kInvalidDescriptorIndex);
+				if (IsDescriptorHandleValid(srvDescriptorAllocator, textureDescriptors[i])) {
+					FreeDescriptor(srvDescriptorAllocator, textureDescriptors[i]);
+				}
+				textureDescriptors[i] = textureDescriptor;
+				textureDescriptorIndices[i] = GetDescriptorHeapIndex(srvDescriptorAllocator, textureDescriptor);
+				createTextureSrv(textureResources[i], loadedMetadata, textureDescriptorIndices[i]);
+				Log(std::format(L"Loaded texture {} (decode {:.2f} ms, mips {:.2f} ms)", textureLoad->filePath.wstring(), textureLoad->decodeMilliseconds, textureLoad->mipMilliseconds));
+			}
+			// プレースホルダーを指すTextureがなくなったら、そのディスクリプタを返す（リソースは GPU が読み終える後片付けまで残す）
+			if (IsDescriptorHandleValid(srvDescriptorAllocator, placeholderDescriptor) &&
+				std::find(std::begin(textureDescriptorIndices), std::end(textureDescriptorIndices), placeholderDescriptorIndex) == std::end(textureDescriptorIndices)) {
+				FreeDescriptor(srvDescriptorAllocator, placeholderDescriptor);
+				placeholderDescriptor = {};
+			}
+
+			// このフレームのテクスチャの表を使い捨ての領域に並べる
+			const uint32_t frameTextureBase = AllocateTransientDescriptors(srvDescriptorAllocator, kSceneTextureCount);
+			assert(frameTextureBase != kInvalidDescriptorIndex);
+			for (uint32_t i = 0; i < kSceneTextureCount; ++i) {
+				device->CopyDescriptorsSimple(1, GetCPUDescriptorHandle(srvDescriptorHeap, descriptorSizeSRV, frameTextureBase + i),
+					GetCPUDescriptorHandle(srvStagingDescriptorHeap, descriptorSizeSRV, textureDescriptorIndices[i]), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+				if (!useBindlessTextures) {
+					commandBackend.textures[i] = GetGPUDescriptorHandle(srvDescriptorHeap, descriptorSizeSRV, frameTextureBase + i);
+				}
+			}
+			if (useBindlessTextures) {
+				commandBackend.textures[0] = GetGPUDescriptorHandle(srvDescriptorHeap, descriptorSizeSRV, frameTextureBase);
+			}
+
+			hr = commandAllocators[frameIndex]->Reset();
 			assert(SUCCEEDED(hr));
-			hr = commandList->Reset(commandAllocator, graphicsPipelineState);
+			hr = commandList->Reset(commandAllocators[frameIndex], nullptr);
 			assert(SUCCEEDED(hr));
+			// GPU が読み終えたページを使い回せるようにしてから、このフレームの定数バッファを切り出す（値はフレームの終わりに書く）
+			RecycleUploadPages(frameUploadAllocator, frameFence.GetCompletedValue());
+			const UploadAllocation directionalLightAllocation = AllocateUpload(frameUploadAllocator, frameUploadPages, sizeof(DirectionalLight), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
 
 			// ゲームパッドの状態取得
 			XINPUT_STATE state{};
 			DWORD result = XInputGetState(0, &state); // 0は1Pコントローラー
+			bool gamepadPickRequested = false;
 
 			if (result == ERROR_SUCCESS) {
 				// ----- Lスティックでカメラ位置を移動 -----
@@ -1421,25 +2355,44 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 
 				wasYPressed = isYPressed;
 
+				// Xボタンで画面の中央にある物体を選ぶ
+				bool isXPressed = (state.Gamepad.wButtons & XINPUT_GAMEPAD_X);
+				gamepadPickRequested = isXPressed && !wasXPressed;
+				wasXPressed = isXPressed;
+
 
 			}
 
 
-			Matrix4x4 cameraMatrix = MakeAffineMatrix(cameraTransform.scale, cameraTransform.rotate, cameraTransform.translate);  // カメラをZ方向に引く
-			Matrix4x4 viewMatrix = Inverse(cameraMatrix);
+			// カメラの行列を作って一般の逆行列を取る代わりに、Transform から直接ビュー行列を作る。
+			// 回転は目標の向きへ Slerp した cameraOrientation を使い、スティックの入力の段差やジンバルロックを出さない
+			cameraOrientation = Slerp(cameraOrientation, MakeQuaternionFromEuler(cameraTransform.rotate), kCameraRotationSmoothing);
+			Matrix4x4 viewMatrix = MakeViewMatrix(QuaternionTransform{ cameraTransform.scale, cameraOrientation, cameraTransform.translate });
 			Matrix4x4 projectionMatrix = MakePerspectiveFovMatrix(
 				0.45f,
 				float(kClientWidth) / float(kClientHeight),
 				0.1f, 100.0f);
 			
-			Matrix4x4 worldMatrixSphere = MakeAffineMatrix(sphereTransform.scale, sphereTransform.rotate, sphereTransform.translate);
-			wvpDataSphere->WVP = Multiply(worldMatrixSphere, Multiply(viewMatrix, projectionMatrix));
-			wvpDataSphere->World = worldMatrixSphere;
-
-			// モデル（Model）のWorld行列
-			Matrix4x4 worldMatrixModel = MakeAffineMatrix(modelTransform.scale, modelTransform.rotate, modelTransform.translate);
-			wvpDataModel->WVP = Multiply(worldMatrixModel, Multiply(viewMatrix, projectionMatrix));
-			wvpDataModel->World = worldMatrixModel;
+			// ImGui で編集された Transform を取り込み、動いたノードだけワールド行列を計算し直してから、全ノードの WVP を計算する（VP は一度だけ）
+			SetSceneNodeTransform(scene, kObjectSphere, sphereTransform);
+			SetSceneNodeTransform(scene, kObjectModel, modelTransform);
+			SetSceneNodeTransform(scene, kObjectTeapot, teapotTransform);
+			SetSceneNodeTransform(scene, kObjectBunny, bunnyTransform);
+			SetSceneNodeTransform(scene, kObjectMultiMesh, multiMeshTransform);
+			UpdateSceneGraph(scene);
+			const Matrix4x4 viewProjectionMatrix = Multiply(viewMatrix, projectionMatrix);
+			ComputeTransformationMatrices(scene, viewProjectionMatrix, objectMatrices.data());
+
+			// 動いたメッシュの箱を BVH に反映してから、ワールド空間でメッシュ単位の視錐台カリングをして、描画する一覧を作る
+			for (uint32_t i = 0; i < sceneMeshes.size(); ++i) {
+				const Aabb bounds = getSceneMeshWorldBounds(sceneMeshes[i]);
+				if (std::memcmp(&bounds, &sceneBvh.itemBounds[i], sizeof(Aabb)) != 0) {
+					UpdateInstanceBvhItem(sceneBvh, i, bounds);
+				}
+			}
+			visibleSceneMeshCount = CullInstanceBvh(sceneBvh, MakeFrustumFromMatrix(viewProjectionMatrix), visibleSceneMeshes.data());
+			// BVH の順に出てくるので、メッシュの順に並べ直す
+			std::sort(visibleSceneMeshes.begin(), visibleSceneMeshes.begin() + visibleSceneMeshCount);
 
 			// Sprite用のWVP行列を作成（正射影）
 			Matrix4x4 worldMatrixSprite = MakeAffineMatrix(transformSprite.scale, transformSprite.rotate, transformSprite.translate);
@@ -1447,13 +2400,74 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 			Matrix4x4 projectionMatrixSprite = MakeOrthographicMatrix(0.0f, 0.0f, float(kClientWidth), float(kClientHeight), 0.0f, 100.0f);
 			Matrix4x4 worldViewProjectionMatrixSprite = Multiply(worldMatrixSprite, Multiply(viewMatrixSprite, projectionMatrixSprite));
 
-			transformationMatrixDataSprite->WVP = worldViewProjectionMatrixSprite;
-			transformationMatrixDataSprite->World = worldMatrixSprite;
+			// このモードで描くものの一覧を作る。インスタンスの行列は、シーンのノードの行列の後ろに詰める
+			const UploadAllocation instanceAllocation = AllocateUpload(frameUploadAllocator, frameUploadPages, sizeof(TransformationMatrix) * instanceCapacity, sizeof(TransformationMatrix));
+			BeginInstancedDrawList(drawList, reinterpret_cast<TransformationMatrix*>(frameUploadPages.CpuAddress(instanceAllocation)), instanceCapacity);
+			sceneFirstInstance = AppendInstances(drawList, objectMatrices.data(), sceneNodeCount);
+			meshletCullStatistics = {};
+			const DrawState modelState = { kPipelineModel, kMaterialModel, static_cast<uint32_t>(selectedTextureIndex) };
+			if (currentMode == DisplayMode::Sprite || currentMode == DisplayMode::Sphere) {
+				// Plane.obj はカリングせずに全部描く
+				AddInstancedDraw(drawList, modelState, 0, 0, { 0, static_cast<uint32_t>(allModels[0].meshes[0].indices.size()) },
+					sceneFirstInstance + kObjectModel, 1, objectMatrices[kObjectModel].WVP.m[3][3]);
+			}
+			if (currentMode == DisplayMode::Sprite) {
+				// スプライトは uvChecker で描く
+				const TransformationMatrix spriteMatrices = { worldViewProjectionMatrixSprite, worldMatrixSprite };
+				const uint32_t spriteInstance = AppendInstances(drawList, &spriteMatrices, 1);
+				AddInstancedDraw(drawList, { kPipelineStandard, kMaterialSprite, 0 }, kSpriteModelIndex, 0, { 0, 6 }, spriteInstance, 1);
+			} else if (currentMode == DisplayMode::Sphere) {
+				AddInstancedDraw(drawList, { kPipelineStandard, kMaterialModel, modelState.texture }, kSphereModelIndex, 0, { 0, static_cast<uint32_t>(vertexDataSphere.size()) },
+					sceneFirstInstance + kObjectSphere, 1, objectMatrices[kObjectSphere].WVP.m[3][3]);
+			} else if (currentMode == DisplayMode::Teapot) {
+				addModelDrawsWithMeshletCulling(1, projectionMatrix); // teapotModel
+			} else if (currentMode == DisplayMode::Bunny) {
+				addModelDrawsWithMeshletCulling(2, projectionMatrix); // modelDataBunny
+			} else if (currentMode == DisplayMode::MultiMesh) {
+				addModelDrawsWithMeshletCulling(3, projectionMatrix); // multiMeshModel
+			} else if (currentMode == DisplayMode::Instancing) {
+				// ティーポットを格子状に並べ、視錐台の中にあるものだけを詰めて、メッシュごとに1回の Draw で描く
+				for (uint32_t i = 0; i < instanceGridCount; ++i) {
+					Transform instanceTransform = teapotTransform;
+					instanceTransform.translate.x += (float(i % kInstanceGridSize) - 0.5f * float(kInstanceGridSize - 1)) * kInstanceGridSpacing;
+					instanceTransform.translate.z += float(i / kInstanceGridSize) * kInstanceGridSpacing;
+					SetTransform(instanceGridTransforms, i, instanceTransform);
+				}
+				ComputeTransformationMatrices(instanceGridTransforms, viewProjectionMatrix, instanceGridMatrices.data());
+				ClearBounds(instanceGridBounds);
+				for (const TransformationMatrix& matrices : instanceGridMatrices) {
+					AddBounds(instanceGridBounds, TransformBounds(teapotBounds, matrices.World));
+				}
+				visibleGridInstanceCount = CullBounds(instanceGridBounds, MakeFrustumFromMatrix(viewProjectionMatrix), visibleGridInstances.data());
+				const uint32_t firstInstance = PackInstances(drawList, instanceGridMatrices.data(), visibleGridInstances.data(), visibleGridInstanceCount);
+				// 並べ替えには一番手前のインスタンスの深度を使う
+				float nearestDepth = FLT_MAX;
+				for (size_t i = 0; i < visibleGridInstanceCount; ++i) {
+					nearestDepth = std::min(nearestDepth, instanceGridMatrices[visibleGridInstances[i]].WVP.m[3][3]);
+				}
+				for (uint32_t meshIndex = 0; meshIndex < teapotModel.meshes.size(); ++meshIndex) {
+					const IndexRange range = { 0, static_cast<uint32_t>(teapotModel.meshes[meshIndex].indices.size()) };
+					AddInstancedDraw(drawList, modelState, 1, meshIndex, range, firstInstance, static_cast<uint32_t>(visibleGridInstanceCount), nearestDepth);
+				}
+			}
+			// bindless のときは、マテリアルとテクスチャの組ごとにマテリアルを作って、描画はその番号だけを持つようにする
+			if (useBindlessTextures) {
+				AssignBindlessMaterials(bindlessMaterials, drawList, kMaterialCount, frameTextureSlots, _countof(frameTextureSlots));
+			}
+			// マテリアルの定数バッファを、1つずつ 256 バイト境界にそろえて続けて切り出す
+			const uint32_t frameMaterialCount = useBindlessTextures ? static_cast<uint32_t>(bindlessMaterials.entries.size()) : kMaterialCount;
+			const size_t materialStride = AlignUp(sizeof(Material), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+			const UploadAllocation materialAllocation = AllocateUpload(frameUploadAllocator, frameUploadPages,
+				materialStride * std::max(frameMaterialCount, 1u), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+			commandBackend.materials.resize(frameMaterialCount);
+			for (uint32_t i = 0; i < frameMaterialCount; ++i) {
+				commandBackend.materials[i] = frameUploadPages.GpuAddress(materialAllocation) + materialStride * i;
+			}
 
+			// 状態が同じ描画が続くよう並べ替える（行列はインスタンスの番号で引くので動かさない）
+			SortInstancedDrawList(drawList);
 
 			commandList->SetGraphicsRootSignature(rootSignature);
-			// マテリアルCBufferの場所を設定
-			commandList->SetGraphicsRootConstantBufferView(0, materialResource->GetGPUVirtualAddress());
 
 			UINT backBufferIndex = swapChain->GetCurrentBackBufferIndex();
 
@@ -1476,118 +2490,24 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 			// 指定した深度で画面全体をクリアする	
 			commandList->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
-			D3D12_GPU_DESCRIPTOR_HANDLE textureSRVs[] = {
-	             textureSrvHandleGPU,   // uvChecker
-	             textureSrvHandleGPU2,  // monsterBall
-	             textureSrvHandleGPU3   // checkerBoard
-			};
-
 			const char* textureNames[] = { "uvChecker", "monsterBall", "checkerBoard" };
-			static int selectedTextureIndex = 0;
 
 			// DrawCall
 			// 共通設定
 			// --- 描画設定 ---
 			commandList->RSSetViewports(1, &viewport);
 			commandList->RSSetScissorRects(1, &scissorRect);
-			commandList->SetPipelineState(graphicsPipelineState);
-            // 'graphicsPipelineState' が nullptr でないことを確認するためのチェックを追加  
-           
 			ID3D12DescriptorHeap* descriptorHeaps[] = { srvDescriptorHeap };
 			commandList->SetDescriptorHeaps(1, descriptorHeaps);
-			// テクスチャ選択に応じて SRV を切り替え
-			commandList->SetGraphicsRootDescriptorTable(3, textureSRVs[selectedTextureIndex]);
-
 
-			// マテリアル・ライト共通設定（Plane, Sphere, Sprite 全部使う）
-			commandList->SetGraphicsRootConstantBufferView(0, materialResource->GetGPUVirtualAddress());
-			commandList->SetGraphicsRootConstantBufferView(1, directionalLightResource->GetGPUVirtualAddress());
+			// ライト共通設定（Plane, Sphere, Sprite 全部使う）。PSO・マテリアル・テクスチャは描画の一覧から設定する
+			commandList->SetGraphicsRootConstantBufferView(1, frameUploadPages.GpuAddress(directionalLightAllocation));
 
 	
 			// ---------- モードごとの描画 ----------
-			if (currentMode == DisplayMode::Sprite) {
-				// --- モデル（Plane.obj）描画 ---
-				commandList->SetGraphicsRootConstantBufferView(2, wvpResourceModel->GetGPUVirtualAddress());
-				commandList->IASetVertexBuffers(0, 1, &vertexBufferViewsPerModel[0][0]); // modelData（Plane）
-				commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-				commandList->DrawInstanced(static_cast<UINT>(allModels[0].meshes[0].vertices.size()), 1, 0, 0);
-
-				// --- スプライト描画 ---
-				commandList->IASetVertexBuffers(0, 1, &vertexBufferViewSprite);
-				commandList->IASetIndexBuffer(&indexBufferViewSprite);
-
-				commandList->SetGraphicsRootConstantBufferView(0, materialResourceSprite->GetGPUVirtualAddress());
-				commandList->SetGraphicsRootConstantBufferView(2, transformationMatrixResourceSprite->GetGPUVirtualAddress());
-				commandList->SetGraphicsRootDescriptorTable(3, textureSrvHandleGPU);
-				commandList->DrawIndexedInstanced(6, 1, 0, 0, 0);
-
-			} else if (currentMode == DisplayMode::Sphere) {
-				// --- 球（Sphere.obj）描画 ---
-				commandList->SetGraphicsRootConstantBufferView(0, materialResource->GetGPUVirtualAddress());
-				commandList->SetGraphicsRootConstantBufferView(1, directionalLightResource->GetGPUVirtualAddress());
-				commandList->SetGraphicsRootConstantBufferView(2, wvpResourceSphere->GetGPUVirtualAddress());
-
-				commandList->IASetVertexBuffers(0, 1, &vertexBufferViewSphere);
-				commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-				commandList->DrawInstanced(static_cast<UINT>(vertexDataSphere.size()), 1, 0, 0);
-
-				// --- モデル（Plane.obj）描画（影などのため）---
-				commandList->SetGraphicsRootConstantBufferView(2, wvpResourceModel->GetGPUVirtualAddress());
-				commandList->IASetVertexBuffers(0, 1, &vertexBufferViewsPerModel[0][0]); // modelData（Plane）
-				commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-				commandList->DrawInstanced(static_cast<UINT>(allModels[0].meshes[0].vertices.size()), 1, 0, 0);
-
-			} else if (currentMode == DisplayMode::Teapot) {
-				// --- ティーポット描画 ---
-				Matrix4x4 worldMatrixTeapot = MakeAffineMatrix(teapotTransform.scale, teapotTransform.rotate, teapotTransform.translate);
-				wvpDataTeapot->WVP = Multiply(worldMatrixTeapot, Multiply(viewMatrix, projectionMatrix));
-				wvpDataTeapot->World = worldMatrixTeapot;
-
-				commandList->SetGraphicsRootConstantBufferView(0, materialResource->GetGPUVirtualAddress());
-				commandList->SetGraphicsRootConstantBufferView(1, directionalLightResource->GetGPUVirtualAddress());
-				commandList->SetGraphicsRootConstantBufferView(2, wvpResourceTeapot->GetGPUVirtualAddress());
-
-				int modelIndex = 1; // teapotModel
-				for (size_t i = 0; i < vertexBufferViewsPerModel[modelIndex].size(); ++i) {
-					commandList->IASetVertexBuffers(0, 1, &vertexBufferViewsPerModel[modelIndex][i]);
-					commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-					commandList->DrawInstanced(static_cast<UINT>(allModels[modelIndex].meshes[i].vertices.size()), 1, 0, 0);
-				}
-
-			} else if (currentMode == DisplayMode::Bunny) {
-				// --- バニー描画 ---
-				Matrix4x4 worldMatrixBunny = MakeAffineMatrix(bunnyTransform.scale, bunnyTransform.rotate, bunnyTransform.translate);
-				wvpDataBunny->WVP = Multiply(worldMatrixBunny, Multiply(viewMatrix, projectionMatrix));
-				wvpDataBunny->World = worldMatrixBunny;
-
-				commandList->SetGraphicsRootConstantBufferView(0, materialResource->GetGPUVirtualAddress());
-				commandList->SetGraphicsRootConstantBufferView(1, directionalLightResource->GetGPUVirtualAddress());
-				commandList->SetGraphicsRootConstantBufferView(2, wvpResourceBunny->GetGPUVirtualAddress());
-
-				int modelIndex = 2; // modelDataBunny
-				for (size_t i = 0; i < vertexBufferViewsPerModel[modelIndex].size(); ++i) {
-					commandList->IASetVertexBuffers(0, 1, &vertexBufferViewsPerModel[modelIndex][i]);
-					commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-					commandList->DrawInstanced(static_cast<UINT>(allModels[modelIndex].meshes[i].vertices.size()), 1, 0, 0);
-				}
-
-			} else if (currentMode == DisplayMode::MultiMesh) {
-				// --- マルチメッシュ描画 ---
-				Matrix4x4 worldMatrixMultiMesh = MakeAffineMatrix(multiMeshTransform.scale, multiMeshTransform.rotate, multiMeshTransform.translate);
-				wvpDataMultiMesh->WVP = Multiply(worldMatrixMultiMesh, Multiply(viewMatrix, projectionMatrix));
-				wvpDataMultiMesh->World = worldMatrixMultiMesh;
-
-				commandList->SetGraphicsRootConstantBufferView(0, materialResource->GetGPUVirtualAddress());
-				commandList->SetGraphicsRootConstantBufferView(1, directionalLightResource->GetGPUVirtualAddress());
-				commandList->SetGraphicsRootConstantBufferView(2, wvpResourceMultiMesh->GetGPUVirtualAddress());
-
-				int modelIndex = 3; // multiMeshModel
-				for (size_t i = 0; i < vertexBufferViewsPerModel[modelIndex].size(); ++i) {
-					commandList->IASetVertexBuffers(0, 1, &vertexBufferViewsPerModel[modelIndex][i]);
-					commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-					commandList->DrawInstanced(static_cast<UINT>(allModels[modelIndex].meshes[i].vertices.size()), 1, 0, 0);
-				}
-			}
+			// 行列はすべてインスタンスバッファから読む。並べ替えた一覧を、状態が変わったときだけ設定し直しながら出す
+			commandList->SetGraphicsRootShaderResourceView(4, frameUploadPages.GpuAddress(instanceAllocation));
+			drawSubmitStatistics = SubmitInstancedDrawList(drawList, commandBackend);
 
 			//描画
 
@@ -1598,26 +2518,35 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 			// 自作ウィンドウだけ表示する
 			ImGui::Begin("Sprite Transform");
 
-			const char* modeItems[] = { "Sprite", "Sphere", "Teapot", "Bunny","MultiMesh"};
+			const char* modeItems[] = { "Sprite", "Sphere", "Teapot", "Bunny","MultiMesh","Instancing"};
 			int currentModeIndex = static_cast<int>(currentMode);
 			if (ImGui::Combo("Display Mode", &currentModeIndex, modeItems, IM_ARRAYSIZE(modeItems))) {
 				currentMode = static_cast<DisplayMode>(currentModeIndex);
 			}
 
+			ImGui::Text("Frustum culling: %zu / %zu meshes visible", visibleSceneMeshCount, sceneMeshes.size());
+			ImGui::Text("Draw list: %u draws, %u state changes (%u redundant avoided)",
+				drawSubmitStatistics.draws, drawSubmitStatistics.stateCommands, drawSubmitStatistics.redundantStateCommandsAvoided);
+			ImGui::Text("Frame uploads: %zu pages (%llu KiB), %zu waiting for the GPU",
+				frameUploadAllocator.pages.size(), static_cast<unsigned long long>(GetUploadPageBytes(frameUploadAllocator) / 1024), frameUploadAllocator.retiredPages.size());
+			if (currentMode == DisplayMode::Instancing) {
+				ImGui::Text("Instancing: %zu / %u teapots visible, %zu draw calls", visibleGridInstanceCount, instanceGridCount, drawList.draws.size());
+			}
+			if (meshletCullStatistics.totalTriangles > 0) {
+				ImGui::Text("Meshlet culling: %u / %u triangles rejected (frustum %u, backface %u)",
+					meshletCullStatistics.frustumCulledTriangles + meshletCullStatistics.backfaceCulledTriangles, meshletCullStatistics.totalTriangles,
+					meshletCullStatistics.frustumCulledTriangles, meshletCullStatistics.backfaceCulledTriangles);
+			}
+			if (currentMode == DisplayMode::Teapot || currentMode == DisplayMode::Bunny || currentMode == DisplayMode::MultiMesh) {
+				ImGui::SliderFloat("LOD Error (px)", &lodPixelThreshold, 0.1f, 16.0f);
+				ImGui::Text("LOD: %u", selectedLodLevel);
+			}
+
 
 			// === モード別UI分岐 ===
+			// シーンの物体（Plane・Sphere・Teapot・Bunny・MultiMesh とそのパーツ）は、クリックして選んだものを下の Selected で編集する
 			if (currentMode == DisplayMode::Sprite) {
-				ImGui::Text("Create");
-				ImGui::Separator();
-
-				// Object (Plane)
-				if (ImGui::CollapsingHeader("Plane", ImGuiTreeNodeFlags_DefaultOpen)) {
-					ImGui::SliderFloat3("##PlaneTranslate", &modelTransform.translate.x, -100.0f, 100.0f); ImGui::SameLine(); ImGui::Text("Translate");
-					ImGui::SliderFloat3("##PlaneRotate", &modelTransform.rotate.x, -3.14f, 3.14f);         ImGui::SameLine(); ImGui::Text("Rotate");
-					ImGui::SliderFloat3("##PlaneScale", &modelTransform.scale.x, 0.0f, 5.0f);              ImGui::SameLine(); ImGui::Text("Scale");
-				}
-
-				// Material
+				// Sprite はシーンの外（ピックできない）ので、ここで編集する
 				if (ImGui::CollapsingHeader("Sprite", ImGuiTreeNodeFlags_DefaultOpen)) {
 					ImGui::SliderFloat3("##SpriteTranslate", &transformSprite.translate.x, -100.0f, 100.0f); ImGui::SameLine(); ImGui::Text("Translate");
 					ImGui::SliderFloat3("##SpriteRotate", &transformSprite.rotate.x, -3.14f, 3.14f);         ImGui::SameLine(); ImGui::Text("Rotate");
@@ -1637,38 +2566,64 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 				ImGui::DragFloat2("##UVScale", &uvTransformSprite.scale.x, 0.01f, 0.0f, 10.0f);
 				ImGui::SameLine(); ImGui::Text("UVScale");
 
+			} else if (currentMode == DisplayMode::Instancing) {
+				// 格子のインスタンスはシーンのノードではないので、基準になる Transform をここで編集する
+				ImGui::Text("Instancing Grid");
+				ImGui::SliderFloat3("Grid Translate", &teapotTransform.translate.x, -10.0f, 10.0f);
+				ImGui::SliderFloat3("Grid Rotate", &teapotTransform.rotate.x, -3.14f, 3.14f);
+				ImGui::SliderFloat3("Grid Scale", &teapotTransform.scale.x, 0.0f, 5.0f);
+			}
+			if (selectedSceneMesh == UINT32_MAX) {
+				ImGui::TextDisabled("Click a mesh to edit its transform");
+			}
 
-			} else if (currentMode == DisplayMode::Sphere) {
-				// Sphere用Object編集
-				if (ImGui::CollapsingHeader("Sphere", ImGuiTreeNodeFlags_DefaultOpen)) {
-					ImGui::SliderFloat3("##SphereTranslate", &sphereTransform.translate.x, -10.0f, 10.0f); ImGui::SameLine(); ImGui::Text("Translate");
-					ImGui::SliderFloat3("##SphereRotate", &sphereTransform.rotate.x, -3.14f, 3.14f);       ImGui::SameLine(); ImGui::Text("Rotate");
-					ImGui::SliderFloat3("##SphereScale", &sphereTransform.scale.x, 0.0f, 5.0f);            ImGui::SameLine(); ImGui::Text("Scale");
-				}
+			// クリックした位置（ゲームパッドなら画面の中央）へカメラからレイを飛ばして、当たったメッシュを選ぶ
+			const bool mousePickRequested = ImGui::IsMouseClicked(ImGuiMouseButton_Left) && !ImGui::GetIO().WantCaptureMouse;
+			if (mousePickRequested || gamepadPickRequested) {
+				const ImVec2 pickPosition = mousePickRequested ? ImGui::GetIO().MousePos : ImVec2(float(kClientWidth) * 0.5f, float(kClientHeight) * 0.5f);
+				const Ray ray = MakeRayFromScreen(pickPosition.x, pickPosition.y, float(kClientWidth), float(kClientHeight), Inverse(viewProjectionMatrix));
+				float hitDistance = 0.0f;
+				// 箱に当たったメッシュは、レイをモデル空間へ移して三角形と交差させる（direction も同じ行列で移すので距離の単位は変わらない）
+				selectedSceneMesh = RaycastInstanceBvh(sceneBvh, ray, hitDistance, [&](uint32_t item, const Ray& worldRay, float maxDistance, float& distance) {
+					const SceneMesh& sceneMesh = sceneMeshes[item];
+					const Matrix4x4 inverseWorld = Inverse(scene.worldMatrices[sceneMesh.node], MatrixType::Affine);
+					const Vector3 farPoint = { worldRay.origin.x + worldRay.direction.x, worldRay.origin.y + worldRay.direction.y, worldRay.origin.z + worldRay.direction.z };
+					const Vector3 modelOrigin = TransformPoint(worldRay.origin, inverseWorld);
+					const Vector3 modelFarPoint = TransformPoint(farPoint, inverseWorld);
+					const Ray modelRay = { modelOrigin, { modelFarPoint.x - modelOrigin.x, modelFarPoint.y - modelOrigin.y, modelFarPoint.z - modelOrigin.z } };
+					RayTriangleHit hit{};
+					if (!RaycastMesh(triangleBvhsPerModel[sceneMesh.modelIndex][sceneMesh.meshIndex], allModels[sceneMesh.modelIndex].meshes[sceneMesh.meshIndex], modelRay, maxDistance, hit)) {
+						return false;
+					}
+					distance = hit.distance;
+					selectedHit = hit;
+					return true;
+				});
+			}
 
-				// Planeモデル共通で表示
-				if (ImGui::CollapsingHeader("Plane", ImGuiTreeNodeFlags_DefaultOpen)) {
-					ImGui::SliderFloat3("##PlaneTranslate", &modelTransform.translate.x, -10.0f, 10.0f); ImGui::SameLine(); ImGui::Text("Translate");
-					ImGui::SliderFloat3("##PlaneRotate", &modelTransform.rotate.x, -3.14f, 3.14f);       ImGui::SameLine(); ImGui::Text("Rotate");
-					ImGui::SliderFloat3("##PlaneScale", &modelTransform.scale.x, 0.0f, 5.0f);            ImGui::SameLine(); ImGui::Text("Scale");
+			// 選んだメッシュのノードを1組のスライダーで編集する。
+			// ルートは ImGui 用の Transform（毎フレームシーンに反映される）を、パーツはシーンのローカルの Transform を書き換える
+			if (selectedSceneMesh != UINT32_MAX) {
+				const SceneMesh& selected = sceneMeshes[selectedSceneMesh];
+				Transform* rootTransforms[kObjectCount] = { &sphereTransform, &modelTransform, &teapotTransform, &bunnyTransform, &multiMeshTransform };
+				Transform selectedTransform = (selected.node < kObjectCount) ? *rootTransforms[selected.node] : GetTransform(scene.localTransforms, selected.node);
+				ImGui::Separator();
+				ImGui::Text("Selected: %s (node %u)", allModels[selected.modelIndex].meshes[selected.meshIndex].name.c_str(), selected.node);
+				ImGui::Text("Hit triangle %u, barycentric (%.3f, %.3f), UV (%.3f, %.3f)", selectedHit.triangle, selectedHit.u, selectedHit.v, selectedHit.texcoord.x, selectedHit.texcoord.y);
+				bool changed = ImGui::DragFloat3("Selected Translate", &selectedTransform.translate.x, 0.01f);
+				changed |= ImGui::DragFloat3("Selected Rotate", &selectedTransform.rotate.x, 0.01f);
+				changed |= ImGui::DragFloat3("Selected Scale", &selectedTransform.scale.x, 0.01f);
+				if (changed) {
+					if (selected.node < kObjectCount) {
+						*rootTransforms[selected.node] = selectedTransform;
+					} else {
+						SetSceneNodeTransform(scene, selected.node, selectedTransform);
+					}
 				}
-			}else if (currentMode == DisplayMode::Teapot) {
-				ImGui::Text("Teapot Controls");
-				ImGui::SliderFloat3("Teapot Translate", &teapotTransform.translate.x, -10.0f, 10.0f);
-				ImGui::SliderFloat3("Teapot Rotate", &teapotTransform.rotate.x, -3.14f, 3.14f);
-				ImGui::SliderFloat3("Teapot Scale", &teapotTransform.scale.x, 0.0f, 5.0f);
-
-			} else if (currentMode == DisplayMode::Bunny){
-				ImGui::Text("Bunny Controls");
-
-				ImGui::SliderFloat3("Bunny Translate", &bunnyTransform.translate.x, -10.0f, 10.0f);
-				ImGui::SliderFloat3("Bunny Rotate", &bunnyTransform.rotate.x, -3.14f, 3.14f);
-				ImGui::SliderFloat3("Bunny Scale", &bunnyTransform.scale.x, 0.0f, 5.0f);
-			} else if (currentMode == DisplayMode::MultiMesh) {
-				ImGui::Text("MultiMesh Controls");
-				ImGui::DragFloat3("MultiMesh Translate", &multiMeshTransform.translate.x, 0.01f);
-				ImGui::DragFloat3("MultiMesh Rotate", &multiMeshTransform.rotate.x, 0.01f);
-				ImGui::DragFloat3("MultiMesh Scale", &multiMeshTransform.scale.x, 0.01f);
+				if (ImGui::Button("Clear Selection")) {
+					selectedSceneMesh = UINT32_MAX;
+				}
+				ImGui::Separator();
 			}
 
 			ImGui::Combo("Texture", &selectedTextureIndex, textureNames, IM_ARRAYSIZE(textureNames));
@@ -1742,6 +2697,17 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 			uvTransformMatrix = Multiply(uvTransformMatrix, MakeTranslateMatrix(uvTransformSprite.translate));
 			materialDataSprite->uvTransform = uvTransformMatrix;
 
+			// このフレームで書き換えた定数を、このフレームで切り出した定数バッファへ書き写す
+			const Material frameMaterials[kMaterialCount] = { modelMaterial, spriteMaterial };  // DrawMaterial の並び
+			if (useBindlessTextures) {
+				WriteBindlessMaterials(bindlessMaterials, frameMaterials, frameUploadPages.CpuAddress(materialAllocation), materialStride);
+			} else {
+				for (uint32_t i = 0; i < kMaterialCount; ++i) {
+					std::memcpy(frameUploadPages.CpuAddress(materialAllocation) + materialStride * i, &frameMaterials[i], sizeof(Material));
+				}
+			}
+			std::memcpy(frameUploadPages.CpuAddress(directionalLightAllocation), &directionalLight, sizeof(DirectionalLight));
+
 			// RenderTarget -> Presentに遷移
 			D3D12_RESOURCE_BARRIER barrierEnd{};
 			barrierEnd.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
@@ -1758,19 +2724,33 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 			commandQueue->ExecuteCommandLists(1, cmdLists);
 			swapChain->Present(1, 0);
 
-			// フェンス同期
-			fenceValue++;
-			hr = commandQueue->Signal(fence, fenceValue);
-			assert(SUCCEEDED(hr));
-			if (fence->GetCompletedValue() < fenceValue) {
-				hr = fence->SetEventOnCompletion(fenceValue, fenceEvent);
-				assert(SUCCEEDED(hr));
-				WaitForSingleObject(fenceEvent, INFINITE);
-			}
+			// この組を使い終えたことをフェンスで知らせる。待つのは次にこの組を使うとき
+			EndFrame(frameRing, frameFence);
+			FinishFrameUploads(frameUploadAllocator, frameRing.lastSignaledValue);
 		}
 	}
 
 	// --- 後片付け ---
+	// GPU がまだ読んでいるかもしれないリソースを解放しないよう、出したフレームがすべて終わるのを待つ
+	WaitForGpuIdle(frameRing, frameFence);
+	// ワーカーがまだ読んでいるTextureは、終わるのを待ってから捨てる
+	for (const TextureLoadHandle& textureLoad : textureLoads) {
+		if (textureLoad) {
+			WaitForTextureLoad(*textureLoad);
+		}
+	}
+	for (ID3D12Resource* textureResource : textureResources) {
+		if (textureResource) textureResource->Release();
+	}
+	for (const DescriptorHandle& textureDescriptor : textureDescriptors) {
+		if (IsDescriptorHandleValid(srvDescriptorAllocator, textureDescriptor)) {
+			FreeDescriptor(srvDescriptorAllocator, textureDescriptor);
+		}
+	}
+	if (IsDescriptorHandleValid(srvDescriptorAllocator, placeholderDescriptor)) {
+		FreeDescriptor(srvDescriptorAllocator, placeholderDescriptor);
+	}
+	if (placeholderTextureResource) placeholderTextureResource->Release();
 	CloseHandle(fenceEvent);
 	if (fence) fence->Release();
 	for (int i = 0; i < 2; ++i) {
@@ -1779,29 +2759,23 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 	if (rtvDescriptorHeap) rtvDescriptorHeap->Release();
 	if (swapChain) swapChain->Release();
 	if (commandList) commandList->Release();
-	if (commandAllocator) commandAllocator->Release();
+	for (ID3D12CommandAllocator* allocator : commandAllocators) {
+		if (allocator) allocator->Release();
+	}
 	if (commandQueue) commandQueue->Release();
 	if (device) device->Release();
 	if (dxgiFactory) dxgiFactory->Release();
 
-	if (vertexResourceSphere) vertexResourceSphere->Release();
-	if (graphicsPipelineState) graphicsPipelineState->Release();
+	staticUploadPages.Release();
+	frameUploadPages.Release();
+	if (instancedGraphicsPipelineState) instancedGraphicsPipelineState->Release();
+	if (compactGraphicsPipelineState) compactGraphicsPipelineState->Release();
 	if (rootSignature) rootSignature->Release();
-	if (vertexShaderBlob) vertexShaderBlob->Release();
+	if (instancedVertexShaderBlob) instancedVertexShaderBlob->Release();
+	if (compactVertexShaderBlob) compactVertexShaderBlob->Release();
 	if (pixelShaderBlob) pixelShaderBlob->Release();
 	if (signatureBlob) signatureBlob->Release();
 	if (errorBlob) errorBlob->Release();
-	materialResource->Release();
-
-	for (auto& resourceList : vertexResourcesPerModel) {
-		for (ID3D12Resource* res : resourceList) {
-			if (res) {
-				res->Release();
-				res = nullptr;
-			}
-		}
-	}
-
 
 	xAudio2.Reset();
 	SoundUnload(&soundData1);
@@ -1809,6 +2783,11 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int) {
 	ImGui_ImplDX12_Shutdown();
 	ImGui_ImplWin32_Shutdown();
 	ImGui::DestroyContext();
+	FreeDescriptor(srvDescriptorAllocator, imguiFontDescriptor);
+	// 割り当てたディスクリプタはすべて返していること
+	assert(GetLiveDescriptorCount(srvDescriptorAllocator) == 0);
+	if (srvStagingDescriptorHeap) srvStagingDescriptorHeap->Release();
+	if (srvDescriptorHeap) srvDescriptorHeap->Release();
 
 	// リソース全開放後、LiveObjectsレポート
 	IDXGIDebug1* debug = nullptr;
@@ -1830,7 +2809,9 @@ IDxcBlob* CompileShader(
 	// 初期化して生成したものを3つ
 	IDxcUtils* dxcUtils,
 	IDxcCompiler3* dxcCompiler,
-	IDxcIncludeHandler* includeHandler)
+	IDxcIncludeHandler* includeHandler,
+	// エントリーポイントの関数名
+	const wchar_t* entryPoint)
 {
 	// hlslファイルを読む
 	Log(std::format(L"Begin CompileShader,path:{},profile:{}\n", filePath, profile));
@@ -1845,7 +2826,7 @@ IDxcBlob* CompileShader(
 	// Compileする
 	LPCWSTR arguments[] = {
 		filePath.c_str(),
-		L"-E",L"main",
+		L"-E",entryPoint,
 		L"-T",profile,
 		L"-Zi",L"Qembed_debug",
 		L"-Od",
@@ -1921,227 +2902,25 @@ ID3D12Resource* CreateBufferResource(ID3D12Device* device, size_t sizeInBytes) {
 	assert(SUCCEEDED(hr));
 	return resource;
 }
-Matrix4x4 MakeIdentity4x4() {
-	Matrix4x4 result = {};
-
-	result.m[0][0] = 1.0f;
-	result.m[1][1] = 1.0f;
-	result.m[2][2] = 1.0f;
-	result.m[3][3] = 1.0f;
-
-	return result;
-}
-Matrix4x4 MakeAffineMatrix(const Vector3& scale, const Vector3& rotate, const Vector3& translate)
-{
-	Matrix4x4 matrix = {};
-	float cosX = cosf(rotate.x);
-	float sinX = sinf(rotate.x);
-	float cosY = cosf(rotate.y);
-	float sinY = sinf(rotate.y);
-	float cosZ = cosf(rotate.z);
-	float sinZ = sinf(rotate.z);
-	matrix.m[0][0] = scale.x * (cosY * cosZ);
-	matrix.m[0][1] = scale.x * (cosY * sinZ);
-	matrix.m[0][2] = scale.x * (-sinY);
-	matrix.m[0][3] = 0.0f;
-	matrix.m[1][0] = scale.y * (sinX * sinY * cosZ - cosX * sinZ);
-	matrix.m[1][1] = scale.y * (sinX * sinY * sinZ + cosX * cosZ);
-	matrix.m[1][2] = scale.y * (sinX * cosY);
-	matrix.m[1][3] = 0.0f;
-	matrix.m[2][0] = scale.z * (cosX * sinY * cosZ + sinX * sinZ);
-	matrix.m[2][1] = scale.z * (cosX * sinY * sinZ - sinX * cosZ);
-	matrix.m[2][2] = scale.z * (cosX * cosY);
-	matrix.m[2][3] = 0.0f;
-	matrix.m[3][0] = translate.x;
-	matrix.m[3][1] = translate.y;
-	matrix.m[3][2] = translate.z;
-	matrix.m[3][3] = 1.0f;
-	return matrix;
-}
-Matrix4x4 MakePerspectiveFovMatrix(float fovY, float aspect, float nearZ, float farZ) {
-	Matrix4x4 m{};
-	float yScale = 1.0f / tanf(fovY / 2.0f);
-	float xScale = yScale / aspect;
-	float range = farZ - nearZ;
-
-	m.m[0][0] = xScale;
-	m.m[1][1] = yScale;
-	m.m[2][2] = farZ / range;
-	m.m[2][3] = 1.0f;
-	m.m[3][2] = -nearZ * farZ / range;
-
-	return m;
-}
-Matrix4x4 Multiply(const Matrix4x4& a, const Matrix4x4& b) {
-	Matrix4x4 r{};
-	for (int row = 0; row < 4; ++row) {
-		for (int col = 0; col < 4; ++col) {
-			for (int k = 0; k < 4; ++k) {
-				r.m[row][col] += a.m[row][k] * b.m[k][col];
-			}
-		}
-	}
-	return r;
-}
-Matrix4x4 Inverse(const Matrix4x4& m)
-{
-	Matrix4x4 result;
-	float* inv = &result.m[0][0];
-	const float* mat = &m.m[0][0];
-
-	float invOut[16];
-
-	invOut[0] = mat[5] * mat[10] * mat[15] -
-		mat[5] * mat[11] * mat[14] -
-		mat[9] * mat[6] * mat[15] +
-		mat[9] * mat[7] * mat[14] +
-		mat[13] * mat[6] * mat[11] -
-		mat[13] * mat[7] * mat[10];
-
-	invOut[1] = -mat[1] * mat[10] * mat[15] +
-		mat[1] * mat[11] * mat[14] +
-		mat[9] * mat[2] * mat[15] -
-		mat[9] * mat[3] * mat[14] -
-		mat[13] * mat[2] * mat[11] +
-		mat[13] * mat[3] * mat[10];
-
-	invOut[2] = mat[1] * mat[6] * mat[15] -
-		mat[1] * mat[7] * mat[14] -
-		mat[5] * mat[2] * mat[15] +
-		mat[5] * mat[3] * mat[14] +
-		mat[13] * mat[2] * mat[7] -
-		mat[13] * mat[3] * mat[6];
-
-	invOut[3] = -mat[1] * mat[6] * mat[11] +
-		mat[1] * mat[7] * mat[10] +
-		mat[5] * mat[2] * mat[11] -
-		mat[5] * mat[3] * mat[10] -
-		mat[9] * mat[2] * mat[7] +
-		mat[9] * mat[3] * mat[6];
-
-	invOut[4] = -mat[4] * mat[10] * mat[15] +
-		mat[4] * mat[11] * mat[14] +
-		mat[8] * mat[6] * mat[15] -
-		mat[8] * mat[7] * mat[14] -
-		mat[12] * mat[6] * mat[11] +
-		mat[12] * mat[7] * mat[10];
-
-	invOut[5] = mat[0] * mat[10] * mat[15] -
-		mat[0] * mat[11] * mat[14] -
-		mat[8] * mat[2] * mat[15] +
-		mat[8] * mat[3] * mat[14] +
-		mat[12] * mat[2] * mat[11] -
-		mat[12] * mat[3] * mat[10];
-
-	invOut[6] = -mat[0] * mat[6] * mat[15] +
-		mat[0] * mat[7] * mat[14] +
-		mat[4] * mat[2] * mat[15] -
-		mat[4] * mat[3] * mat[14] -
-		mat[12] * mat[2] * mat[7] +
-		mat[12] * mat[3] * mat[6];
-
-	invOut[7] = mat[0] * mat[6] * mat[11] -
-		mat[0] * mat[7] * mat[10] -
-		mat[4] * mat[2] * mat[11] +
-		mat[4] * mat[3] * mat[10] +
-		mat[8] * mat[2] * mat[7] -
-		mat[8] * mat[3] * mat[6];
-
-	invOut[8] = mat[4] * mat[9] * mat[15] -
-		mat[4] * mat[11] * mat[13] -
-		mat[8] * mat[5] * mat[15] +
-		mat[8] * mat[7] * mat[13] +
-		mat[12] * mat[5] * mat[11] -
-		mat[12] * mat[7] * mat[9];
-
-	invOut[9] = -mat[0] * mat[9] * mat[15] +
-		mat[0] * mat[11] * mat[13] +
-		mat[8] * mat[1] * mat[15] -
-		mat[8] * mat[3] * mat[13] -
-		mat[12] * mat[1] * mat[11] +
-		mat[12] * mat[3] * mat[9];
-
-	invOut[10] = mat[0] * mat[5] * mat[15] -
-		mat[0] * mat[7] * mat[13] -
-		mat[4] * mat[1] * mat[15] +
-		mat[4] * mat[3] * mat[13] +
-		mat[12] * mat[1] * mat[7] -
-		mat[12] * mat[3] * mat[5];
-
-	invOut[11] = -mat[0] * mat[5] * mat[11] +
-		mat[0] * mat[7] * mat[9] +
-		mat[4] * mat[1] * mat[11] -
-		mat[4] * mat[3] * mat[9] -
-		mat[8] * mat[1] * mat[7] +
-		mat[8] * mat[3] * mat[5];
-
-	invOut[12] = -mat[4] * mat[9] * mat[14] +
-		mat[4] * mat[10] * mat[13] +
-		mat[8] * mat[5] * mat[14] -
-		mat[8] * mat[6] * mat[13] -
-		mat[12] * mat[5] * mat[10] +
-		mat[12] * mat[6] * mat[9];
-
-	invOut[13] = mat[0] * mat[9] * mat[14] -
-		mat[0] * mat[10] * mat[13] -
-		mat[8] * mat[1] * mat[14] +
-		mat[8] * mat[2] * mat[13] +
-		mat[12] * mat[1] * mat[10] -
-		mat[12] * mat[2] * mat[9];
-
-	invOut[14] = -mat[0] * mat[5] * mat[14] +
-		mat[0] * mat[6] * mat[13] +
-		mat[4] * mat[1] * mat[14] -
-		mat[4] * mat[2] * mat[13] -
-		mat[12] * mat[1] * mat[6] +
-		mat[12] * mat[2] * mat[5];
-
-	invOut[15] = mat[0] * mat[5] * mat[10] -
-		mat[0] * mat[6] * mat[9] -
-		mat[4] * mat[1] * mat[10] +
-		mat[4] * mat[2] * mat[9] +
-		mat[8] * mat[1] * mat[6] -
-		mat[8] * mat[2] * mat[5];
-
-	float det = mat[0] * invOut[0] + mat[1] * invOut[4] + mat[2] * invOut[8] + mat[3] * invOut[12];
-	if (det == 0.0f)
-	{
-		// 逆行列なし（特異行列）
-		return MakeIdentity4x4(); // または assert, エラーログ等
-	}
-
-	float invDet = 1.0f / det;
-	for (int i = 0; i < 16; ++i)
-	{
-		inv[i] = invOut[i] * invDet;
-	}
-
-	return result;
-}
 DirectX::ScratchImage LoadTexture(const std::string& filePath)
 {
-	DirectX::ScratchImage image{};
 	std::wstring filePathW = ConvertString(filePath);
 
 	// ファイルパスの確認ログ
 	Log(std::format(L"Attempting to load texture from: {}", filePathW));
 
-	HRESULT hr = DirectX::LoadFromWICFile(filePathW.c_str(), DirectX::WIC_FLAGS_FORCE_SRGB, nullptr, image);
+	// デコードとミップマップの作成（非同期の読み込みと同じ処理を、この場で行う）
+	DirectX::ScratchImage mipImage{};
+	double decodeMilliseconds = 0.0;
+	double mipMilliseconds = 0.0;
+	HRESULT hr = DecodeTextureWithMips(filePath, mipImage, decodeMilliseconds, mipMilliseconds);
 
 	if (FAILED(hr)) {
 		Log(std::format(L"Failed to load texture. HRESULT: {}", hr));
 		// 詳細なエラーメッセージを追加
-		return image;  // エラー処理。適切な返り値を返す
+		mipImage.Release();
+		return mipImage;  // エラー処理。適切な返り値を返す
 	}
-
-	// 成功時の処理
-	assert(SUCCEEDED(hr));
-
-
-	// ミップマップの作成
-	DirectX::ScratchImage mipImage{};
-	hr = DirectX::GenerateMipMaps(image.GetImages(), image.GetImageCount(), image.GetMetadata(), DirectX::TEX_FILTER_SRGB, 0, mipImage);
-	assert(SUCCEEDED(hr));
 	return mipImage;
 }
 ID3D12Resource* CreateTextureResource(ID3D12Device* device, const DirectX::TexMetadata& metadata)
@@ -0,0 +1,166 @@
+// CompactVertex.h のテストとベンチマーク（Linux でも動く）。
+// Resources のモデルを圧縮頂点にして戻し、位置・法線・UV の誤差が決めた範囲（位置と UV は丸めの半段、法線は kOctahedralNormalMaxError）に
+// 収まることを確かめ、頂点バッファの大きさと変換の時間を表示する
+#include "CompactVertex.h"
+#include "ObjLoader.h"
+#include "TestUtility.h"
+#include <filesystem>
+#include <random>
+
+namespace {
+
+/// <summary>
+/// half の変換が、決まった値で正しく丸められ、すべての half が float を通して同じ値に戻ること
+/// </summary>
+void TestHalfConversion()
+{
+	struct Case
+	{
+		float value;
+		uint16_t expected;
+	};
+	const Case kCases[] = {
+		{ 0.0f, 0x0000 },
+		{ -0.0f, 0x8000 },
+		{ 1.0f, 0x3C00 },
+		{ -2.0f, 0xC000 },
+		{ 0.5f, 0x3800 },
+		{ 65504.0f, 0x7BFF },                          // 最大値
+		{ 65519.0f, 0x7BFF },
+		{ 65520.0f, 0x7C00 },                          // 最大値と無限大の中間は偶数の側（無限大）
+		{ 1.0e10f, 0x7C00 },
+		{ 6.103515625e-05f, 0x0400 },                  // 最小の正規化数 2^-14
+		{ 5.9604644775390625e-08f, 0x0001 },           // 最小の非正規化数 2^-24
+		{ 2.98023223876953125e-08f, 0x0000 },          // 2^-25 は 0 と 2^-24 の中間なので偶数の側（0）
+		{ 8.94069671630859375e-08f, 0x0002 },          // 3 * 2^-25 は 1 と 2 の中間なので偶数の側（2）
+		{ 1.00048828125f, 0x3C00 },                    // 1 + 2^-11 は 1 と 1 + 2^-10 の中間なので偶数の側（1）
+		{ 1.00146484375f, 0x3C02 },                    // 1 + 3 * 2^-11 は奇数と偶数の中間なので偶数の側（1 + 2^-9）
+	};
+	bool allMatch = true;
+	for (const Case& testCase : kCases) {
+		const uint16_t half = ConvertFloatToHalf(testCase.value);
+		if (half != testCase.expected) {
+			std::printf("ConvertFloatToHalf(%.9g) = 0x%04X, expected 0x%04X\n", testCase.value, half, testCase.expected);
+			allMatch = false;
+		}
+	}
+	Check(allMatch, "ConvertFloatToHalf rounds to the nearest half, ties to even");
+
+	bool allRoundTrip = true;
+	for (uint32_t half = 0; half <= 0xFFFF; ++half) {
+		const bool isNan = (half & 0x7C00) == 0x7C00 && (half & 0x03FF) != 0;
+		if (!isNan && ConvertFloatToHalf(ConvertHalfToFloat(static_cast<uint16_t>(half))) != half) {
+			allRoundTrip = false;
+		}
+	}
+	Check(allRoundTrip, "every non-NaN half survives a round trip through float");
+	Check(std::isnan(ConvertHalfToFloat(ConvertFloatToHalf(NAN))), "NaN stays NaN");
+}
+
+/// <summary>
+/// Resources のモデルを圧縮頂点にして戻し、誤差が範囲に収まることを確かめる
+/// </summary>
+void TestResourceModels()
+{
+	size_t totalFullBytes = 0;
+	size_t totalCompactBytes = 0;
+	size_t meshCount = 0;
+	bool allWithinBounds = true;
+	bool allPositionsClose = true;
+	for (const auto& entry : std::filesystem::directory_iterator(RESOURCES_DIRECTORY)) {
+		if (entry.path().extension() != ".obj") {
+			continue;
+		}
+		const std::string filename = entry.path().filename().string();
+		const ModelData model = LoadObjFile(RESOURCES_DIRECTORY, filename);
+		for (const MeshData& mesh : model.meshes) {
+			VertexQuantization quantization{};
+			std::vector<CompactVertexData> compactVertices;
+			const double milliseconds = MeasureNanoseconds(10, 1, [&] {
+				quantization = ComputeVertexQuantization(mesh.vertices);
+				compactVertices = EncodeCompactVertices(mesh.vertices, quantization);
+			}) / 1.0e6;
+
+			const CompactVertexError error = MeasureCompactVertexError(mesh.vertices, compactVertices, quantization);
+			const bool isWithinBounds = IsCompactVertexErrorWithinBounds(error);
+			allWithinBounds = allWithinBounds && isWithinBounds;
+
+			// 位置の誤差をモデル空間の長さでも確かめる（軸ごとに箱の大きさの 1 / 65535 の半分まで）
+			for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+				const VertexData decoded = DecodeCompactVertex(compactVertices[i], quantization);
+				const Vector4& original = mesh.vertices[i].position;
+				const Vector3& extent = quantization.positionExtent;
+				allPositionsClose = allPositionsClose &&
+					fabsf(decoded.position.x - original.x) <= extent.x * (0.51f / 65535.0f) + 1.0e-7f &&
+					fabsf(decoded.position.y - original.y) <= extent.y * (0.51f / 65535.0f) + 1.0e-7f &&
+					fabsf(decoded.position.z - original.z) <= extent.z * (0.51f / 65535.0f) + 1.0e-7f;
+			}
+
+			const size_t fullBytes = sizeof(VertexData) * mesh.vertices.size();
+			const size_t compactBytes = sizeof(CompactVertexData) * compactVertices.size();
+			totalFullBytes += fullBytes;
+			totalCompactBytes += compactBytes;
+			std::printf("%s/%s: %zu vertices, %zu -> %zu bytes, max error position %.3f steps, uv %.3f half steps, normal %.2e rad, %.3f ms%s\n",
+				filename.c_str(), mesh.name.c_str(), mesh.vertices.size(), fullBytes, compactBytes,
+				error.position, error.texcoord, error.normal, milliseconds, isWithinBounds ? "" : " (OUT OF BOUNDS)");
+			++meshCount;
+		}
+	}
+	if (totalFullBytes > 0) {
+		std::printf("total: %zu -> %zu bytes (%.1f%%)\n", totalFullBytes, totalCompactBytes, 100.0 * totalCompactBytes / totalFullBytes);
+	}
+	Check(meshCount >= 6, "Resources contains the OBJ fixtures");
+	Check(allWithinBounds, "position, UV and normal errors of every Resources mesh are within the documented bounds");
+	Check(allPositionsClose, "decoded positions are within half a quantization step of the originals");
+}
+
+/// <summary>
+/// 法線の向き・厚みの無い軸・範囲の広い UV など、モデルに出てこない値でも誤差が範囲に収まること
+/// </summary>
+void TestSyntheticVertices()
+{
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<VertexData> vertices;
+	// 軸の向き・八面体の辺と頂点（折り返しの境目）を含める
+	const Vector3 kNormals[] = {
+		{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+		{ 1, 1, 0 }, { 1, -1, 0 }, { -1, 0, 1 }, { 0, -1, -1 }, { 1, 1, 1 }, { -1, -1, -1 }, { 1, -1, -1e-6f },
+	};
+	for (const Vector3& normal : kNormals) {
+		vertices.push_back({ { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f }, Normalize(normal), 0.0f });
+	}
+	for (int32_t i = 0; i < 100000; ++i) {
+		Vector3 normal{ unit(random), unit(random), unit(random) };
+		if (normal.x * normal.x + normal.y * normal.y + normal.z * normal.z < 1.0e-6f) {
+			continue;
+		}
+		// z は 0 のままにして、厚みの無い軸を作る
+		vertices.push_back({ { unit(random) * 100.0f, unit(random) * 0.01f, 0.0f, 1.0f }, { unit(random) * 8.0f, unit(random) * 1.0e-4f },
+			Normalize(normal), 0.0f });
+	}
+	const VertexQuantization quantization = ComputeVertexQuantization(vertices);
+	const std::vector<CompactVertexData> compactVertices = EncodeCompactVertices(vertices, quantization);
+	const CompactVertexError error = MeasureCompactVertexError(vertices, compactVertices, quantization);
+	std::printf("synthetic: %zu vertices, max error position %.3f steps, uv %.3f half steps, normal %.2e rad (bound %.2e)\n",
+		vertices.size(), error.position, error.texcoord, error.normal, kOctahedralNormalMaxError);
+	Check(IsCompactVertexErrorWithinBounds(error), "random normals, flat axes and wide UVs stay within the documented bounds");
+
+	bool flatAxisExact = true;
+	for (const CompactVertexData& compact : compactVertices) {
+		flatAxisExact = flatAxisExact && DecodeCompactVertex(compact, quantization).position.z == 0.0f;
+	}
+	Check(flatAxisExact, "an axis without extent decodes exactly");
+
+	Check(ComputeVertexQuantization({}).positionExtent.x == 0.0f && EncodeCompactVertices({}, {}).empty(), "an empty vertex list encodes to nothing");
+}
+
+} // namespace
+
+int main()
+{
+	TestHalfConversion();
+	TestResourceModels();
+	TestSyntheticVertices();
+	return GetTestExitCode();
+}
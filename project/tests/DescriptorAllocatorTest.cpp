@@ -0,0 +1,161 @@
+// DescriptorAllocator.h のテストとベンチマーク（Linux でも動く）。
+// 割り当て・解放・世代・使い捨ての領域の動きを確かめ、割り当てと解放の速さを、使用中の印を先頭から探して空きを見つける方法と比べる
+#include "DescriptorAllocator.h"
+#include "TestUtility.h"
+#include <random>
+
+namespace {
+
+/// <summary>
+/// 割り当て・解放・世代・使い捨ての領域
+/// </summary>
+void TestBasics()
+{
+	DescriptorAllocator allocator;
+	InitializeDescriptorAllocator(allocator, 1, 4, 3, 2);
+	Check(GetDescriptorHeapSize(allocator) == 1 + 4 + 3 * 2, "heap size");
+	DescriptorHandle handles[4];
+	bool isLowestFirst = true;
+	for (uint32_t i = 0; i < 4; ++i) {
+		handles[i] = AllocateDescriptor(allocator);
+		isLowestFirst = isLowestFirst && IsDescriptorHandleValid(allocator, handles[i]) && GetDescriptorHeapIndex(allocator, handles[i]) == 1 + i;
+	}
+	Check(isLowestFirst, "allocates from the lowest index");
+	Check(AllocateDescriptor(allocator).index == kInvalidDescriptorIndex, "full allocator returns an invalid handle");
+	FreeDescriptor(allocator, handles[2]);
+	Check(!IsDescriptorHandleValid(allocator, handles[2]), "freed handle is stale");
+	const DescriptorHandle reused = AllocateDescriptor(allocator);
+	Check(reused.index == handles[2].index && reused.generation != handles[2].generation, "freed slot is reused with a new generation");
+	Check(!IsDescriptorHandleValid(allocator, handles[2]) && IsDescriptorHandleValid(allocator, reused), "stale handle stays invalid after reuse");
+	Check(!IsDescriptorHandleValid(allocator, DescriptorHandle{}), "default handle is invalid");
+	Check(GetLiveDescriptorCount(allocator) == 4, "live count");
+
+	BeginDescriptorFrame(allocator, 0);
+	const uint32_t first = AllocateTransientDescriptors(allocator, 2);
+	const uint32_t second = AllocateTransientDescriptors(allocator, 1);
+	Check(first == 5 && second == 7, "transient descriptors follow the persistent region");
+	Check(AllocateTransientDescriptors(allocator, 1) == kInvalidDescriptorIndex, "transient region overflow");
+	BeginDescriptorFrame(allocator, 1);
+	Check(AllocateTransientDescriptors(allocator, 3) == 8, "each frame has its own transient region");
+	BeginDescriptorFrame(allocator, 0);
+	Check(AllocateTransientDescriptors(allocator, 1) == 5, "transient region restarts at the beginning of the frame");
+}
+
+/// <summary>
+/// ランダムな割り当てと解放を、使用中の番号の集合と比べる
+/// </summary>
+void TestRandomOperations()
+{
+	const uint32_t kCapacity = 1024;
+	const uint32_t kSteps = 200000;
+	DescriptorAllocator allocator;
+	InitializeDescriptorAllocator(allocator, 0, kCapacity, 0, 1);
+	std::mt19937 random(21);
+	std::vector<DescriptorHandle> live;
+	std::vector<DescriptorHandle> stale;
+	std::vector<uint8_t> used(kCapacity, 0);
+	uint32_t errors = 0;
+	for (uint32_t step = 0; step < kSteps; ++step) {
+		const bool allocate = live.empty() || (random() % 100 < 55 && live.size() < kCapacity);
+		if (allocate) {
+			const DescriptorHandle handle = AllocateDescriptor(allocator);
+			errors += (handle.index >= kCapacity || used[handle.index]) ? 1 : 0;
+			if (handle.index < kCapacity) {
+				used[handle.index] = 1;
+				live.push_back(handle);
+			}
+		} else {
+			const size_t i = random() % live.size();
+			const DescriptorHandle handle = live[i];
+			live[i] = live.back();
+			live.pop_back();
+			FreeDescriptor(allocator, handle);
+			used[handle.index] = 0;
+			stale.push_back(handle);
+		}
+	}
+	for (const DescriptorHandle& handle : stale) {
+		errors += IsDescriptorHandleValid(allocator, handle) ? 1 : 0;
+	}
+	for (const DescriptorHandle& handle : live) {
+		errors += IsDescriptorHandleValid(allocator, handle) ? 0 : 1;
+	}
+	errors += (GetLiveDescriptorCount(allocator) == live.size()) ? 0 : 1;
+	std::printf("random test: %u operations, %zu live, %zu stale handles checked, %u errors\n", kSteps, live.size(), stale.size(), errors);
+	Check(errors == 0, "random allocate / free matches the reference");
+}
+
+/// <summary>
+/// 速さ。半分ほど埋まった状態で、解放と割り当てを繰り返す
+/// </summary>
+void TestSpeed()
+{
+	const uint32_t kOperations = 1000000;
+	for (uint32_t capacity : { 128u, 1024u, 4096u }) {
+		std::mt19937 random(capacity);
+		std::vector<uint32_t> victims(kOperations);
+		for (uint32_t& victim : victims) {
+			victim = random() % (capacity / 2);
+		}
+
+		DescriptorAllocator allocator;
+		InitializeDescriptorAllocator(allocator, 0, capacity, 0, 1);
+		std::vector<DescriptorHandle> live(capacity / 2);
+		for (DescriptorHandle& handle : live) {
+			handle = AllocateDescriptor(allocator);
+		}
+		const double freeListNanoseconds = MeasureNanoseconds(1, kOperations, [&] {
+			for (uint32_t victim : victims) {
+				FreeDescriptor(allocator, live[victim]);
+				live[victim] = AllocateDescriptor(allocator);
+			}
+		});
+
+		// 使用中の印を先頭から探す方法（ばらばらに解放された後は、空きを見つけるまで長く探すことがある）
+		std::vector<uint8_t> used(capacity, 0);
+		std::vector<uint32_t> liveIndices(capacity / 2);
+		for (uint32_t i = 0; i < capacity / 2; ++i) {
+			used[i] = 1;
+			liveIndices[i] = i;
+		}
+		uint64_t checksum = 0;
+		const double scanNanoseconds = MeasureNanoseconds(1, kOperations, [&] {
+			for (uint32_t victim : victims) {
+				used[liveIndices[victim]] = 0;
+				uint32_t index = 0;
+				while (used[index]) {
+					++index;
+				}
+				used[index] = 1;
+				liveIndices[victim] = index;
+				checksum += index;
+			}
+		});
+
+		// 使い捨ての領域は足すだけ
+		DescriptorAllocator transientAllocator;
+		InitializeDescriptorAllocator(transientAllocator, 0, 0, capacity, 1);
+		const double transientNanoseconds = MeasureNanoseconds(1, kOperations, [&] {
+			for (uint32_t i = 0; i < kOperations; ++i) {
+				if (i % capacity == 0) {
+					BeginDescriptorFrame(transientAllocator, 0);
+				}
+				checksum += AllocateTransientDescriptors(transientAllocator, 1);
+			}
+		});
+
+		std::printf("%u descriptors: free list %.1f ns per free+allocate, linear scan %.1f ns (x%.1f), transient %.2f ns per allocate (checksum %llu)\n",
+			capacity, freeListNanoseconds, scanNanoseconds, scanNanoseconds / freeListNanoseconds, transientNanoseconds, static_cast<unsigned long long>(checksum));
+		Check(GetLiveDescriptorCount(allocator) == capacity / 2, "live count after the benchmark");
+	}
+}
+
+} // namespace
+
+int main()
+{
+	TestBasics();
+	TestRandomOperations();
+	TestSpeed();
+	return GetTestExitCode();
+}
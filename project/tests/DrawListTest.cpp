@@ -0,0 +1,168 @@
+// DrawList.h のインスタンス描画のテストとベンチマーク（Linux でも動く）。
+// 見えている物体の行列をインスタンスバッファへ直接詰める BeginInstancedDrawList / PackInstances と、メッシュごとに1回のインスタンス描画が
+// 物体ごとに1回ずつ描くのと同じものを描くことを、RecordingCommandBackend に出したコマンドで確かめる
+#include "DrawList.h"
+#include "TestUtility.h"
+#include <random>
+
+namespace {
+
+const uint32_t kMeshCount = 8;
+const uint32_t kInstancesPerMesh = 4096;
+const uint32_t kObjectCount = kMeshCount * kInstancesPerMesh;
+const int32_t kIterations = 50;
+
+// GPU の代わりに記録したコマンドをたどって並べる、描かれるインスタンスごとの (メッシュ, インデックスの範囲, 行列)
+struct DrawnInstance {
+	uint32_t meshIndex;
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	const TransformationMatrix* matrices;
+};
+
+/// <summary>
+/// 記録したコマンドを順にたどって、描かれるインスタンスを並べる
+/// </summary>
+std::vector<DrawnInstance> ReplayInstances(const RecordingCommandBackend& backend, const TransformationMatrix* instances)
+{
+	std::vector<DrawnInstance> drawn;
+	uint32_t meshIndex = UINT32_MAX;
+	uint32_t first = UINT32_MAX;
+	for (const RecordedCommand& command : backend.commands) {
+		if (command.type == RecordedCommandType::SetMesh) {
+			meshIndex = command.arguments[1];
+		} else if (command.type == RecordedCommandType::SetFirstInstance) {
+			first = command.arguments[0];
+		} else if (command.type == RecordedCommandType::DrawIndexedInstanced) {
+			for (uint32_t instanceId = 0; instanceId < command.arguments[1]; ++instanceId) {
+				drawn.push_back({ meshIndex, command.arguments[2], command.arguments[0], &instances[first + instanceId] });
+			}
+		}
+	}
+	return drawn;
+}
+
+/// <summary>
+/// 見えている物体の行列の詰め込みと、インスタンス描画の一覧を確かめて測る
+/// </summary>
+void TestInstancing()
+{
+	const Matrix4x4 viewProjection = Multiply(
+		MakeViewMatrix(Transform{ { 1.0f, 1.0f, 1.0f }, { 0.3f, 0.5f, 0.0f }, { 0.0f, 2.0f, -20.0f } }),
+		MakePerspectiveFovMatrix(0.45f, 16.0f / 9.0f, 0.1f, 100.0f));
+
+	std::mt19937 random(20250512);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	TransformSoA transforms;
+	for (uint32_t i = 0; i < kObjectCount; ++i) {
+		AddTransform(transforms, {
+			{ 1.0f, 1.0f, 1.0f },
+			{ 3.14159265f * unit(random), 3.14159265f * unit(random), 0.0f },
+			{ 50.0f * unit(random), 50.0f * unit(random), 50.0f * unit(random) } });
+	}
+	std::vector<TransformationMatrix> matrices(kObjectCount);
+	ComputeTransformationMatrices(transforms, viewProjection, matrices.data());
+
+	// カリングで半分ほど残ったことにする（メッシュ i のインスタンスは i * kInstancesPerMesh から並ぶ）
+	std::vector<uint32_t> visible;
+	std::vector<uint32_t> visibleCountPerMesh(kMeshCount, 0);
+	for (uint32_t i = 0; i < kObjectCount; ++i) {
+		if (unit(random) >= 0.0f) {
+			visible.push_back(i);
+			++visibleCountPerMesh[i / kInstancesPerMesh];
+		}
+	}
+
+	// 今までの方法: 見えている物体ごとに、256 バイトおきに並べた定数バッファへ書く
+	const size_t kConstantBufferStride = 256;
+	std::vector<uint8_t> constantBuffer(kConstantBufferStride * kObjectCount);
+	const double perObjectNanoseconds = MeasureNanoseconds(kIterations, visible.size(), [&] {
+		for (size_t i = 0; i < visible.size(); ++i) {
+			std::memcpy(constantBuffer.data() + kConstantBufferStride * i, &matrices[visible[i]], sizeof(TransformationMatrix));
+		}
+	});
+
+	// インスタンス描画: 見えている物体の行列を、インスタンスバッファへ直接詰める（描画で使う方法）
+	InstancedDrawList drawList;
+	std::vector<TransformationMatrix> instanceBuffer(kObjectCount);
+	const double inPlaceNanoseconds = MeasureNanoseconds(kIterations, visible.size(), [&] {
+		BeginInstancedDrawList(drawList, instanceBuffer.data(), instanceBuffer.size());
+		PackInstances(drawList, matrices.data(), visible.data(), visible.size());
+	});
+	size_t inPlaceMismatches = (drawList.instances == instanceBuffer.data() && drawList.instanceCount == visible.size()) ? 0 : 1;
+	for (size_t i = 0; i < visible.size(); ++i) {
+		if (std::memcmp(&instanceBuffer[i], &matrices[visible[i]], sizeof(TransformationMatrix)) != 0) {
+			++inPlaceMismatches;
+		}
+	}
+
+	// 比較用: instanceStorage に詰めてから、1回の memcpy で送る（コピーが物体ごとに2回になる）
+	std::vector<TransformationMatrix> stagedBuffer(kObjectCount);
+	const double stagedNanoseconds = MeasureNanoseconds(kIterations, visible.size(), [&] {
+		ClearInstancedDrawList(drawList);
+		PackInstances(drawList, matrices.data(), visible.data(), visible.size());
+		UploadInstances(drawList, stagedBuffer.data(), stagedBuffer.size());
+	});
+	const bool stagedMatches = std::memcmp(stagedBuffer.data(), instanceBuffer.data(), sizeof(TransformationMatrix) * visible.size()) == 0;
+
+	std::printf("%zu of %u objects: per-object constant buffers %.2f ns/object (%zu KiB), instance buffer written in place %.2f ns/object, staged + upload %.2f ns/object (%zu KiB), %zu mismatches\n",
+		visible.size(), kObjectCount, perObjectNanoseconds, kConstantBufferStride * visible.size() / 1024,
+		inPlaceNanoseconds, stagedNanoseconds, sizeof(TransformationMatrix) * visible.size() / 1024, inPlaceMismatches);
+	Check(inPlaceMismatches == 0, "BeginInstancedDrawList + PackInstances write the visible matrices in order into the instance buffer");
+	Check(stagedMatches, "ClearInstancedDrawList + PackInstances + UploadInstances write the same matrices");
+
+	// instanceStorage に詰めるときは、足りなければ広げて、前に詰めた行列を残す
+	InstancedDrawList growingList;
+	bool growsInOrder = true;
+	for (uint32_t i = 0; i < 100; ++i) {
+		growsInOrder = growsInOrder && AppendInstances(growingList, &matrices[i], 1) == i;
+	}
+	growsInOrder = growsInOrder && growingList.instanceCount == 100 && growingList.instanceCapacity >= 100 &&
+		std::memcmp(growingList.instances, matrices.data(), sizeof(TransformationMatrix) * 100) == 0;
+	Check(growsInOrder, "AppendInstances grows the owned storage and keeps the earlier matrices");
+
+	// 物体ごとに1回ずつ描く一覧と、メッシュごとに1回のインスタンス描画の一覧を作る
+	auto makeRange = [](uint32_t meshIndex) { return IndexRange{ meshIndex * 300, 300 + meshIndex * 36 }; };
+	InstancedDrawList perObjectList;
+	uint32_t firstInstance = PackInstances(perObjectList, matrices.data(), visible.data(), visible.size());
+	for (uint32_t meshIndex = 0; meshIndex < kMeshCount; ++meshIndex) {
+		for (uint32_t i = 0; i < visibleCountPerMesh[meshIndex]; ++i) {
+			AddInstancedDraw(perObjectList, DrawState{}, 0, meshIndex, makeRange(meshIndex), firstInstance++, 1);
+		}
+	}
+	InstancedDrawList instancedList;
+	firstInstance = PackInstances(instancedList, matrices.data(), visible.data(), visible.size());
+	for (uint32_t meshIndex = 0; meshIndex < kMeshCount; ++meshIndex) {
+		AddInstancedDraw(instancedList, DrawState{}, 0, meshIndex, makeRange(meshIndex), firstInstance, visibleCountPerMesh[meshIndex]);
+		firstInstance += visibleCountPerMesh[meshIndex];
+	}
+	// インスタンスが1つもない描画は追加されない
+	AddInstancedDraw(instancedList, DrawState{}, 0, 0, makeRange(0), firstInstance, 0);
+
+	RecordingCommandBackend perObjectBackend;
+	SubmitInstancedDrawList(perObjectList, perObjectBackend);
+	RecordingCommandBackend instancedBackend;
+	SubmitInstancedDrawList(instancedList, instancedBackend);
+	const std::vector<DrawnInstance> expected = ReplayInstances(perObjectBackend, perObjectList.instances);
+	const std::vector<DrawnInstance> actual = ReplayInstances(instancedBackend, instancedList.instances);
+
+	size_t drawMismatches = (expected.size() == actual.size()) ? 0 : std::max(expected.size(), actual.size());
+	for (size_t i = 0; i < std::min(expected.size(), actual.size()); ++i) {
+		if (expected[i].meshIndex != actual[i].meshIndex || expected[i].indexOffset != actual[i].indexOffset || expected[i].indexCount != actual[i].indexCount ||
+			std::memcmp(expected[i].matrices, actual[i].matrices, sizeof(TransformationMatrix)) != 0) {
+			++drawMismatches;
+		}
+	}
+	std::printf("%u meshes: per-object %zu commands (%zu draws), instanced %zu commands (%zu draws), %zu instances drawn, %zu mismatches\n",
+		kMeshCount, perObjectBackend.commands.size(), perObjectList.draws.size(), instancedBackend.commands.size(), instancedList.draws.size(), actual.size(), drawMismatches);
+	Check(drawMismatches == 0 && actual.size() == visible.size(), "instanced draws draw the same instances as per-object draws");
+	Check(instancedList.draws.size() == kMeshCount, "one instanced draw per mesh");
+}
+
+} // namespace
+
+int main()
+{
+	TestInstancing();
+	return GetTestExitCode();
+}
@@ -0,0 +1,160 @@
+// DrawList.h の描画の並べ替えのテストとベンチマーク（Linux でも動く）。
+// RadixSortDrawKeys が std::stable_sort と同じ順になること、並べ替えても描かれるものが変わらず、
+// 状態を設定するコマンドが減って重複しないことを RecordingCommandBackend で確かめ、速度を表示する
+#include "DrawList.h"
+#include "TestUtility.h"
+#include <random>
+
+namespace {
+
+const uint32_t kPipelineCount = 3;
+const uint32_t kMaterialCount = 16;
+const uint32_t kTextureCount = 8;
+const uint32_t kModelCount = 8;
+const uint32_t kMeshCount = 32;
+
+// 描かれるもの（状態・モデル・メッシュ・範囲・インスタンス）
+struct DrawnItem {
+	uint32_t values[9];
+	bool operator<(const DrawnItem& other) const { return std::lexicographical_compare(values, values + 9, other.values, other.values + 9); }
+	bool operator==(const DrawnItem& other) const { return std::equal(values, values + 9, other.values); }
+};
+
+/// <summary>
+/// 記録したコマンドを状態を追いながらたどって、描かれるものを並べる。
+/// 直前と同じ値を設定し直したコマンドは redundantCommands に数える
+/// </summary>
+std::vector<DrawnItem> ReplayDraws(const RecordingCommandBackend& backend, size_t& redundantCommands)
+{
+	std::vector<DrawnItem> drawn;
+	// pipeline, material, texture, model, mesh, firstInstance の今の値
+	uint32_t current[6] = { UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX };
+	auto set = [&](int slot, uint32_t value) {
+		if (current[slot] == value) {
+			++redundantCommands;
+		}
+		current[slot] = value;
+	};
+	for (const RecordedCommand& command : backend.commands) {
+		switch (command.type) {
+		case RecordedCommandType::SetPipeline: set(0, command.arguments[0]); break;
+		case RecordedCommandType::SetMaterial: set(1, command.arguments[0]); break;
+		case RecordedCommandType::SetTexture: set(2, command.arguments[0]); break;
+		case RecordedCommandType::SetMesh:
+			if (current[3] == command.arguments[0] && current[4] == command.arguments[1]) {
+				++redundantCommands;
+			}
+			current[3] = command.arguments[0];
+			current[4] = command.arguments[1];
+			break;
+		case RecordedCommandType::SetFirstInstance: set(5, command.arguments[0]); break;
+		case RecordedCommandType::DrawIndexedInstanced:
+			drawn.push_back({ { current[0], current[1], current[2], current[3], current[4], command.arguments[2], command.arguments[0], current[5], command.arguments[1] } });
+			break;
+		default: break;
+		}
+	}
+	std::sort(drawn.begin(), drawn.end());
+	return drawn;
+}
+
+/// <summary>
+/// キーの各部分が上位から PSO・マテリアル・テクスチャ・モデル・メッシュ・深度の順に効くことを確かめる
+/// </summary>
+void TestDrawSortKey()
+{
+	const DrawState state = { 1, 2, 3 };
+	const uint64_t key = MakeDrawSortKey(state, 4, 5, 10.0f);
+	bool isOrdered = true;
+	isOrdered = isOrdered && key < MakeDrawSortKey({ 2, 0, 0 }, 0, 0, 0.0f);
+	isOrdered = isOrdered && key < MakeDrawSortKey({ 1, 3, 0 }, 0, 0, 0.0f);
+	isOrdered = isOrdered && key < MakeDrawSortKey({ 1, 2, 4 }, 0, 0, 0.0f);
+	isOrdered = isOrdered && key < MakeDrawSortKey(state, 5, 0, 0.0f);
+	isOrdered = isOrdered && key < MakeDrawSortKey(state, 4, 6, 0.0f);
+	isOrdered = isOrdered && key < MakeDrawSortKey(state, 4, 5, 20.0f);
+	// 手前から順（負の深度は 0 として扱う）
+	isOrdered = isOrdered && MakeDrawSortKey(state, 4, 5, -1.0f) == MakeDrawSortKey(state, 4, 5, 0.0f);
+	isOrdered = isOrdered && MakeDrawSortKey(state, 4, 5, 0.0f) < key;
+	Check(isOrdered, "MakeDrawSortKey orders by pipeline, material, texture, model, mesh, then depth");
+}
+
+/// <summary>
+/// 描画の数を変えて、並べ替えの結果と速さ、状態を設定するコマンドの数を確かめる
+/// </summary>
+void TestDrawSorting()
+{
+	std::mt19937 random(20250519);
+	for (uint32_t drawCount : { 100u, 10000u, 100000u }) {
+		const int32_t iterations = std::max(1, int32_t(1000000 / drawCount));
+
+		InstancedDrawList drawList;
+		std::fill_n(ReserveInstances(drawList, drawCount), drawCount, TransformationMatrix{ MakeIdentity4x4(), MakeIdentity4x4() });
+		std::uniform_real_distribution<float> depthDistribution(0.1f, 100.0f);
+		for (uint32_t i = 0; i < drawCount; ++i) {
+			const DrawState state = { uint32_t(random() % kPipelineCount), uint32_t(random() % kMaterialCount), uint32_t(random() % kTextureCount) };
+			const uint32_t meshIndex = random() % kMeshCount;
+			AddInstancedDraw(drawList, state, random() % kModelCount, meshIndex, { meshIndex * 600, 600 }, i, 1, depthDistribution(random));
+		}
+
+		// キーの並べ替えだけを比べる（どちらも安定なので結果は一致するはず）
+		std::vector<DrawSortEntry> unsorted(drawCount);
+		for (uint32_t i = 0; i < drawCount; ++i) {
+			unsorted[i] = { drawList.draws[i].sortKey, i };
+		}
+		std::vector<DrawSortEntry> entries;
+		std::vector<DrawSortEntry> scratch;
+		const double radixNanoseconds = MeasureNanoseconds(iterations, drawCount, [&] {
+			entries = unsorted;
+			RadixSortDrawKeys(entries, scratch);
+		});
+		std::vector<DrawSortEntry> sorted;
+		const double stableSortNanoseconds = MeasureNanoseconds(iterations, drawCount, [&] {
+			sorted = unsorted;
+			std::stable_sort(sorted.begin(), sorted.end(), [](const DrawSortEntry& a, const DrawSortEntry& b) { return a.key < b.key; });
+		});
+		size_t orderMismatches = 0;
+		for (uint32_t i = 0; i < drawCount; ++i) {
+			if (entries[i].drawIndex != sorted[i].drawIndex) {
+				++orderMismatches;
+			}
+		}
+		std::printf("%u draws: RadixSortDrawKeys %.2f ns/draw, std::stable_sort %.2f ns/draw (x%.2f), %zu order mismatches\n",
+			drawCount, radixNanoseconds, stableSortNanoseconds, stableSortNanoseconds / radixNanoseconds, orderMismatches);
+		Check(orderMismatches == 0, "RadixSortDrawKeys gives the same order as std::stable_sort");
+
+		// 並べ替えの前と後で一覧を出し、描かれるものが同じで、状態の設定が重複しないこと
+		RecordingCommandBackend unsortedBackend;
+		const DrawSubmitStatistics unsortedStatistics = SubmitInstancedDrawList(drawList, unsortedBackend);
+		SortInstancedDrawList(drawList);
+		RecordingCommandBackend sortedBackend;
+		const DrawSubmitStatistics sortedStatistics = SubmitInstancedDrawList(drawList, sortedBackend);
+		size_t redundantCommands = 0;
+		const bool sameDraws = ReplayDraws(unsortedBackend, redundantCommands) == ReplayDraws(sortedBackend, redundantCommands);
+
+		bool keysOrdered = true;
+		for (uint32_t i = 1; i < drawCount; ++i) {
+			keysOrdered = keysOrdered && (drawList.draws[i - 1].sortKey <= drawList.draws[i].sortKey);
+		}
+		auto countOf = [](const RecordingCommandBackend& backend, RecordedCommandType type) { return backend.commandCounts[static_cast<size_t>(type)]; };
+		std::printf("%u draws: state commands unsorted %u (pipeline %u, material %u, texture %u, mesh %u), sorted %u (pipeline %u, material %u, texture %u, mesh %u), %u of %u redundant avoided\n",
+			drawCount,
+			unsortedStatistics.stateCommands, countOf(unsortedBackend, RecordedCommandType::SetPipeline), countOf(unsortedBackend, RecordedCommandType::SetMaterial),
+			countOf(unsortedBackend, RecordedCommandType::SetTexture), countOf(unsortedBackend, RecordedCommandType::SetMesh),
+			sortedStatistics.stateCommands, countOf(sortedBackend, RecordedCommandType::SetPipeline), countOf(sortedBackend, RecordedCommandType::SetMaterial),
+			countOf(sortedBackend, RecordedCommandType::SetTexture), countOf(sortedBackend, RecordedCommandType::SetMesh),
+			sortedStatistics.redundantStateCommandsAvoided, drawCount * kStateCommandsPerDraw);
+		Check(sameDraws && sortedStatistics.draws == drawCount, "sorting does not change what is drawn");
+		Check(keysOrdered, "SortInstancedDrawList orders draws by key");
+		Check(redundantCommands == 0, "SubmitInstancedDrawList never sets the same state twice in a row");
+		Check(sortedStatistics.stateCommands <= unsortedStatistics.stateCommands, "sorting does not add state commands");
+	}
+}
+
+} // namespace
+
+int main()
+{
+	TestDrawSortKey();
+	TestDrawSorting();
+	return GetTestExitCode();
+}
@@ -0,0 +1,75 @@
+// FrameRing.h のテスト（Linux でも動く）。
+// CPU と GPU の1フレームの時間を決めて SimulatedFence で FrameRing を動かし、組の使い回しとフェンスを待つ時機を確かめる
+#include "FrameRing.h"
+#include "TestUtility.h"
+#include <cmath>
+
+namespace {
+
+const uint32_t kFrameCount = 1000;
+
+/// <summary>
+/// 同時に進めるフレームの数ごとに、1フレームあたりの時間と待った回数を確かめる。
+/// 組を使い始めるときにはその組の前のフレームが GPU で終わっていること、待つ必要のないときに待っていないこと、
+/// 2組以上なら1フレームの時間が CPU と GPU の遅いほうの時間まで縮むこと
+/// </summary>
+void TestFramesInFlight()
+{
+	struct FrameTiming { double cpuFrameTime; double gpuFrameTime; const char* name; };
+	const FrameTiming timings[] = {
+		{ 4.0, 6.0, "GPU bound" },
+		{ 6.0, 4.0, "CPU bound" },
+		{ 5.0, 5.0, "balanced" },
+	};
+
+	for (const FrameTiming& timing : timings) {
+		for (uint32_t framesInFlight = 1; framesInFlight <= kMaxFramesInFlight; ++framesInFlight) {
+			FrameRing ring;
+			InitializeFrameRing(ring, framesInFlight);
+			SimulatedFence fence;
+			fence.gpuFrameTime = timing.gpuFrameTime;
+
+			uint32_t reuseViolations = 0;
+			uint32_t indexMismatches = 0;
+			for (uint32_t frame = 0; frame < kFrameCount; ++frame) {
+				const uint64_t previousUse = ring.frameFenceValues[ring.frameIndex];
+				const uint32_t frameIndex = BeginFrame(ring, fence);
+				// 組は順に使い回し、使い始めるときには GPU がその組を読み終えていること
+				indexMismatches += (frameIndex != frame % framesInFlight) ? 1 : 0;
+				reuseViolations += (fence.GetCompletedValue() < previousUse) ? 1 : 0;
+				fence.now += timing.cpuFrameTime;
+				EndFrame(ring, fence);
+			}
+			const uint64_t frameWaits = ring.waitCount;
+			WaitForGpuIdle(ring, fence);
+
+			const double frameTime = fence.now / kFrameCount;
+			// 1組ならフレームごとに GPU の完了を待つので CPU と GPU の時間の和、2組以上なら遅いほうの時間になるはず
+			const double expectedFrameTime = (framesInFlight == 1) ?
+				timing.cpuFrameTime + timing.gpuFrameTime : std::max(timing.cpuFrameTime, timing.gpuFrameTime);
+			// 1組なら2フレーム目から毎フレーム待つ。GPU のほうが速ければ、2組以上では一度も待たない
+			bool waitsMatch = true;
+			if (framesInFlight == 1) {
+				waitsMatch = (frameWaits == kFrameCount - 1);
+			} else if (timing.gpuFrameTime < timing.cpuFrameTime) {
+				waitsMatch = (frameWaits == 0);
+			}
+
+			std::printf("%s (CPU %.1f ms, GPU %.1f ms), %u frame(s) in flight: %.2f ms/frame (expected %.2f), %llu waits (%.1f ms waiting), %llu unnecessary waits, %u reuse violations\n",
+				timing.name, timing.cpuFrameTime, timing.gpuFrameTime, framesInFlight, frameTime, expectedFrameTime,
+				static_cast<unsigned long long>(frameWaits), fence.waitTime, static_cast<unsigned long long>(fence.unnecessaryWaitCount), reuseViolations);
+			Check(indexMismatches == 0 && reuseViolations == 0, "BeginFrame reuses a slot only after the GPU finished it");
+			Check(fence.unnecessaryWaitCount == 0 && waitsMatch, "BeginFrame waits only when it has to");
+			Check(std::abs(frameTime - expectedFrameTime) <= expectedFrameTime * 0.01, "frame time matches the CPU / GPU overlap");
+			Check(fence.GetCompletedValue() == ring.lastSignaledValue, "WaitForGpuIdle waits for every signaled frame");
+		}
+	}
+}
+
+} // namespace
+
+int main()
+{
+	TestFramesInFlight();
+	return GetTestExitCode();
+}
@@ -0,0 +1,161 @@
+// FrustumCulling.h のテストとベンチマーク（Linux でも動く）。
+// 命令セットごとの CullBounds の結果がスカラー版と同じになることを確かめ、速度を表示する
+#include "FrustumCulling.h"
+#include "TestUtility.h"
+#include <random>
+#include <iterator>
+
+namespace {
+
+// SIMD 版とスカラー版の判定が違ってもよい、平面すれすれの範囲（計算順の違いによる誤差）
+const float kBoundaryTolerance = 1.0e-4f;
+
+// テストで使うカメラ（少し傾けて、箱が平面をいろいろな向きでまたぐようにする）
+const Transform kCamera{ { 1.0f, 1.0f, 1.0f }, { 0.1f, 0.3f, 0.0f }, { 0.0f, 0.0f, -10.0f } };
+
+/// <summary>
+/// テストで使う視錐台
+/// </summary>
+Frustum MakeTestFrustum()
+{
+	const Matrix4x4 viewMatrix = MakeViewMatrix(kCamera);
+	const Matrix4x4 projectionMatrix = MakePerspectiveFovMatrix(0.45f, 16.0f / 9.0f, 0.1f, 100.0f);
+	return MakeFrustumFromMatrix(Multiply(viewMatrix, projectionMatrix));
+}
+
+/// <summary>
+/// 中心と半分の長さから箱と球を作る（球は箱に外接するもの）
+/// </summary>
+MeshBounds MakeBounds(const Vector3& center, const Vector3& extent)
+{
+	return { center, extent, sqrtf(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z) };
+}
+
+/// <summary>
+/// 見える・見えないがはっきりしているものを、SIMD の幅に満たない数で比べる
+/// </summary>
+void TestKnownBounds()
+{
+	const Frustum frustum = MakeTestFrustum();
+	const Matrix4x4 cameraMatrix = MakeAffineMatrix(kCamera.scale, kCamera.rotate, kCamera.translate);
+	BoundsSoA bounds;
+	AddBounds(bounds, MakeBounds(TransformPoint({ 0.0f, 0.0f, 20.0f }, cameraMatrix), { 1.0f, 1.0f, 1.0f })); // カメラの正面
+	AddBounds(bounds, MakeBounds({ 0.0f, 0.0f, -50.0f }, { 1.0f, 1.0f, 1.0f }));   // カメラの後ろ
+	AddBounds(bounds, MakeBounds({ 0.0f, 500.0f, 20.0f }, { 1.0f, 1.0f, 1.0f }));  // 真上の遠く
+	AddBounds(bounds, MakeBounds({ 0.0f, 0.0f, 500.0f }, { 1.0f, 1.0f, 1.0f }));   // 遠クリップ面の先
+	AddBounds(bounds, MakeBounds({ 0.0f, 0.0f, -10.0f }, { 1.0f, 1.0f, 1.0f }));   // カメラを囲んでいる（近クリップ面をまたぐ）
+	const bool expected[] = { true, false, false, false, true };
+
+	for (MathBackend backend : { MathBackend::Scalar, MathBackend::SSE41, MathBackend::AVX2 }) {
+		if (!SetMathBackend(backend)) {
+			continue;
+		}
+		uint32_t visible[5] = {};
+		const size_t visibleCount = CullBounds(bounds, frustum, visible);
+		bool isSame = true;
+		size_t next = 0;
+		for (uint32_t i = 0; i < 5; ++i) {
+			const bool isVisible = next < visibleCount && visible[next] == i;
+			next += isVisible ? 1 : 0;
+			isSame = isSame && (isVisible == expected[i]);
+		}
+		std::printf("known bounds (%ls): %zu visible\n", GetMathBackendName(backend), visibleCount);
+		Check(isSame && next == visibleCount, "CullBounds keeps exactly the bounds that overlap the frustum");
+	}
+}
+
+/// <summary>
+/// TransformBounds の箱が、変換した元の箱の8つの角をすべて囲んでいることを確かめる
+/// </summary>
+void TestTransformBounds()
+{
+	std::mt19937 random(20250425);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	bool isConservative = true;
+	for (int32_t trial = 0; trial < 1000; ++trial) {
+		const MeshBounds local = MakeBounds({ unit(random), unit(random), unit(random) }, { 1.0f + unit(random) * 0.5f, 1.0f + unit(random) * 0.5f, 1.0f + unit(random) * 0.5f });
+		const Matrix4x4 world = MakeAffineMatrix(
+			Vector3{ 1.5f + unit(random), 1.5f + unit(random), 1.5f + unit(random) },
+			Vector3{ 3.14159265f * unit(random), 3.14159265f * unit(random), 3.14159265f * unit(random) },
+			Vector3{ 10.0f * unit(random), 10.0f * unit(random), 10.0f * unit(random) });
+		const MeshBounds transformed = TransformBounds(local, world);
+		for (int corner = 0; corner < 8; ++corner) {
+			const Vector3 p = TransformPoint({
+				local.center.x + ((corner & 1) ? local.extent.x : -local.extent.x),
+				local.center.y + ((corner & 2) ? local.extent.y : -local.extent.y),
+				local.center.z + ((corner & 4) ? local.extent.z : -local.extent.z) }, world);
+			const float dx = p.x - transformed.center.x;
+			const float dy = p.y - transformed.center.y;
+			const float dz = p.z - transformed.center.z;
+			isConservative = isConservative &&
+				fabsf(dx) <= transformed.extent.x * 1.0001f + 1.0e-4f &&
+				fabsf(dy) <= transformed.extent.y * 1.0001f + 1.0e-4f &&
+				fabsf(dz) <= transformed.extent.z * 1.0001f + 1.0e-4f &&
+				sqrtf(dx * dx + dy * dy + dz * dz) <= transformed.radius * 1.0001f + 1.0e-4f;
+		}
+	}
+	Check(isConservative, "TransformBounds encloses every transformed corner");
+}
+
+/// <summary>
+/// たくさんの箱と球で、SIMD 版の結果がスカラー版と同じになることを確かめて測る
+/// </summary>
+/// <param name="boundsCount">箱と球の数</param>
+void TestManyBounds(size_t boundsCount = 1000000)
+{
+	const int32_t kIterations = 20;
+
+	std::mt19937 random(20250424);
+	std::uniform_real_distribution<float> spread(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> size(0.1f, 2.0f);
+	BoundsSoA bounds;
+	for (size_t i = 0; i < boundsCount; ++i) {
+		MeshBounds value{};
+		value.center = { spread(random), spread(random), spread(random) + 80.0f };
+		value.extent = { size(random), size(random), size(random) };
+		value.radius = sqrtf(value.extent.x * value.extent.x + value.extent.y * value.extent.y + value.extent.z * value.extent.z) * 0.9f;
+		AddBounds(bounds, value);
+	}
+	const Frustum frustum = MakeTestFrustum();
+
+	std::vector<uint32_t> expected(boundsCount);
+	SetMathBackend(MathBackend::Scalar);
+	expected.resize(CullBounds(bounds, frustum, expected.data()));
+
+	std::vector<uint32_t> visible(boundsCount);
+	for (MathBackend backend : { MathBackend::Scalar, MathBackend::SSE41, MathBackend::AVX2 }) {
+		if (!SetMathBackend(backend)) {
+			continue;
+		}
+		size_t visibleCount = 0;
+		const double nanoseconds = MeasureNanoseconds(kIterations, boundsCount, [&] {
+			visibleCount = CullBounds(bounds, frustum, visible.data());
+		});
+
+		// スカラー版と違う判定になったものは、平面すれすれであること
+		std::vector<uint32_t> difference;
+		std::set_symmetric_difference(visible.begin(), visible.begin() + visibleCount, expected.begin(), expected.end(), std::back_inserter(difference));
+		size_t unexpected = 0;
+		for (uint32_t index : difference) {
+			if (fabsf(GetBoundsFrustumMargin(bounds, index, frustum)) > kBoundaryTolerance) {
+				++unexpected;
+			}
+		}
+		std::printf("%zu bounds (%ls): %.3f ns/object, %zu visible (%.1f%%), %zu boundary differences\n",
+			boundsCount, GetMathBackendName(backend), nanoseconds, visibleCount, 100.0 * double(visibleCount) / double(boundsCount), difference.size());
+		Check(unexpected == 0 && std::is_sorted(visible.begin(), visible.begin() + visibleCount), "CullBounds matches the scalar result in ascending order");
+	}
+}
+
+} // namespace
+
+int main()
+{
+	const MathBackend detectedBackend = DetectMathBackend();
+	TestKnownBounds();
+	TestTransformBounds();
+	TestManyBounds();
+	TestManyBounds(1003); // SIMD の幅で割り切れない数
+	SetMathBackend(detectedBackend);
+	return GetTestExitCode();
+}
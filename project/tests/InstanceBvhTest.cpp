@@ -0,0 +1,423 @@
+// InstanceBvh.h のテストとベンチマーク（Linux でも動く）。
+// ランダムな箱で作った BVH の視錐台カリングとレイキャストが、すべての箱を総当たりで比べた結果と一致することを、
+// 作った直後・物体を動かした後・refit の後で確かめ、作成・更新・カリング・レイキャストの時間を表示する
+#include "InstanceBvh.h"
+#include "TestUtility.h"
+#include <iterator>
+#include <random>
+
+namespace {
+
+// 完全に内側の部分木は比べずに書き出すので、平面すれすれの箱は総当たりと判定が違ってもよい
+const float kBoundaryTolerance = 1.0e-4f;
+
+/// <summary>
+/// 中心を spread の範囲に散らした、大きさのばらばらな箱を作る（main.cpp のシーンと同じく z を 80 ずらす）
+/// </summary>
+std::vector<Aabb> MakeRandomBoxes(uint32_t count, float spread, std::mt19937& random)
+{
+	std::uniform_real_distribution<float> position(-spread, spread);
+	std::uniform_real_distribution<float> size(0.1f, 2.0f);
+	std::vector<Aabb> boxes(count);
+	for (Aabb& box : boxes) {
+		box = MakeAabb({ { position(random), position(random), position(random) + 80.0f }, { size(random), size(random), size(random) }, 0.0f });
+	}
+	return boxes;
+}
+
+/// <summary>
+/// 箱を少し動かす
+/// </summary>
+Aabb MoveBox(const Aabb& box, const Vector3& offset)
+{
+	return {
+		{ box.minimum.x + offset.x, box.minimum.y + offset.y, box.minimum.z + offset.z },
+		{ box.maximum.x + offset.x, box.maximum.y + offset.y, box.maximum.z + offset.z } };
+}
+
+/// <summary>
+/// 箱が視錐台の内側にどれだけ入っているか（負なら外。平面ごとの距離に箱の厚みを足したものの最小値）
+/// </summary>
+float GetBoxFrustumMargin(const Aabb& box, const Frustum& frustum)
+{
+	const Vector3 center = { (box.minimum.x + box.maximum.x) * 0.5f, (box.minimum.y + box.maximum.y) * 0.5f, (box.minimum.z + box.maximum.z) * 0.5f };
+	const Vector3 extent = { (box.maximum.x - box.minimum.x) * 0.5f, (box.maximum.y - box.minimum.y) * 0.5f, (box.maximum.z - box.minimum.z) * 0.5f };
+	float margin = FLT_MAX;
+	for (const Vector4& plane : frustum.planes) {
+		const float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		const float radius = fabsf(plane.x) * extent.x + fabsf(plane.y) * extent.y + fabsf(plane.z) * extent.z;
+		margin = std::min(margin, distance + radius);
+	}
+	return margin;
+}
+
+/// <summary>
+/// 位置と向きをでたらめに選んだカメラの視錐台
+/// </summary>
+Frustum MakeRandomFrustum(std::mt19937& random)
+{
+	std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+	std::uniform_real_distribution<float> angle(-3.14159265f, 3.14159265f);
+	const Transform camera{ { 1.0f, 1.0f, 1.0f }, { 0.5f * angle(random), angle(random), 0.0f }, { position(random), position(random), position(random) + 80.0f } };
+	const Matrix4x4 viewProjection = Multiply(MakeViewMatrix(camera), MakePerspectiveFovMatrix(0.45f, 16.0f / 9.0f, 0.1f, 100.0f));
+	return MakeFrustumFromMatrix(viewProjection);
+}
+
+/// <summary>
+/// 木の形が正しいこと：どの物体もちょうど1つの葉にあり、itemLeaves がその葉を指し、葉は maxLeafItems 以下で、
+/// 子の箱が親の箱に、物体の箱が葉の箱に含まれる
+/// </summary>
+bool IsValidBvh(const InstanceBvh& bvh, uint32_t maxLeafItems)
+{
+	auto contains = [](const Aabb& outer, const Aabb& inner) {
+		return outer.minimum.x <= inner.minimum.x && outer.minimum.y <= inner.minimum.y && outer.minimum.z <= inner.minimum.z &&
+			outer.maximum.x >= inner.maximum.x && outer.maximum.y >= inner.maximum.y && outer.maximum.z >= inner.maximum.z;
+	};
+	std::vector<uint32_t> leafCounts(bvh.itemBounds.size(), 0);
+	bool isValid = bvh.parents.size() == bvh.nodes.size() && bvh.parents[0] == kBvhNoParent;
+	for (size_t i = 0; i < bvh.nodes.size() && isValid; ++i) {
+		const BvhNode& node = bvh.nodes[i];
+		if (i > 0) {
+			isValid = bvh.parents[i] < i && contains(bvh.nodes[bvh.parents[i]].bounds, node.bounds);
+		}
+		if (node.count == 0) {
+			isValid = isValid && node.firstOrChild > i && node.firstOrChild + 1 < bvh.nodes.size() &&
+				bvh.parents[node.firstOrChild] == i && bvh.parents[node.firstOrChild + 1] == i;
+			continue;
+		}
+		isValid = isValid && node.count <= maxLeafItems && node.firstOrChild + node.count <= bvh.items.size();
+		for (uint32_t j = 0; j < node.count && isValid; ++j) {
+			const uint32_t item = bvh.items[node.firstOrChild + j];
+			isValid = item < leafCounts.size() && bvh.itemLeaves[item] == i && contains(node.bounds, bvh.itemBounds[item]);
+			++leafCounts[item];
+		}
+	}
+	for (uint32_t count : leafCounts) {
+		isValid = isValid && count == 1;
+	}
+	return isValid;
+}
+
+/// <summary>
+/// BVH の視錐台カリングの結果を総当たりと比べる。どの物体も1回までしか書き出さず、判定が違うのは平面すれすれの箱だけであること
+/// </summary>
+/// <returns>平面すれすれでないのに判定が違った数（重複して書き出した物体も数える）</returns>
+size_t CountCullMismatches(const InstanceBvh& bvh, const Frustum& frustum, size_t* visibleCount = nullptr)
+{
+	const uint32_t itemCount = static_cast<uint32_t>(bvh.itemBounds.size());
+	std::vector<uint32_t> visible(itemCount);
+	visible.resize(CullInstanceBvh(bvh, frustum, visible.data()));
+	std::sort(visible.begin(), visible.end());
+	size_t mismatches = visible.size() - static_cast<size_t>(std::unique(visible.begin(), visible.end()) - visible.begin());
+	visible.erase(std::unique(visible.begin(), visible.end()), visible.end());
+
+	std::vector<uint32_t> expected;
+	for (uint32_t item = 0; item < itemCount; ++item) {
+		if (GetBoxFrustumMargin(bvh.itemBounds[item], frustum) >= 0.0f) {
+			expected.push_back(item);
+		}
+	}
+	std::vector<uint32_t> difference;
+	std::set_symmetric_difference(visible.begin(), visible.end(), expected.begin(), expected.end(), std::back_inserter(difference));
+	for (uint32_t item : difference) {
+		if (fabsf(GetBoxFrustumMargin(bvh.itemBounds[item], frustum)) > kBoundaryTolerance) {
+			++mismatches;
+		}
+	}
+	if (visibleCount) {
+		*visibleCount = visible.size();
+	}
+	return mismatches;
+}
+
+/// <summary>
+/// 総当たりで一番近い箱までの距離（当たらなければ FLT_MAX）
+/// </summary>
+float RaycastBruteForce(const std::vector<Aabb>& boxes, const Ray& ray)
+{
+	const Vector3 inverseDirection = GetInverseDirection(ray);
+	float nearest = FLT_MAX;
+	for (const Aabb& box : boxes) {
+		float distance = 0.0f;
+		if (IntersectRayAabb(ray, inverseDirection, box, nearest, distance)) {
+			nearest = distance;
+		}
+	}
+	return nearest;
+}
+
+/// <summary>
+/// BVH のレイキャストを総当たりと比べる。当たる・当たらないと距離が一致し、返した物体の箱がその距離で当たること
+/// （同じ距離の箱が重なっていると番号は違ってもよい）
+/// </summary>
+/// <returns>一致しなかったレイの数</returns>
+size_t CountRayMismatches(const InstanceBvh& bvh, const std::vector<Ray>& rays, size_t* hitCount = nullptr)
+{
+	size_t mismatches = 0;
+	size_t hits = 0;
+	for (const Ray& ray : rays) {
+		float distance = 0.0f;
+		const uint32_t item = RaycastInstanceBvh(bvh, ray, distance);
+		const float expected = RaycastBruteForce(bvh.itemBounds, ray);
+		bool isSame = (item != UINT32_MAX) == (expected < FLT_MAX);
+		if (isSame && item != UINT32_MAX) {
+			float itemDistance = 0.0f;
+			// 箱に入る距離は、BVH をたどっても総当たりでも同じ計算なので、ぴったり一致する
+			isSame = distance == expected &&
+				IntersectRayAabb(ray, GetInverseDirection(ray), bvh.itemBounds[item], FLT_MAX, itemDistance) && itemDistance == distance;
+			++hits;
+		}
+		mismatches += isSame ? 0 : 1;
+	}
+	if (hitCount) {
+		*hitCount = hits;
+	}
+	return mismatches;
+}
+
+/// <summary>
+/// 始点を箱の散らばる範囲の内外に、向きをでたらめに（軸に平行なものも混ぜて）選んだレイ
+/// </summary>
+std::vector<Ray> MakeRandomRays(uint32_t count, std::mt19937& random)
+{
+	std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<Ray> rays(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		Vector3 direction{ unit(random), unit(random), unit(random) };
+		// 8本に1本は軸に平行にして、向きの成分が 0 のとき（逆数を FLT_MAX にする）も確かめる
+		if (i % 8 == 0) {
+			const Vector3 kAxes[] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+			const float sign = (unit(random) < 0.0f) ? -1.0f : 1.0f;
+			const Vector3& axis = kAxes[i / 8 % 3];
+			direction = { axis.x * sign, axis.y * sign, axis.z * sign };
+		}
+		rays[i] = { { position(random), position(random), position(random) + 80.0f }, Normalize(direction) };
+	}
+	return rays;
+}
+
+/// <summary>
+/// 作った直後・一部の物体を UpdateInstanceBvhItem で動かした後・全部を動かして RefitInstanceBvh した後で、
+/// 視錐台カリングとレイキャストが総当たりと一致すること
+/// </summary>
+void TestAgainstBruteForce(uint32_t maxLeafItems)
+{
+	const uint32_t kItemCount = 20000;
+	const int32_t kFrustumCount = 16;
+	const uint32_t kRayCount = 2000;
+	std::mt19937 random(20250425 + maxLeafItems);
+	std::uniform_real_distribution<float> step(-3.0f, 3.0f);
+
+	InstanceBvh bvh;
+	BuildInstanceBvh(bvh, MakeRandomBoxes(kItemCount, 100.0f, random), maxLeafItems);
+	const std::vector<Ray> rays = MakeRandomRays(kRayCount, random);
+
+	bool allValid = true;
+	size_t cullMismatches = 0;
+	size_t rayMismatches = 0;
+	for (const char* stage : { "built", "updated", "refit" }) {
+		if (stage[0] == 'u') {
+			// 1割の物体を1つずつ動かす（葉から根へ箱を広げ直す）
+			std::uniform_int_distribution<uint32_t> pickItem(0, kItemCount - 1);
+			for (uint32_t i = 0; i < kItemCount / 10; ++i) {
+				const uint32_t item = pickItem(random);
+				UpdateInstanceBvhItem(bvh, item, MoveBox(bvh.itemBounds[item], { step(random), step(random), step(random) }));
+			}
+		} else if (stage[0] == 'r') {
+			// 全部の物体を動かしてからまとめて計算し直す
+			for (Aabb& box : bvh.itemBounds) {
+				box = MoveBox(box, { step(random), step(random), step(random) });
+			}
+			RefitInstanceBvh(bvh);
+		}
+		const bool isValid = IsValidBvh(bvh, maxLeafItems);
+		size_t stageCullMismatches = 0;
+		size_t visibleTotal = 0;
+		for (int32_t i = 0; i < kFrustumCount; ++i) {
+			size_t visibleCount = 0;
+			stageCullMismatches += CountCullMismatches(bvh, MakeRandomFrustum(random), &visibleCount);
+			visibleTotal += visibleCount;
+		}
+		size_t hitCount = 0;
+		const size_t stageRayMismatches = CountRayMismatches(bvh, rays, &hitCount);
+		std::printf("maxLeafItems %u, %s: %zu nodes, SAH cost %.1f, %zu visible over %d frusta (%zu mismatches), %zu / %u rays hit (%zu mismatches)%s\n",
+			maxLeafItems, stage, bvh.nodes.size(), GetInstanceBvhCost(bvh), visibleTotal, kFrustumCount, stageCullMismatches,
+			hitCount, kRayCount, stageRayMismatches, isValid ? "" : " (INVALID TREE)");
+		allValid = allValid && isValid;
+		cullMismatches += stageCullMismatches;
+		rayMismatches += stageRayMismatches;
+	}
+	char name[128];
+	std::snprintf(name, sizeof(name), "maxLeafItems %u: every item is in exactly one leaf and every box is inside its parent", maxLeafItems);
+	Check(allValid, name);
+	std::snprintf(name, sizeof(name), "maxLeafItems %u: frustum culling matches brute force after build, update and refit", maxLeafItems);
+	Check(cullMismatches == 0, name);
+	std::snprintf(name, sizeof(name), "maxLeafItems %u: raycasts find the same nearest box as brute force after build, update and refit", maxLeafItems);
+	Check(rayMismatches == 0, name);
+}
+
+/// <summary>
+/// 物体が無いとき・1つだけのとき・すべて同じ場所にあるとき（SAH で分けられず半分に分ける）も壊れないこと
+/// </summary>
+void TestDegenerateInputs()
+{
+	std::mt19937 random(3);
+	const Frustum frustum = MakeRandomFrustum(random);
+	const std::vector<Ray> rays = MakeRandomRays(200, random);
+
+	InstanceBvh empty;
+	BuildInstanceBvh(empty, {});
+	float distance = 0.0f;
+	uint32_t visible[1] = {};
+	Check(CullInstanceBvh(empty, frustum, visible) == 0 && RaycastInstanceBvh(empty, rays[0], distance) == UINT32_MAX,
+		"an empty BVH culls and raycasts to nothing");
+
+	InstanceBvh single;
+	BuildInstanceBvh(single, MakeRandomBoxes(1, 100.0f, random));
+	Check(IsValidBvh(single, kBvhMaxLeafItems) && CountCullMismatches(single, frustum) == 0 && CountRayMismatches(single, rays) == 0,
+		"a single item matches brute force");
+
+	// 同じ箱を重ねると中心が広がらないので、並び順のまま半分に分けていく
+	const Aabb box = { { -1.0f, -1.0f, 79.0f }, { 1.0f, 1.0f, 81.0f } };
+	InstanceBvh stacked;
+	BuildInstanceBvh(stacked, std::vector<Aabb>(1000, box));
+	std::vector<Ray> towardBox;
+	for (const Ray& ray : rays) {
+		const Vector3 toCenter = { -ray.origin.x, -ray.origin.y, 80.0f - ray.origin.z };
+		towardBox.push_back({ ray.origin, Normalize(toCenter) });
+	}
+	size_t hitCount = 0;
+	const size_t rayMismatches = CountRayMismatches(stacked, towardBox, &hitCount);
+	Check(IsValidBvh(stacked, kBvhMaxLeafItems) && CountCullMismatches(stacked, frustum) == 0 && rayMismatches == 0 && hitCount == towardBox.size(),
+		"1000 identical boxes split into small leaves and match brute force");
+}
+
+/// <summary>
+/// MakeRayFromScreen のレイが、画面上の同じ位置に映ること（始点は近クリップ面、その先の点も同じピクセルに投影される）
+/// </summary>
+void TestRayFromScreen()
+{
+	const float kWidth = 1280.0f;
+	const float kHeight = 720.0f;
+	const Transform camera{ { 1.0f, 1.0f, 1.0f }, { 0.1f, 0.3f, 0.0f }, { 0.0f, 0.0f, -10.0f } };
+	const Matrix4x4 viewProjection = Multiply(MakeViewMatrix(camera), MakePerspectiveFovMatrix(0.45f, kWidth / kHeight, 0.1f, 100.0f));
+	const Matrix4x4 inverseViewProjection = Inverse(viewProjection);
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> screenX(0.0f, kWidth);
+	std::uniform_real_distribution<float> screenY(0.0f, kHeight);
+	float maxPixelError = 0.0f;
+	float maxNearError = 0.0f;
+	for (int32_t i = 0; i < 1000; ++i) {
+		const float x = screenX(random);
+		const float y = screenY(random);
+		const Ray ray = MakeRayFromScreen(x, y, kWidth, kHeight, inverseViewProjection);
+		for (float t : { 0.0f, 5.0f, 50.0f }) {
+			const Vector3 point = { ray.origin.x + ray.direction.x * t, ray.origin.y + ray.direction.y * t, ray.origin.z + ray.direction.z * t };
+			const Matrix4x4& m = viewProjection;
+			const float w = point.x * m.m[0][3] + point.y * m.m[1][3] + point.z * m.m[2][3] + m.m[3][3];
+			const Vector3 clip = TransformPoint(point, viewProjection);
+			const Vector3 ndc = { clip.x / w, clip.y / w, clip.z / w };
+			maxPixelError = std::max({ maxPixelError, fabsf((ndc.x + 1.0f) * 0.5f * kWidth - x), fabsf((1.0f - ndc.y) * 0.5f * kHeight - y) });
+			if (t == 0.0f) {
+				maxNearError = std::max(maxNearError, fabsf(ndc.z));
+			}
+		}
+	}
+	std::printf("MakeRayFromScreen: max reprojection error %.2e px, max near-plane depth %.2e\n", maxPixelError, maxNearError);
+	Check(maxPixelError < 0.1f && maxNearError < 1.0e-3f, "rays from the screen reproject onto the same pixel and start on the near plane");
+}
+
+/// <summary>
+/// 10万個の物体で、作成・1% の物体の更新・refit・視錐台カリング（すべての箱を SIMD で比べる CullBounds と比べる）・レイキャストの時間を表示する
+/// </summary>
+void BenchmarkInstanceBvh()
+{
+	const uint32_t kItemCount = 100000;
+	const uint32_t kMovedPerFrame = kItemCount / 100;
+	const int32_t kIterations = 20;
+	const uint32_t kRayCount = 100000;
+	// 総当たりと比べるレイの数（総当たりは遅いので一部だけ）
+	const uint32_t kVerifiedRayCount = 1000;
+
+	std::mt19937 random(20250425);
+	std::vector<Aabb> itemBounds = MakeRandomBoxes(kItemCount, 100.0f, random);
+
+	InstanceBvh bvh;
+	const double buildMilliseconds = MeasureNanoseconds(kIterations, 1, [&] { BuildInstanceBvh(bvh, itemBounds); }) / 1.0e6;
+	const float builtCost = GetInstanceBvhCost(bvh);
+
+	// 1% の物体を少しずつ動かして、葉から根へ箱を広げ直す
+	std::uniform_int_distribution<uint32_t> pickItem(0, kItemCount - 1);
+	std::uniform_real_distribution<float> step(-0.5f, 0.5f);
+	double updateNanoseconds = 0.0;
+	for (int32_t iteration = 0; iteration < kIterations; ++iteration) {
+		std::vector<std::pair<uint32_t, Aabb>> moves(kMovedPerFrame);
+		for (auto& [item, box] : moves) {
+			item = pickItem(random);
+			box = MoveBox(itemBounds[item], { step(random), step(random), step(random) });
+			itemBounds[item] = box;
+		}
+		updateNanoseconds += MeasureNanoseconds(1, 1, [&] {
+			for (const auto& [item, box] : moves) {
+				UpdateInstanceBvhItem(bvh, item, box);
+			}
+		});
+	}
+	const double updateMilliseconds = updateNanoseconds / kIterations / 1.0e6;
+	const double refitMilliseconds = MeasureNanoseconds(kIterations, 1, [&] { RefitInstanceBvh(bvh); }) / 1.0e6;
+	std::printf("%u items: build %.2f ms (SAH cost %.1f), update %u moved items %.3f ms, full refit %.3f ms (SAH cost after refit %.1f)\n",
+		kItemCount, buildMilliseconds, builtCost, kMovedPerFrame, updateMilliseconds, refitMilliseconds, GetInstanceBvhCost(bvh));
+
+	// 視錐台カリング：BVH と、すべての箱を SIMD で比べる方法を比べる
+	const Transform camera{ { 1.0f, 1.0f, 1.0f }, { 0.1f, 0.3f, 0.0f }, { 0.0f, 0.0f, -10.0f } };
+	const Matrix4x4 viewProjection = Multiply(MakeViewMatrix(camera), MakePerspectiveFovMatrix(0.45f, 16.0f / 9.0f, 0.1f, 100.0f));
+	const Frustum frustum = MakeFrustumFromMatrix(viewProjection);
+	BoundsSoA flatBounds;
+	for (const Aabb& box : itemBounds) {
+		const Vector3 extent = { (box.maximum.x - box.minimum.x) * 0.5f, (box.maximum.y - box.minimum.y) * 0.5f, (box.maximum.z - box.minimum.z) * 0.5f };
+		// 箱だけで比べるよう、球は箱を確実に囲む大きさにしておく
+		AddBounds(flatBounds, { { box.minimum.x + extent.x, box.minimum.y + extent.y, box.minimum.z + extent.z }, extent, FLT_MAX });
+	}
+	std::vector<uint32_t> visible(kItemCount);
+	size_t bvhVisibleCount = 0;
+	size_t flatVisibleCount = 0;
+	const double bvhCullMilliseconds = MeasureNanoseconds(kIterations, 1, [&] { bvhVisibleCount = CullInstanceBvh(bvh, frustum, visible.data()); }) / 1.0e6;
+	const double flatCullMilliseconds = MeasureNanoseconds(kIterations, 1, [&] { flatVisibleCount = CullBounds(flatBounds, frustum, visible.data()); }) / 1.0e6;
+	const size_t cullMismatches = CountCullMismatches(bvh, frustum);
+	std::printf("frustum cull: BVH %.3f ms, flat SIMD %.3f ms, %zu / %zu visible, %zu mismatches against brute force\n",
+		bvhCullMilliseconds, flatCullMilliseconds, bvhVisibleCount, flatVisibleCount, cullMismatches);
+	Check(cullMismatches == 0, "100k items: BVH frustum culling matches brute force");
+
+	// カメラから画面のランダムな位置へ飛ばすレイ
+	const Matrix4x4 inverseViewProjection = Inverse(viewProjection);
+	std::uniform_real_distribution<float> screenX(0.0f, 1280.0f);
+	std::uniform_real_distribution<float> screenY(0.0f, 720.0f);
+	std::vector<Ray> rays(kRayCount);
+	for (Ray& ray : rays) {
+		ray = MakeRayFromScreen(screenX(random), screenY(random), 1280.0f, 720.0f, inverseViewProjection);
+	}
+	size_t hitCount = 0;
+	const double rayNanoseconds = MeasureNanoseconds(1, kRayCount, [&] {
+		for (const Ray& ray : rays) {
+			float distance = 0.0f;
+			hitCount += (RaycastInstanceBvh(bvh, ray, distance) != UINT32_MAX) ? 1 : 0;
+		}
+	});
+	const size_t rayMismatches = CountRayMismatches(bvh, std::vector<Ray>(rays.begin(), rays.begin() + kVerifiedRayCount));
+	std::printf("raycast: %.2f Mrays/s (%zu / %u hit), %zu / %u mismatches against brute force\n",
+		1.0e3 / rayNanoseconds, hitCount, kRayCount, rayMismatches, kVerifiedRayCount);
+	Check(rayMismatches == 0, "100k items: raycasts from the camera match brute force");
+}
+
+} // namespace
+
+int main()
+{
+	TestAgainstBruteForce(kBvhMaxLeafItems);
+	TestAgainstBruteForce(1);
+	TestDegenerateInputs();
+	TestRayFromScreen();
+	BenchmarkInstanceBvh();
+	return GetTestExitCode();
+}
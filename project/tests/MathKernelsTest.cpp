@@ -0,0 +1,219 @@
+// MathKernels.h のテストとベンチマーク（Linux でも動く）。
+// 命令セット（スカラー / SSE4.1 / AVX2）ごとに、スカラー版との誤差が許容範囲に入っていることを確かめ、速度を表示する
+#include "MathKernels.h"
+#include "TestUtility.h"
+#include <random>
+
+namespace {
+
+// 誤差の許容範囲（積はスカラー版との差、逆行列は M * M^-1 と単位行列の差、sin / cos は倍精度の値との差）
+const float kMultiplyTolerance = 1.0e-6f;
+const float kInverseTolerance = 1.0e-5f;
+const float kSinCosTolerance = 1.0e-6f;
+// MakeAffineMatrix と SoA でまとめて計算した World / WVP の差の許容範囲
+const float kTransformTolerance = 1.0e-5f;
+
+const size_t kMatrixCount = 1024;
+const size_t kAngleCount = 4096;
+const int32_t kIterations = 200;
+
+/// <summary>
+/// ランダムな拡大縮小・回転・平行移動
+/// </summary>
+Transform MakeRandomTransform(std::mt19937& random)
+{
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	return {
+		{ 1.25f + 0.75f * unit(random), 1.25f + 0.75f * unit(random), 1.25f + 0.75f * unit(random) },
+		{ 3.14159265f * unit(random), 3.14159265f * unit(random), 3.14159265f * unit(random) },
+		{ 10.0f * unit(random), 10.0f * unit(random), 10.0f * unit(random) } };
+}
+
+/// <summary>
+/// 積・逆行列・sin / cos・MakeAffineMatrix を命令セットごとに確かめて測る
+/// </summary>
+void TestKernels()
+{
+	// 半分はアフィン行列、残りは対角を大きくして条件数を抑えた一般の行列
+	std::mt19937 random(20250419);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<Matrix4x4> matrices(kMatrixCount);
+	std::vector<Transform> transforms(kMatrixCount);
+	SetMathBackend(MathBackend::Scalar);
+	for (size_t i = 0; i < kMatrixCount; ++i) {
+		transforms[i] = MakeRandomTransform(random);
+		if (i % 2 == 0) {
+			matrices[i] = MakeAffineMatrix(transforms[i].scale, transforms[i].rotate, transforms[i].translate);
+		} else {
+			for (int row = 0; row < 4; ++row) {
+				for (int col = 0; col < 4; ++col) {
+					matrices[i].m[row][col] = unit(random) + (row == col ? 4.0f : 0.0f);
+				}
+			}
+		}
+	}
+	std::vector<float> angles(kAngleCount);
+	for (float& angle : angles) {
+		angle = 100.0f * unit(random);
+	}
+
+	// スカラー版の結果を基準にする
+	std::vector<Matrix4x4> referenceProducts(kMatrixCount);
+	std::vector<Matrix4x4> referenceAffine(kMatrixCount);
+	for (size_t i = 0; i < kMatrixCount; ++i) {
+		referenceProducts[i] = Multiply(matrices[i], matrices[(i + 1) % kMatrixCount]);
+		referenceAffine[i] = MakeAffineMatrix(transforms[i].scale, transforms[i].rotate, transforms[i].translate);
+	}
+
+	std::vector<Matrix4x4> results(kMatrixCount);
+	std::vector<float> sines(kAngleCount);
+	std::vector<float> cosines(kAngleCount);
+	double scalarNanoseconds[4] = {};
+	for (MathBackend backend : { MathBackend::Scalar, MathBackend::SSE41, MathBackend::AVX2 }) {
+		if (!SetMathBackend(backend)) {
+			std::printf("%ls: not supported on this CPU / build\n", GetMathBackendName(backend));
+			continue;
+		}
+
+		const double nanoseconds[4] = {
+			MeasureNanoseconds(kIterations, kMatrixCount, [&] {
+				for (size_t i = 0; i < kMatrixCount; ++i) {
+					results[i] = Multiply(matrices[i], matrices[(i + 1) % kMatrixCount]);
+				}
+			}),
+			MeasureNanoseconds(kIterations, kMatrixCount, [&] {
+				for (size_t i = 0; i < kMatrixCount; ++i) {
+					results[i] = Inverse(matrices[i]);
+				}
+			}),
+			MeasureNanoseconds(kIterations, kAngleCount, [&] {
+				SinCosBatch(angles.data(), sines.data(), cosines.data(), kAngleCount);
+			}),
+			MeasureNanoseconds(kIterations, kMatrixCount, [&] {
+				for (size_t i = 0; i < kMatrixCount; ++i) {
+					results[i] = MakeAffineMatrix(transforms[i].scale, transforms[i].rotate, transforms[i].translate);
+				}
+			}),
+		};
+		if (backend == MathBackend::Scalar) {
+			std::copy(nanoseconds, nanoseconds + 4, scalarNanoseconds);
+		}
+		std::printf("%ls: multiply %.2f ns (x%.2f), inverse %.2f ns (x%.2f), sincos %.2f ns/angle (x%.2f), MakeAffineMatrix %.2f ns (x%.2f)\n",
+			GetMathBackendName(backend),
+			nanoseconds[0], scalarNanoseconds[0] / nanoseconds[0], nanoseconds[1], scalarNanoseconds[1] / nanoseconds[1],
+			nanoseconds[2], scalarNanoseconds[2] / nanoseconds[2], nanoseconds[3], scalarNanoseconds[3] / nanoseconds[3]);
+
+		float multiplyError = 0.0f;
+		float inverseError = 0.0f;
+		float affineError = 0.0f;
+		for (size_t i = 0; i < kMatrixCount; ++i) {
+			multiplyError = std::max(multiplyError, MaxMatrixDifference(Multiply(matrices[i], matrices[(i + 1) % kMatrixCount]), referenceProducts[i]));
+			inverseError = std::max(inverseError, MaxMatrixDifference(MultiplyScalar(matrices[i], Inverse(matrices[i])), MakeIdentity4x4()));
+			affineError = std::max(affineError, MaxMatrixDifference(MakeAffineMatrix(transforms[i].scale, transforms[i].rotate, transforms[i].translate), referenceAffine[i]));
+		}
+		SinCosBatch(angles.data(), sines.data(), cosines.data(), kAngleCount);
+		float sinCosError = 0.0f;
+		for (size_t i = 0; i < kAngleCount; ++i) {
+			sinCosError = std::max(sinCosError, float(std::fabs(sines[i] - std::sin(double(angles[i])))));
+			sinCosError = std::max(sinCosError, float(std::fabs(cosines[i] - std::cos(double(angles[i])))));
+		}
+		std::printf("%ls: max error multiply %.2e, inverse %.2e, sincos %.2e, MakeAffineMatrix %.2e\n",
+			GetMathBackendName(backend), multiplyError, inverseError, sinCosError, affineError);
+		Check(multiplyError <= kMultiplyTolerance, "Multiply matches the scalar product");
+		Check(inverseError <= kInverseTolerance, "M * Inverse(M) is the identity");
+		Check(sinCosError <= kSinCosTolerance, "SinCosBatch matches double-precision sin / cos");
+		Check(affineError <= kTransformTolerance, "MakeAffineMatrix matches the scalar build");
+	}
+}
+
+/// <summary>
+/// 行列の種類を使う逆行列と MakeViewMatrix が、一般の逆行列と同じになることを確かめる
+/// </summary>
+void TestTypedInverse()
+{
+	std::mt19937 random(20250420);
+	float srtError = 0.0f;
+	float affineError = 0.0f;
+	float rigidError = 0.0f;
+	float viewError = 0.0f;
+	for (MathBackend backend : { MathBackend::Scalar, MathBackend::SSE41, MathBackend::AVX2 }) {
+		if (!SetMathBackend(backend)) {
+			continue;
+		}
+		for (size_t i = 0; i < kMatrixCount; ++i) {
+			const Transform transform = MakeRandomTransform(random);
+			const Matrix4x4 srt = MakeAffineMatrix(transform.scale, transform.rotate, transform.translate);
+			const Matrix4x4 rigid = MakeAffineMatrix({ 1.0f, 1.0f, 1.0f }, transform.rotate, transform.translate);
+			srtError = std::max(srtError, MaxMatrixDifference(MultiplyScalar(srt, Inverse(srt, MatrixType::ScaleRotateTranslate)), MakeIdentity4x4()));
+			affineError = std::max(affineError, MaxMatrixDifference(MultiplyScalar(srt, Inverse(srt, MatrixType::Affine)), MakeIdentity4x4()));
+			rigidError = std::max(rigidError, MaxMatrixDifference(MultiplyScalar(rigid, Inverse(rigid, MatrixType::Rigid)), MakeIdentity4x4()));
+			viewError = std::max(viewError, MaxMatrixDifference(MakeViewMatrix(transform), InverseScalar(srt)));
+		}
+	}
+	std::printf("typed inverse: max error SRT %.2e, affine %.2e, rigid %.2e, MakeViewMatrix %.2e\n", srtError, affineError, rigidError, viewError);
+	Check(srtError <= kInverseTolerance, "Inverse(ScaleRotateTranslate)");
+	Check(affineError <= kInverseTolerance, "Inverse(Affine)");
+	Check(rigidError <= kInverseTolerance, "Inverse(Rigid)");
+	Check(viewError <= kInverseTolerance, "MakeViewMatrix equals InverseScalar(MakeAffineMatrix)");
+}
+
+/// <summary>
+/// SoA でまとめて計算した World / WVP が、物体ごとに計算したものと同じになることを確かめて測る（端数が出る数も試す）
+/// </summary>
+void TestTransformBatch()
+{
+	const Matrix4x4 viewProjection = Multiply(
+		MakeViewMatrix(Transform{ { 1.0f, 1.0f, 1.0f }, { 0.3f, 0.5f, 0.0f }, { 0.0f, 2.0f, -20.0f } }),
+		MakePerspectiveFovMatrix(0.45f, 16.0f / 9.0f, 0.1f, 100.0f));
+	std::mt19937 random(20250421);
+	for (size_t objectCount : { size_t(13), size_t(1000), size_t(100000) }) {
+		std::vector<Transform> objects(objectCount);
+		TransformSoA transforms;
+		for (Transform& object : objects) {
+			object = MakeRandomTransform(random);
+			AddTransform(transforms, object);
+		}
+
+		SetMathBackend(MathBackend::Scalar);
+		std::vector<TransformationMatrix> reference(objectCount);
+		for (size_t i = 0; i < objectCount; ++i) {
+			reference[i].World = MakeAffineMatrix(objects[i].scale, objects[i].rotate, objects[i].translate);
+			reference[i].WVP = Multiply(reference[i].World, viewProjection);
+		}
+
+		const int32_t iterations = int32_t(std::max<size_t>(1, 200000 / objectCount));
+		std::vector<TransformationMatrix> batched(objectCount);
+		std::vector<Matrix4x4> worlds(objectCount);
+		for (MathBackend backend : { MathBackend::Scalar, MathBackend::SSE41, MathBackend::AVX2 }) {
+			if (!SetMathBackend(backend)) {
+				continue;
+			}
+			const double nanoseconds = MeasureNanoseconds(iterations, objectCount, [&] {
+				ComputeTransformationMatrices(transforms, viewProjection, batched.data());
+			});
+			ComputeWorldMatrices(transforms, worlds.data(), sizeof(Matrix4x4), 0, objectCount);
+
+			float error = 0.0f;
+			for (size_t i = 0; i < objectCount; ++i) {
+				error = std::max(error, MaxMatrixDifference(batched[i].WVP, reference[i].WVP));
+				error = std::max(error, MaxMatrixDifference(batched[i].World, reference[i].World));
+				error = std::max(error, MaxMatrixDifference(worlds[i], reference[i].World));
+			}
+			std::printf("%zu objects, SoA batch (%ls): %.2f ns/object, max error %.2e\n", objectCount, GetMathBackendName(backend), nanoseconds, error);
+			Check(error <= kTransformTolerance, "SoA World / WVP match the per-object matrices");
+		}
+	}
+}
+
+} // namespace
+
+int main()
+{
+	const MathBackend detectedBackend = DetectMathBackend();
+	std::printf("detected backend: %ls\n", GetMathBackendName(detectedBackend));
+	TestKernels();
+	TestTypedInverse();
+	TestTransformBatch();
+	SetMathBackend(detectedBackend);
+	return GetTestExitCode();
+}
@@ -0,0 +1,185 @@
+// MeshCache.h のテストとベンチマーク（Linux でも動く）。
+// 焼き込み済みメッシュを書いて読み戻すと元と同じになること、壊れたファイル・古い版・違うキーのファイルは読まないことを確かめ、
+// OBJ の解析（コールド）と焼き込み済みメッシュの読み込み（ウォーム）の時間を比べる
+#include "MeshCache.h"
+#include "TestUtility.h"
+#include <random>
+
+namespace {
+
+/// <summary>
+/// メッシュレット・LOD の領域も書き出されるよう、読み込んだモデルに中身のわかる値を入れる
+/// </summary>
+void FillCookedSections(ModelData& model)
+{
+	uint32_t meshIndex = 0;
+	for (MeshData& mesh : model.meshes) {
+		const uint32_t triangleCount = static_cast<uint32_t>(mesh.indices.size() / 3);
+		mesh.meshlets.push_back({ 0, triangleCount * 3, static_cast<uint32_t>(mesh.vertices.size()), { 1.0f, 2.0f, 3.0f }, 4.0f,
+			{ 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, float(meshIndex) });
+		mesh.lodIndices.assign(mesh.indices.begin(), mesh.indices.begin() + (triangleCount / 2) * 3);
+		mesh.lods.push_back({ 0, static_cast<uint32_t>(mesh.lodIndices.size()), 0.5f });
+		mesh.bounds = { { 1.0f, float(meshIndex), 0.0f }, { 2.0f, 2.0f, 2.0f }, 3.5f };
+		++meshIndex;
+	}
+}
+
+/// <summary>
+/// 2つのモデルが、名前・頂点・インデックス・メッシュレット・LOD・箱と球まで同じか
+/// </summary>
+bool IsSameModel(const ModelData& a, const ModelData& b)
+{
+	auto isSameBytes = [](const auto& x, const auto& y) {
+		return x.size() == y.size() && std::memcmp(x.data(), y.data(), sizeof(x[0]) * x.size()) == 0;
+	};
+	bool isSame = a.meshes.size() == b.meshes.size();
+	for (size_t i = 0; isSame && i < a.meshes.size(); ++i) {
+		const MeshData& x = a.meshes[i];
+		const MeshData& y = b.meshes[i];
+		isSame = x.name == y.name && isSameBytes(x.vertices, y.vertices) && x.indices == y.indices && isSameBytes(x.meshlets, y.meshlets) &&
+			x.lodIndices == y.lodIndices && isSameBytes(x.lods, y.lods) && std::memcmp(&x.bounds, &y.bounds, sizeof(MeshBounds)) == 0;
+	}
+	return isSame;
+}
+
+std::vector<char> ReadBytes(const std::filesystem::path& path)
+{
+	std::vector<char> bytes(std::filesystem::file_size(path));
+	std::ifstream(path, std::ios::binary).read(bytes.data(), bytes.size());
+	return bytes;
+}
+
+/// <summary>
+/// Resources の OBJ を焼き込んで読み戻す。壊したファイルはどれも読まずに false を返すこと
+/// </summary>
+void TestCookedMeshes(const std::filesystem::path& directory)
+{
+	const int32_t kIterations = 20;
+	size_t fileCount = 0;
+	bool allRoundTrip = true;
+	bool allRejected = true;
+	std::mt19937 random(7);
+	for (const auto& entry : std::filesystem::directory_iterator(RESOURCES_DIRECTORY)) {
+		if (entry.path().extension() != ".obj") {
+			continue;
+		}
+		const std::string filename = entry.path().filename().string();
+		MappedFile sourceFile = MapFileReadOnly(entry.path().string());
+		const uint64_t cacheKey = MakeCookedMeshKey(sourceFile.data, sourceFile.size, MakeModelLoadOptions(filename, true));
+		UnmapFile(&sourceFile);
+		const std::string cookedPath = (directory / GetCookedMeshPath(cacheKey)).string();
+
+		// コールド：OBJ を解析して焼き込む。ウォーム：焼き込み済みメッシュを読む
+		ModelData model;
+		const double coldNanoseconds = MeasureNanoseconds(kIterations, 1, [&] {
+			model = LoadObjFile(RESOURCES_DIRECTORY, filename);
+			FillCookedSections(model);
+			WriteCookedMesh(cookedPath, cacheKey, model);
+		});
+		ModelData cooked;
+		bool readAll = true;
+		const double warmNanoseconds = MeasureNanoseconds(kIterations, 1, [&] {
+			cooked = ModelData{};
+			readAll = ReadCookedMesh(cookedPath, cacheKey, cooked) && readAll;
+		});
+		const bool roundTrip = readAll && IsSameModel(model, cooked);
+		allRoundTrip = allRoundTrip && roundTrip;
+		std::printf("%s: cold (parse + write) %.3f ms, warm (read) %.3f ms, x%.1f%s\n", filename.c_str(), coldNanoseconds / 1.0e6,
+			warmNanoseconds / 1.0e6, coldNanoseconds / warmNanoseconds, roundTrip ? "" : " (MISMATCH)");
+
+		// 壊したファイルは、マップした外を読まずにキャッシュが無いものとして扱うこと
+		const std::vector<char> bytes = ReadBytes(cookedPath);
+		const std::string corruptPath = cookedPath + ".corrupt";
+		auto rejects = [&](const std::vector<char>& corruptBytes, uint64_t key) {
+			std::ofstream(corruptPath, std::ios::binary | std::ios::trunc).write(corruptBytes.data(), corruptBytes.size());
+			ModelData corrupt;
+			return !ReadCookedMesh(corruptPath, key, corrupt);
+		};
+		auto modifyHeader = [&](auto&& modify) {
+			std::vector<char> corruptBytes = bytes;
+			modify(*reinterpret_cast<CookedMeshHeader*>(corruptBytes.data()));
+			return corruptBytes;
+		};
+		auto modifyFirstRange = [&](auto&& modify) {
+			std::vector<char> corruptBytes = bytes;
+			modify(*reinterpret_cast<CookedMeshRange*>(corruptBytes.data() + sizeof(CookedMeshHeader)));
+			return corruptBytes;
+		};
+		bool rejected = rejects(bytes, cacheKey ^ 1); // 元の OBJ か設定が変わった（キーが違う）
+		rejected = rejects(modifyHeader([](CookedMeshHeader& header) { header.version = kCookedMeshVersion - 1; }), cacheKey) && rejected;
+		rejected = rejects(modifyHeader([](CookedMeshHeader& header) { header.cacheKey ^= 0x100; }), cacheKey) && rejected;
+		rejected = rejects(modifyHeader([](CookedMeshHeader& header) { header.magic[0] = 'X'; }), cacheKey) && rejected;
+		rejected = rejects(modifyHeader([](CookedMeshHeader& header) { header.vertexDataSize += 4; }), cacheKey) && rejected;
+		rejected = rejects(modifyHeader([](CookedMeshHeader& header) { header.meshCount += 1; }), cacheKey) && rejected;
+		rejected = rejects(modifyHeader([](CookedMeshHeader& header) { header.meshletOffset = UINT64_MAX; }), cacheKey) && rejected;
+		rejected = rejects(modifyHeader([](CookedMeshHeader& header) { header.indexOffset += 2; }), cacheKey) && rejected;
+		rejected = rejects(modifyHeader([](CookedMeshHeader& header) { header.fileSize += 1; }), cacheKey) && rejected;
+		rejected = rejects(modifyFirstRange([](CookedMeshRange& range) { range.indexCount = UINT32_MAX; }), cacheKey) && rejected;
+		rejected = rejects(modifyFirstRange([](CookedMeshRange& range) { range.vertexOffset = UINT32_MAX; }), cacheKey) && rejected;
+		rejected = rejects(modifyFirstRange([](CookedMeshRange& range) { range.nameLength = 0x10000; }), cacheKey) && rejected;
+		rejected = rejects(modifyFirstRange([](CookedMeshRange& range) { range.lodCount = UINT32_MAX; }), cacheKey) && rejected;
+		// 途中で切れたファイル（fileSize も合わせたものと、合わせていないもの）
+		std::vector<char> truncated(bytes.begin(), bytes.end() - sizeof(MeshLod));
+		rejected = rejects(truncated, cacheKey) && rejected;
+		reinterpret_cast<CookedMeshHeader*>(truncated.data())->fileSize = truncated.size();
+		rejected = rejects(truncated, cacheKey) && rejected;
+		rejected = rejects(std::vector<char>(bytes.begin(), bytes.begin() + sizeof(CookedMeshHeader) / 2), cacheKey) && rejected;
+		rejected = rejects({}, cacheKey) && rejected;
+		// ヘッダーと範囲の配列のどこか1バイトを壊したものは、読めても読めなくてもマップの外を読まないこと（読めたら中身は範囲に収まる）
+		const size_t tableBytes = sizeof(CookedMeshHeader) + sizeof(CookedMeshRange) * model.meshes.size();
+		for (int32_t i = 0; i < 200; ++i) {
+			std::vector<char> corruptBytes = bytes;
+			corruptBytes[random() % tableBytes] ^= char(1 + random() % 255);
+			std::ofstream(corruptPath, std::ios::binary | std::ios::trunc).write(corruptBytes.data(), corruptBytes.size());
+			ModelData corrupt;
+			if (ReadCookedMesh(corruptPath, cacheKey, corrupt)) {
+				for (const MeshData& mesh : corrupt.meshes) {
+					rejected = rejected && mesh.vertices.size() <= bytes.size() / sizeof(VertexData);
+				}
+			}
+		}
+		allRejected = allRejected && rejected;
+		++fileCount;
+	}
+	Check(fileCount >= 5, "Resources contains the OBJ fixtures");
+	Check(allRoundTrip, "cooked meshes read back identical to what was written");
+	Check(allRejected, "corrupt, truncated, version-mismatched and key-mismatched caches are rejected");
+}
+
+/// <summary>
+/// キャッシュのキーは元の OBJ の内容と読み込み設定で変わり、同じなら同じになること
+/// </summary>
+void TestCacheKey()
+{
+	const std::string text = "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n";
+	std::string edited = text;
+	edited[2] = '1';
+	const uint64_t key = MakeCookedMeshKey(text.data(), text.size(), MakeModelLoadOptions("model.obj", true));
+	Check(key == MakeCookedMeshKey(text.data(), text.size(), MakeModelLoadOptions("other.obj", true)), "the same content and options give the same key");
+	Check(key != MakeCookedMeshKey(edited.data(), edited.size(), MakeModelLoadOptions("model.obj", true)), "edited content changes the key");
+	Check(key != MakeCookedMeshKey(text.data(), text.size(), MakeModelLoadOptions("model.obj", false)), "disabling optimization changes the key");
+	Check(key != MakeCookedMeshKey(text.data(), text.size(), MakeModelLoadOptions("plane.obj", true)), "the flipY option changes the key");
+	// 8 バイト単位の部分と端数の部分のどちらの1バイトの違いでもハッシュが変わる
+	const uint8_t bytes[13] = {};
+	bool allDifferent = true;
+	for (size_t i = 0; i < sizeof(bytes); ++i) {
+		uint8_t changed[13] = {};
+		changed[i] = 1;
+		allDifferent = allDifferent && HashBytes(bytes, sizeof(bytes)) != HashBytes(changed, sizeof(changed));
+	}
+	Check(allDifferent, "HashBytes changes with any single byte");
+}
+
+} // namespace
+
+int main()
+{
+	// 書き出す場所（終わったら消す）
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "MeshCacheTest";
+	std::filesystem::remove_all(directory);
+	TestCookedMeshes(directory);
+	TestCacheKey();
+	std::error_code removeError;
+	std::filesystem::remove_all(directory, removeError);
+	return GetTestExitCode();
+}
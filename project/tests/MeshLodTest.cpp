@@ -0,0 +1,249 @@
+// MeshLod.h のテストとベンチマーク（Linux でも動く）。
+// LOD ごとにインデックスの数が減っていき、インデックスがすべて頂点を指すこと、SelectMeshLod が決まった距離で切り替わることを確かめ、
+// LOD の三角形数・誤差・生成時間を表示する
+#include "MeshLod.h"
+#include "ObjLoader.h"
+#include "TestUtility.h"
+#include <cfloat>
+
+namespace {
+
+/// <summary>
+/// 点と三角形の最短距離（Ericson の「Real-Time Collision Detection」の最近点の求め方）
+/// </summary>
+float DistancePointTriangle(const Vector3& p, const Vector3& a, const Vector3& b, const Vector3& c)
+{
+	auto subtract = [](const Vector3& l, const Vector3& r) { return Vector3{ l.x - r.x, l.y - r.y, l.z - r.z }; };
+	auto dot = [](const Vector3& l, const Vector3& r) { return l.x * r.x + l.y * r.y + l.z * r.z; };
+	auto length = [&dot](const Vector3& v) { return sqrtf(dot(v, v)); };
+
+	const Vector3 ab = subtract(b, a);
+	const Vector3 ac = subtract(c, a);
+	const Vector3 ap = subtract(p, a);
+	const float d1 = dot(ab, ap);
+	const float d2 = dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f) {
+		return length(ap);
+	}
+
+	const Vector3 bp = subtract(p, b);
+	const float d3 = dot(ab, bp);
+	const float d4 = dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3) {
+		return length(bp);
+	}
+
+	const float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+		const float v = d1 / (d1 - d3);
+		return length(subtract(ap, { ab.x * v, ab.y * v, ab.z * v }));
+	}
+
+	const Vector3 cp = subtract(p, c);
+	const float d5 = dot(ab, cp);
+	const float d6 = dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6) {
+		return length(cp);
+	}
+
+	const float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+		const float w = d2 / (d2 - d6);
+		return length(subtract(ap, { ac.x * w, ac.y * w, ac.z * w }));
+	}
+
+	const float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+		const float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		const Vector3 bc = subtract(c, b);
+		return length(subtract(bp, { bc.x * w, bc.y * w, bc.z * w }));
+	}
+
+	const float denominator = 1.0f / (va + vb + vc);
+	const float v = vb * denominator;
+	const float w = vc * denominator;
+	return length(subtract(ap, { ab.x * v + ac.x * w, ab.y * v + ac.y * w, ab.z * v + ac.z * w }));
+}
+
+/// <summary>
+/// 格子状の波打った面（開いた縁のあるメッシュ）
+/// </summary>
+MeshData MakeWavyGrid(uint32_t gridSize)
+{
+	MeshData mesh;
+	mesh.name = "wavy grid";
+	for (uint32_t y = 0; y <= gridSize; ++y) {
+		for (uint32_t x = 0; x <= gridSize; ++x) {
+			const float u = float(x) / float(gridSize);
+			const float v = float(y) / float(gridSize);
+			mesh.vertices.push_back({ { u, v, 0.05f * sinf(u * 6.0f) * cosf(v * 4.0f), 1.0f }, { u, v }, { 0.0f, 0.0f, -1.0f }, 0.0f });
+		}
+	}
+	for (uint32_t y = 0; y < gridSize; ++y) {
+		for (uint32_t x = 0; x < gridSize; ++x) {
+			const uint32_t i = y * (gridSize + 1) + x;
+			mesh.indices.insert(mesh.indices.end(), { i, i + 1, i + gridSize + 1 });
+			mesh.indices.insert(mesh.indices.end(), { i + 1, i + gridSize + 2, i + gridSize + 1 });
+		}
+	}
+	return mesh;
+}
+
+/// <summary>
+/// LOD がインデックスの数の減る順に並び、lodIndices を隙間なく分け合い、面積の無い三角形を含まず、誤差が減らないか
+/// </summary>
+bool IsValidLodChain(const MeshData& mesh)
+{
+	size_t previousIndexCount = mesh.indices.size();
+	float previousError = 0.0f;
+	uint32_t nextOffset = 0;
+	for (const MeshLod& lod : mesh.lods) {
+		if (lod.indexOffset != nextOffset || lod.indexCount == 0 || lod.indexCount % 3 != 0 || lod.indexCount >= previousIndexCount ||
+			lod.error < previousError) {
+			return false;
+		}
+		for (uint32_t i = lod.indexOffset; i < lod.indexOffset + lod.indexCount; i += 3) {
+			const uint32_t a = mesh.lodIndices[i];
+			const uint32_t b = mesh.lodIndices[i + 1];
+			const uint32_t c = mesh.lodIndices[i + 2];
+			if (a >= mesh.vertices.size() || b >= mesh.vertices.size() || c >= mesh.vertices.size() || a == b || b == c || a == c) {
+				return false;
+			}
+		}
+		previousIndexCount = lod.indexCount;
+		previousError = lod.error;
+		nextOffset = lod.indexOffset + lod.indexCount;
+	}
+	return nextOffset == mesh.lodIndices.size();
+}
+
+/// <summary>
+/// 元の頂点から LOD の面までの最大距離を実際に測る
+/// </summary>
+float MeasureLodDeviation(const MeshData& mesh, const MeshLod& lod)
+{
+	float measuredError = 0.0f;
+	for (const VertexData& vertex : mesh.vertices) {
+		const Vector3 p{ vertex.position.x, vertex.position.y, vertex.position.z };
+		float nearest = FLT_MAX;
+		for (uint32_t i = lod.indexOffset; i < lod.indexOffset + lod.indexCount; i += 3) {
+			const Vector4& a = mesh.vertices[mesh.lodIndices[i]].position;
+			const Vector4& b = mesh.vertices[mesh.lodIndices[i + 1]].position;
+			const Vector4& c = mesh.vertices[mesh.lodIndices[i + 2]].position;
+			nearest = std::min(nearest, DistancePointTriangle(p, { a.x, a.y, a.z }, { b.x, b.y, b.z }, { c.x, c.y, c.z }));
+		}
+		measuredError = std::max(measuredError, nearest);
+	}
+	return measuredError;
+}
+
+/// <summary>
+/// ティーポット・スザンヌ・波打った格子の LOD を作り、並びとインデックスを確かめる。三角形数・誤差・生成時間を表示する
+/// </summary>
+void TestBuildMeshLods()
+{
+	std::vector<std::pair<std::string, MeshData>> meshes;
+	for (const char* filename : { "teapot.obj", "suzanne.obj" }) {
+		for (MeshData& mesh : LoadObjFile(RESOURCES_DIRECTORY, filename).meshes) {
+			meshes.push_back({ std::string(filename) + "/" + mesh.name, std::move(mesh) });
+		}
+	}
+	meshes.push_back({ "wavy grid", MakeWavyGrid(48) });
+
+	bool allValid = true;
+	bool allBuilt = true;
+	for (auto& [name, mesh] : meshes) {
+		OptimizeMesh(mesh);
+		const double milliseconds = MeasureNanoseconds(1, 1, [&] { BuildMeshLods(mesh); }) / 1.0e6;
+		const bool isValid = IsValidLodChain(mesh);
+		allValid = allValid && isValid;
+		// 数百個以上の三角形があれば、LOD1 は目標（半分）の近くまで減らせる
+		allBuilt = allBuilt && !mesh.lods.empty() && mesh.lods[0].indexCount <= mesh.indices.size() * 6 / 10;
+
+		// 大きさの違うモデルを比べられるよう、誤差はモデルを囲む球の半径に対する割合でも出す
+		Vector3 minimum{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 maximum{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (const VertexData& vertex : mesh.vertices) {
+			minimum = { std::min(minimum.x, vertex.position.x), std::min(minimum.y, vertex.position.y), std::min(minimum.z, vertex.position.z) };
+			maximum = { std::max(maximum.x, vertex.position.x), std::max(maximum.y, vertex.position.y), std::max(maximum.z, vertex.position.z) };
+		}
+		const Vector3 extent{ maximum.x - minimum.x, maximum.y - minimum.y, maximum.z - minimum.z };
+		const float radius = 0.5f * sqrtf(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z);
+
+		std::printf("%s: LOD0 %zu triangles, %zu LODs built in %.2f ms%s\n", name.c_str(), mesh.indices.size() / 3, mesh.lods.size(), milliseconds,
+			isValid ? "" : " (INVALID)");
+		for (size_t level = 0; level < mesh.lods.size(); ++level) {
+			const MeshLod& lod = mesh.lods[level];
+			const float measuredError = MeasureLodDeviation(mesh, lod);
+			std::printf("  LOD%zu: %u triangles (%.1f%%), quadric error %.4f (%.2f%% of radius), max deviation %.4f (%.2f%% of radius)\n",
+				level + 1, lod.indexCount / 3, 100.0 * lod.indexCount / mesh.indices.size(),
+				lod.error, 100.0f * lod.error / radius, measuredError, 100.0f * measuredError / radius);
+		}
+	}
+	Check(allValid, "LOD index counts decrease monotonically, errors never decrease and every index is valid");
+	Check(allBuilt, "LOD1 of every test mesh has at most 60% of the original triangles");
+
+	// 減らす余地のないメッシュには LOD を作らない
+	MeshData empty;
+	BuildMeshLods(empty);
+	MeshData triangle;
+	triangle.vertices.resize(3);
+	triangle.vertices[1].position = { 1.0f, 0.0f, 0.0f, 1.0f };
+	triangle.vertices[2].position = { 0.0f, 1.0f, 0.0f, 1.0f };
+	triangle.indices = { 0, 1, 2 };
+	BuildMeshLods(triangle);
+	Check(empty.lods.empty() && empty.lodIndices.empty() && triangle.lods.empty() && triangle.lodIndices.empty(),
+		"meshes too small to simplify get no LODs");
+}
+
+/// <summary>
+/// SelectMeshLod が、画面上の誤差が閾値を超えない中で一番粗い LOD を選ぶこと
+/// </summary>
+void TestSelectMeshLod()
+{
+	// 縦 1000 ピクセル・projectionScaleY = 1 なら、距離 d で長さ 1 は 500 / d ピクセルになる。
+	// LOD1～3 の誤差 0.01 / 0.02 / 0.04 は、距離 5 / 10 / 20 でちょうど 1 ピクセルになる
+	MeshData mesh;
+	mesh.lods = { { 0, 3, 0.01f }, { 3, 3, 0.02f }, { 6, 3, 0.04f } };
+	struct Case
+	{
+		float distance;
+		float worldScale;
+		float pixelThreshold;
+		uint32_t expectedLevel;
+	};
+	const Case kCases[] = {
+		{ 0.0f, 1.0f, 1.0f, 0 },     // カメラの位置（距離は 0 にしない）
+		{ 4.9f, 1.0f, 1.0f, 0 },
+		{ 5.1f, 1.0f, 1.0f, 1 },
+		{ 9.9f, 1.0f, 1.0f, 1 },
+		{ 10.1f, 1.0f, 1.0f, 2 },
+		{ 20.1f, 1.0f, 1.0f, 3 },
+		{ 1000.0f, 1.0f, 1.0f, 3 },  // 一番粗い LOD より先は無い
+		{ 10.1f, 2.0f, 1.0f, 1 },    // 2 倍に拡大すると誤差も 2 倍
+		{ 5.1f, 1.0f, 2.0f, 2 },     // 閾値を 2 ピクセルにすると半分の距離で切り替わる
+		{ 5.1f, 1.0f, 0.0f, 0 },     // 閾値が 0 なら誤差のある LOD は選ばない
+	};
+	bool allMatch = true;
+	for (const Case& testCase : kCases) {
+		const uint32_t level = SelectMeshLod(mesh, testCase.distance, testCase.worldScale, 1.0f, 1000.0f, testCase.pixelThreshold);
+		if (level != testCase.expectedLevel) {
+			std::printf("distance %.1f scale %.1f threshold %.1f: level %u, expected %u\n",
+				testCase.distance, testCase.worldScale, testCase.pixelThreshold, level, testCase.expectedLevel);
+			allMatch = false;
+		}
+	}
+	Check(allMatch, "SelectMeshLod switches levels at the distances where the error reaches the pixel threshold");
+
+	MeshData noLods;
+	Check(SelectMeshLod(noLods, 1000.0f, 1.0f, 1.0f, 1000.0f) == 0, "a mesh without LODs always selects level 0");
+}
+
+} // namespace
+
+int main()
+{
+	TestBuildMeshLods();
+	TestSelectMeshLod();
+	return GetTestExitCode();
+}
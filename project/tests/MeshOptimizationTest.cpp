@@ -0,0 +1,212 @@
+// MeshOptimization.h のテストとベンチマーク（Linux でも動く）。
+// 最適化で ACMR（三角形あたりの頂点キャッシュミス）が下がり、三角形の集まりが変わらないことを確かめ、前後の ACMR / ATVR と時間を表示する
+#include "MeshOptimization.h"
+#include "ObjLoader.h"
+#include "TestUtility.h"
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <random>
+
+namespace {
+
+// 三角形を頂点の中身で表したもの（並べ替えや頂点の付け直しの前後で比べる）
+using TriangleKey = std::array<VertexData, 3>;
+
+bool IsLessVertex(const VertexData& lhs, const VertexData& rhs)
+{
+	return std::memcmp(&lhs, &rhs, sizeof(VertexData)) < 0;
+}
+
+/// <summary>
+/// 三角形を頂点の中身の組にして並べたもの。回る向きは保ったまま、最も小さい頂点が先頭になるよう回す
+/// </summary>
+std::vector<TriangleKey> MakeTriangleMultiset(const MeshData& mesh)
+{
+	std::vector<TriangleKey> triangles;
+	triangles.reserve(mesh.indices.size() / 3);
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+		TriangleKey triangle{ mesh.vertices[mesh.indices[i]], mesh.vertices[mesh.indices[i + 1]], mesh.vertices[mesh.indices[i + 2]] };
+		while (IsLessVertex(triangle[1], triangle[0]) || IsLessVertex(triangle[2], triangle[0])) {
+			std::rotate(triangle.begin(), triangle.begin() + 1, triangle.end());
+		}
+		triangles.push_back(triangle);
+	}
+	std::sort(triangles.begin(), triangles.end(), [](const TriangleKey& lhs, const TriangleKey& rhs) {
+		return std::memcmp(lhs.data(), rhs.data(), sizeof(TriangleKey)) < 0;
+	});
+	return triangles;
+}
+
+bool IsSameTriangleMultiset(const std::vector<TriangleKey>& a, const std::vector<TriangleKey>& b)
+{
+	return a.size() == b.size() && std::memcmp(a.data(), b.data(), sizeof(TriangleKey) * a.size()) == 0;
+}
+
+/// <summary>
+/// 頂点が最初に使われる順に並んでいて、使われていない頂点が無いか（OptimizeVertexFetch の後）
+/// </summary>
+bool IsInFirstUseOrder(const MeshData& mesh)
+{
+	uint32_t nextVertex = 0;
+	for (uint32_t index : mesh.indices) {
+		if (index > nextVertex) {
+			return false;
+		}
+		if (index == nextVertex) {
+			++nextVertex;
+		}
+	}
+	return nextVertex == mesh.vertices.size();
+}
+
+/// <summary>
+/// 三角形の順番をばらばらにする（頂点キャッシュが効かない並び）
+/// </summary>
+void ShuffleTriangles(MeshData& mesh, uint32_t seed)
+{
+	std::vector<std::array<uint32_t, 3>> triangles(mesh.indices.size() / 3);
+	std::memcpy(triangles.data(), mesh.indices.data(), sizeof(uint32_t) * triangles.size() * 3);
+	std::mt19937 random(seed);
+	std::shuffle(triangles.begin(), triangles.end(), random);
+	std::memcpy(mesh.indices.data(), triangles.data(), sizeof(uint32_t) * triangles.size() * 3);
+}
+
+/// <summary>
+/// 格子状のメッシュを、三角形の順番をばらばらにして作る
+/// </summary>
+MeshData MakeShuffledGrid(uint32_t gridSize, uint32_t seed)
+{
+	MeshData mesh;
+	mesh.name = "shuffled grid";
+	for (uint32_t y = 0; y <= gridSize; ++y) {
+		for (uint32_t x = 0; x <= gridSize; ++x) {
+			const float u = float(x) / float(gridSize);
+			const float v = float(y) / float(gridSize);
+			// 少し波打たせて、オーバードロー最適化の塊ごとの向きに差をつける
+			mesh.vertices.push_back({ { u, v, 0.1f * sinf(u * 6.0f) * cosf(v * 6.0f), 1.0f }, { u, v }, { 0.0f, 0.0f, -1.0f }, 0.0f });
+		}
+	}
+	for (uint32_t y = 0; y < gridSize; ++y) {
+		for (uint32_t x = 0; x < gridSize; ++x) {
+			const uint32_t i = y * (gridSize + 1) + x;
+			mesh.indices.insert(mesh.indices.end(), { i, i + 1, i + gridSize + 1 });
+			mesh.indices.insert(mesh.indices.end(), { i + 1, i + gridSize + 2, i + gridSize + 1 });
+		}
+	}
+	ShuffleTriangles(mesh, seed);
+	return mesh;
+}
+
+/// <summary>
+/// メッシュを最適化し、ACMR が上がらない（shouldImprove なら下がる）こと、三角形の集まりが変わらないことを確かめる
+/// </summary>
+/// <returns>確かめたことがすべて成り立てば true</returns>
+bool OptimizeAndVerify(const std::string& label, MeshData mesh, bool shouldImprove)
+{
+	const std::vector<TriangleKey> original = MakeTriangleMultiset(mesh);
+	// GPUによってキャッシュのサイズが違うので、小さいものと大きいものの両方で見る
+	const VertexCacheStatistics before16 = AnalyzeVertexCache(mesh.indices, mesh.vertices.size(), 16);
+	const VertexCacheStatistics before32 = AnalyzeVertexCache(mesh.indices, mesh.vertices.size(), 32);
+
+	// 段階ごとに三角形の集まりが変わらないことを確かめる
+	MeshData cacheOptimized = mesh;
+	OptimizeVertexCache(cacheOptimized.indices, cacheOptimized.vertices.size());
+	const VertexCacheStatistics cache = AnalyzeVertexCache(cacheOptimized.indices, cacheOptimized.vertices.size(), 16);
+	bool isValid = IsSameTriangleMultiset(original, MakeTriangleMultiset(cacheOptimized));
+	OptimizeOverdraw(cacheOptimized.indices, cacheOptimized.vertices, 1.05f);
+	isValid = isValid && IsSameTriangleMultiset(original, MakeTriangleMultiset(cacheOptimized));
+
+	const double milliseconds = MeasureNanoseconds(1, 1, [&] { OptimizeMesh(mesh); }) / 1.0e6;
+	isValid = isValid && IsSameTriangleMultiset(original, MakeTriangleMultiset(mesh)) && IsInFirstUseOrder(mesh);
+
+	const VertexCacheStatistics after16 = AnalyzeVertexCache(mesh.indices, mesh.vertices.size(), 16);
+	const VertexCacheStatistics after32 = AnalyzeVertexCache(mesh.indices, mesh.vertices.size(), 32);
+	// 頂点キャッシュ最適化で ACMR が上がらないこと。オーバードロー最適化は、塊に分けるときに使うキャッシュのサイズ（16）で
+	// しきい値（1.05 倍）までしか悪くしない
+	isValid = isValid && cache.misses <= before16.misses && after16.misses <= cache.misses * 1.05f;
+	if (shouldImprove) {
+		isValid = isValid && after16.acmr < before16.acmr && after32.acmr < before32.acmr;
+	}
+	std::printf("%s: %zu triangles, cache16 ACMR %.3f -> %.3f ATVR %.3f -> %.3f, cache32 ACMR %.3f -> %.3f ATVR %.3f -> %.3f, %.3f ms%s\n",
+		label.c_str(), mesh.indices.size() / 3, before16.acmr, after16.acmr, before16.atvr, after16.atvr,
+		before32.acmr, after32.acmr, before32.atvr, after32.atvr, milliseconds, isValid ? "" : " (FAILED)");
+	return isValid;
+}
+
+/// <summary>
+/// Resources のモデルを、読み込んだ順と三角形の順番をばらばらにした順から最適化する。ばらばらの順からは ACMR が下がること
+/// </summary>
+void TestResourceMeshes()
+{
+	bool allValid = true;
+	bool allImproved = true;
+	size_t meshCount = 0;
+	for (const auto& entry : std::filesystem::directory_iterator(RESOURCES_DIRECTORY)) {
+		if (entry.path().extension() != ".obj") {
+			continue;
+		}
+		const std::string filename = entry.path().filename().string();
+		const ModelData model = LoadObjFile(RESOURCES_DIRECTORY, filename);
+		for (const MeshData& mesh : model.meshes) {
+			// 読み込んだ順がすでに良い並びのこともある（teapot など）ので、上がらないことだけ確かめる
+			allValid = OptimizeAndVerify(filename + "/" + mesh.name, mesh, false) && allValid;
+			// 数十個の三角形ならどんな順でもキャッシュに収まるので、ばらばらにして比べるのは大きいものだけにする
+			if (mesh.indices.size() / 3 >= 100) {
+				MeshData shuffled = mesh;
+				ShuffleTriangles(shuffled, 3);
+				allImproved = OptimizeAndVerify(filename + "/" + mesh.name + " (shuffled)", shuffled, true) && allImproved;
+			}
+			++meshCount;
+		}
+	}
+	Check(meshCount >= 6, "Resources contains the OBJ fixtures");
+	Check(allValid, "optimizing the Resources meshes keeps every triangle and does not raise ACMR");
+	Check(allImproved, "optimizing the shuffled Resources meshes lowers ACMR and keeps every triangle");
+}
+
+/// <summary>
+/// 三角形の順番をばらばらにした格子は、最適化で ACMR が大きく下がること
+/// </summary>
+void TestShuffledGrid()
+{
+	Check(OptimizeAndVerify("shuffled grid 64x64", MakeShuffledGrid(64, 1), true), "optimizing a shuffled grid lowers ACMR and keeps every triangle");
+
+	// 格子の ACMR は頂点数/三角形数 ≒ 0.5 が下限。32 のキャッシュなら 1 を大きく下回ること
+	MeshData mesh = MakeShuffledGrid(128, 2);
+	OptimizeMesh(mesh);
+	const VertexCacheStatistics statistics = AnalyzeVertexCache(mesh.indices, mesh.vertices.size(), 32);
+	std::printf("shuffled grid 128x128: cache32 ACMR %.3f ATVR %.3f\n", statistics.acmr, statistics.atvr);
+	Check(statistics.acmr < 0.8f, "the optimized grid reaches an ACMR below 0.8 with a 32-entry cache");
+}
+
+/// <summary>
+/// 空のメッシュや三角形1つのメッシュでも壊れないこと
+/// </summary>
+void TestSmallMeshes()
+{
+	MeshData empty;
+	OptimizeMesh(empty);
+	Check(empty.indices.empty() && empty.vertices.empty(), "optimizing an empty mesh leaves it empty");
+
+	MeshData triangle;
+	triangle.vertices.resize(5);
+	for (uint32_t i = 0; i < 5; ++i) {
+		triangle.vertices[i].position = { float(i), float(i * i), 0.0f, 1.0f };
+	}
+	triangle.indices = { 4, 2, 3 };
+	const std::vector<TriangleKey> original = MakeTriangleMultiset(triangle);
+	OptimizeMesh(triangle);
+	Check(triangle.vertices.size() == 3 && IsSameTriangleMultiset(original, MakeTriangleMultiset(triangle)),
+		"optimizing a single triangle keeps it and drops the unused vertices");
+}
+
+} // namespace
+
+int main()
+{
+	TestResourceMeshes();
+	TestShuffledGrid();
+	TestSmallMeshes();
+	return GetTestExitCode();
+}
@@ -0,0 +1,288 @@
+// MeshTriangleBvh.h のテストとベンチマーク（Linux でも動く）。
+// 命令セットごとの RaycastMesh の結果が、すべての三角形を double で総当たりした Möller–Trumbore の結果と一致することを確かめ、
+// Resources のモデルと細かく分けた球で、レイの交差の速さ（rays/s）を表示する
+#include "MeshTriangleBvh.h"
+#include "ObjLoader.h"
+#include "TestUtility.h"
+#include <filesystem>
+#include <random>
+
+namespace {
+
+// 三角形の辺や頂点すれすれのレイは、float と double で当たり外れが違ってもよい（重心座標でこれだけの幅）
+const double kEdgeTolerance = 1.0e-4;
+// 距離の相対誤差の許容範囲
+const float kDistanceTolerance = 1.0e-4f;
+
+// double で計算したレイと三角形の交差（総当たりの答え）
+struct ReferenceHit {
+	double distance = DBL_MAX;
+	double u = 0.0;
+	double v = 0.0;
+	uint32_t triangle = UINT32_MAX;
+};
+
+/// <summary>
+/// レイと三角形の交差を double で計算する（Möller–Trumbore 法。裏からの交差も当たりにする）
+/// </summary>
+/// <param name="margin">重心座標が三角形の内側にどれだけ入っているか（負なら外）</param>
+/// <returns>レイの先（距離が 0 以上）で三角形の面と交わったら true（margin で内外を判断する）</returns>
+bool IntersectRayTriangleDouble(const Ray& ray, const Vector4& a, const Vector4& b, const Vector4& c, double& distance, double& u, double& v, double& margin)
+{
+	const double edge1[3] = { double(b.x) - a.x, double(b.y) - a.y, double(b.z) - a.z };
+	const double edge2[3] = { double(c.x) - a.x, double(c.y) - a.y, double(c.z) - a.z };
+	const double direction[3] = { ray.direction.x, ray.direction.y, ray.direction.z };
+	const double p[3] = { direction[1] * edge2[2] - direction[2] * edge2[1], direction[2] * edge2[0] - direction[0] * edge2[2], direction[0] * edge2[1] - direction[1] * edge2[0] };
+	const double determinant = edge1[0] * p[0] + edge1[1] * p[1] + edge1[2] * p[2];
+	if (std::fabs(determinant) < 1.0e-12) {
+		return false;
+	}
+	const double toOrigin[3] = { double(ray.origin.x) - a.x, double(ray.origin.y) - a.y, double(ray.origin.z) - a.z };
+	const double q[3] = { toOrigin[1] * edge1[2] - toOrigin[2] * edge1[1], toOrigin[2] * edge1[0] - toOrigin[0] * edge1[2], toOrigin[0] * edge1[1] - toOrigin[1] * edge1[0] };
+	u = (toOrigin[0] * p[0] + toOrigin[1] * p[1] + toOrigin[2] * p[2]) / determinant;
+	v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) / determinant;
+	distance = (edge2[0] * q[0] + edge2[1] * q[1] + edge2[2] * q[2]) / determinant;
+	margin = std::min({ u, v, 1.0 - u - v });
+	return distance >= 0.0;
+}
+
+/// <summary>
+/// すべての三角形を総当たりして、一番近く当たるもの（重心座標の幅 -tolerance まで内側とみなす）
+/// </summary>
+ReferenceHit RaycastBruteForce(const MeshData& mesh, const Ray& ray, double tolerance)
+{
+	ReferenceHit nearest;
+	for (uint32_t triangle = 0; triangle * 3 + 2 < mesh.indices.size(); ++triangle) {
+		double distance = 0.0;
+		double u = 0.0;
+		double v = 0.0;
+		double margin = 0.0;
+		const bool isHit = IntersectRayTriangleDouble(ray, mesh.vertices[mesh.indices[triangle * 3]].position,
+			mesh.vertices[mesh.indices[triangle * 3 + 1]].position, mesh.vertices[mesh.indices[triangle * 3 + 2]].position, distance, u, v, margin);
+		if (isHit && margin >= -tolerance && distance < nearest.distance) {
+			nearest = { distance, u, v, triangle };
+		}
+	}
+	return nearest;
+}
+
+/// <summary>
+/// RaycastMesh の答えが総当たりと一致するか。辺すれすれで当たり外れが分かれるときは、どちらの答えも許す。
+/// 当たったなら、距離が総当たりと同じで、重心座標が返した三角形の上にあり、UV がその重心座標で補間したものであること
+/// </summary>
+bool MatchesBruteForce(const MeshData& mesh, const Ray& ray, bool isHit, const RayTriangleHit& hit)
+{
+	// 確実に当たる（内側に kEdgeTolerance 以上入っている）ものと、辺すれすれまで当たりにしたもの
+	const ReferenceHit strict = RaycastBruteForce(mesh, ray, -kEdgeTolerance);
+	const ReferenceHit loose = RaycastBruteForce(mesh, ray, kEdgeTolerance);
+	if (!isHit) {
+		return strict.triangle == UINT32_MAX;
+	}
+	if (loose.triangle == UINT32_MAX) {
+		return false;
+	}
+	// 当たった距離は、辺すれすれのものまで含めた一番近いものと、確実に当たる一番近いものの間にある
+	const double upper = (strict.triangle != UINT32_MAX) ? strict.distance : DBL_MAX;
+	const double slack = kDistanceTolerance * std::max(1.0, loose.distance);
+	if (hit.distance < loose.distance - slack || hit.distance > upper + slack) {
+		return false;
+	}
+
+	// 返した三角形の上で、重心座標と UV が合っていること
+	double distance = 0.0;
+	double u = 0.0;
+	double v = 0.0;
+	double margin = 0.0;
+	const uint32_t* corners = &mesh.indices[hit.triangle * 3];
+	if (!IntersectRayTriangleDouble(ray, mesh.vertices[corners[0]].position, mesh.vertices[corners[1]].position, mesh.vertices[corners[2]].position, distance, u, v, margin) ||
+		margin < -kEdgeTolerance || std::fabs(distance - hit.distance) > slack || std::fabs(u - hit.u) > kEdgeTolerance || std::fabs(v - hit.v) > kEdgeTolerance) {
+		return false;
+	}
+	const Vector2& t0 = mesh.vertices[corners[0]].texcoord;
+	const Vector2& t1 = mesh.vertices[corners[1]].texcoord;
+	const Vector2& t2 = mesh.vertices[corners[2]].texcoord;
+	const float w = 1.0f - hit.u - hit.v;
+	return fabsf(hit.texcoord.x - (t0.x * w + t1.x * hit.u + t2.x * hit.v)) <= 1.0e-5f &&
+		fabsf(hit.texcoord.y - (t0.y * w + t1.y * hit.u + t2.y * hit.v)) <= 1.0e-5f;
+}
+
+/// <summary>
+/// メッシュを囲む球の2倍の半径の球面から、メッシュを囲む箱の中のランダムな点へ向けて飛ばすレイ。
+/// 一部は軸に平行にし、一部はメッシュの中心から外へ向けて飛ばす
+/// </summary>
+std::vector<Ray> MakeRaysTowardMesh(const MeshTriangleBvh& triangleBvh, uint32_t count, uint32_t seed)
+{
+	const Aabb& box = triangleBvh.bvh.nodes[0].bounds;
+	const Vector3 center = { (box.minimum.x + box.maximum.x) * 0.5f, (box.minimum.y + box.maximum.y) * 0.5f, (box.minimum.z + box.maximum.z) * 0.5f };
+	const Vector3 extent = { (box.maximum.x - box.minimum.x) * 0.5f, (box.maximum.y - box.minimum.y) * 0.5f, (box.maximum.z - box.minimum.z) * 0.5f };
+	const float radius = std::max(sqrtf(extent.x * extent.x + extent.y * extent.y + extent.z * extent.z), 1.0e-3f);
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<Ray> rays(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		const Vector3 target = { center.x + extent.x * unit(random), center.y + extent.y * unit(random), center.z + extent.z * unit(random) };
+		Vector3 direction = Normalize(Vector3{ unit(random), unit(random), unit(random) });
+		if (i % 16 == 1) {
+			// 軸に平行（向きの成分が 0）
+			const Vector3 kAxes[] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+			direction = kAxes[i / 16 % 3];
+		}
+		if (i % 16 == 2) {
+			// メッシュの中の点から外へ
+			rays[i] = { target, direction };
+			continue;
+		}
+		const Vector3 origin = { target.x - direction.x * radius * 2.0f, target.y - direction.y * radius * 2.0f, target.z - direction.z * radius * 2.0f };
+		rays[i] = { origin, direction };
+	}
+	return rays;
+}
+
+/// <summary>
+/// 経度・緯度で細かく分けた球
+/// </summary>
+MeshData MakeSphere(uint32_t slices, uint32_t stacks)
+{
+	MeshData mesh;
+	mesh.name = "sphere";
+	for (uint32_t stack = 0; stack <= stacks; ++stack) {
+		const float latitude = 3.14159265f * (float(stack) / float(stacks) - 0.5f);
+		for (uint32_t slice = 0; slice <= slices; ++slice) {
+			const float longitude = 2.0f * 3.14159265f * float(slice) / float(slices);
+			const Vector3 normal = { cosf(latitude) * cosf(longitude), sinf(latitude), cosf(latitude) * sinf(longitude) };
+			mesh.vertices.push_back({ { normal.x, normal.y, normal.z, 1.0f }, { float(slice) / float(slices), float(stack) / float(stacks) }, normal, 0.0f });
+		}
+	}
+	for (uint32_t stack = 0; stack < stacks; ++stack) {
+		for (uint32_t slice = 0; slice < slices; ++slice) {
+			const uint32_t i = stack * (slices + 1) + slice;
+			mesh.indices.insert(mesh.indices.end(), { i, i + slices + 1, i + 1 });
+			mesh.indices.insert(mesh.indices.end(), { i + 1, i + slices + 1, i + slices + 2 });
+		}
+	}
+	return mesh;
+}
+
+/// <summary>
+/// 命令セットごとに、レイの交差を総当たりと比べ、速さを表示する
+/// </summary>
+/// <returns>総当たりと一致しなかったレイの数</returns>
+size_t VerifyAndMeasure(const std::string& label, const MeshData& mesh, uint32_t rayCount, uint32_t verifiedRayCount)
+{
+	MeshTriangleBvh triangleBvh;
+	const double buildMilliseconds = MeasureNanoseconds(1, 1, [&] { BuildMeshTriangleBvh(triangleBvh, mesh); }) / 1.0e6;
+	const std::vector<Ray> rays = MakeRaysTowardMesh(triangleBvh, rayCount, 20250426);
+
+	const MathBackend detectedBackend = gMathKernels.backend;
+	size_t mismatches = 0;
+	std::string results;
+	for (MathBackend backend : { MathBackend::Scalar, MathBackend::SSE41, MathBackend::AVX2 }) {
+		if (!SetMathBackend(backend)) {
+			continue;
+		}
+		std::vector<RayTriangleHit> hits(rays.size());
+		std::vector<uint8_t> hitFlags(rays.size());
+		const double nanoseconds = MeasureNanoseconds(1, rays.size(), [&] {
+			for (size_t i = 0; i < rays.size(); ++i) {
+				hitFlags[i] = RaycastMesh(triangleBvh, mesh, rays[i], FLT_MAX, hits[i]) ? 1 : 0;
+			}
+		});
+		size_t hitCount = 0;
+		size_t backendMismatches = 0;
+		for (size_t i = 0; i < rays.size(); ++i) {
+			hitCount += hitFlags[i];
+			if (i < verifiedRayCount && !MatchesBruteForce(mesh, rays[i], hitFlags[i] != 0, hits[i])) {
+				++backendMismatches;
+			}
+		}
+
+		// maxDistance より手前に当たるものが無ければ外れになること
+		for (size_t i = 0; i < verifiedRayCount && i < rays.size(); ++i) {
+			RayTriangleHit limited{};
+			if (hitFlags[i] && RaycastMesh(triangleBvh, mesh, rays[i], hits[i].distance * 0.999f, limited) && limited.distance >= hits[i].distance * 0.999f) {
+				++backendMismatches;
+			}
+		}
+		mismatches += backendMismatches;
+		char result[128];
+		std::snprintf(result, sizeof(result), ", %ls %.2f Mrays/s (%.1f%% hit, %zu mismatches)",
+			GetMathBackendName(backend), 1.0e3 / nanoseconds, 100.0 * double(hitCount) / double(rays.size()), backendMismatches);
+		results += result;
+	}
+	SetMathBackend(detectedBackend);
+	std::printf("%s: %zu triangles, BVH %zu nodes built in %.2f ms%s\n",
+		label.c_str(), mesh.indices.size() / 3, triangleBvh.bvh.nodes.size(), buildMilliseconds, results.c_str());
+	return mismatches;
+}
+
+/// <summary>
+/// Resources のモデルでレイの交差を総当たりと比べる
+/// </summary>
+void TestResourceMeshes()
+{
+	size_t meshCount = 0;
+	size_t mismatches = 0;
+	for (const auto& entry : std::filesystem::directory_iterator(RESOURCES_DIRECTORY)) {
+		if (entry.path().extension() != ".obj") {
+			continue;
+		}
+		const std::string filename = entry.path().filename().string();
+		const ModelData model = LoadObjFile(RESOURCES_DIRECTORY, filename);
+		for (const MeshData& mesh : model.meshes) {
+			if (mesh.indices.empty()) {
+				continue;
+			}
+			mismatches += VerifyAndMeasure(filename + "/" + mesh.name, mesh, 20000, 1000);
+			++meshCount;
+		}
+	}
+	Check(meshCount >= 6, "Resources contains the OBJ fixtures");
+	Check(mismatches == 0, "RaycastMesh on the Resources meshes matches brute-force ray/triangle intersection on every backend");
+}
+
+/// <summary>
+/// 10万三角形の球で、レイの交差を総当たりと比べ、速さを表示する
+/// </summary>
+void TestSphere()
+{
+	const MeshData sphere = MakeSphere(256, 196);
+	Check(VerifyAndMeasure("sphere", sphere, 200000, 300) == 0, "RaycastMesh on a 100k-triangle sphere matches brute-force ray/triangle intersection on every backend");
+}
+
+/// <summary>
+/// 三角形がばらばらに散らばったメッシュ（葉に入る三角形の数がいろいろになる）と、空のメッシュ
+/// </summary>
+void TestTriangleSoupAndEmpty()
+{
+	std::mt19937 random(9);
+	std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+	std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+	MeshData soup;
+	soup.name = "soup";
+	for (uint32_t triangle = 0; triangle < 5000; ++triangle) {
+		const Vector3 center = { position(random), position(random), position(random) };
+		for (uint32_t corner = 0; corner < 3; ++corner) {
+			soup.vertices.push_back({ { center.x + offset(random), center.y + offset(random), center.z + offset(random), 1.0f },
+				{ offset(random), offset(random) }, { 0.0f, 0.0f, 1.0f }, 0.0f });
+			soup.indices.push_back(triangle * 3 + corner);
+		}
+	}
+	Check(VerifyAndMeasure("triangle soup", soup, 20000, 2000) == 0, "RaycastMesh on a random triangle soup matches brute-force ray/triangle intersection on every backend");
+
+	MeshData empty;
+	MeshTriangleBvh triangleBvh;
+	BuildMeshTriangleBvh(triangleBvh, empty);
+	RayTriangleHit hit{};
+	Check(triangleBvh.packets.empty() && !RaycastMesh(triangleBvh, empty, { { 0.0f, 0.0f, -5.0f }, { 0.0f, 0.0f, 1.0f } }, FLT_MAX, hit),
+		"a mesh without triangles has no packets and is never hit");
+}
+
+} // namespace
+
+int main()
+{
+	TestResourceMeshes();
+	TestTriangleSoupAndEmpty();
+	TestSphere();
+	return GetTestExitCode();
+}
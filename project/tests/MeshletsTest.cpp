@@ -0,0 +1,320 @@
+// Meshlets.h のテストとベンチマーク（Linux でも動く）。
+// メッシュレットが頂点数と三角形数の上限を守り、すべての三角形をちょうど1回ずつ含むこと、
+// 法線コーンの背面カリングと視錐台カリングが表を向いた見える三角形を捨てないことを確かめ、カリングの速さを表示する
+#include "Meshlets.h"
+#include "MeshOptimization.h"
+#include "ObjLoader.h"
+#include "TestUtility.h"
+#include <filesystem>
+#include <random>
+
+namespace {
+
+Vector3 GetPosition(const MeshData& mesh, uint32_t index)
+{
+	const Vector4& p = mesh.vertices[index].position;
+	return { p.x, p.y, p.z };
+}
+
+float Dot(const Vector3& a, const Vector3& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+/// <summary>
+/// 三角形が視点から表を向いているか（ComputeMeshletBounds と同じく cross(b - a, c - a) を面の向きとする）
+/// </summary>
+bool IsFrontFacing(const MeshData& mesh, size_t triangle, const Vector3& cameraPosition)
+{
+	const Vector3 a = GetPosition(mesh, mesh.indices[triangle * 3 + 0]);
+	const Vector3 b = GetPosition(mesh, mesh.indices[triangle * 3 + 1]);
+	const Vector3 c = GetPosition(mesh, mesh.indices[triangle * 3 + 2]);
+	const Vector3 ab{ b.x - a.x, b.y - a.y, b.z - a.z };
+	const Vector3 ac{ c.x - a.x, c.y - a.y, c.z - a.z };
+	const Vector3 normal{ ab.y * ac.z - ab.z * ac.y, ab.z * ac.x - ab.x * ac.z, ab.x * ac.y - ab.y * ac.x };
+	return Dot(normal, { cameraPosition.x - a.x, cameraPosition.y - a.y, cameraPosition.z - a.z }) > 0.0f;
+}
+
+/// <summary>
+/// 三角形のどれかの頂点が視錐台の内側にあるか
+/// </summary>
+bool HasVertexInFrustum(const MeshData& mesh, size_t triangle, const Frustum& frustum)
+{
+	for (uint32_t k = 0; k < 3; ++k) {
+		if (IsSphereInFrustum(frustum, GetPosition(mesh, mesh.indices[triangle * 3 + k]), 0.0f)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/// <summary>
+/// どこも捨てない視錐台（すべての平面が常に内側）
+/// </summary>
+Frustum MakeInfiniteFrustum()
+{
+	Frustum frustum{};
+	for (Vector4& plane : frustum.planes) {
+		plane = { 0.0f, 0.0f, 0.0f, 1.0f };
+	}
+	return frustum;
+}
+
+/// <summary>
+/// 三角形の向きが外向きになる UV 球（背面カリングが効くことを確かめる）
+/// </summary>
+MeshData MakeSphere(uint32_t slices, uint32_t stacks)
+{
+	MeshData mesh;
+	mesh.name = "sphere";
+	for (uint32_t stack = 0; stack <= stacks; ++stack) {
+		for (uint32_t slice = 0; slice <= slices; ++slice) {
+			const float theta = 3.14159265f * float(stack) / float(stacks);
+			const float phi = 6.2831853f * float(slice) / float(slices);
+			const Vector3 p{ sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi) };
+			mesh.vertices.push_back({ { p.x, p.y, p.z, 1.0f }, { float(slice) / float(slices), float(stack) / float(stacks) }, p, 0.0f });
+		}
+	}
+	auto addTriangle = [&mesh](uint32_t a, uint32_t b, uint32_t c) {
+		const Vector3 pa = GetPosition(mesh, a);
+		const Vector3 pb = GetPosition(mesh, b);
+		const Vector3 pc = GetPosition(mesh, c);
+		const Vector3 ab{ pb.x - pa.x, pb.y - pa.y, pb.z - pa.z };
+		const Vector3 ac{ pc.x - pa.x, pc.y - pa.y, pc.z - pa.z };
+		const Vector3 normal{ ab.y * ac.z - ab.z * ac.y, ab.z * ac.x - ab.x * ac.z, ab.x * ac.y - ab.y * ac.x };
+		if (Dot(normal, normal) == 0.0f) {
+			return; // 極の潰れた三角形
+		}
+		if (Dot(normal, { pa.x + pb.x + pc.x, pa.y + pb.y + pc.y, pa.z + pb.z + pc.z }) < 0.0f) {
+			std::swap(b, c);
+		}
+		mesh.indices.insert(mesh.indices.end(), { a, b, c });
+	};
+	for (uint32_t stack = 0; stack < stacks; ++stack) {
+		for (uint32_t slice = 0; slice < slices; ++slice) {
+			const uint32_t i = stack * (slices + 1) + slice;
+			addTriangle(i, i + 1, i + slices + 1);
+			addTriangle(i + 1, i + slices + 2, i + slices + 1);
+		}
+	}
+	return mesh;
+}
+
+/// <summary>
+/// メッシュレットが上限を守り、順に並んですべての三角形をちょうど1回ずつ含み、球がその頂点を囲んでいるか
+/// </summary>
+bool IsValidMeshletSplit(const MeshData& mesh, uint32_t maxVertices, uint32_t maxTriangles)
+{
+	if (mesh.indices.empty()) {
+		return mesh.meshlets.empty();
+	}
+	std::vector<uint32_t> lastMeshlet(mesh.vertices.size(), UINT32_MAX);
+	uint32_t nextOffset = 0;
+	for (uint32_t m = 0; m < mesh.meshlets.size(); ++m) {
+		const Meshlet& meshlet = mesh.meshlets[m];
+		// 前のメッシュレットのすぐ後ろから始まるので、三角形の重なりも抜けもない
+		if (meshlet.indexOffset != nextOffset || meshlet.indexCount == 0 || meshlet.indexCount % 3 != 0 || meshlet.indexCount / 3 > maxTriangles) {
+			return false;
+		}
+		uint32_t vertexCount = 0;
+		for (uint32_t i = meshlet.indexOffset; i < meshlet.indexOffset + meshlet.indexCount; ++i) {
+			const uint32_t index = mesh.indices[i];
+			if (lastMeshlet[index] != m) {
+				lastMeshlet[index] = m;
+				++vertexCount;
+			}
+			const Vector3 p = GetPosition(mesh, index);
+			const Vector3 d{ p.x - meshlet.center.x, p.y - meshlet.center.y, p.z - meshlet.center.z };
+			if (sqrtf(Dot(d, d)) > meshlet.radius * 1.0001f + 1.0e-6f) {
+				return false;
+			}
+		}
+		if (vertexCount != meshlet.vertexCount || vertexCount > maxVertices) {
+			return false;
+		}
+		nextOffset = meshlet.indexOffset + meshlet.indexCount;
+	}
+	return nextOffset == mesh.indices.size();
+}
+
+/// <summary>
+/// カリングの結果が、表を向いていて視錐台に頂点がある三角形をすべて含むか。
+/// 範囲が重ならず昇順で、隣り合う範囲がまとめられていて、捨てた数と合わせて全体の数になることも確かめる
+/// </summary>
+bool IsConservativeCull(const MeshData& mesh, const Frustum& frustum, const Vector3& cameraPosition,
+	const std::vector<IndexRange>& drawRanges, const MeshletCullStatistics& statistics)
+{
+	std::vector<uint8_t> isDrawn(mesh.indices.size() / 3, 0);
+	uint32_t drawnTriangles = 0;
+	uint32_t previousEnd = 0;
+	for (size_t r = 0; r < drawRanges.size(); ++r) {
+		const IndexRange& range = drawRanges[r];
+		if ((r > 0 && range.indexOffset <= previousEnd) || range.indexOffset + range.indexCount > mesh.indices.size()) {
+			return false;
+		}
+		for (uint32_t i = range.indexOffset; i < range.indexOffset + range.indexCount; i += 3) {
+			isDrawn[i / 3] = 1;
+		}
+		drawnTriangles += range.indexCount / 3;
+		previousEnd = range.indexOffset + range.indexCount;
+	}
+	if (drawnTriangles + statistics.frustumCulledTriangles + statistics.backfaceCulledTriangles != statistics.totalTriangles) {
+		return false;
+	}
+	for (size_t t = 0; t < isDrawn.size(); ++t) {
+		if (!isDrawn[t] && IsFrontFacing(mesh, t, cameraPosition) && HasVertexInFrustum(mesh, t, frustum)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/// <summary>
+/// モデルを囲む球を頂点から求める
+/// </summary>
+void ComputeModelSphere(const ModelData& model, Vector3& center, float& radius)
+{
+	Vector3 minimum{ FLT_MAX, FLT_MAX, FLT_MAX };
+	Vector3 maximum{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (const MeshData& mesh : model.meshes) {
+		for (const VertexData& vertex : mesh.vertices) {
+			minimum = { std::min(minimum.x, vertex.position.x), std::min(minimum.y, vertex.position.y), std::min(minimum.z, vertex.position.z) };
+			maximum = { std::max(maximum.x, vertex.position.x), std::max(maximum.y, vertex.position.y), std::max(maximum.z, vertex.position.z) };
+		}
+	}
+	center = { (minimum.x + maximum.x) * 0.5f, (minimum.y + maximum.y) * 0.5f, (minimum.z + maximum.z) * 0.5f };
+	const Vector3 half{ maximum.x - center.x, maximum.y - center.y, maximum.z - center.z };
+	radius = std::max(sqrtf(Dot(half, half)), 1.0e-3f);
+}
+
+/// <summary>
+/// Resources のモデルと球を読み込み、main.cpp の LoadModel と同じくメッシュレットに分ける前に最適化しておく
+/// </summary>
+std::vector<std::pair<std::string, ModelData>> LoadTestModels()
+{
+	std::vector<std::pair<std::string, ModelData>> models;
+	for (const auto& entry : std::filesystem::directory_iterator(RESOURCES_DIRECTORY)) {
+		if (entry.path().extension() == ".obj") {
+			const std::string filename = entry.path().filename().string();
+			models.push_back({ filename, LoadObjFile(RESOURCES_DIRECTORY, filename) });
+		}
+	}
+	ModelData sphere;
+	sphere.meshes.push_back(MakeSphere(64, 32));
+	models.push_back({ "sphere", sphere });
+	for (auto& [name, model] : models) {
+		for (MeshData& mesh : model.meshes) {
+			OptimizeMesh(mesh);
+		}
+	}
+	return models;
+}
+
+void TestMeshletLimits(const std::vector<std::pair<std::string, ModelData>>& models)
+{
+	// 既定の上限と、分け目がたくさんできる小さな上限の両方で確かめる
+	const uint32_t kLimits[][2] = { { kMeshletMaxVertices, kMeshletMaxTriangles }, { 8, 4 }, { 3, 124 }, { 64, 1 } };
+	bool allValid = true;
+	for (const auto& [name, model] : models) {
+		for (MeshData mesh : model.meshes) {
+			for (const auto& limit : kLimits) {
+				BuildMeshlets(mesh, limit[0], limit[1]);
+				allValid = IsValidMeshletSplit(mesh, limit[0], limit[1]) && allValid;
+			}
+		}
+	}
+	Check(allValid, "meshlets stay within the vertex and triangle limits and cover every triangle exactly once");
+
+	MeshData empty;
+	BuildMeshlets(empty);
+	Check(empty.meshlets.empty(), "an empty mesh has no meshlets");
+}
+
+/// <summary>
+/// モデルの周りを回りながら中心を見る視点と、近づいて一部だけを見る視点、モデルの内側の視点でカリングする
+/// </summary>
+void TestMeshletCulling(const std::vector<std::pair<std::string, ModelData>>& models)
+{
+	const int32_t kViewCount = 8;
+	const int32_t kIterations = 1000;
+	const Matrix4x4 projectionMatrix = MakePerspectiveFovMatrix(0.45f, 16.0f / 9.0f, 0.1f, 100.0f);
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	bool allConservative = true;
+	uint32_t sphereBackfaceCulled = 0;
+	uint32_t sphereTotal = 0;
+	for (auto [name, model] : models) {
+		size_t meshletCount = 0;
+		for (MeshData& mesh : model.meshes) {
+			BuildMeshlets(mesh);
+			meshletCount += mesh.meshlets.size();
+		}
+		Vector3 center{};
+		float radius = 0.0f;
+		ComputeModelSphere(model, center, radius);
+
+		for (int32_t view = 0; view < kViewCount; ++view) {
+			const float angle = 6.2831853f * float(view) / float(kViewCount);
+			const float distance = radius * ((view % 2 == 0) ? 4.0f : 1.5f);
+			Transform camera{ { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f }, { center.x + sinf(angle) * distance, center.y, center.z + cosf(angle) * distance } };
+			camera.rotate.y = atan2f(center.x - camera.translate.x, center.z - camera.translate.z);
+			const Frustum frustum = MakeFrustumFromMatrix(Multiply(MakeViewMatrix(camera), projectionMatrix));
+
+			std::vector<IndexRange> drawRanges;
+			MeshletCullStatistics statistics{};
+			const double nanoseconds = MeasureNanoseconds(kIterations, 1, [&] {
+				drawRanges.clear();
+				statistics = {};
+				for (const MeshData& mesh : model.meshes) {
+					CullMeshlets(mesh, frustum, camera.translate, drawRanges, statistics);
+				}
+			});
+			const uint32_t culled = statistics.frustumCulledTriangles + statistics.backfaceCulledTriangles;
+			std::printf("%s view %d: %zu meshlets, rejected %u/%u triangles (%.1f%%: frustum %u, backface %u), %zu draws, %.2f us/cull\n",
+				name.c_str(), view, meshletCount, culled, statistics.totalTriangles,
+				statistics.totalTriangles == 0 ? 0.0 : 100.0 * culled / statistics.totalTriangles,
+				statistics.frustumCulledTriangles, statistics.backfaceCulledTriangles, drawRanges.size(), nanoseconds / 1.0e3);
+
+			// メッシュごとに結果を確かめる
+			for (const MeshData& mesh : model.meshes) {
+				drawRanges.clear();
+				statistics = {};
+				CullMeshlets(mesh, frustum, camera.translate, drawRanges, statistics);
+				allConservative = IsConservativeCull(mesh, frustum, camera.translate, drawRanges, statistics) && allConservative;
+			}
+		}
+
+		// 背面カリングだけを、モデルの内側・表面の近く・遠くのいろいろな位置から確かめる
+		const Frustum everything = MakeInfiniteFrustum();
+		for (int32_t i = 0; i < 300; ++i) {
+			const float scale = radius * ((i % 3 == 0) ? 0.5f : (i % 3 == 1) ? 1.2f : 20.0f);
+			const Vector3 cameraPosition{ center.x + unit(random) * scale, center.y + unit(random) * scale, center.z + unit(random) * scale };
+			for (const MeshData& mesh : model.meshes) {
+				std::vector<IndexRange> drawRanges;
+				MeshletCullStatistics statistics{};
+				CullMeshlets(mesh, everything, cameraPosition, drawRanges, statistics);
+				allConservative = allConservative && statistics.frustumCulledTriangles == 0 &&
+					IsConservativeCull(mesh, everything, cameraPosition, drawRanges, statistics);
+				if (name == "sphere" && i % 3 == 2) {
+					sphereBackfaceCulled += statistics.backfaceCulledTriangles;
+					sphereTotal += statistics.totalTriangles;
+				}
+			}
+		}
+	}
+	Check(allConservative, "meshlet culling never rejects a front-facing triangle inside the frustum");
+	// 遠くから見た球はほぼ半分が裏を向いているが、メッシュレット単位なので、向きのばらつきが大きい塊や輪郭にかかる塊の分だけ減る
+	std::printf("sphere from far away: backface culled %.1f%% of triangles\n", sphereTotal == 0 ? 0.0 : 100.0 * sphereBackfaceCulled / sphereTotal);
+	Check(sphereBackfaceCulled * 10 >= sphereTotal, "cone culling rejects at least a tenth of a sphere seen from far away");
+}
+
+} // namespace
+
+int main()
+{
+	const std::vector<std::pair<std::string, ModelData>> models = LoadTestModels();
+	TestMeshletLimits(models);
+	TestMeshletCulling(models);
+	return GetTestExitCode();
+}
@@ -0,0 +1,424 @@
+// ObjLoader.h のテストとベンチマーク（Linux でも動く。ファイルは mmap で読む）。
+// Resources の OBJ を、istringstream で1行ずつ読む素朴な読み込みと比べて頂点・インデックスの数と中身が同じになること、
+// 並列の解析がチャンクの数によらず1スレッドの解析とバイト単位で同じになること、壊れたインデックスの面と三角形にならない面を捨てることを確かめ、
+// 速度を表示する
+#include "ObjLoader.h"
+#include "TestUtility.h"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <tuple>
+
+namespace {
+
+/// <summary>
+/// 比べるための素朴な OBJ の読み込み（istringstream と std::map を使う、速さを考えないもの）。
+/// メッシュの区切り・重複の除き方・扇状の三角形分割・左手系への変換は LoadObjFile と同じ決まりにする
+/// </summary>
+ModelData LoadObjFileReference(const std::filesystem::path& path, bool flipY)
+{
+	std::ifstream file(path);
+	std::vector<Vector4> positions;
+	std::vector<Vector2> texcoords;
+	std::vector<Vector3> normals;
+	ModelData model;
+	model.meshes.push_back({});
+	model.meshes.back().name = "Default";
+	std::map<std::tuple<int32_t, int32_t, int32_t>, uint32_t> vertexNumbers;
+	auto resolve = [](int32_t index, size_t count) { return (index < 0) ? int32_t(count) + index : index - 1; };
+
+	for (std::string line; std::getline(file, line);) {
+		std::istringstream stream(line);
+		std::string identifier;
+		stream >> identifier;
+		if (identifier == "v") {
+			Vector4 position{ 0.0f, 0.0f, 0.0f, 1.0f };
+			stream >> position.x >> position.y >> position.z;
+			positions.push_back(position);
+		} else if (identifier == "vt") {
+			Vector2 texcoord{};
+			stream >> texcoord.x >> texcoord.y;
+			texcoord.y = 1.0f - texcoord.y;
+			texcoords.push_back(texcoord);
+		} else if (identifier == "vn") {
+			Vector3 normal{};
+			stream >> normal.x >> normal.y >> normal.z;
+			normals.push_back(normal);
+		} else if (identifier == "o" || identifier == "g") {
+			std::string name;
+			stream >> name;
+			// 面の無いメッシュは名前だけ差し替える
+			if (model.meshes.back().vertices.empty()) {
+				model.meshes.back().name = name;
+			} else {
+				model.meshes.push_back({});
+				model.meshes.back().name = name;
+				vertexNumbers.clear();
+			}
+		} else if (identifier == "f") {
+			MeshData& mesh = model.meshes.back();
+			std::vector<std::string> definitions;
+			for (std::string definition; stream >> definition;) {
+				definitions.push_back(definition);
+			}
+			// 三角形にならない面は読まない
+			if (definitions.size() < 3) {
+				continue;
+			}
+			std::vector<uint32_t> corners;
+			for (const std::string& definition : definitions) {
+				int32_t elements[3] = { 0, 0, 0 };
+				std::istringstream elementStream(definition);
+				std::string element;
+				for (int32_t i = 0; i < 3 && std::getline(elementStream, element, '/'); ++i) {
+					elements[i] = element.empty() ? 0 : std::stoi(element);
+				}
+				const std::tuple<int32_t, int32_t, int32_t> key{ resolve(elements[0], positions.size()),
+					elements[1] ? resolve(elements[1], texcoords.size()) : -1, elements[2] ? resolve(elements[2], normals.size()) : -1 };
+				auto [found, inserted] = vertexNumbers.emplace(key, uint32_t(mesh.vertices.size()));
+				if (inserted) {
+					Vector4 position = positions[std::get<0>(key)];
+					const Vector2 texcoord = (std::get<1>(key) >= 0) ? texcoords[std::get<1>(key)] : Vector2{ 0.0f, 0.0f };
+					Vector3 normal = (std::get<2>(key) >= 0) ? normals[std::get<2>(key)] : Vector3{ 0.0f, 0.0f, 0.0f };
+					if (flipY) {
+						// x を反転してから y 軸まわりに π 回す
+						position.x *= -1.0f;
+						normal.x *= -1.0f;
+						const float x = position.x;
+						const float z = position.z;
+						position.x = x * cosf(3.141592f) - z * sinf(3.141592f);
+						position.z = x * sinf(3.141592f) + z * cosf(3.141592f);
+					}
+					mesh.vertices.push_back({ position, texcoord, normal, 0.0f });
+				}
+				corners.push_back(found->second);
+			}
+			for (size_t i = 2; i < corners.size(); ++i) {
+				mesh.indices.insert(mesh.indices.end(), { corners[i], corners[i - 1], corners[0] });
+			}
+		}
+	}
+	std::erase_if(model.meshes, [](const MeshData& mesh) { return mesh.vertices.empty(); });
+	return model;
+}
+
+bool IsNear(float a, float b)
+{
+	return std::fabs(a - b) <= 1.0e-5f * (std::max)(1.0f, std::fabs(b));
+}
+
+/// <summary>
+/// 素朴な読み込みと、メッシュの名前・インデックス・頂点（浮動小数点の読み方の違いだけ許す）が同じか
+/// </summary>
+bool IsSameAsReference(const ModelData& model, const ModelData& reference)
+{
+	bool isSame = model.meshes.size() == reference.meshes.size();
+	for (size_t i = 0; isSame && i < model.meshes.size(); ++i) {
+		const MeshData& mesh = model.meshes[i];
+		const MeshData& referenceMesh = reference.meshes[i];
+		isSame = mesh.name == referenceMesh.name && mesh.indices == referenceMesh.indices && mesh.vertices.size() == referenceMesh.vertices.size();
+		for (size_t v = 0; isSame && v < mesh.vertices.size(); ++v) {
+			const VertexData& a = mesh.vertices[v];
+			const VertexData& b = referenceMesh.vertices[v];
+			isSame = IsNear(a.position.x, b.position.x) && IsNear(a.position.y, b.position.y) && IsNear(a.position.z, b.position.z) &&
+				a.position.w == b.position.w && IsNear(a.texcoord.x, b.texcoord.x) && IsNear(a.texcoord.y, b.texcoord.y) &&
+				IsNear(a.normal.x, b.normal.x) && IsNear(a.normal.y, b.normal.y) && IsNear(a.normal.z, b.normal.z);
+		}
+	}
+	return isSame;
+}
+
+/// <summary>
+/// 名前・インデックス・頂点のバイト列まで完全に同じか（並列の解析と1スレッドの解析を比べる）
+/// </summary>
+bool IsIdentical(const ModelData& model, const ModelData& reference)
+{
+	bool isSame = model.meshes.size() == reference.meshes.size();
+	for (size_t i = 0; isSame && i < model.meshes.size(); ++i) {
+		const MeshData& mesh = model.meshes[i];
+		const MeshData& referenceMesh = reference.meshes[i];
+		isSame = mesh.name == referenceMesh.name && mesh.indices == referenceMesh.indices &&
+			mesh.vertices.size() == referenceMesh.vertices.size() &&
+			std::memcmp(mesh.vertices.data(), referenceMesh.vertices.data(), sizeof(VertexData) * mesh.vertices.size()) == 0;
+	}
+	return isSame;
+}
+
+size_t CountVertices(const ModelData& model)
+{
+	size_t count = 0;
+	for (const MeshData& mesh : model.meshes) {
+		count += mesh.vertices.size();
+	}
+	return count;
+}
+
+size_t CountIndices(const ModelData& model)
+{
+	size_t count = 0;
+	for (const MeshData& mesh : model.meshes) {
+		count += mesh.indices.size();
+	}
+	return count;
+}
+
+/// <summary>
+/// 格子状の合成 OBJ テキストを作る。三角形の数は gridSize * gridSize * 2 で、256 行ごとにメッシュを区切る
+/// </summary>
+std::string MakeSyntheticObjText(int32_t gridSize)
+{
+	std::string text;
+	char line[256];
+	for (int32_t y = 0; y <= gridSize; ++y) {
+		for (int32_t x = 0; x <= gridSize; ++x) {
+			const float u = float(x) / float(gridSize);
+			const float v = float(y) / float(gridSize);
+			std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn 0.0 1.0 0.0\n", u * 10.0f, sinf(u * 20.0f) * cosf(v * 20.0f), v * 10.0f, u, v);
+			text += line;
+		}
+	}
+	for (int32_t y = 0; y < gridSize; ++y) {
+		if (y % 256 == 0) {
+			std::snprintf(line, sizeof(line), "o Part%d\n", y / 256);
+			text += line;
+		}
+		for (int32_t x = 0; x < gridSize; ++x) {
+			const int32_t a = y * (gridSize + 1) + x + 1;
+			const int32_t b = a + 1;
+			const int32_t c = a + gridSize + 1;
+			const int32_t d = c + 1;
+			// 後ろ半分は相対指定（負のインデックス）で書き、チャンクをまたぐ補正も確かめる
+			if (y < gridSize / 2) {
+				std::snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\nf %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, d, d, d, a, a, a, d, d, d, c, c, c);
+			} else {
+				const int32_t count = (gridSize + 1) * (gridSize + 1) + 1;
+				std::snprintf(line, sizeof(line), "f %d/%d %d/%d %d/%d\nf %d/%d %d/%d %d/%d\n", a - count, a - count, b - count, b - count, d - count, d - count,
+					a - count, a - count, d - count, d - count, c - count, c - count);
+			}
+			text += line;
+		}
+	}
+	return text;
+}
+
+/// <summary>
+/// Resources の OBJ を読み、素朴な読み込みと同じ結果になること。既知のファイルは数も確かめる
+/// </summary>
+void TestResourceFiles()
+{
+	const int32_t kIterations = 20;
+	size_t fileCount = 0;
+	bool allSame = true;
+	for (const auto& entry : std::filesystem::directory_iterator(RESOURCES_DIRECTORY)) {
+		if (entry.path().extension() != ".obj") {
+			continue;
+		}
+		const std::string filename = entry.path().filename().string();
+		const bool flipY = (filename != "plane.obj");
+		ModelData model;
+		const double nanoseconds = MeasureNanoseconds(kIterations, 1, [&] { model = LoadObjFile(RESOURCES_DIRECTORY, filename); });
+		const ModelData reference = LoadObjFileReference(entry.path(), flipY);
+		const bool isSame = IsSameAsReference(model, reference);
+		allSame = allSame && isSame;
+		++fileCount;
+		std::printf("%s: %zu meshes, %zu vertices, %zu indices, %.3f ms/load, %.1f MB/s%s\n", filename.c_str(), model.meshes.size(),
+			CountVertices(model), CountIndices(model), nanoseconds / 1.0e6, double(entry.file_size()) / (1024.0 * 1024.0) / (nanoseconds / 1.0e9),
+			isSame ? "" : " (MISMATCH)");
+	}
+	Check(fileCount >= 5, "Resources contains the OBJ fixtures");
+	Check(allSame, "every Resources OBJ matches the reference loader");
+
+	// plane.obj は四角形1枚（頂点 4 個・三角形 2 枚）
+	const ModelData plane = LoadObjFile(RESOURCES_DIRECTORY, "plane.obj");
+	Check(plane.meshes.size() == 1 && plane.meshes[0].name == "Plane" && plane.meshes[0].vertices.size() == 4 && plane.meshes[0].indices.size() == 6,
+		"plane.obj is one mesh with 4 vertices and 6 indices");
+	// multiMesh.obj は四角形と立方体（面ごとに法線が違うので頂点は 4 × 6 個・三角形 12 枚）
+	const ModelData multiMesh = LoadObjFile(RESOURCES_DIRECTORY, "multiMesh.obj");
+	Check(multiMesh.meshes.size() == 2 && multiMesh.meshes[0].name == "Plane" && multiMesh.meshes[1].name == "Cube" &&
+		multiMesh.meshes[0].indices.size() == 6 && multiMesh.meshes[1].indices.size() == 36,
+		"multiMesh.obj splits into Plane and Cube at the o lines");
+	// 三角形だけの teapot.obj は、面の数 × 3 のインデックスになる
+	const ModelData teapot = LoadObjFile(RESOURCES_DIRECTORY, "teapot.obj");
+	Check(CountIndices(teapot) == 992 * 3, "teapot.obj has 3 indices per face");
+}
+
+/// <summary>
+/// 並列の解析が、チャンクの数・スレッドの数によらず1スレッドの解析と同じになること
+/// </summary>
+void TestParallelParsing()
+{
+	WorkerPool workerPool(4);
+	// Resources の OBJ（小さいので、行の数より多いチャンクにも分ける）
+	bool resourcesSame = true;
+	for (const auto& entry : std::filesystem::directory_iterator(RESOURCES_DIRECTORY)) {
+		if (entry.path().extension() != ".obj") {
+			continue;
+		}
+		MappedFile mappedFile = MapFileReadOnly(entry.path().string());
+		const char* begin = mappedFile.data;
+		const char* end = mappedFile.data + mappedFile.size;
+		const ModelData reference = ParseObjText(begin, end, true);
+		for (uint32_t chunkCount : { 1u, 2u, 3u, 7u, 64u, 100000u }) {
+			resourcesSame = resourcesSame && IsIdentical(ParseObjTextParallel(begin, end, true, workerPool, chunkCount), reference);
+		}
+		UnmapFile(&mappedFile);
+	}
+	Check(resourcesSame, "parallel parses of Resources OBJ files are identical to the serial parse");
+
+	// 合成した大きな OBJ（相対指定のインデックスとメッシュの区切りがチャンクをまたぐ）
+	const int32_t kGridSize = 512;
+	const std::string text = MakeSyntheticObjText(kGridSize);
+	const double megaBytes = double(text.size()) / (1024.0 * 1024.0);
+	ModelData reference;
+	const double serialNanoseconds = MeasureNanoseconds(1, 1, [&] { reference = ParseObjText(text.data(), text.data() + text.size(), true); });
+	std::printf("synthetic OBJ: %.1f MB, %d triangles, %zu meshes, serial %.1f MB/s\n", megaBytes, kGridSize * kGridSize * 2, reference.meshes.size(),
+		megaBytes / (serialNanoseconds / 1.0e9));
+	Check(reference.meshes.size() == size_t(kGridSize / 256) && CountIndices(reference) == size_t(kGridSize) * kGridSize * 6,
+		"synthetic OBJ has one mesh per o line and 6 indices per quad");
+	bool syntheticSame = true;
+	for (uint32_t threadCount : { 1u, 2u, 4u }) {
+		WorkerPool pool(threadCount);
+		for (uint32_t chunkCount : { threadCount, threadCount * 4 }) {
+			ModelData model;
+			const double nanoseconds = MeasureNanoseconds(1, 1, [&] { model = ParseObjTextParallel(text.data(), text.data() + text.size(), true, pool, chunkCount); });
+			const bool isSame = IsIdentical(model, reference);
+			syntheticSame = syntheticSame && isSame;
+			std::printf("  %u threads, %3u chunks: %.1f MB/s, x%.2f of serial%s\n", threadCount, chunkCount, megaBytes / (nanoseconds / 1.0e9),
+				serialNanoseconds / nanoseconds, isSame ? "" : " (MISMATCH)");
+		}
+	}
+	Check(syntheticSame, "parallel parses of a synthetic OBJ are identical to the serial parse");
+	std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+}
+
+/// <summary>
+/// 壊れた OBJ。範囲外のインデックス（0・無い要素・先頭より前の相対指定・int32_t に収まらない値）を含む面は捨てて、
+/// 正しい面だけが残ること。並列に解析しても同じになること
+/// </summary>
+void TestMalformedIndices()
+{
+	auto parse = [](const std::string& text) { return ParseObjText(text.data(), text.data() + text.size(), false); };
+	const std::string header = "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvn 0 0 1\n";
+	const std::string validFace = "f 1/1/1 2/1/1 3/1/1\n";
+
+	const char* const malformedFaces[] = {
+		"f 0 1 2\n",                       // 0 は使えない
+		"f 1 2 4\n",                       // 位置は 3 個しかない
+		"f -4 -2 -1\n",                    // 先頭より前を指す相対指定
+		"f 1/2 2/1 3/1\n",                 // UV は 1 個しかない
+		"f 1//2 2//1 3//1\n",              // 法線は 1 個しかない
+		"f 99999999999999999999 1 2\n",    // int32_t に収まらない
+		"f -99999999999999999999 1 2\n",
+		"f 2147483647 1 2\n",
+	};
+	bool allSkipped = true;
+	for (const char* malformedFace : malformedFaces) {
+		// 壊れた面だけのときはメッシュが残らない
+		const ModelData onlyMalformed = parse(header + malformedFace);
+		// 正しい面の前後にあるときは正しい面だけが残る
+		const ModelData mixed = parse(header + validFace + malformedFace + validFace);
+		const bool skipped = onlyMalformed.meshes.empty() && mixed.meshes.size() == 1 && mixed.meshes[0].vertices.size() == 3 &&
+			mixed.meshes[0].indices == std::vector<uint32_t>{ 2, 1, 0, 2, 1, 0 };
+		if (!skipped) {
+			std::printf("  not skipped: %s", malformedFace);
+		}
+		allSkipped = allSkipped && skipped;
+	}
+	Check(allSkipped, "faces with out-of-range or overflowing indices are dropped");
+
+	// 正しい相対指定と、最後の要素を指すインデックスは使える
+	const ModelData relative = parse(header + "f -3/-1/-1 -2/-1/-1 -1/-1/-1\nf 3 2 1\n");
+	Check(relative.meshes.size() == 1 && relative.meshes[0].indices.size() == 6, "in-range relative and last-element indices are kept");
+
+	// 壊れた面を多く含むテキストでも、並列の解析が1スレッドの解析と同じになる
+	std::string text = header;
+	for (int32_t i = 0; i < 2000; ++i) {
+		text += (i % 3 == 0) ? malformedFaces[i % std::size(malformedFaces)] : validFace;
+		if (i % 500 == 0) {
+			text += "v 0 0 1\no Part\n";
+		}
+	}
+	WorkerPool workerPool(4);
+	const ModelData reference = parse(text);
+	bool isSame = true;
+	for (uint32_t chunkCount : { 2u, 5u, 64u }) {
+		isSame = isSame && IsIdentical(ParseObjTextParallel(text.data(), text.data() + text.size(), false, workerPool, chunkCount), reference);
+	}
+	Check(isSame && !reference.meshes.empty(), "parallel parses drop the same malformed faces as the serial parse");
+}
+
+/// <summary>
+/// 頂点が 1・2 個の面は三角形にならないので捨てて、三角形の無いメッシュは作らないこと
+/// （空のインデックスのメッシュを GPU に送って描かないように）
+/// </summary>
+void TestDegenerateFaces()
+{
+	auto parse = [](const std::string& text) { return ParseObjText(text.data(), text.data() + text.size(), false); };
+	const std::string header = "v 0 0 0\nv 1 0 0\nv 0 1 0\nv 1 1 0\n";
+
+	const ModelData onlyDegenerate = parse(header + "f 1\nf 1 2\n");
+	Check(onlyDegenerate.meshes.empty(), "faces with 1 or 2 corners make no mesh");
+
+	// 三角形にならない面だけのメッシュは作らず、名前は次の区切りのものになる
+	const ModelData split = parse(header + "o Line\nf 1 2\nf 3\no Quad\nf 1 2 4 3\no Point\nf 4\n");
+	Check(split.meshes.size() == 1 && split.meshes[0].name == "Quad" && split.meshes[0].indices.size() == 6 && split.meshes[0].vertices.size() == 4,
+		"meshes with only degenerate faces are dropped");
+
+	// 三角形の面に混ざった線と点は、頂点も作らない
+	const ModelData mixed = parse(header + "f 1 2 3\nf 4 1\nf 4\n");
+	Check(mixed.meshes.size() == 1 && mixed.meshes[0].indices.size() == 3 && mixed.meshes[0].vertices.size() == 3,
+		"degenerate faces add no vertices or indices");
+
+	// 並列に解析しても同じになる（区切りと三角形にならない面がチャンクをまたぐ）
+	std::string text = header;
+	for (int32_t i = 0; i < 3000; ++i) {
+		text += (i % 7 == 0) ? "o Part\n" : "";
+		text += (i % 3 == 0) ? "f 1 2 3\n" : (i % 3 == 1) ? "f 2 4\n" : "f 3\n";
+	}
+	WorkerPool workerPool(4);
+	const ModelData reference = parse(text);
+	bool isSame = true;
+	for (uint32_t chunkCount : { 2u, 5u, 64u }) {
+		isSame = isSame && IsIdentical(ParseObjTextParallel(text.data(), text.data() + text.size(), false, workerPool, chunkCount), reference);
+	}
+	bool noEmptyMesh = !reference.meshes.empty();
+	for (const MeshData& mesh : reference.meshes) {
+		noEmptyMesh = noEmptyMesh && !mesh.indices.empty() && mesh.indices.size() % 3 == 0;
+	}
+	Check(isSame && noEmptyMesh, "parallel parses drop the same degenerate faces and leave no empty mesh");
+}
+
+/// <summary>
+/// 開けないファイルと空のファイル
+/// </summary>
+void TestMappedFile()
+{
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "ObjLoaderTest";
+	std::filesystem::create_directories(directory);
+	MappedFile missing = MapFileReadOnly((directory / "missing.obj").string());
+	Check(!IsFileMapped(missing), "a missing file is not mapped");
+	std::ofstream((directory / "empty.obj").string()).close();
+	MappedFile empty = MapFileReadOnly((directory / "empty.obj").string());
+	Check(IsFileMapped(empty) && empty.data == nullptr && empty.size == 0, "an empty file opens with no data");
+	UnmapFile(&empty);
+	Check(!IsFileMapped(empty), "UnmapFile closes the file");
+	const ModelData emptyModel = ParseObjText(nullptr, nullptr, true);
+	Check(emptyModel.meshes.empty(), "an empty OBJ has no meshes");
+	std::error_code removeError;
+	std::filesystem::remove_all(directory, removeError);
+}
+
+} // namespace
+
+int main()
+{
+	TestResourceFiles();
+	TestParallelParsing();
+	TestMalformedIndices();
+	TestDegenerateFaces();
+	TestMappedFile();
+	return GetTestExitCode();
+}
@@ -0,0 +1,226 @@
+// SceneGraph.h のテストとベンチマーク（Linux でも動く）。
+// ノードを動かしたときに、そのノードと子孫だけが計算し直され、結果が全ノードを計算し直したものと一致することを確かめ、
+// 10万ノードの木で毎フレーム約1%のノードを動かしたときの更新時間を、全ノードを計算し直す場合と比べて表示する
+#include "SceneGraph.h"
+#include "TestUtility.h"
+#include <random>
+
+namespace {
+
+// 10万ノードの木で、段を重ねて掛けた行列どうしを比べるときの許容誤差
+const float kTolerance = 1.0e-5f;
+
+Transform MakeRandomTransform(std::mt19937& random)
+{
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	return Transform{
+		{ 1.0f + 0.05f * unit(random), 1.0f + 0.05f * unit(random), 1.0f + 0.05f * unit(random) },
+		{ 0.5f * unit(random), 0.5f * unit(random), 0.5f * unit(random) },
+		{ unit(random), unit(random), unit(random) } };
+}
+
+/// <summary>
+/// ノードを nodeCount 個並べた木を作る。branching が 0 なら親を前のノードからでたらめに選ぶ
+/// </summary>
+SceneGraph MakeScene(uint32_t nodeCount, uint32_t branching, std::mt19937& random)
+{
+	SceneGraph scene;
+	for (uint32_t i = 0; i < nodeCount; ++i) {
+		int32_t parent = kSceneNoParent;
+		if (i > 0) {
+			parent = (branching > 0) ? int32_t((i - 1) / branching) : int32_t(std::uniform_int_distribution<uint32_t>(0, i - 1)(random));
+		}
+		AddSceneNode(scene, parent, MakeRandomTransform(random));
+	}
+	return scene;
+}
+
+/// <summary>
+/// 親をたどってローカル行列を掛け直した、全ノードのワールド行列（SIMD を使わない比較用）
+/// </summary>
+std::vector<Matrix4x4> ComputeReferenceWorldMatrices(const SceneGraph& scene)
+{
+	std::vector<Matrix4x4> worlds(GetSceneNodeCount(scene));
+	for (size_t i = 0; i < worlds.size(); ++i) {
+		const Transform local = GetTransform(scene.localTransforms, i);
+		const Matrix4x4 localMatrix = MakeAffineMatrix(local.scale, local.rotate, local.translate);
+		worlds[i] = (scene.parents[i] == kSceneNoParent) ? localMatrix : MultiplyScalar(localMatrix, worlds[scene.parents[i]]);
+	}
+	return worlds;
+}
+
+float MaxWorldDifference(const SceneGraph& scene, const std::vector<Matrix4x4>& expected)
+{
+	float maxError = 0.0f;
+	for (size_t i = 0; i < expected.size(); ++i) {
+		maxError = std::max(maxError, MaxMatrixDifference(scene.worldMatrices[i], expected[i]));
+	}
+	return maxError;
+}
+
+/// <summary>
+/// 動かしたノードとその子孫の印（子の一覧をたどって求める。UpdateSceneGraph の伝え方とは別の方法で数える）
+/// </summary>
+std::vector<uint8_t> CollectSubtrees(const SceneGraph& scene, const std::vector<uint32_t>& roots)
+{
+	const size_t count = GetSceneNodeCount(scene);
+	std::vector<std::vector<uint32_t>> children(count);
+	for (size_t i = 0; i < count; ++i) {
+		if (scene.parents[i] != kSceneNoParent) {
+			children[scene.parents[i]].push_back(uint32_t(i));
+		}
+	}
+	std::vector<uint8_t> inSubtree(count, 0);
+	std::vector<uint32_t> stack(roots.begin(), roots.end());
+	while (!stack.empty()) {
+		const uint32_t node = stack.back();
+		stack.pop_back();
+		if (inSubtree[node]) {
+			continue;
+		}
+		inSubtree[node] = 1;
+		stack.insert(stack.end(), children[node].begin(), children[node].end());
+	}
+	return inSubtree;
+}
+
+/// <summary>
+/// 木の形を変えて、動かしたノードとその子孫だけが計算し直され、結果が全ノードを計算し直したものと一致すること
+/// </summary>
+void TestDirtyPropagation(const char* label, uint32_t branching)
+{
+	const uint32_t kNodeCount = 100000;
+	std::mt19937 random(20250423 + branching);
+	SceneGraph scene = MakeScene(kNodeCount, branching, random);
+
+	bool passed = UpdateSceneGraph(scene) == kNodeCount;
+	passed = passed && MaxWorldDifference(scene, ComputeReferenceWorldMatrices(scene)) <= kTolerance;
+	passed = passed && UpdateSceneGraph(scene) == 0;
+
+	// 同じ Transform を入れ直しても印はつかない
+	for (uint32_t node : { 0u, kNodeCount / 2, kNodeCount - 1 }) {
+		SetSceneNodeTransform(scene, node, GetTransform(scene.localTransforms, node));
+	}
+	passed = passed && UpdateSceneGraph(scene) == 0;
+	char name[128];
+	std::snprintf(name, sizeof(name), "%s: a full update recomputes every node, and unchanged transforms mark nothing", label);
+	Check(passed, name);
+
+	std::uniform_int_distribution<uint32_t> pickNode(0, kNodeCount - 1);
+	bool onlySubtrees = true;
+	bool matchesFull = true;
+	for (int32_t round = 0; round < 8; ++round) {
+		// ルートの近く（子孫が多い）と葉の近くの両方が選ばれるよう、最初の何回かは前の方のノードを混ぜる
+		std::vector<uint32_t> changed;
+		for (uint32_t i = 0; i < 20; ++i) {
+			changed.push_back((round < 2 && i == 0) ? uint32_t(round * 3 + 1) : pickNode(random));
+		}
+		for (uint32_t node : changed) {
+			Transform transform = GetTransform(scene.localTransforms, node);
+			transform.rotate.y += 0.01f;
+			transform.translate.x += 0.1f;
+			SetSceneNodeTransform(scene, node, transform);
+		}
+
+		const std::vector<uint8_t> inSubtree = CollectSubtrees(scene, changed);
+		size_t expectedCount = 0;
+		for (uint8_t flag : inSubtree) {
+			expectedCount += flag;
+		}
+		const std::vector<Matrix4x4> before = scene.worldMatrices;
+		const size_t updatedCount = UpdateSceneGraph(scene);
+
+		// 子孫でないノードの行列は1ビットも変わらず、子孫のノードは変わっている
+		bool untouched = updatedCount == expectedCount;
+		for (size_t i = 0; i < kNodeCount; ++i) {
+			const bool isSame = std::memcmp(&scene.worldMatrices[i], &before[i], sizeof(Matrix4x4)) == 0;
+			untouched = untouched && (inSubtree[i] ? !isSame : isSame);
+		}
+		onlySubtrees = onlySubtrees && untouched;
+
+		const float error = MaxWorldDifference(scene, ComputeReferenceWorldMatrices(scene));
+		matchesFull = matchesFull && error <= kTolerance;
+		std::printf("%s round %d: %zu nodes changed, %zu nodes recomputed (expected %zu), max |dirty - full| %.2e\n",
+			label, round, changed.size(), updatedCount, expectedCount, error);
+	}
+	std::snprintf(name, sizeof(name), "%s: only the changed nodes and their descendants are recomputed", label);
+	Check(onlySubtrees, name);
+	std::snprintf(name, sizeof(name), "%s: the dirty update matches a full recompute", label);
+	Check(matchesFull, name);
+}
+
+/// <summary>
+/// ComputeTransformationMatrices が World と WVP = World * viewProjection を書き出すこと
+/// </summary>
+void TestTransformationMatrices()
+{
+	std::mt19937 random(7);
+	SceneGraph scene = MakeScene(1000, 3, random);
+	UpdateSceneGraph(scene);
+	const Transform camera = MakeRandomTransform(random);
+	const Matrix4x4 viewProjection = MakeAffineMatrix(camera.scale, camera.rotate, camera.translate);
+	std::vector<TransformationMatrix> output(GetSceneNodeCount(scene));
+	ComputeTransformationMatrices(scene, viewProjection, output.data());
+	float maxError = 0.0f;
+	for (size_t i = 0; i < output.size(); ++i) {
+		maxError = std::max(maxError, MaxMatrixDifference(output[i].World, scene.worldMatrices[i]));
+		maxError = std::max(maxError, MaxMatrixDifference(output[i].WVP, MultiplyScalar(scene.worldMatrices[i], viewProjection)));
+	}
+	Check(maxError <= kTolerance, "ComputeTransformationMatrices writes World and World * viewProjection");
+}
+
+/// <summary>
+/// 10万ノードの木で、毎フレーム約1%のノードを動かしたときの更新時間を、全ノードを計算し直す場合と比べて表示する
+/// </summary>
+void BenchmarkSceneGraph()
+{
+	const uint32_t kNodeCount = 100000;
+	// 1ノードあたりの子の数（深さは約8段になる）
+	const uint32_t kBranching = 4;
+	const uint32_t kChangedPerFrame = kNodeCount / 100;
+	const int32_t kFrames = 100;
+
+	std::mt19937 random(20250423);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	SceneGraph scene = MakeScene(kNodeCount, kBranching, random);
+	UpdateSceneGraph(scene);
+
+	std::uniform_int_distribution<uint32_t> pickNode(0, kNodeCount - 1);
+	size_t updatedTotal = 0;
+	double dirtyNanoseconds = 0.0;
+	for (int32_t frame = 0; frame < kFrames; ++frame) {
+		for (uint32_t i = 0; i < kChangedPerFrame; ++i) {
+			const uint32_t node = pickNode(random);
+			Transform transform = GetTransform(scene.localTransforms, node);
+			transform.rotate.y += 0.01f;
+			transform.translate.x += 0.01f * unit(random);
+			SetSceneNodeTransform(scene, node, transform);
+		}
+		dirtyNanoseconds += MeasureNanoseconds(1, 1, [&] { updatedTotal += UpdateSceneGraph(scene); });
+	}
+
+	// 比較用：全ノードに印をつけて毎フレームすべて計算し直す
+	double fullNanoseconds = 0.0;
+	for (int32_t frame = 0; frame < kFrames; ++frame) {
+		std::fill(scene.dirty.begin(), scene.dirty.end(), uint8_t(1));
+		scene.firstDirty = 0;
+		fullNanoseconds += MeasureNanoseconds(1, 1, [&] { UpdateSceneGraph(scene); });
+	}
+
+	const double dirtyMilliseconds = dirtyNanoseconds / kFrames / 1.0e6;
+	const double fullMilliseconds = fullNanoseconds / kFrames / 1.0e6;
+	std::printf("%u nodes, %u changed per frame: dirty update %.3f ms/frame (%zu nodes recomputed), full update %.3f ms/frame (x%.1f)\n",
+		kNodeCount, kChangedPerFrame, dirtyMilliseconds, updatedTotal / kFrames, fullMilliseconds, fullMilliseconds / dirtyMilliseconds);
+	Check(updatedTotal / kFrames < kNodeCount, "moving 1% of the nodes recomputes fewer nodes than a full update");
+}
+
+} // namespace
+
+int main()
+{
+	TestDirtyPropagation("4-ary tree", 4);
+	TestDirtyPropagation("random tree", 0);
+	TestTransformationMatrices();
+	BenchmarkSceneGraph();
+	return GetTestExitCode();
+}
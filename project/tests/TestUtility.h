@@ -0,0 +1,45 @@
+#pragma once
+// tests/ のテストで使う小さな道具（確認の結果の表示と、時間の計測）。
+// テストは Windows に依存しないヘッダーだけを使い、失敗した確認があれば 0 以外の終了コードで終わる
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+
+// 失敗した確認の数（main の最後にこれを見て終了コードを決める）
+inline int gTestFailureCount = 0;
+
+/// <summary>
+/// 確認の結果を1行表示する。失敗したら数える
+/// </summary>
+/// <param name="passed">確認が通ったか</param>
+/// <param name="name">確認の内容</param>
+inline void Check(bool passed, const char* name)
+{
+	std::printf("%s %s\n", passed ? "[PASS]" : "[FAIL]", name);
+	if (!passed) {
+		++gTestFailureCount;
+	}
+}
+
+/// <summary>
+/// テストの終了コード（失敗した確認があれば 1）
+/// </summary>
+inline int GetTestExitCode()
+{
+	std::printf("%s (%d failed)\n", gTestFailureCount == 0 ? "ALL PASSED" : "FAILED", gTestFailureCount);
+	return gTestFailureCount == 0 ? 0 : 1;
+}
+
+/// <summary>
+/// body を iterations 回実行して、count 個あたりのナノ秒を返す
+/// </summary>
+template<typename Body>
+double MeasureNanoseconds(int32_t iterations, size_t count, Body&& body)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int32_t iteration = 0; iteration < iterations; ++iteration) {
+		body();
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / (double(iterations) * double(count));
+}
@@ -0,0 +1,275 @@
+// TextureCooking.h と tools/TextureCooker のテスト（Linux でも動く。DirectXTex の TGA のコーデックとブロック圧縮を使う）。
+// TGA の画像を BC1 / BC3 / BC7 にクックして大きさ・時間・画質を比べ、読み込みがクック済みの DDS を元の画像より新しいときだけ使うことを確かめる。
+// CompressImageParallel（BC7）がスレッドの数によらず DirectX::Compress と同じバイト列を作ることと、その速さも確かめる。
+// 最後に、ビルドした TextureCooker を実際に動かして DDS が書き出されることを確かめる
+#include "TextureCooking.h"
+#include "TestUtility.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const uint32_t kSourceCount = 3;
+// BC7 の quality は 1 スレッドではとても遅いので小さくする
+const size_t kTextureSize = 64;
+const size_t kExpectedMipLevels = 7; // 64 → 1
+
+/// <summary>
+/// なめらかな色の変化と大きな市松模様の TGA を書き出す。alpha なら アルファも変化させる
+/// </summary>
+bool WriteSourceTexture(const std::filesystem::path& path, uint32_t seed, bool alpha)
+{
+	DirectX::ScratchImage image{};
+	if (FAILED(image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, kTextureSize, kTextureSize, 1, 1))) {
+		return false;
+	}
+	const DirectX::Image* pixels = image.GetImage(0, 0, 0);
+	for (size_t y = 0; y < kTextureSize; ++y) {
+		uint8_t* row = pixels->pixels + y * pixels->rowPitch;
+		for (size_t x = 0; x < kTextureSize; ++x) {
+			row[x * 4 + 0] = uint8_t((x * 255) / (kTextureSize - 1));
+			row[x * 4 + 1] = uint8_t((y * 255) / (kTextureSize - 1));
+			row[x * 4 + 2] = (((x >> 5) + (y >> 5) + seed) % 2 == 0) ? 0xC0 : 0x40;
+			row[x * 4 + 3] = alpha ? uint8_t(((x + y) * 255) / (2 * kTextureSize - 2)) : 0xFF;
+		}
+	}
+	return SUCCEEDED(DirectX::SaveToTGAFile(*pixels, DirectX::TGA_FLAGS_NONE, path.wstring().c_str(), &image.GetMetadata()));
+}
+
+/// <summary>
+/// BC1 / BC3 / BC7 のクック。大きさが 1/8・1/4 ほどになり、画質が足りていて、BC7 が BC1 よりきれいなこと。
+/// BC1 のアルファは 1 ビットなので、アルファの変化する最後の画像は BC1 の画質に数えない
+/// </summary>
+void TestCookFormats(const std::vector<std::filesystem::path>& sourcePaths, const std::filesystem::path& directory)
+{
+	// クックしていない元の画像を、実行時と同じように読む（ミップマップも作る）
+	double sourceLoadMilliseconds = 0.0;
+	double sourceMipMilliseconds = 0.0;
+	std::vector<DirectX::ScratchImage> sourceImages(kSourceCount);
+	bool sourcesLoaded = true;
+	for (uint32_t i = 0; i < kSourceCount; ++i) {
+		double decode = 0.0;
+		double mip = 0.0;
+		sourcesLoaded = sourcesLoaded && SUCCEEDED(DecodeTextureWithMips(sourcePaths[i], sourceImages[i], decode, mip));
+		sourceLoadMilliseconds += decode + mip;
+		sourceMipMilliseconds += mip;
+	}
+	std::printf("runtime load of %u source textures %.2f ms (mips %.2f ms)\n", kSourceCount, sourceLoadMilliseconds, sourceMipMilliseconds);
+	Check(sourcesLoaded, "source textures load");
+
+	const TextureCookFormat formats[] = { TextureCookFormat::BC1, TextureCookFormat::BC3, TextureCookFormat::BC7 };
+	float minimumPsnr[std::size(formats)] = {};
+	for (size_t formatIndex = 0; formatIndex < std::size(formats); ++formatIndex) {
+		const TextureCookFormat format = formats[formatIndex];
+		const DXGI_FORMAT expectedFormat = GetCookedTextureFormat(format, true);
+		size_t sourceBytes = 0;
+		size_t cookedBytes = 0;
+		double compressMilliseconds = 0.0;
+		double cookMilliseconds = 0.0;
+		uint32_t errors = 0;
+		minimumPsnr[formatIndex] = FLT_MAX;
+		for (uint32_t i = 0; i < kSourceCount; ++i) {
+			const std::filesystem::path cookedPath = directory / (sourcePaths[i].stem().wstring() + L"_" + GetTextureCookFormatName(format) + L".dds");
+			const TextureCookResult cook = CookTexture(sourcePaths[i], cookedPath, format, TextureCookQuality::Quality, GetWorkerPool());
+			if (FAILED(cook.result)) {
+				++errors;
+				continue;
+			}
+			sourceBytes += cook.sourceBytes;
+			cookedBytes += cook.cookedBytes;
+			compressMilliseconds += cook.compressMilliseconds;
+			cookMilliseconds += cook.decodeMilliseconds + cook.mipMilliseconds + cook.compressMilliseconds + cook.saveMilliseconds;
+
+			// 書き出した DDS は圧縮された形式で、ミップマップがそろっていること
+			DirectX::ScratchImage cooked{};
+			if (FAILED(DirectX::LoadFromDDSFile(cookedPath.wstring().c_str(), DirectX::DDS_FLAGS_NONE, nullptr, cooked))) {
+				++errors;
+				continue;
+			}
+			const DirectX::TexMetadata& metadata = cooked.GetMetadata();
+			errors += (metadata.format != expectedFormat || metadata.mipLevels != kExpectedMipLevels || metadata.width != kTextureSize) ? 1 : 0;
+
+			// 一番上のミップの画質（sRGB は線形に戻して比べる）
+			float mse = 0.0f;
+			if (FAILED(DirectX::ComputeMSE(*sourceImages[i].GetImage(0, 0, 0), *cooked.GetImage(0, 0, 0), mse, nullptr))) {
+				++errors;
+				continue;
+			}
+			const float psnr = (mse > 0.0f) ? 10.0f * log10f(1.0f / mse) : 99.0f;
+			if (format != TextureCookFormat::BC1 || i + 1 < kSourceCount) {
+				minimumPsnr[formatIndex] = std::min(minimumPsnr[formatIndex], psnr);
+			}
+		}
+		// ブロックより小さいミップも1ブロックを使うので、比は 8 倍・4 倍よりわずかに小さくなる
+		const double ratio = (cookedBytes > 0) ? double(sourceBytes) / double(cookedBytes) : 0.0;
+		const double expectedRatio = (format == TextureCookFormat::BC1) ? 8.0 : 4.0;
+		const float requiredPsnr = (format == TextureCookFormat::BC7) ? 30.0f : 25.0f;
+		// 圧縮する画素の数（ミップマップまで含めると一番上のおよそ 4/3 倍）
+		const double megapixels = double(kSourceCount) * double(kTextureSize * kTextureSize) * 4.0 / 3.0 / 1.0e6;
+		std::printf("%ls: %u textures, %.1f KiB -> %.1f KiB (%.2fx), cook %.1f ms (compress %.1f ms, %.3f MPixel/s), min PSNR %.1f dB, errors %u\n",
+			GetTextureCookFormatName(format), kSourceCount, double(sourceBytes) / 1024.0, double(cookedBytes) / 1024.0, ratio,
+			cookMilliseconds, compressMilliseconds, megapixels / (compressMilliseconds / 1000.0), minimumPsnr[formatIndex], errors);
+		Check(errors == 0, "cooked DDS files have the expected format and mip chain");
+		Check(ratio > expectedRatio * 0.95, "cooked size is 1/8 (BC1) or 1/4 (BC3 / BC7) of RGBA8");
+		Check(minimumPsnr[formatIndex] >= requiredPsnr, "cooked quality reaches the required PSNR");
+	}
+	Check(minimumPsnr[2] > minimumPsnr[0], "BC7 is higher quality than BC1");
+}
+
+/// <summary>
+/// 既定の場所に DDS がなければ元の画像を、元の画像より新しい DDS があればそちらを読む
+/// </summary>
+void TestCookedLoad(const std::filesystem::path& sourcePath)
+{
+	const std::filesystem::path cookedPath = GetCookedTexturePath(sourcePath);
+	Check(ResolveCookedTexturePath(sourcePath) == sourcePath, "source is loaded before cooking");
+	const TextureCookResult cook = CookTexture(sourcePath, cookedPath, TextureCookFormat::BC7, TextureCookQuality::Fast, GetWorkerPool());
+	const std::filesystem::file_time_type sourceTime = std::filesystem::last_write_time(sourcePath);
+	// 同じ時刻なら、どちらが新しいかわからないので元の画像を読む
+	std::filesystem::last_write_time(cookedPath, sourceTime);
+	Check(ResolveCookedTexturePath(sourcePath) == sourcePath, "source is loaded when the cooked DDS has the same time");
+	std::filesystem::last_write_time(cookedPath, sourceTime + std::chrono::seconds(1));
+	Check(SUCCEEDED(cook.result) && ResolveCookedTexturePath(sourcePath) == cookedPath, "cooked DDS is loaded when newer");
+	DirectX::ScratchImage cookedLoad{};
+	double decodeMilliseconds = 0.0;
+	double mipMilliseconds = 0.0;
+	const bool cookedLoadCompressed = SUCCEEDED(DecodeTextureWithMips(sourcePath, cookedLoad, decodeMilliseconds, mipMilliseconds)) &&
+		cookedLoad.GetMetadata().format == DXGI_FORMAT_BC7_UNORM_SRGB && cookedLoad.GetMetadata().mipLevels == kExpectedMipLevels;
+	std::printf("runtime load of one cooked BC7 texture %.2f ms (mips %.2f ms)\n", decodeMilliseconds + mipMilliseconds, mipMilliseconds);
+	Check(cookedLoadCompressed, "cooked load is BC7 with mips and builds no mips");
+	// 元の画像を直したら（DDS より新しくなったら）、クックし直すまでは元の画像を読む
+	std::filesystem::last_write_time(sourcePath, sourceTime + std::chrono::seconds(2));
+	Check(ResolveCookedTexturePath(sourcePath) == sourcePath, "source is loaded when it is newer than the cooked DDS");
+}
+
+/// <summary>
+/// ビルドした TextureCooker（CMake が TEXTURE_COOKER_PATH に場所を入れる）を、arguments を付けて動かして終了コードを返す
+/// </summary>
+int RunTextureCooker(const std::string& arguments)
+{
+	std::string command = std::string("\"") + TEXTURE_COOKER_PATH + "\" " + arguments;
+#if defined(_WIN32)
+	// cmd は最初と最後の " を取り除くので、全体をもう一度囲む
+	command = "\"" + command + "\"";
+#endif
+	return std::system(command.c_str());
+}
+
+/// <summary>
+/// ビルドした TextureCooker を動かす。指定した画像の隣に DDS を書き出し、読めない画像があれば終了コードが 0 でなくなること
+/// </summary>
+void TestCookerTool(const std::filesystem::path& directory)
+{
+	const std::filesystem::path sourcePath = directory / "tool.tga";
+	const std::filesystem::path cookedPath = GetCookedTexturePath(sourcePath);
+	Check(WriteSourceTexture(sourcePath, 0, false), "tool source texture is written");
+	const int exitCode = RunTextureCooker("--bc1 \"" + sourcePath.string() + "\"");
+	DirectX::ScratchImage cooked{};
+	const bool loaded = SUCCEEDED(DirectX::LoadFromDDSFile(cookedPath.wstring().c_str(), DirectX::DDS_FLAGS_NONE, nullptr, cooked));
+	Check(exitCode == 0 && loaded && cooked.GetMetadata().format == DXGI_FORMAT_BC1_UNORM_SRGB && cooked.GetMetadata().mipLevels == kExpectedMipLevels,
+		"TextureCooker --bc1 writes a BC1 DDS with mips next to the source");
+	const int failedExitCode = RunTextureCooker("\"" + (directory / "missing.tga").string() + "\"");
+	Check(failedExitCode != 0, "TextureCooker fails for a missing source");
+}
+
+/// <summary>
+/// CompressImageParallel で BC7 に圧縮する。1 スレッドでも複数のスレッドでも、DirectX::Compress で1度に圧縮したものと
+/// バイト単位で同じになること。高さは 4 の倍数にせず、最後のブロックの行が半端でも同じになることも見る。
+/// 速さは出すだけで比べない（コアが1つしかない環境では複数のスレッドでも速くならない）
+/// </summary>
+void TestCompressImageParallel()
+{
+	const size_t kWidth = 128;
+	const size_t kHeight = 126;
+	DirectX::ScratchImage source{};
+	Check(SUCCEEDED(source.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, kWidth, kHeight, 1, 1)), "parallel compress source is allocated");
+	const DirectX::Image& image = *source.GetImage(0, 0, 0);
+	uint32_t random = 12345;
+	for (size_t y = 0; y < kHeight; ++y) {
+		uint8_t* row = image.pixels + y * image.rowPitch;
+		for (size_t x = 0; x < kWidth; ++x) {
+			// 行ごとに圧縮の手間が変わるよう、下の方ほどノイズを強くする
+			random = random * 1664525u + 1013904223u;
+			const uint8_t noise = uint8_t((random >> 24) * y / kHeight);
+			row[x * 4 + 0] = uint8_t(x + noise);
+			row[x * 4 + 1] = uint8_t(y + noise);
+			row[x * 4 + 2] = (((x >> 4) + (y >> 4)) % 2 == 0) ? 0xC0 : 0x40;
+			row[x * 4 + 3] = uint8_t(0xFF - noise / 2);
+		}
+	}
+	const DXGI_FORMAT format = GetCookedTextureFormat(TextureCookFormat::BC7, true);
+	// 今の環境のコアの数によらず、本当に複数のスレッドで動かすために専用のプールを使う
+	WorkerPool workerPool(4);
+	const uint32_t threadCounts[] = { 1, 2, 4 };
+	const double megapixels = double(kWidth) * double(kHeight) / 1.0e6;
+
+	for (TextureCookQuality quality : { TextureCookQuality::Fast, TextureCookQuality::Quality }) {
+		// quality はとても遅いので、上の方の帯だけで比べる
+		DirectX::Image input = image;
+		if (quality == TextureCookQuality::Quality) {
+			input.height = 18;
+			input.slicePitch = input.height * input.rowPitch;
+		}
+		const double inputMegapixels = megapixels * double(input.height) / double(kHeight);
+
+		DirectX::ScratchImage reference{};
+		HRESULT hr = E_FAIL;
+		const double referenceMilliseconds = MeasureNanoseconds(1, 1, [&] {
+			hr = DirectX::Compress(input, format, GetTextureCompressFlags(quality), DirectX::TEX_THRESHOLD_DEFAULT, reference);
+		}) / 1.0e6;
+		Check(SUCCEEDED(hr), "DirectX::Compress to BC7 succeeds");
+		std::printf("BC7 %ls %zux%zu, DirectX::Compress: %.1f ms, %.3f MPixel/s\n",
+			GetTextureCookQualityName(quality), input.width, input.height, referenceMilliseconds, inputMegapixels / (referenceMilliseconds / 1000.0));
+
+		bool identical = true;
+		double singleThreadMilliseconds = 0.0;
+		for (uint32_t threadCount : threadCounts) {
+			DirectX::ScratchImage compressed{};
+			hr = compressed.Initialize2D(format, input.width, input.height, 1, 1);
+			const double milliseconds = MeasureNanoseconds(1, 1, [&] {
+				hr = SUCCEEDED(hr) ? CompressImageParallel(input, format, GetTextureCompressFlags(quality), *compressed.GetImage(0, 0, 0), workerPool, threadCount) : hr;
+			}) / 1.0e6;
+			if (threadCount == 1) {
+				singleThreadMilliseconds = milliseconds;
+			}
+			const bool same = SUCCEEDED(hr) && compressed.GetPixelsSize() == reference.GetPixelsSize() &&
+				std::memcmp(compressed.GetPixels(), reference.GetPixels(), reference.GetPixelsSize()) == 0;
+			identical = identical && same;
+			std::printf("BC7 %ls, CompressImageParallel %u threads: %.1f ms, %.3f MPixel/s, %.2fx of 1 thread, identical %d\n",
+				GetTextureCookQualityName(quality), threadCount, milliseconds, inputMegapixels / (milliseconds / 1000.0),
+				singleThreadMilliseconds / milliseconds, same ? 1 : 0);
+		}
+		Check(identical, "CompressImageParallel matches DirectX::Compress byte for byte on 1, 2 and 4 threads");
+	}
+	std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+}
+
+} // namespace
+
+int main()
+{
+	// 書き出す場所（終わったら消す）
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "TextureCookingTest";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+	std::vector<std::filesystem::path> sourcePaths;
+	bool written = true;
+	for (uint32_t i = 0; i < kSourceCount; ++i) {
+		sourcePaths.push_back(directory / ("source" + std::to_string(i) + ".tga"));
+		// 最後の1枚だけアルファも変化させる
+		written = written && WriteSourceTexture(sourcePaths.back(), i, i == kSourceCount - 1);
+	}
+	Check(written, "source textures are written");
+	TestCookFormats(sourcePaths, directory);
+	TestCookedLoad(sourcePaths[0]);
+	TestCompressImageParallel();
+	TestCookerTool(directory);
+	std::error_code removeError;
+	std::filesystem::remove_all(directory, removeError);
+	return GetTestExitCode();
+}
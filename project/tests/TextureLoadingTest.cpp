@@ -0,0 +1,297 @@
+// TextureLoading.h のテストとベンチマーク（Linux でも動く。DirectXTex の DDS / TGA / HDR のコーデックを使う）。
+// DDS / TGA / HDR のテクスチャを書き出して、デコードした画素・作ったミップマップ・クック済みの DDS の選び方を確かめ、
+// 1枚ずつ順に読む場合と、LoadTextureAsync でワーカーに並べて読む場合の時間を比べる
+#include "TextureLoading.h"
+#include "TestUtility.h"
+#include <cstring>
+#include <cfloat>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+const size_t kTextureSize = 256;
+
+/// <summary>
+/// 模様と乱数の混ざった画像を作る（ミップマップの平均が自明にならないように）
+/// </summary>
+void MakeTestImages(uint32_t seed, DirectX::ScratchImage& colorImage, DirectX::ScratchImage& hdrImage)
+{
+	std::mt19937 random(seed);
+	[[maybe_unused]] HRESULT hr = colorImage.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, kTextureSize, kTextureSize, 1, 1);
+	assert(SUCCEEDED(hr));
+	hr = hdrImage.Initialize2D(DXGI_FORMAT_R32G32B32A32_FLOAT, kTextureSize, kTextureSize, 1, 1);
+	assert(SUCCEEDED(hr));
+	const DirectX::Image* color = colorImage.GetImage(0, 0, 0);
+	const DirectX::Image* hdr = hdrImage.GetImage(0, 0, 0);
+	for (size_t y = 0; y < kTextureSize; ++y) {
+		uint8_t* colorRow = color->pixels + y * color->rowPitch;
+		float* hdrRow = reinterpret_cast<float*>(hdr->pixels + y * hdr->rowPitch);
+		for (size_t x = 0; x < kTextureSize; ++x) {
+			const uint8_t noise = uint8_t(random() & 0x3F);
+			colorRow[x * 4 + 0] = uint8_t((x * 255) / kTextureSize) ^ noise;
+			colorRow[x * 4 + 1] = uint8_t((y * 255) / kTextureSize) ^ noise;
+			colorRow[x * 4 + 2] = (((x >> 5) + (y >> 5) + seed) % 2 == 0) ? 0xE0 : 0x20;
+			colorRow[x * 4 + 3] = 0xFF;
+			hdrRow[x * 4 + 0] = float(x) / float(kTextureSize) * 4.0f;
+			hdrRow[x * 4 + 1] = float(y) / float(kTextureSize) * 4.0f;
+			hdrRow[x * 4 + 2] = float(noise) / 16.0f;
+			hdrRow[x * 4 + 3] = 1.0f;
+		}
+	}
+}
+
+/// <summary>
+/// 1枚目のミップの RGB の平均
+/// </summary>
+void AverageRgb(const DirectX::Image& image, double average[3])
+{
+	average[0] = average[1] = average[2] = 0.0;
+	for (size_t y = 0; y < image.height; ++y) {
+		const float* row = reinterpret_cast<const float*>(image.pixels + y * image.rowPitch);
+		for (size_t x = 0; x < image.width; ++x) {
+			for (int c = 0; c < 3; ++c) {
+				average[c] += row[x * 4 + c];
+			}
+		}
+	}
+	for (int c = 0; c < 3; ++c) {
+		average[c] /= double(image.width * image.height);
+	}
+}
+
+/// <summary>
+/// 形式ごとの読み込み。デコードした画素が書き出したものと同じで、ミップマップが 1x1 まであり、HDR の 1x1 が全体の平均になること
+/// </summary>
+void TestDecode(const std::filesystem::path& directory)
+{
+	DirectX::ScratchImage colorImage{};
+	DirectX::ScratchImage hdrImage{};
+	MakeTestImages(1, colorImage, hdrImage);
+	const DirectX::Image& color = *colorImage.GetImage(0, 0, 0);
+	const DirectX::Image& hdr = *hdrImage.GetImage(0, 0, 0);
+	const std::filesystem::path tgaPath = directory / "decode.tga";
+	const std::filesystem::path ddsPath = directory / "decode-dds.dds";
+	const std::filesystem::path hdrPath = directory / "decode.hdr";
+	bool saved = SUCCEEDED(DirectX::SaveToTGAFile(color, DirectX::TGA_FLAGS_NONE, tgaPath.wstring().c_str(), &colorImage.GetMetadata()));
+	saved = saved && SUCCEEDED(DirectX::SaveToDDSFile(color, DirectX::DDS_FLAGS_NONE, ddsPath.wstring().c_str()));
+	saved = saved && SUCCEEDED(DirectX::SaveToHDRFile(hdr, hdrPath.wstring().c_str()));
+	Check(saved, "TGA / DDS / HDR files are written");
+
+	const size_t kMipLevels = 9; // 256 → 1
+	for (const std::filesystem::path& path : { tgaPath, ddsPath }) {
+		DirectX::ScratchImage mipImages{};
+		double decodeMilliseconds = 0.0;
+		double mipMilliseconds = 0.0;
+		const HRESULT hr = DecodeTextureWithMips(path, mipImages, decodeMilliseconds, mipMilliseconds);
+		const DirectX::TexMetadata& metadata = mipImages.GetMetadata();
+		const DirectX::Image* top = mipImages.GetImage(0, 0, 0);
+		const DirectX::Image* last = mipImages.GetImage(kMipLevels - 1, 0, 0);
+		const bool decoded = SUCCEEDED(hr) && metadata.format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB && metadata.mipLevels == kMipLevels &&
+			top->rowPitch == color.rowPitch && std::memcmp(top->pixels, color.pixels, color.slicePitch) == 0 && last->width == 1 && last->height == 1;
+		std::printf("%ls: decode %.2f ms, mips %.2f ms\n", path.filename().wstring().c_str(), decodeMilliseconds, mipMilliseconds);
+		Check(decoded, (path == tgaPath) ? "TGA decodes to the written sRGB pixels with a full mip chain" : "DDS decodes to the written sRGB pixels with a full mip chain");
+	}
+
+	// HDR は RGBE（共通の指数と 8 ビットの仮数）なので、値は 1/128 ほどの誤差で戻る
+	DirectX::ScratchImage hdrMips{};
+	double decodeMilliseconds = 0.0;
+	double mipMilliseconds = 0.0;
+	const HRESULT hr = DecodeTextureWithMips(hdrPath, hdrMips, decodeMilliseconds, mipMilliseconds);
+	std::printf("%ls: decode %.2f ms, mips %.2f ms\n", hdrPath.filename().wstring().c_str(), decodeMilliseconds, mipMilliseconds);
+	Check(SUCCEEDED(hr) && hdrMips.GetMetadata().format == DXGI_FORMAT_R32G32B32A32_FLOAT && hdrMips.GetMetadata().mipLevels == kMipLevels, "HDR decodes to float RGBA with a full mip chain");
+	if (SUCCEEDED(hr)) {
+		const DirectX::Image& top = *hdrMips.GetImage(0, 0, 0);
+		float maxRelativeError = 0.0f;
+		for (size_t y = 0; y < kTextureSize; ++y) {
+			const float* expected = reinterpret_cast<const float*>(hdr.pixels + y * hdr.rowPitch);
+			const float* actual = reinterpret_cast<const float*>(top.pixels + y * top.rowPitch);
+			for (size_t x = 0; x < kTextureSize; ++x) {
+				const float largest = std::max({ expected[x * 4 + 0], expected[x * 4 + 1], expected[x * 4 + 2] });
+				for (int c = 0; c < 3; ++c) {
+					maxRelativeError = std::max(maxRelativeError, std::fabs(actual[x * 4 + c] - expected[x * 4 + c]) / std::max(largest, 1e-3f));
+				}
+			}
+		}
+		// 線形の画像は、ミップマップを作っても平均は変わらない
+		double topAverage[3];
+		double lastAverage[3];
+		AverageRgb(top, topAverage);
+		AverageRgb(*hdrMips.GetImage(kMipLevels - 1, 0, 0), lastAverage);
+		double maxAverageError = 0.0;
+		for (int c = 0; c < 3; ++c) {
+			maxAverageError = std::max(maxAverageError, std::fabs(lastAverage[c] - topAverage[c]) / topAverage[c]);
+		}
+		std::printf("HDR: max relative pixel error %.4f, 1x1 mip vs image average error %.6f\n", maxRelativeError, maxAverageError);
+		Check(maxRelativeError < 1.0f / 64.0f, "HDR pixels round-trip within RGBE precision");
+		Check(maxAverageError < 1e-4, "1x1 mip of a linear image is the image average");
+	}
+}
+
+/// <summary>
+/// クック済みの DDS は、元の画像より新しいときだけ使う
+/// </summary>
+void TestCookedPath(const std::filesystem::path& directory)
+{
+	const std::filesystem::path sourcePath = directory / "cooked.tga";
+	const std::filesystem::path cookedPath = GetCookedTexturePath(sourcePath);
+	Check(cookedPath == directory / "cooked.dds", "cooked path replaces the extension with .dds");
+
+	DirectX::ScratchImage colorImage{};
+	DirectX::ScratchImage hdrImage{};
+	MakeTestImages(2, colorImage, hdrImage);
+	Check(ResolveCookedTexturePath(sourcePath) == sourcePath, "without a cooked DDS the source is used");
+	DirectX::SaveToDDSFile(*colorImage.GetImage(0, 0, 0), DirectX::DDS_FLAGS_NONE, cookedPath.wstring().c_str());
+	Check(ResolveCookedTexturePath(sourcePath) == cookedPath, "a cooked DDS without the source is used");
+	DirectX::SaveToTGAFile(*colorImage.GetImage(0, 0, 0), DirectX::TGA_FLAGS_NONE, sourcePath.wstring().c_str(), &colorImage.GetMetadata());
+	const std::filesystem::file_time_type sourceTime = std::filesystem::last_write_time(sourcePath);
+	std::filesystem::last_write_time(cookedPath, sourceTime + std::chrono::seconds(1));
+	Check(ResolveCookedTexturePath(sourcePath) == cookedPath, "a cooked DDS newer than the source is used");
+	std::filesystem::last_write_time(cookedPath, sourceTime);
+	Check(ResolveCookedTexturePath(sourcePath) == sourcePath, "a cooked DDS as old as the source is ignored");
+	std::filesystem::last_write_time(cookedPath, sourceTime - std::chrono::seconds(1));
+	Check(ResolveCookedTexturePath(sourcePath) == sourcePath, "a cooked DDS older than the source is ignored");
+}
+
+/// <summary>
+/// 1枚ずつ順に読む場合と、LoadTextureAsync でワーカーに並べて読む場合の時間を比べ、結果が同じかも確かめる
+/// </summary>
+void TestAsyncLoading(const std::filesystem::path& directory)
+{
+	const uint32_t kTexturesPerFormat = 8;
+	const int32_t kIterations = 3;
+
+	// 名前を形式ごとに分けておく（同じ名前の .dds があると、クック済みとしてそちらが読まれる）
+	std::vector<std::filesystem::path> filePaths;
+	bool saved = true;
+	for (uint32_t i = 0; i < kTexturesPerFormat; ++i) {
+		DirectX::ScratchImage colorImage{};
+		DirectX::ScratchImage hdrImage{};
+		MakeTestImages(i, colorImage, hdrImage);
+		const std::string index = std::to_string(i);
+		const std::filesystem::path tgaPath = directory / ("tga" + index + ".tga");
+		const std::filesystem::path ddsPath = directory / ("dds" + index + ".dds");
+		const std::filesystem::path hdrPath = directory / ("hdr" + index + ".hdr");
+		saved = saved && SUCCEEDED(DirectX::SaveToTGAFile(*colorImage.GetImage(0, 0, 0), DirectX::TGA_FLAGS_NONE, tgaPath.wstring().c_str(), &colorImage.GetMetadata()));
+		saved = saved && SUCCEEDED(DirectX::SaveToDDSFile(colorImage.GetImages(), colorImage.GetImageCount(), colorImage.GetMetadata(), DirectX::DDS_FLAGS_NONE, ddsPath.wstring().c_str()));
+		saved = saved && SUCCEEDED(DirectX::SaveToHDRFile(*hdrImage.GetImage(0, 0, 0), hdrPath.wstring().c_str()));
+		filePaths.push_back(tgaPath);
+		filePaths.push_back(ddsPath);
+		filePaths.push_back(hdrPath);
+	}
+	Check(saved, "benchmark textures are written");
+	const size_t textureCount = filePaths.size();
+
+	// 1枚ずつ順に読む（LoadTexture と同じ処理）
+	std::vector<DirectX::ScratchImage> sequentialImages(textureCount);
+	double sequentialMilliseconds = DBL_MAX;
+	double decodeMilliseconds = 0.0;
+	double mipMilliseconds = 0.0;
+	uint32_t sequentialFailures = 0;
+	for (int32_t iteration = 0; iteration < kIterations; ++iteration) {
+		double iterationDecodeMilliseconds = 0.0;
+		double iterationMipMilliseconds = 0.0;
+		sequentialFailures = 0;
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < textureCount; ++i) {
+			double decode = 0.0;
+			double mip = 0.0;
+			sequentialImages[i].Release();
+			sequentialFailures += FAILED(DecodeTextureWithMips(filePaths[i], sequentialImages[i], decode, mip)) ? 1 : 0;
+			iterationDecodeMilliseconds += decode;
+			iterationMipMilliseconds += mip;
+		}
+		// 一番速かった回の内訳を出す
+		const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		if (milliseconds < sequentialMilliseconds) {
+			sequentialMilliseconds = milliseconds;
+			decodeMilliseconds = iterationDecodeMilliseconds;
+			mipMilliseconds = iterationMipMilliseconds;
+		}
+	}
+
+	// ワーカーに全部積んでから、すべて終わるのを待つ
+	WorkerPool& workerPool = GetWorkerPool();
+	std::vector<TextureLoadHandle> loads(textureCount);
+	double asyncMilliseconds = DBL_MAX;
+	double submitMilliseconds = DBL_MAX;
+	for (int32_t iteration = 0; iteration < kIterations; ++iteration) {
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0; i < textureCount; ++i) {
+			loads[i] = LoadTextureAsync(filePaths[i], workerPool);
+		}
+		submitMilliseconds = std::min(submitMilliseconds, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+		for (const TextureLoadHandle& load : loads) {
+			WaitForTextureLoad(*load);
+		}
+		asyncMilliseconds = std::min(asyncMilliseconds, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+	}
+
+	// どちらで読んでも、ミップマップまで同じ画像になること
+	uint32_t asyncFailures = 0;
+	uint32_t mismatches = 0;
+	uint32_t missingMips = 0;
+	size_t totalBytes = 0;
+	for (size_t i = 0; i < textureCount; ++i) {
+		const TextureLoadJob& load = *loads[i];
+		if (!IsTextureLoadFinished(load) || load.state.load(std::memory_order_acquire) != TextureLoadState::Ready) {
+			++asyncFailures;
+			continue;
+		}
+		const DirectX::TexMetadata& expected = sequentialImages[i].GetMetadata();
+		const DirectX::TexMetadata& actual = load.mipImages.GetMetadata();
+		missingMips += (actual.mipLevels < 2) ? 1 : 0;
+		if (expected.format != actual.format || expected.mipLevels != actual.mipLevels || expected.width != actual.width ||
+			sequentialImages[i].GetPixelsSize() != load.mipImages.GetPixelsSize() ||
+			std::memcmp(sequentialImages[i].GetPixels(), load.mipImages.GetPixels(), load.mipImages.GetPixelsSize()) != 0) {
+			++mismatches;
+		}
+		totalBytes += load.mipImages.GetPixelsSize();
+	}
+
+	const uint32_t threadCount = workerPool.GetThreadCount();
+	const double speedup = sequentialMilliseconds / asyncMilliseconds;
+	std::printf("%zu textures (%zux%zu, TGA / DDS / HDR, %.1f MiB with mips), %u worker threads\n",
+		textureCount, kTextureSize, kTextureSize, double(totalBytes) / (1024.0 * 1024.0), threadCount);
+	std::printf("sequential %.2f ms (decode %.2f ms, mips %.2f ms), async %.2f ms (submit %.3f ms), %.2fx\n",
+		sequentialMilliseconds, decodeMilliseconds, mipMilliseconds, asyncMilliseconds, submitMilliseconds, speedup);
+	Check(sequentialFailures == 0 && asyncFailures == 0, "all textures load sequentially and asynchronously");
+	Check(mismatches == 0 && missingMips == 0, "async loads match sequential loads including mips");
+	// スレッドが1つしかなければ速くはならないので、そのときは結果が同じことだけを確かめる
+	Check(threadCount == 1 || speedup > 1.0, "async loading is faster when there is more than one worker thread");
+}
+
+/// <summary>
+/// 読めないファイルは Failed になり、待っても止まらないこと。プレースホルダーはすぐに使える形であること
+/// </summary>
+void TestFailureAndPlaceholder(const std::filesystem::path& directory)
+{
+	const TextureLoadHandle missingLoad = LoadTextureAsync(directory / "missing.dds", GetWorkerPool());
+	const bool missingFailed = WaitForTextureLoad(*missingLoad) == TextureLoadState::Failed;
+	Check(missingFailed && FAILED(missingLoad->result) && missingLoad->mipImages.GetImageCount() == 0, "missing file reports Failed without images");
+
+	// png は Windows では WIC で読み、それ以外ではコーデックがない（ファイルもないので、どちらでも Failed になる）
+	const TextureLoadHandle pngLoad = LoadTextureAsync(directory / "decode.png", GetWorkerPool());
+	Check(WaitForTextureLoad(*pngLoad) == TextureLoadState::Failed, "file without a codec reports Failed");
+
+	const DirectX::ScratchImage placeholder = MakePlaceholderTexture();
+	Check(placeholder.GetMetadata().format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB && placeholder.GetMetadata().mipLevels == 1, "placeholder is a ready sRGB texture");
+}
+
+} // namespace
+
+int main()
+{
+	// 書き出す場所（終わったら消す）
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "TextureLoadingTest";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+	TestDecode(directory);
+	TestCookedPath(directory);
+	TestAsyncLoading(directory);
+	TestFailureAndPlaceholder(directory);
+	std::error_code removeError;
+	std::filesystem::remove_all(directory, removeError);
+	return GetTestExitCode();
+}
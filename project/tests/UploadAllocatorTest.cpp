@@ -0,0 +1,176 @@
+// UploadAllocator.h のテスト（Linux でも動く）。
+// ページを CPU のメモリで用意する backend で UploadPageAllocator を動かし、バッファごとに CreateCommittedResource する場合と
+// ヒープの数と確保する量を比べる。フレームごとの切り出しは FrameRing と SimulatedFence で動かして、
+// GPU がまだ読んでいる領域を切り出さないこと・境界がそろっていること・ページが増え続けないことを確かめる
+#include "UploadAllocator.h"
+#include "FrameRing.h"
+#include "TestUtility.h"
+#include <cmath>
+#include <random>
+
+namespace {
+
+// ページを作った回数だけを数える backend
+struct CountingPageBackend
+{
+	uint32_t createdPages = 0;
+	void CreatePage(uint32_t, uint64_t) { ++createdPages; }
+};
+
+// ページのメモリを CPU のメモリで用意する backend。バイトごとに、最後に書いたフレームのフェンスの値を持つ
+struct HeapPageBackend
+{
+	std::vector<std::vector<uint64_t>> writtenFenceValues;
+	void CreatePage([[maybe_unused]] uint32_t pageIndex, uint64_t size)
+	{
+		assert(pageIndex == writtenFenceValues.size());
+		writtenFenceValues.emplace_back(size_t(size), 0);
+	}
+};
+
+/// <summary>
+/// 静的なジオメトリ（メッシュごとの頂点・インデックスバッファ）。大きさは 64B から 512KiB まで対数で散らす
+/// </summary>
+void TestStaticGeometry(std::mt19937& random)
+{
+	const uint32_t kBufferCount = 400;
+	std::uniform_real_distribution<float> logSize(6.0f, 19.0f);
+	std::vector<uint64_t> sizes(kBufferCount);
+	uint64_t committedBytes = 0;
+	for (uint64_t& size : sizes) {
+		size = static_cast<uint64_t>(exp2f(logSize(random)));
+		committedBytes += AlignUp(size, kUploadPageGranularity);
+	}
+
+	CountingPageBackend backend;
+	UploadPageAllocator allocator;
+	InitializeUploadPageAllocator(allocator, 4 * 1024 * 1024);
+	std::vector<UploadAllocation> allocations;
+	const double nanoseconds = MeasureNanoseconds(1, kBufferCount, [&] {
+		for (uint64_t size : sizes) {
+			allocations.push_back(AllocateUpload(allocator, backend, size, 16));
+		}
+	});
+
+	// 切り出した領域が重ならず、境界がそろっていること
+	std::sort(allocations.begin(), allocations.end(), [](const UploadAllocation& a, const UploadAllocation& b) {
+		return (a.pageIndex != b.pageIndex) ? (a.pageIndex < b.pageIndex) : (a.offset < b.offset);
+	});
+	uint32_t overlaps = 0;
+	uint32_t misaligned = 0;
+	for (size_t i = 0; i < allocations.size(); ++i) {
+		misaligned += (allocations[i].offset % 16 != 0) ? 1 : 0;
+		overlaps += (allocations[i].offset + allocations[i].size > allocator.pages[allocations[i].pageIndex].size) ? 1 : 0;
+		if (i > 0 && allocations[i - 1].pageIndex == allocations[i].pageIndex) {
+			overlaps += (allocations[i - 1].offset + allocations[i - 1].size > allocations[i].offset) ? 1 : 0;
+		}
+	}
+	const uint64_t pageBytes = GetUploadPageBytes(allocator);
+	std::printf("static geometry: %u buffers (%llu KiB) -> committed: %u heaps, %llu KiB; suballocated: %zu pages, %llu KiB (%.2fx less), %.1f ns per allocation, %u overlaps, %u misaligned\n",
+		kBufferCount, static_cast<unsigned long long>(allocator.requestedBytes / 1024), kBufferCount, static_cast<unsigned long long>(committedBytes / 1024),
+		allocator.pages.size(), static_cast<unsigned long long>(pageBytes / 1024), double(committedBytes) / double(pageBytes), nanoseconds, overlaps, misaligned);
+	Check(overlaps == 0 && misaligned == 0, "static allocations do not overlap and are aligned");
+	Check(allocator.pages.size() < kBufferCount && pageBytes < committedBytes && backend.createdPages == allocator.pages.size(), "suballocation uses fewer heaps and less memory than committed buffers");
+}
+
+/// <summary>
+/// 1フレームの定数バッファ（マテリアルなど 96 バイトを 256 バイト境界に）が1枚のページに収まること
+/// </summary>
+void TestConstants()
+{
+	const uint32_t kConstantBufferCount = 500;
+	// main.cpp の Material の大きさ
+	const uint64_t kConstantBufferSize = 96;
+	CountingPageBackend backend;
+	UploadPageAllocator allocator;
+	InitializeUploadPageAllocator(allocator, 1024 * 1024);
+	for (uint32_t i = 0; i < kConstantBufferCount; ++i) {
+		AllocateUpload(allocator, backend, kConstantBufferSize, 256);
+	}
+	const uint64_t committedBytes = uint64_t(kConstantBufferCount) * kUploadPageGranularity;
+	std::printf("constants: %u x %llu bytes -> committed: %llu KiB; suballocated: %zu page(s), %llu KiB used (%llu bytes of 256-byte alignment padding)\n",
+		kConstantBufferCount, static_cast<unsigned long long>(kConstantBufferSize), static_cast<unsigned long long>(committedBytes / 1024), allocator.pages.size(),
+		static_cast<unsigned long long>((allocator.requestedBytes + allocator.paddingBytes) / 1024), static_cast<unsigned long long>(allocator.paddingBytes));
+	Check(allocator.pages.size() == 1, "a frame of constants fits in one page");
+}
+
+/// <summary>
+/// フレームごとの切り出しの耐久テスト。GPU のほうが遅く、CPU は常に数フレーム先を書いている
+/// </summary>
+void TestFrameStress(std::mt19937& random)
+{
+	const uint32_t kFrameCount = 2000;
+	const uint64_t kPageSize = 64 * 1024;
+	FrameRing ring;
+	InitializeFrameRing(ring, kMaxFramesInFlight);
+	SimulatedFence fence;
+	fence.gpuFrameTime = 6.0;
+	HeapPageBackend backend;
+	UploadPageAllocator allocator;
+	InitializeUploadPageAllocator(allocator, kPageSize);
+
+	std::uniform_int_distribution<uint32_t> allocationsPerFrame(1, 40);
+	std::uniform_int_distribution<uint32_t> smallSize(1, 8 * 1024);
+	std::uniform_int_distribution<uint32_t> alignmentShift(0, 8);
+	std::uniform_int_distribution<uint32_t> percent(0, 99);
+	const uint64_t largeSizes[] = { 80 * 1024, 128 * 1024, 192 * 1024 };
+	std::uniform_int_distribution<uint32_t> largeSize(0, 2);
+
+	uint64_t overwrittenBytes = 0;
+	uint32_t misaligned = 0;
+	uint64_t maxFrameBytes = 0;
+	size_t pagesAtHalf = 0;
+	for (uint32_t frame = 0; frame < kFrameCount; ++frame) {
+		BeginFrame(ring, fence);
+		const uint64_t completedValue = fence.GetCompletedValue();
+		RecycleUploadPages(allocator, completedValue);
+		// このフレームの終わりで Signal する値
+		const uint64_t frameFenceValue = ring.lastSignaledValue + 1;
+		uint64_t frameBytes = 0;
+		const uint32_t allocationCount = allocationsPerFrame(random);
+		for (uint32_t i = 0; i < allocationCount; ++i) {
+			const uint64_t size = (percent(random) < 2) ? largeSizes[largeSize(random)] : smallSize(random);
+			const uint64_t alignment = uint64_t(1) << alignmentShift(random);
+			const UploadAllocation allocation = AllocateUpload(allocator, backend, size, alignment);
+			misaligned += (allocation.offset % alignment != 0) ? 1 : 0;
+			// GPU が読み終えていない（このフレームを含む）フレームの書いたバイトを上書きしていないこと
+			std::vector<uint64_t>& written = backend.writtenFenceValues[allocation.pageIndex];
+			for (uint64_t byte = allocation.offset; byte < allocation.offset + allocation.size; ++byte) {
+				overwrittenBytes += (written[byte] > completedValue) ? 1 : 0;
+				written[byte] = frameFenceValue;
+			}
+			frameBytes += size;
+		}
+		maxFrameBytes = std::max(maxFrameBytes, frameBytes);
+		fence.now += 4.0;
+		EndFrame(ring, fence);
+		FinishFrameUploads(allocator, ring.lastSignaledValue);
+		if (frame == kFrameCount / 2) {
+			pagesAtHalf = allocator.pages.size();
+		}
+	}
+	WaitForGpuIdle(ring, fence);
+	RecycleUploadPages(allocator, fence.GetCompletedValue());
+
+	// GPU が読んでいる可能性のあるフレーム（kMaxFramesInFlight）と今のフレームの分を超えてページが増えないこと
+	const uint64_t pageBytes = GetUploadPageBytes(allocator);
+	const uint64_t pageBytesBound = (kMaxFramesInFlight + 1) * (maxFrameBytes + 2 * largeSizes[2] + kPageSize);
+	std::printf("stress: %u frames, %llu allocations (%llu MiB), %u frames in flight, %llu waits: %zu pages (%llu KiB, bound %llu KiB; %zu pages at frame %u), %llu bytes overwritten while in use, %u misaligned\n",
+		kFrameCount, static_cast<unsigned long long>(allocator.allocationCount), static_cast<unsigned long long>(allocator.requestedBytes / (1024 * 1024)),
+		kMaxFramesInFlight, static_cast<unsigned long long>(ring.waitCount), allocator.pages.size(), static_cast<unsigned long long>(pageBytes / 1024),
+		static_cast<unsigned long long>(pageBytesBound / 1024), pagesAtHalf, kFrameCount / 2, static_cast<unsigned long long>(overwrittenBytes), misaligned);
+	Check(overwrittenBytes == 0, "no bytes are reused while the GPU may still read them");
+	Check(misaligned == 0, "per-frame allocations are aligned");
+	Check(pageBytes <= pageBytesBound && allocator.retiredPages.empty(), "pages stay bounded and are all recycled after the GPU is idle");
+}
+
+} // namespace
+
+int main()
+{
+	std::mt19937 random(20);
+	TestStaticGeometry(random);
+	TestConstants();
+	TestFrameStress(random);
+	return GetTestExitCode();
+}
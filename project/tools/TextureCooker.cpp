@@ -0,0 +1,77 @@
+// テクスチャのクックを行うコマンドラインのツール（アプリ本体とは別に、ウィンドウを作らずに動く）。
+// 元の画像の隣に、拡張子だけを .dds にしたファイルを書き出し、大きさと時間を出す。1枚でも失敗したら終了コードは 1
+//
+// 使い方: TextureCooker [--bc1 | --bc3 | --bc7] [--fast] [元の画像...]
+//   --bc1 / --bc3 / --bc7  圧縮の形式（既定は BC7）
+//   --fast                 BC7 をモード 6 だけで圧縮する（既定は quality）
+//   元の画像を指定しなければ、シーンのテクスチャ（kSceneTextureFilePaths）を今のフォルダーからの相対パスでクックする
+#include "TextureCooking.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#if defined(_WIN32)
+#include <objbase.h> // CoInitializeEx 用（png などは WIC で読む）
+#endif
+
+int main(int argc, char* argv[])
+{
+	TextureCookFormat format = TextureCookFormat::BC7;
+	TextureCookQuality quality = TextureCookQuality::Quality;
+	std::vector<std::filesystem::path> sourcePaths;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--bc1") == 0) {
+			format = TextureCookFormat::BC1;
+		} else if (std::strcmp(argv[i], "--bc3") == 0) {
+			format = TextureCookFormat::BC3;
+		} else if (std::strcmp(argv[i], "--bc7") == 0) {
+			format = TextureCookFormat::BC7;
+		} else if (std::strcmp(argv[i], "--fast") == 0) {
+			quality = TextureCookQuality::Fast;
+		} else if (std::strncmp(argv[i], "--", 2) == 0) {
+			std::fprintf(stderr, "unknown option: %s\nusage: TextureCooker [--bc1 | --bc3 | --bc7] [--fast] [source images...]\n", argv[i]);
+			return 2;
+		} else {
+			sourcePaths.emplace_back(argv[i]);
+		}
+	}
+	if (sourcePaths.empty()) {
+		for (const char* sourceFile : kSceneTextureFilePaths) {
+			sourcePaths.emplace_back(sourceFile);
+		}
+	}
+
+#if defined(_WIN32)
+	const HRESULT comResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+#endif
+	WorkerPool& workerPool = GetWorkerPool();
+	uint32_t failures = 0;
+	size_t totalSourceBytes = 0;
+	size_t totalCookedBytes = 0;
+	double totalMilliseconds = 0.0;
+	for (const std::filesystem::path& sourcePath : sourcePaths) {
+		const std::filesystem::path cookedPath = GetCookedTexturePath(sourcePath);
+		const TextureCookResult cook = CookTexture(sourcePath, cookedPath, format, quality, workerPool);
+		if (FAILED(cook.result)) {
+			std::printf("[cook] %ls: failed. HRESULT: 0x%08X\n", sourcePath.wstring().c_str(), static_cast<uint32_t>(cook.result));
+			++failures;
+			continue;
+		}
+		const double milliseconds = cook.decodeMilliseconds + cook.mipMilliseconds + cook.compressMilliseconds + cook.saveMilliseconds;
+		std::printf("[cook] %ls -> %ls (%ls %ls %zux%zu, %zu mips): %.1f KiB -> %.1f KiB (%.1fx), file %.1f KiB, decode %.1f ms, mips %.1f ms, compress %.1f ms, save %.1f ms\n",
+			sourcePath.wstring().c_str(), cookedPath.wstring().c_str(), GetTextureCookFormatName(format), GetTextureCookQualityName(quality), cook.width, cook.height, cook.mipLevels,
+			double(cook.sourceBytes) / 1024.0, double(cook.cookedBytes) / 1024.0, double(cook.sourceBytes) / double(cook.cookedBytes), double(cook.fileBytes) / 1024.0,
+			cook.decodeMilliseconds, cook.mipMilliseconds, cook.compressMilliseconds, cook.saveMilliseconds);
+		totalSourceBytes += cook.sourceBytes;
+		totalCookedBytes += cook.cookedBytes;
+		totalMilliseconds += milliseconds;
+	}
+	std::printf("[cook] %zu textures cooked, %u failed: %.1f KiB -> %.1f KiB, %.1f ms on %u threads\n",
+		sourcePaths.size() - failures, failures, double(totalSourceBytes) / 1024.0, double(totalCookedBytes) / 1024.0, totalMilliseconds,
+		workerPool.GetThreadCount());
+#if defined(_WIN32)
+	if (SUCCEEDED(comResult)) {
+		CoUninitialize();
+	}
+#endif
+	return (failures == 0) ? 0 : 1;
+}